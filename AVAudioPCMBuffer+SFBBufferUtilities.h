@@ -97,7 +97,22 @@ NS_ASSUME_NONNULL_BEGIN
 - (BOOL)isFull;
 
 /// Returns @c YES if @c self contains only digital silence
+/// @note The samples are compared in blocks that may be vectorized, stopping at the first block containing a non-silent sample
 - (BOOL)isDigitalSilence;
+
+/// Returns @c YES if the magnitude of every sample in @c self is at most @c threshold
+/// @note Only native-endian @c float, @c double, @c int16_t, and @c int32_t formats are supported
+/// @param threshold The maximum magnitude of a silent sample as a linear amplitude, where full scale is @c 1
+/// @return @c YES if the audio is silent, @c NO if it is not or the format is unsupported
+- (BOOL)isSilentBelowThreshold:(float)threshold NS_SWIFT_NAME(isSilent(below:));
+
+/// Computes the peak and RMS level of each channel in @c self in a single pass
+/// @note Only native-endian @c float, @c double, @c int16_t, and @c int32_t formats are supported
+/// @note The levels are linear amplitudes, where full scale is @c 1
+/// @param peakLevels An array of @c self.format.channelCount values to receive the peak level of each channel
+/// @param rmsLevels An array of @c self.format.channelCount values to receive the RMS level of each channel
+/// @return @c YES on success, @c NO if the format is unsupported
+- (BOOL)getPeakLevels:(float *)peakLevels rmsLevels:(float *)rmsLevels NS_SWIFT_NAME(getLevels(peak:rms:));
 @end
 
 NS_ASSUME_NONNULL_END
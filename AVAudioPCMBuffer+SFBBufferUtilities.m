@@ -4,8 +4,136 @@
 // MIT license
 //
 
+#import <libkern/OSByteOrder.h>
+
+#import <Accelerate/Accelerate.h>
+
 #import "AVAudioPCMBuffer+SFBBufferUtilities.h"
 
+/// The number of samples examined at once by the signal analysis methods
+#define SFBScanBlockSize 1024
+
+/// Defines a function returning @c YES if @c (sample&mask)==value for all @c sampleCount samples in @c buffer
+///
+/// The samples are compared in blocks that compilers can vectorize, stopping after the first block containing a mismatch.
+#define SFB_DEFINE_ALL_SAMPLES_MATCH(name, type) \
+static BOOL name(const void *buffer, size_t sampleCount, type mask, type value) \
+{ \
+	const type *samples = (const type *)buffer; \
+	while(sampleCount) { \
+		const size_t count = MIN(sampleCount, (size_t)SFBScanBlockSize); \
+		type difference = 0; \
+		for(size_t i = 0; i < count; ++i) \
+			difference |= (samples[i] & mask) ^ value; \
+		if(difference) \
+			return NO; \
+		samples += count; \
+		sampleCount -= count; \
+	} \
+	return YES; \
+}
+
+SFB_DEFINE_ALL_SAMPLES_MATCH(SFBAllSamplesMatch8, uint8_t)
+SFB_DEFINE_ALL_SAMPLES_MATCH(SFBAllSamplesMatch16, uint16_t)
+SFB_DEFINE_ALL_SAMPLES_MATCH(SFBAllSamplesMatch32, uint32_t)
+SFB_DEFINE_ALL_SAMPLES_MATCH(SFBAllSamplesMatch64, uint64_t)
+
+/// Returns @c YES if all @c sampleCount packed 24-bit samples in @c buffer are equal to @c value
+/// @param value The three bytes of a silent sample in memory order
+static BOOL SFBAllPackedSamplesMatch(const void *buffer, size_t sampleCount, const uint8_t value[3])
+{
+	// Silence for signed samples is all zero bytes
+	if(!value[0] && !value[1] && !value[2])
+		return SFBAllSamplesMatch8(buffer, 3 * sampleCount, 0xff, 0);
+
+	const uint8_t *samples = (const uint8_t *)buffer;
+	while(sampleCount) {
+		const size_t count = MIN(sampleCount, (size_t)SFBScanBlockSize);
+		uint8_t difference = 0;
+		for(size_t i = 0; i < count; ++i)
+			difference |= (samples[3 * i] ^ value[0]) | (samples[3 * i + 1] ^ value[1]) | (samples[3 * i + 2] ^ value[2]);
+		if(difference)
+			return NO;
+		samples += 3 * count;
+		sampleCount -= count;
+	}
+	return YES;
+}
+
+/// Sample formats supported by the signal analysis methods
+typedef NS_ENUM(NSInteger, SFBScanFormat) {
+	/// The format is not supported
+	SFBScanFormatUnsupported,
+	/// Native-endian @c float
+	SFBScanFormatFloat32,
+	/// Native-endian @c double
+	SFBScanFormatFloat64,
+	/// Native-endian @c int16_t
+	SFBScanFormatInt16,
+	/// Native-endian @c int32_t
+	SFBScanFormatInt32,
+};
+
+/// Returns the @c SFBScanFormat corresponding to @c asbd
+static SFBScanFormat SFBScanFormatForFormat(const AudioStreamBasicDescription *asbd)
+{
+	const UInt32 interleavedChannelCount = asbd->mFormatFlags & kAudioFormatFlagIsNonInterleaved ? 1 : asbd->mChannelsPerFrame;
+	if(asbd->mFormatID != kAudioFormatLinearPCM || !interleavedChannelCount || (asbd->mFormatFlags & kAudioFormatFlagIsBigEndian) != kAudioFormatFlagsNativeEndian || asbd->mBitsPerChannel != 8 * (asbd->mBytesPerFrame / interleavedChannelCount))
+		return SFBScanFormatUnsupported;
+
+	if(asbd->mFormatFlags & kAudioFormatFlagIsFloat) {
+		if(asbd->mBitsPerChannel == 32)
+			return SFBScanFormatFloat32;
+		else if(asbd->mBitsPerChannel == 64)
+			return SFBScanFormatFloat64;
+	}
+	else if(asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger) {
+		if(asbd->mBitsPerChannel == 16)
+			return SFBScanFormatInt16;
+		else if(asbd->mBitsPerChannel == 32)
+			return SFBScanFormatInt32;
+	}
+
+	return SFBScanFormatUnsupported;
+}
+
+/// Returns the size in bytes of a sample in @c format
+static size_t SFBScanFormatSampleSize(SFBScanFormat format)
+{
+	switch(format) {
+		case SFBScanFormatFloat32:		return sizeof(float);
+		case SFBScanFormatFloat64:		return sizeof(double);
+		case SFBScanFormatInt16:		return sizeof(int16_t);
+		case SFBScanFormatInt32:		return sizeof(int32_t);
+		default:						return 0;
+	}
+}
+
+/// Converts @c count samples spaced @c stride samples apart to normalized @c float
+/// @return @c samples if @c format is @c SFBScanFormatFloat32, otherwise @c block containing contiguous converted samples
+static const float * SFBConvertBlock(const void *samples, vDSP_Stride stride, vDSP_Length count, SFBScanFormat format, float *block)
+{
+	switch(format) {
+		case SFBScanFormatFloat64:
+			vDSP_vdpsp((const double *)samples, stride, block, 1, count);
+			return block;
+		case SFBScanFormatInt16: {
+			vDSP_vflt16((const short *)samples, stride, block, 1, count);
+			const float scale = 1.f / 32768.f;
+			vDSP_vsmul(block, 1, &scale, block, 1, count);
+			return block;
+		}
+		case SFBScanFormatInt32: {
+			vDSP_vflt32((const int *)samples, stride, block, 1, count);
+			const float scale = 1.f / 2147483648.f;
+			vDSP_vsmul(block, 1, &scale, block, 1, count);
+			return block;
+		}
+		default:
+			return (const float *)samples;
+	}
+}
+
 @implementation AVAudioPCMBuffer (SFBBufferUtilities)
 
 - (AVAudioFrameCount)prependContentsOfBuffer:(AVAudioPCMBuffer *)buffer
@@ -183,201 +311,151 @@
 	const AudioStreamBasicDescription *asbd = self.format.streamDescription;
 	const AudioBufferList *abl = self.audioBufferList;
 
+	const UInt32 interleavedChannelCount = asbd->mFormatFlags & kAudioFormatFlagIsNonInterleaved ? 1 : asbd->mChannelsPerFrame;
+	const UInt32 bytesPerSample = asbd->mBytesPerFrame / interleavedChannelCount;
+	const size_t sampleCount = (size_t)self.frameLength * interleavedChannelCount;
+
+	// The value of silent samples after masking, which for floating point ignores the sign bit so -0 is silent
+	uint64_t mask = UINT64_MAX;
+	uint64_t silence = 0;
+
 	// Floating point
 	if(asbd->mFormatFlags & kAudioFormatFlagIsFloat) {
 		NSAssert(asbd->mBitsPerChannel == 32 || asbd->mBitsPerChannel == 64, @"Unsupported mBitsPerChannel %d for kAudioFormatFlagIsFloat", asbd->mBitsPerChannel);
-		if(asbd->mBitsPerChannel == 32) {
-			for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-				const float *buf = (const float *)abl->mBuffers[i].mData;
-				for(UInt32 sampleNumber = 0; i < abl->mBuffers[i].mDataByteSize / sizeof(float); ++sampleNumber) {
-					if(buf[sampleNumber] != 0)
-						return NO;
-				}
-			}
-			return YES;
-		}
-		else if(asbd->mBitsPerChannel == 64) {
-			for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-				const double *buf = (const double *)abl->mBuffers[i].mData;
-				for(UInt32 sampleNumber = 0; i < abl->mBuffers[i].mDataByteSize / sizeof(double); ++sampleNumber) {
-					if(buf[sampleNumber] != 0)
-						return NO;
-				}
-			}
-			return YES;
-		}
+		if(bytesPerSample != 4 && bytesPerSample != 8)
+			return NO;
+		mask = ~((uint64_t)1 << ((bytesPerSample * 8) - 1));
 	}
 	// Integer
 	else {
-		const UInt32 interleavedChannelCount = asbd->mFormatFlags & kAudioFormatFlagIsNonInterleaved ? 1 : asbd->mChannelsPerFrame;
-		const UInt32 bytesPerSample = asbd->mBytesPerFrame / interleavedChannelCount;
-
 		NSAssert(bytesPerSample == 1 || bytesPerSample == 2 || bytesPerSample == 3 || bytesPerSample == 4 || bytesPerSample == 8, @"Unsupported sample width %d", bytesPerSample);
+		// Unsigned silence is the midpoint of the sample range
+		if(!(asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger)) {
+			const UInt32 shift = (bytesPerSample * 8) - asbd->mBitsPerChannel;
+			silence = (uint64_t)1 << ((asbd->mBitsPerChannel - 1) + (asbd->mFormatFlags & kAudioFormatFlagIsAlignedHigh ? shift : 0));
+		}
+	}
 
-		// Integer, packed
-		if(asbd->mFormatFlags & kAudioFormatFlagIsPacked /*|| ((asbd->mBitsPerChannel / 8) * asbd->mChannelsPerFrame) == asbd->mBytesPerFrame*/) {
-			switch(bytesPerSample) {
-				case 1: {
-					const uint8_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : 0x80;
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint8_t *buf = (const uint8_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-				case 2: {
-					const uint16_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : 0x8000;
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint16_t *buf = (const uint16_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-				case 3: {
-					const uint32_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : 0x800000;
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint8_t *buf = (const uint8_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							uint32_t sample = 0;
-							if(asbd->mFormatFlags & kAudioFormatFlagIsBigEndian) {
-								sample |= (*buf++ << 16) & 0xff0000;
-								sample |= (*buf++ << 8) & 0xff00;
-								sample |= *buf++ & 0xff;
-							}
-							else {
-								sample |= *buf++ & 0xff;
-								sample |= (*buf++ << 8) & 0xff00;
-								sample |= (*buf++ << 16) & 0xff0000;
-							}
-							if(sample != silence)
-								return NO;
-						}
-					}
-					return YES;
-				}
-				case 4: {
-					const uint32_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : 0x80000000;
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint32_t *buf = (const uint32_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-				case 8: {
-					const uint64_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : 0x8000000000000000;
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint64_t *buf = (const uint64_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-			}
+	if(bytesPerSample == 3) {
+		uint8_t value[3];
+		if(asbd->mFormatFlags & kAudioFormatFlagIsBigEndian) {
+			value[0] = (uint8_t)(silence >> 16);
+			value[1] = (uint8_t)(silence >> 8);
+			value[2] = (uint8_t)silence;
 		}
-		// Integer, unpacked
 		else {
-			const size_t shift = (bytesPerSample * 8) - asbd->mBitsPerChannel;
-			switch(bytesPerSample) {
-				case 1: {
-					const uint8_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : (uint8_t)(1 << ((asbd->mBitsPerChannel - 1) + (asbd->mFormatFlags & kAudioFormatFlagIsAlignedHigh ? shift : 0)));
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint8_t *buf = (const uint8_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-				case 2: {
-					const uint16_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : (uint16_t)(1 << ((asbd->mBitsPerChannel - 1) + (asbd->mFormatFlags & kAudioFormatFlagIsAlignedHigh ? shift : 0)));
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint16_t *buf = (const uint16_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-				case 3: {
-					const uint32_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : (uint32_t)(1 << ((asbd->mBitsPerChannel - 1) + (asbd->mFormatFlags & kAudioFormatFlagIsAlignedHigh ? shift : 0)));
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint8_t *buf = (const uint8_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							uint32_t sample = 0;
-							if(asbd->mFormatFlags & kAudioFormatFlagIsBigEndian) {
-								sample |= (*buf++ << 16) & 0xff0000;
-								sample |= (*buf++ << 8) & 0xff00;
-								sample |= *buf++ & 0xff;
-							}
-							else {
-								sample |= *buf++ & 0xff;
-								sample |= (*buf++ << 8) & 0xff00;
-								sample |= (*buf++ << 16) & 0xff0000;
-							}
-							if(sample != silence)
-								return NO;
-						}
-					}
-					return YES;
-				}
-				case 4: {
-					const uint32_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : (uint32_t)(1 << ((asbd->mBitsPerChannel - 1) + (asbd->mFormatFlags & kAudioFormatFlagIsAlignedHigh ? shift : 0)));
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint32_t *buf = (const uint32_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-				case 8: {
-					const uint64_t silence = asbd->mFormatFlags & kAudioFormatFlagIsSignedInteger ? 0 : (uint64_t)(1 << ((asbd->mBitsPerChannel - 1) + (asbd->mFormatFlags & kAudioFormatFlagIsAlignedHigh ? shift : 0)));
-					for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
-						const uint64_t *buf = (const uint64_t *)abl->mBuffers[i].mData;
-						size_t sampleCount = abl->mBuffers[i].mDataByteSize / bytesPerSample;
-						while(sampleCount--) {
-							if(*buf != silence)
-								return NO;
-							++buf;
-						}
-					}
-					return YES;
-				}
-			}
+			value[0] = (uint8_t)silence;
+			value[1] = (uint8_t)(silence >> 8);
+			value[2] = (uint8_t)(silence >> 16);
+		}
+		for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
+			if(!SFBAllPackedSamplesMatch(abl->mBuffers[i].mData, sampleCount, value))
+				return NO;
+		}
+		return YES;
+	}
+
+	// Compare samples in their stored byte order
+	const BOOL swap = (asbd->mFormatFlags & kAudioFormatFlagIsBigEndian) != kAudioFormatFlagsNativeEndian;
+
+	for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
+		const void *data = abl->mBuffers[i].mData;
+		BOOL match;
+		switch(bytesPerSample) {
+			case 1:
+				match = SFBAllSamplesMatch8(data, sampleCount, (uint8_t)mask, (uint8_t)silence);
+				break;
+			case 2:
+				match = SFBAllSamplesMatch16(data, sampleCount, swap ? OSSwapInt16((uint16_t)mask) : (uint16_t)mask, swap ? OSSwapInt16((uint16_t)silence) : (uint16_t)silence);
+				break;
+			case 4:
+				match = SFBAllSamplesMatch32(data, sampleCount, swap ? OSSwapInt32((uint32_t)mask) : (uint32_t)mask, swap ? OSSwapInt32((uint32_t)silence) : (uint32_t)silence);
+				break;
+			case 8:
+				match = SFBAllSamplesMatch64(data, sampleCount, swap ? OSSwapInt64(mask) : mask, swap ? OSSwapInt64(silence) : silence);
+				break;
+			default:
+				return NO;
+		}
+		if(!match)
+			return NO;
+	}
+
+	return YES;
+}
+
+- (BOOL)isSilentBelowThreshold:(float)threshold
+{
+	const AudioStreamBasicDescription *asbd = self.format.streamDescription;
+	const SFBScanFormat format = SFBScanFormatForFormat(asbd);
+	if(format == SFBScanFormatUnsupported)
+		return NO;
+
+	const AudioBufferList *abl = self.audioBufferList;
+	const UInt32 interleavedChannelCount = asbd->mFormatFlags & kAudioFormatFlagIsNonInterleaved ? 1 : asbd->mChannelsPerFrame;
+	const vDSP_Length sampleCount = (vDSP_Length)self.frameLength * interleavedChannelCount;
+
+	// For silence detection the channels don't need to be distinguished
+	float block[SFBScanBlockSize];
+	for(UInt32 i = 0; i < abl->mNumberBuffers; ++i) {
+		const uint8_t *samples = (const uint8_t *)abl->mBuffers[i].mData;
+		vDSP_Length remaining = sampleCount;
+		while(remaining) {
+			const vDSP_Length count = MIN(remaining, (vDSP_Length)SFBScanBlockSize);
+			float peak;
+			vDSP_maxmgv(SFBConvertBlock(samples, 1, count, format, block), 1, &peak, count);
+			if(!(peak <= threshold))
+				return NO;
+			samples += count * SFBScanFormatSampleSize(format);
+			remaining -= count;
 		}
 	}
 
-	return NO;
+	return YES;
+}
+
+- (BOOL)getPeakLevels:(float *)peakLevels rmsLevels:(float *)rmsLevels
+{
+	NSParameterAssert(peakLevels != NULL);
+	NSParameterAssert(rmsLevels != NULL);
+
+	const AudioStreamBasicDescription *asbd = self.format.streamDescription;
+	const SFBScanFormat format = SFBScanFormatForFormat(asbd);
+	if(format == SFBScanFormatUnsupported)
+		return NO;
+
+	const AudioBufferList *abl = self.audioBufferList;
+	const BOOL isInterleaved = !(asbd->mFormatFlags & kAudioFormatFlagIsNonInterleaved);
+	const vDSP_Stride stride = isInterleaved ? asbd->mChannelsPerFrame : 1;
+	const size_t sampleSize = SFBScanFormatSampleSize(format);
+	const AVAudioFrameCount frameLength = self.frameLength;
+
+	float block[SFBScanBlockSize];
+	for(UInt32 channel = 0; channel < asbd->mChannelsPerFrame; ++channel) {
+		const uint8_t *samples = isInterleaved ? (const uint8_t *)abl->mBuffers[0].mData + channel * sampleSize : (const uint8_t *)abl->mBuffers[channel].mData;
+
+		// The peak and sum of squares are computed for each block while it is in cache
+		float peak = 0;
+		double sumOfSquares = 0;
+		vDSP_Length remaining = frameLength;
+		while(remaining) {
+			const vDSP_Length count = MIN(remaining, (vDSP_Length)SFBScanBlockSize);
+			const float *blockSamples = SFBConvertBlock(samples, stride, count, format, block);
+			const vDSP_Stride blockStride = blockSamples == block ? 1 : stride;
+			float blockPeak, blockSumOfSquares;
+			vDSP_maxmgv(blockSamples, blockStride, &blockPeak, count);
+			vDSP_svesq(blockSamples, blockStride, &blockSumOfSquares, count);
+			peak = MAX(peak, blockPeak);
+			sumOfSquares += blockSumOfSquares;
+			samples += count * stride * sampleSize;
+			remaining -= count;
+		}
+
+		peakLevels[channel] = peak;
+		rmsLevels[channel] = frameLength ? (float)sqrt(sumOfSquares / frameLength) : 0;
+	}
+
+	return YES;
 }
 
 @end
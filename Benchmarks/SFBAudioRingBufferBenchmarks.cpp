@@ -0,0 +1,188 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <atomic>
+#import <new>
+#import <thread>
+
+#import "SFBBenchmarkHarness.hpp"
+#import "SFBAudioRingBuffer.hpp"
+#import "SFBCABufferList.hpp"
+
+namespace {
+
+/// The frame counts transferred by each read and write
+constexpr uint32_t kFrameCounts[] = { 64, 256, 1024, 4096 };
+/// The channel counts of the audio
+constexpr uint32_t kChannelCounts[] = { 1, 2, 8 };
+/// The ring buffer capacity as a multiple of the frame count
+constexpr uint32_t kCapacityMultiplier = 4;
+/// The number of unsuccessful polls before a waiting thread yields
+constexpr unsigned int kSpinsBeforeYield = 1024;
+
+/// Waits until @c condition returns @c true
+template <typename F>
+void SpinUntil(F&& condition) noexcept
+{
+	for(unsigned int spins = 0; !condition(); ++spins) {
+		if(spins >= kSpinsBeforeYield) {
+			std::this_thread::yield();
+			spins = 0;
+		}
+	}
+}
+
+/// Allocates @c ringBuffer for @c format and @c capacityFrames frames
+void Allocate(SFB::AudioRingBuffer& ringBuffer, const SFB::CAStreamBasicDescription& format, uint32_t capacityFrames, bool mirrored = false)
+{
+	if(!ringBuffer.Allocate(format, capacityFrames, mirrored))
+		throw std::bad_alloc();
+}
+
+/// Returns a full @c CABufferList of @c frameCount frames of @c format
+SFB::CABufferList MakeBuffer(const SFB::CAStreamBasicDescription& format, uint32_t frameCount)
+{
+	SFB::CABufferList buffer(format, frameCount);
+	buffer.SetFrameLength(frameCount);
+	return buffer;
+}
+
+/// Transfers @c iterations chunks of @c frameCount frames from a writer thread to the calling thread
+SFB::Benchmarks::Nanoseconds SPSCThroughput(const SFB::CAStreamBasicDescription& format, uint32_t frameCount, uint64_t iterations)
+{
+	SFB::AudioRingBuffer ringBuffer;
+	Allocate(ringBuffer, format, kCapacityMultiplier * frameCount);
+
+	auto source = MakeBuffer(format, frameCount);
+	auto destination = MakeBuffer(format, frameCount);
+
+	const auto totalFrames = iterations * frameCount;
+	std::atomic_bool start = false;
+
+	std::thread writer([&] {
+		SpinUntil([&] { return start.load(std::memory_order_acquire); });
+		for(uint64_t remaining = totalFrames; remaining > 0; ) {
+			auto framesWritten = ringBuffer.Write(source, static_cast<uint32_t>(std::min<uint64_t>(remaining, frameCount)));
+			if(framesWritten == 0)
+				SpinUntil([&] { return ringBuffer.FramesAvailableToWrite() > 0; });
+			remaining -= framesWritten;
+		}
+	});
+
+	auto elapsed = SFB::Benchmarks::Time([&] {
+		start.store(true, std::memory_order_release);
+		for(uint64_t remaining = totalFrames; remaining > 0; ) {
+			destination.SetFrameLength(destination.FrameCapacity());
+			auto framesRead = ringBuffer.Read(destination, static_cast<uint32_t>(std::min<uint64_t>(remaining, frameCount)));
+			if(framesRead == 0)
+				SpinUntil([&] { return ringBuffer.FramesAvailableToRead() > 0; });
+			remaining -= framesRead;
+		}
+	});
+
+	writer.join();
+	return elapsed;
+}
+
+/// Measures the round trip time of chunks of @c frameCount frames sent to an echo thread and back
+void SPSCLatency(const SFB::CAStreamBasicDescription& format, uint32_t frameCount, std::vector<SFB::Benchmarks::Nanoseconds>& samples)
+{
+	SFB::AudioRingBuffer request, response;
+	Allocate(request, format, kCapacityMultiplier * frameCount);
+	Allocate(response, format, kCapacityMultiplier * frameCount);
+
+	auto source = MakeBuffer(format, frameCount);
+	auto destination = MakeBuffer(format, frameCount);
+
+	std::atomic_bool stop = false;
+
+	std::thread echo([&] {
+		auto buffer = MakeBuffer(format, frameCount);
+		for(;;) {
+			SpinUntil([&] { return request.FramesAvailableToRead() >= frameCount || stop.load(std::memory_order_relaxed); });
+			if(stop.load(std::memory_order_relaxed))
+				break;
+			buffer.SetFrameLength(buffer.FrameCapacity());
+			request.Read(buffer, frameCount);
+			response.Write(buffer, frameCount);
+		}
+	});
+
+	for(auto& sample : samples) {
+		sample = SFB::Benchmarks::Time([&] {
+			request.Write(source, frameCount);
+			SpinUntil([&] { return response.FramesAvailableToRead() >= frameCount; });
+			destination.SetFrameLength(destination.FrameCapacity());
+			response.Read(destination, frameCount);
+		});
+	}
+
+	stop.store(true, std::memory_order_relaxed);
+	echo.join();
+}
+
+/// Writes and reads @c iterations chunks of @c frameCount frames on the calling thread
+///
+/// Each copy either straddles the end of the buffer or starts at the beginning of the buffer.
+SFB::Benchmarks::Nanoseconds WrappedCopy(const SFB::CAStreamBasicDescription& format, uint32_t frameCount, bool wrapped, bool mirrored, uint64_t iterations)
+{
+	SFB::AudioRingBuffer ringBuffer;
+	Allocate(ringBuffer, format, 2 * frameCount, mirrored);
+
+	auto source = MakeBuffer(format, frameCount);
+	auto destination = MakeBuffer(format, frameCount);
+
+	// Advancing by the remainder of the capacity returns the pointers to the same offset after each copy
+	const auto capacity = ringBuffer.CapacityFrames();
+	const auto advance = capacity - frameCount;
+	if(wrapped) {
+		ringBuffer.AdvanceWritePosition(capacity - frameCount / 2);
+		ringBuffer.AdvanceReadPosition(capacity - frameCount / 2);
+	}
+
+	return SFB::Benchmarks::Time([&] {
+		for(uint64_t i = 0; i < iterations; ++i) {
+			ringBuffer.Write(source, frameCount);
+			destination.SetFrameLength(destination.FrameCapacity());
+			ringBuffer.Read(destination, frameCount);
+			ringBuffer.AdvanceWritePosition(advance);
+			ringBuffer.AdvanceReadPosition(advance);
+		}
+		SFB::Benchmarks::ClobberMemory();
+	});
+}
+
+}
+
+void SFB::Benchmarks::RegisterAudioRingBufferBenchmarks(Harness& harness)
+{
+	for(auto channelCount : kChannelCounts) {
+		const CAStreamBasicDescription format(CommonPCMFormat::float32, 48000, channelCount, false);
+		for(auto frameCount : kFrameCounts) {
+			Parameters parameters{ {"channels", channelCount}, {"frames", frameCount} };
+			harness.Add("AudioRingBuffer/SPSCThroughput", parameters, frameCount * format.mBytesPerFrame * channelCount, frameCount, [=](uint64_t iterations) {
+				return SPSCThroughput(format, frameCount, iterations);
+			});
+			harness.AddLatency("AudioRingBuffer/SPSCRoundTripLatency", parameters, [=](std::vector<Nanoseconds>& samples) {
+				SPSCLatency(format, frameCount, samples);
+			});
+		}
+	}
+
+	const CAStreamBasicDescription format(CommonPCMFormat::float32, 48000, 2, false);
+	for(auto mirrored : { false, true }) {
+		for(auto wrapped : { false, true }) {
+			for(uint32_t frameCount : { 256, 1024, 4096 }) {
+				Parameters parameters{ {"channels", 2}, {"frames", frameCount}, {"wrapped", wrapped}, {"mirrored", mirrored} };
+				// Each iteration writes and reads the frames
+				harness.Add("AudioRingBuffer/Copy", parameters, 2 * frameCount * format.mBytesPerFrame * format.mChannelsPerFrame, frameCount, [=](uint64_t iterations) {
+					return WrappedCopy(format, frameCount, wrapped, mirrored, iterations);
+				});
+			}
+		}
+	}
+}
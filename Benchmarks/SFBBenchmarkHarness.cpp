@@ -0,0 +1,310 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cerrno>
+#import <cstdio>
+#import <cstdlib>
+#import <cstring>
+#import <ctime>
+#import <exception>
+#import <thread>
+
+#import <sys/sysctl.h>
+
+#import "SFBBenchmarkHarness.hpp"
+#import "SFBRingBufferStatistics.hpp"
+
+namespace {
+
+/// The largest number of iterations in a repetition
+constexpr uint64_t kMaximumIterations = 1000000000;
+/// The number of samples discarded before a latency benchmark is measured
+constexpr std::size_t kLatencyWarmupSamples = 1000;
+
+/// The measurements of a benchmark
+struct Result {
+	/// The benchmark's name
+	std::string mName;
+	/// The benchmark's name followed by its parameters
+	std::string mFullName;
+	/// The parameters identifying the variant
+	SFB::Benchmarks::Parameters mParameters;
+	/// The number of bytes processed by each iteration
+	double mBytesPerIteration = 0;
+	/// The number of audio frames processed by each iteration
+	double mFramesPerIteration = 0;
+	/// The number of iterations in each repetition
+	uint64_t mIterations = 0;
+	/// The time per iteration in nanoseconds for each repetition, sorted
+	std::vector<double> mNanosecondsPerIteration;
+	/// The latency samples in nanoseconds, sorted
+	std::vector<double> mLatencyNanoseconds;
+};
+
+/// Returns the value at fraction @c p of the sorted values @c values
+double Percentile(const std::vector<double>& values, double p) noexcept
+{
+	if(values.empty())
+		return 0;
+	auto index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+	return values[std::min(index, values.size() - 1)];
+}
+
+/// Returns the arithmetic mean of @c values
+double Mean(const std::vector<double>& values) noexcept
+{
+	if(values.empty())
+		return 0;
+	double sum = 0;
+	for(auto value : values)
+		sum += value;
+	return sum / static_cast<double>(values.size());
+}
+
+/// Returns the value of the string system control @c name or an empty string
+std::string SystemControlString(const char *name)
+{
+	std::size_t size = 0;
+	if(sysctlbyname(name, nullptr, &size, nullptr, 0) != 0 || size == 0)
+		return {};
+	std::string value(size, '\0');
+	if(sysctlbyname(name, value.data(), &size, nullptr, 0) != 0)
+		return {};
+	value.resize(std::strlen(value.c_str()));
+	return value;
+}
+
+/// Returns the name of the processor architecture
+const char * ArchitectureName() noexcept
+{
+#if defined(__arm64__) || defined(__aarch64__)
+	return "arm64";
+#elif defined(__x86_64__)
+	return "x86_64";
+#else
+	return "unknown";
+#endif
+}
+
+/// Returns @c name followed by the values of @c parameters
+std::string FullName(const std::string& name, const SFB::Benchmarks::Parameters& parameters)
+{
+	auto fullName = name;
+	for(const auto& parameter : parameters)
+		fullName += "/" + parameter.mName + ":" + parameter.mValue;
+	return fullName;
+}
+
+/// Returns @c value as a quoted and escaped JSON string
+std::string JSONString(const std::string& value)
+{
+	std::string result = "\"";
+	for(auto c : value) {
+		switch(c) {
+			case '"':	result += "\\\"";	break;
+			case '\\':	result += "\\\\";	break;
+			case '\n':	result += "\\n";	break;
+			case '\t':	result += "\\t";	break;
+			default:
+				if(static_cast<unsigned char>(c) < 0x20) {
+					char escape[8];
+					std::snprintf(escape, sizeof escape, "\\u%04x", c);
+					result += escape;
+				}
+				else
+					result += c;
+				break;
+		}
+	}
+	return result + "\"";
+}
+
+/// Returns @c value formatted as a JSON number
+std::string JSONNumber(double value)
+{
+	char buffer[32];
+	std::snprintf(buffer, sizeof buffer, "%.9g", value);
+	return buffer;
+}
+
+/// Formats @c bytesPerSecond and @c framesPerSecond for display
+std::string FormatThroughput(double bytesPerSecond, double framesPerSecond)
+{
+	char buffer[64];
+	if(framesPerSecond > 0)
+		std::snprintf(buffer, sizeof buffer, "%8.3f GB/s %9.3f Mframes/s", bytesPerSecond / 1e9, framesPerSecond / 1e6);
+	else
+		std::snprintf(buffer, sizeof buffer, "%8.3f GB/s", bytesPerSecond / 1e9);
+	return buffer;
+}
+
+/// Prints @c result as a table row to @c file
+void PrintResult(std::FILE *file, const Result& result)
+{
+	if(!result.mLatencyNanoseconds.empty()) {
+		std::fprintf(file, "%-72s %12zu  p50 %9.0f ns  p99 %9.0f ns  max %9.0f ns\n", result.mFullName.c_str(), result.mLatencyNanoseconds.size(), Percentile(result.mLatencyNanoseconds, 0.5), Percentile(result.mLatencyNanoseconds, 0.99), result.mLatencyNanoseconds.back());
+		return;
+	}
+
+	auto median = Percentile(result.mNanosecondsPerIteration, 0.5);
+	auto throughput = median > 0 ? FormatThroughput(result.mBytesPerIteration * 1e9 / median, result.mFramesPerIteration * 1e9 / median) : std::string();
+	std::fprintf(file, "%-72s %12llu %12.1f ns  %s\n", result.mFullName.c_str(), static_cast<unsigned long long>(result.mIterations), median, throughput.c_str());
+}
+
+/// Writes @c results and the run context as JSON to @c file
+void WriteJSON(std::FILE *file, const std::vector<Result>& results, const SFB::Benchmarks::Harness::Options& options)
+{
+	char date[32];
+	auto now = std::time(nullptr);
+	std::tm utc;
+	gmtime_r(&now, &utc);
+	std::strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+	std::fprintf(file, "{\n");
+	std::fprintf(file, "  \"context\": {\n");
+	std::fprintf(file, "    \"date\": %s,\n", JSONString(date).c_str());
+	std::fprintf(file, "    \"architecture\": %s,\n", JSONString(ArchitectureName()).c_str());
+	std::fprintf(file, "    \"cpu\": %s,\n", JSONString(SystemControlString("machdep.cpu.brand_string")).c_str());
+	std::fprintf(file, "    \"model\": %s,\n", JSONString(SystemControlString("hw.model")).c_str());
+	std::fprintf(file, "    \"os_version\": %s,\n", JSONString(SystemControlString("kern.osproductversion")).c_str());
+	std::fprintf(file, "    \"logical_cpus\": %u,\n", std::thread::hardware_concurrency());
+#if NDEBUG
+	std::fprintf(file, "    \"build_type\": \"release\",\n");
+#else
+	std::fprintf(file, "    \"build_type\": \"debug\",\n");
+#endif
+	std::fprintf(file, "    \"ring_buffer_statistics\": %s,\n", SFB_RING_BUFFER_STATISTICS ? "true" : "false");
+	std::fprintf(file, "    \"minimum_time\": %s,\n", JSONNumber(options.mMinimumTime).c_str());
+	std::fprintf(file, "    \"repetitions\": %u\n", options.mRepetitions);
+	std::fprintf(file, "  },\n");
+
+	std::fprintf(file, "  \"benchmarks\": [");
+	for(std::size_t i = 0; i < results.size(); ++i) {
+		const auto& result = results[i];
+		std::fprintf(file, "%s\n    {\n", i > 0 ? "," : "");
+		std::fprintf(file, "      \"name\": %s,\n", JSONString(result.mName).c_str());
+		std::fprintf(file, "      \"full_name\": %s,\n", JSONString(result.mFullName).c_str());
+
+		std::fprintf(file, "      \"parameters\": {");
+		for(std::size_t j = 0; j < result.mParameters.size(); ++j) {
+			const auto& parameter = result.mParameters[j];
+			std::fprintf(file, "%s%s: %s", j > 0 ? ", " : "", JSONString(parameter.mName).c_str(), parameter.mIsNumeric ? parameter.mValue.c_str() : JSONString(parameter.mValue).c_str());
+		}
+		std::fprintf(file, "},\n");
+
+		if(!result.mLatencyNanoseconds.empty()) {
+			const auto& samples = result.mLatencyNanoseconds;
+			std::fprintf(file, "      \"samples\": %zu,\n", samples.size());
+			std::fprintf(file, "      \"latency_ns\": {\"min\": %s, \"p50\": %s, \"p90\": %s, \"p99\": %s, \"p999\": %s, \"max\": %s, \"mean\": %s}\n", JSONNumber(samples.front()).c_str(), JSONNumber(Percentile(samples, 0.5)).c_str(), JSONNumber(Percentile(samples, 0.9)).c_str(), JSONNumber(Percentile(samples, 0.99)).c_str(), JSONNumber(Percentile(samples, 0.999)).c_str(), JSONNumber(samples.back()).c_str(), JSONNumber(Mean(samples)).c_str());
+		}
+		else {
+			const auto& times = result.mNanosecondsPerIteration;
+			auto median = Percentile(times, 0.5);
+			std::fprintf(file, "      \"iterations\": %llu,\n", static_cast<unsigned long long>(result.mIterations));
+			std::fprintf(file, "      \"repetitions\": %zu,\n", times.size());
+			std::fprintf(file, "      \"ns_per_iteration\": {\"min\": %s, \"median\": %s, \"mean\": %s, \"max\": %s},\n", JSONNumber(times.front()).c_str(), JSONNumber(median).c_str(), JSONNumber(Mean(times)).c_str(), JSONNumber(times.back()).c_str());
+			std::fprintf(file, "      \"bytes_per_iteration\": %s,\n", JSONNumber(result.mBytesPerIteration).c_str());
+			std::fprintf(file, "      \"frames_per_iteration\": %s,\n", JSONNumber(result.mFramesPerIteration).c_str());
+			std::fprintf(file, "      \"bytes_per_second\": %s,\n", JSONNumber(median > 0 ? result.mBytesPerIteration * 1e9 / median : 0).c_str());
+			std::fprintf(file, "      \"frames_per_second\": %s\n", JSONNumber(median > 0 ? result.mFramesPerIteration * 1e9 / median : 0).c_str());
+		}
+		std::fprintf(file, "    }");
+	}
+	std::fprintf(file, "\n  ]\n}\n");
+}
+
+}
+
+void SFB::Benchmarks::Harness::Add(std::string name, Parameters parameters, double bytesPerIteration, double framesPerIteration, Body body)
+{
+	mBenchmarks.push_back({std::move(name), std::move(parameters), bytesPerIteration, framesPerIteration, std::move(body), {}});
+}
+
+void SFB::Benchmarks::Harness::AddLatency(std::string name, Parameters parameters, LatencyBody body)
+{
+	mBenchmarks.push_back({std::move(name), std::move(parameters), 0, 0, {}, std::move(body)});
+}
+
+int SFB::Benchmarks::Harness::Run(const Options& options)
+{
+	std::vector<Result> results;
+	auto failed = false;
+
+	// The table is printed to standard error when the JSON is written to standard output
+	auto table = options.mJSONPath == "-" ? stderr : stdout;
+
+	for(const auto& benchmark : mBenchmarks) {
+		auto fullName = FullName(benchmark.mName, benchmark.mParameters);
+		if(!options.mFilter.empty() && fullName.find(options.mFilter) == std::string::npos)
+			continue;
+
+		if(options.mList) {
+			std::printf("%s\n", fullName.c_str());
+			continue;
+		}
+
+		Result result;
+		result.mName = benchmark.mName;
+		result.mFullName = fullName;
+		result.mParameters = benchmark.mParameters;
+		result.mBytesPerIteration = benchmark.mBytesPerIteration;
+		result.mFramesPerIteration = benchmark.mFramesPerIteration;
+
+		try {
+			if(benchmark.mBody) {
+				// Increase the iteration count until a repetition fills the minimum time; this also warms up the caches
+				Nanoseconds target(options.mMinimumTime * 1e9);
+				uint64_t iterations = 1;
+				for(;;) {
+					auto elapsed = benchmark.mBody(iterations);
+					if(elapsed >= target || iterations >= kMaximumIterations)
+						break;
+					auto multiplier = elapsed.count() > 0 ? std::min(10.0, 1.4 * (target / elapsed)) : 10.0;
+					iterations = std::min(kMaximumIterations, std::max(iterations + 1, static_cast<uint64_t>(static_cast<double>(iterations) * multiplier)));
+				}
+
+				result.mIterations = iterations;
+				for(unsigned int i = 0; i < std::max(options.mRepetitions, 1u); ++i)
+					result.mNanosecondsPerIteration.push_back(benchmark.mBody(iterations).count() / static_cast<double>(iterations));
+				std::sort(result.mNanosecondsPerIteration.begin(), result.mNanosecondsPerIteration.end());
+			}
+			else {
+				std::vector<Nanoseconds> samples(std::min(options.mLatencySamples, kLatencyWarmupSamples));
+				benchmark.mLatencyBody(samples);
+
+				samples.assign(std::max(options.mLatencySamples, static_cast<std::size_t>(1)), Nanoseconds::zero());
+				benchmark.mLatencyBody(samples);
+				for(const auto& sample : samples)
+					result.mLatencyNanoseconds.push_back(sample.count());
+				std::sort(result.mLatencyNanoseconds.begin(), result.mLatencyNanoseconds.end());
+			}
+		}
+		catch(const std::exception& e) {
+			std::fprintf(stderr, "%s: %s\n", fullName.c_str(), e.what());
+			failed = true;
+			continue;
+		}
+
+		PrintResult(table, result);
+		std::fflush(table);
+		results.push_back(std::move(result));
+	}
+
+	if(!options.mList && !options.mJSONPath.empty()) {
+		auto toStandardOutput = options.mJSONPath == "-";
+		auto file = toStandardOutput ? stdout : std::fopen(options.mJSONPath.c_str(), "w");
+		if(!file) {
+			std::fprintf(stderr, "Unable to open %s: %s\n", options.mJSONPath.c_str(), std::strerror(errno));
+			return EXIT_FAILURE;
+		}
+		WriteJSON(file, results, options);
+		if(!toStandardOutput)
+			std::fclose(file);
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
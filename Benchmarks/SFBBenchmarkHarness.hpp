@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <chrono>
+#import <cstdint>
+#import <functional>
+#import <string>
+#import <utility>
+#import <vector>
+
+namespace SFB {
+
+namespace Benchmarks {
+
+/// A duration in nanoseconds
+using Nanoseconds = std::chrono::duration<double, std::nano>;
+
+/// A benchmark parameter reported as a name/value pair
+struct Parameter {
+	/// Creates a numeric parameter
+	Parameter(std::string name, int64_t value)
+	: mName(std::move(name)), mValue(std::to_string(value)), mIsNumeric(true)
+	{}
+
+	/// Creates a string parameter
+	Parameter(std::string name, std::string value)
+	: mName(std::move(name)), mValue(std::move(value)), mIsNumeric(false)
+	{}
+
+	/// The parameter's name
+	std::string mName;
+	/// The parameter's value
+	std::string mValue;
+	/// Whether @c mValue is a number
+	bool mIsNumeric;
+};
+
+/// The parameters identifying a benchmark variant
+using Parameters = std::vector<Parameter>;
+
+/// A benchmark body that performs @c iterations iterations and returns the time they took
+///
+/// Setup and teardown may be performed outside the timed region.
+using Body = std::function<Nanoseconds(uint64_t iterations)>;
+
+/// A benchmark body that fills @c samples with the duration of each measured operation
+using LatencyBody = std::function<void(std::vector<Nanoseconds>& samples)>;
+
+/// Returns the time taken to call @c f
+template <typename F>
+Nanoseconds Time(F&& f)
+{
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::steady_clock::now() - start;
+}
+
+/// Prevents the compiler from optimizing away the computation of @c value
+template <typename T>
+inline void DoNotOptimize(const T& value) noexcept
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Prevents the compiler from optimizing away or reordering memory writes
+inline void ClobberMemory() noexcept
+{
+	asm volatile("" : : : "memory");
+}
+
+/// A collection of benchmarks and the driver that runs them
+///
+/// Each benchmark is calibrated until an iteration count fills the minimum time and then measured for a number of
+/// repetitions. The results are printed as a table and optionally written as JSON.
+class Harness
+{
+
+public:
+
+	/// Run options
+	struct Options {
+		/// Only benchmarks whose full name contains this string are run
+		std::string mFilter;
+		/// The path of the JSON output file, @c - for standard output, or empty for none
+		std::string mJSONPath;
+		/// The minimum time for each repetition in seconds
+		double mMinimumTime = 0.1;
+		/// The number of measured repetitions of each benchmark
+		unsigned int mRepetitions = 5;
+		/// The number of samples collected by each latency benchmark
+		std::size_t mLatencySamples = 10000;
+		/// Whether to list the benchmarks instead of running them
+		bool mList = false;
+	};
+
+	/// Adds a throughput benchmark
+	/// @param name The benchmark's name
+	/// @param parameters The parameters identifying the variant
+	/// @param bytesPerIteration The number of bytes processed by each iteration
+	/// @param framesPerIteration The number of audio frames processed by each iteration, or @c 0 if not applicable
+	/// @param body The benchmark body
+	void Add(std::string name, Parameters parameters, double bytesPerIteration, double framesPerIteration, Body body);
+
+	/// Adds a latency benchmark
+	/// @param name The benchmark's name
+	/// @param parameters The parameters identifying the variant
+	/// @param body The benchmark body
+	void AddLatency(std::string name, Parameters parameters, LatencyBody body);
+
+	/// Runs the benchmarks
+	/// @return @c 0 on success, nonzero on error
+	int Run(const Options& options);
+
+private:
+
+	/// A registered benchmark
+	struct Benchmark {
+		/// The benchmark's name
+		std::string mName;
+		/// The parameters identifying the variant
+		Parameters mParameters;
+		/// The number of bytes processed by each iteration
+		double mBytesPerIteration;
+		/// The number of audio frames processed by each iteration
+		double mFramesPerIteration;
+		/// The body of a throughput benchmark
+		Body mBody;
+		/// The body of a latency benchmark
+		LatencyBody mLatencyBody;
+	};
+
+	/// The registered benchmarks
+	std::vector<Benchmark> mBenchmarks;
+
+};
+
+/// Registers the @c AudioRingBuffer benchmarks
+void RegisterAudioRingBufferBenchmarks(Harness& harness);
+
+/// Registers the @c CARingBuffer benchmarks
+void RegisterCARingBufferBenchmarks(Harness& harness);
+
+/// Registers the @c CABufferList benchmarks
+void RegisterCABufferListBenchmarks(Harness& harness);
+
+/// Registers the @c ByteStream benchmarks
+void RegisterByteStreamBenchmarks(Harness& harness);
+
+} // namespace Benchmarks
+
+} // namespace SFB
@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <cstdio>
+#import <cstdlib>
+#import <cstring>
+#import <string>
+
+#import "SFBBenchmarkHarness.hpp"
+
+namespace {
+
+/// Prints the command line usage
+void PrintUsage(const char *program)
+{
+	std::fprintf(stderr,
+				 "Usage: %s [options]\n"
+				 "  --filter=<string>        Run only the benchmarks whose full name contains <string>\n"
+				 "  --json=<path>            Write the results as JSON to <path>, or - for standard output\n"
+				 "  --min-time=<seconds>     The minimum time for each repetition (default 0.1)\n"
+				 "  --repetitions=<count>    The number of measured repetitions (default 5)\n"
+				 "  --latency-samples=<n>    The number of samples for latency benchmarks (default 10000)\n"
+				 "  --list                   List the benchmarks without running them\n",
+				 program);
+}
+
+/// Returns the value of @c argument if it begins with @c option followed by @c =, or @c nullptr
+const char * OptionValue(const char *argument, const char *option) noexcept
+{
+	auto length = std::strlen(option);
+	if(std::strncmp(argument, option, length) != 0 || argument[length] != '=')
+		return nullptr;
+	return argument + length + 1;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	SFB::Benchmarks::Harness::Options options;
+
+	for(auto i = 1; i < argc; ++i) {
+		auto argument = argv[i];
+		if(auto value = OptionValue(argument, "--filter"); value)
+			options.mFilter = value;
+		else if(auto value = OptionValue(argument, "--json"); value)
+			options.mJSONPath = value;
+		else if(auto value = OptionValue(argument, "--min-time"); value)
+			options.mMinimumTime = std::strtod(value, nullptr);
+		else if(auto value = OptionValue(argument, "--repetitions"); value)
+			options.mRepetitions = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+		else if(auto value = OptionValue(argument, "--latency-samples"); value)
+			options.mLatencySamples = std::strtoul(value, nullptr, 10);
+		else if(std::strcmp(argument, "--list") == 0)
+			options.mList = true;
+		else {
+			PrintUsage(argv[0]);
+			return std::strcmp(argument, "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	SFB::Benchmarks::Harness harness;
+	SFB::Benchmarks::RegisterAudioRingBufferBenchmarks(harness);
+	SFB::Benchmarks::RegisterCARingBufferBenchmarks(harness);
+	SFB::Benchmarks::RegisterCABufferListBenchmarks(harness);
+	SFB::Benchmarks::RegisterByteStreamBenchmarks(harness);
+
+	return harness.Run(options);
+}
@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <memory>
+#import <random>
+#import <stdexcept>
+#import <string>
+#import <vector>
+
+#import "SFBBenchmarkHarness.hpp"
+#import "SFBByteStream.hpp"
+#import "SFBWritableByteStream.hpp"
+
+namespace {
+
+/// The number of bytes parsed by each iteration
+constexpr std::size_t kBufferSize = 1024 * 1024;
+/// The number of values read by each bulk read
+constexpr std::size_t kBulkCounts[] = { 16, 256, 4096 };
+
+/// Returns @c kBufferSize pseudo-random bytes
+std::shared_ptr<const std::vector<uint8_t>> RandomBytes()
+{
+	auto bytes = std::make_shared<std::vector<uint8_t>>(kBufferSize);
+	std::mt19937 engine(0x5fb);
+	for(auto& byte : *bytes)
+		byte = static_cast<uint8_t>(engine());
+	return bytes;
+}
+
+/// Returns @c kBufferSize bytes of consecutive chunks, each a big-endian identifier, a little-endian payload size,
+/// and a payload beginning with a big-endian 16-bit value
+std::shared_ptr<const std::vector<uint8_t>> ChunkBytes()
+{
+	auto bytes = std::make_shared<std::vector<uint8_t>>(kBufferSize);
+	SFB::WritableByteStream stream(bytes->data(), bytes->size());
+
+	std::mt19937 engine(0x5fb);
+	std::uniform_int_distribution<uint32_t> payloadSize(8, 256);
+	for(;;) {
+		auto size = payloadSize(engine);
+		if(stream.Remaining() < 8 + size)
+			break;
+		stream.WriteBE(static_cast<uint32_t>(engine()));
+		stream.WriteLE(size);
+		stream.WriteBE(static_cast<uint16_t>(size));
+		stream.Skip(size - sizeof(uint16_t));
+	}
+
+	return bytes;
+}
+
+/// Returns the parameter value for type @c T
+template <typename T>
+int64_t BitWidth() noexcept
+{
+	return static_cast<int64_t>(8 * sizeof(T));
+}
+
+/// Reads the buffer as consecutive values of type @c T @c iterations times
+template <typename T>
+SFB::Benchmarks::Nanoseconds ScalarRead(const std::vector<uint8_t>& bytes, bool bigEndian, uint64_t iterations)
+{
+	return SFB::Benchmarks::Time([&] {
+		for(uint64_t i = 0; i < iterations; ++i) {
+			SFB::ByteStream stream(bytes.data(), bytes.size());
+			T sum = 0;
+			if(bigEndian) {
+				while(stream.Remaining() >= sizeof(T))
+					sum += stream.ReadBE<T>();
+			}
+			else {
+				while(stream.Remaining() >= sizeof(T))
+					sum += stream.ReadLE<T>();
+			}
+			SFB::Benchmarks::DoNotOptimize(sum);
+		}
+	});
+}
+
+/// Reads the buffer as arrays of @c count 32-bit values @c iterations times
+SFB::Benchmarks::Nanoseconds BulkRead(const std::vector<uint8_t>& bytes, std::size_t count, bool bigEndian, uint64_t iterations)
+{
+	std::vector<uint32_t> values(count);
+	return SFB::Benchmarks::Time([&] {
+		for(uint64_t i = 0; i < iterations; ++i) {
+			SFB::ByteStream stream(bytes.data(), bytes.size());
+			while(bigEndian ? stream.ReadBE(values.data(), count) : stream.ReadLE(values.data(), count))
+				SFB::Benchmarks::DoNotOptimize(values.front());
+		}
+		SFB::Benchmarks::ClobberMemory();
+	});
+}
+
+/// Parses the chunks in @c bytes @c iterations times
+SFB::Benchmarks::Nanoseconds ChunkParse(const std::vector<uint8_t>& bytes, uint64_t iterations)
+{
+	return SFB::Benchmarks::Time([&] {
+		for(uint64_t i = 0; i < iterations; ++i) {
+			SFB::ByteStream stream(bytes.data(), bytes.size());
+			uint32_t identifiers = 0;
+			uint32_t payloadSizes = 0;
+			for(;;) {
+				uint32_t identifier, size;
+				if(!stream.ReadBE(identifier) || !stream.ReadLE(size))
+					break;
+				SFB::ByteStream payload;
+				if(!stream.ReadSpan(payload, size))
+					break;
+				identifiers ^= identifier;
+				payloadSizes += payload.ReadBE<uint16_t>();
+			}
+			if(payloadSizes == 0)
+				throw std::runtime_error("No chunks parsed");
+			SFB::Benchmarks::DoNotOptimize(identifiers);
+			SFB::Benchmarks::DoNotOptimize(payloadSizes);
+		}
+	});
+}
+
+}
+
+void SFB::Benchmarks::RegisterByteStreamBenchmarks(Harness& harness)
+{
+	auto randomBytes = RandomBytes();
+
+	for(auto bigEndian : { false, true }) {
+		const std::string endian = bigEndian ? "big" : "little";
+
+		harness.Add("ByteStream/ScalarRead", { {"bits", BitWidth<uint16_t>()}, {"endian", endian} }, kBufferSize, 0, [=](uint64_t iterations) {
+			return ScalarRead<uint16_t>(*randomBytes, bigEndian, iterations);
+		});
+		harness.Add("ByteStream/ScalarRead", { {"bits", BitWidth<uint32_t>()}, {"endian", endian} }, kBufferSize, 0, [=](uint64_t iterations) {
+			return ScalarRead<uint32_t>(*randomBytes, bigEndian, iterations);
+		});
+		harness.Add("ByteStream/ScalarRead", { {"bits", BitWidth<uint64_t>()}, {"endian", endian} }, kBufferSize, 0, [=](uint64_t iterations) {
+			return ScalarRead<uint64_t>(*randomBytes, bigEndian, iterations);
+		});
+
+		for(auto count : kBulkCounts) {
+			harness.Add("ByteStream/BulkRead", { {"bits", BitWidth<uint32_t>()}, {"count", static_cast<int64_t>(count)}, {"endian", endian} }, kBufferSize, 0, [=](uint64_t iterations) {
+				return BulkRead(*randomBytes, count, bigEndian, iterations);
+			});
+		}
+	}
+
+	auto chunkBytes = ChunkBytes();
+	harness.Add("ByteStream/ChunkParse", {}, kBufferSize, 0, [=](uint64_t iterations) {
+		return ChunkParse(*chunkBytes, iterations);
+	});
+}
@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <stdexcept>
+#import <string>
+
+#import "SFBBenchmarkHarness.hpp"
+#import "SFBCABufferList.hpp"
+
+namespace {
+
+/// The capacity of the buffers in frames
+constexpr uint32_t kCapacityFrames = 16384;
+/// The number of valid frames in the buffers
+constexpr uint32_t kFrameLength = 8192;
+/// The frame counts inserted and trimmed
+constexpr uint32_t kFrameCounts[] = { 64, 512, 4096 };
+
+/// The position of an insertion relative to the valid frames
+enum class InsertPosition {
+	/// Before the first frame
+	head,
+	/// Between the two halves of the frames
+	middle,
+	/// After the last frame
+	tail,
+};
+
+/// Returns the parameter value for @c position
+std::string Name(InsertPosition position)
+{
+	switch(position) {
+		case InsertPosition::head:		return "head";
+		case InsertPosition::middle:	return "middle";
+		case InsertPosition::tail:		return "tail";
+	}
+	return {};
+}
+
+/// Inserts @c frameCount frames at @c position and trims them @c iterations times
+SFB::Benchmarks::Nanoseconds InsertTrim(const SFB::CAStreamBasicDescription& format, uint32_t frameCount, InsertPosition position, bool tracksHeadOffset, uint64_t iterations)
+{
+	SFB::CABufferList buffer(format, kCapacityFrames);
+	buffer.SetTracksHeadOffset(tracksHeadOffset);
+	buffer.SetFrameLength(kFrameLength);
+
+	SFB::CABufferList source(format, frameCount);
+	source.SetFrameLength(frameCount);
+
+	UInt32 offset = 0;
+	switch(position) {
+		case InsertPosition::head:		offset = 0;					break;
+		case InsertPosition::middle:	offset = kFrameLength / 2;	break;
+		case InsertPosition::tail:		offset = kFrameLength;		break;
+	}
+
+	return SFB::Benchmarks::Time([&] {
+		for(uint64_t i = 0; i < iterations; ++i) {
+			if(buffer.InsertFromBuffer(source, 0, frameCount, offset) != frameCount || buffer.TrimAtOffset(offset, frameCount) != frameCount)
+				throw std::runtime_error("CABufferList insert or trim failed");
+		}
+		SFB::Benchmarks::ClobberMemory();
+	});
+}
+
+/// Appends @c frameCount frames and trims the same number from the start @c iterations times
+SFB::Benchmarks::Nanoseconds AppendTrimFirst(const SFB::CAStreamBasicDescription& format, uint32_t frameCount, bool tracksHeadOffset, uint64_t iterations)
+{
+	SFB::CABufferList buffer(format, kCapacityFrames);
+	buffer.SetTracksHeadOffset(tracksHeadOffset);
+	buffer.SetFrameLength(kFrameLength);
+
+	SFB::CABufferList source(format, frameCount);
+	source.SetFrameLength(frameCount);
+
+	return SFB::Benchmarks::Time([&] {
+		for(uint64_t i = 0; i < iterations; ++i) {
+			if(buffer.AppendContentsOfBuffer(source) != frameCount || buffer.TrimFirst(frameCount) != frameCount)
+				throw std::runtime_error("CABufferList append or trim failed");
+		}
+		SFB::Benchmarks::ClobberMemory();
+	});
+}
+
+}
+
+void SFB::Benchmarks::RegisterCABufferListBenchmarks(Harness& harness)
+{
+	const CAStreamBasicDescription format(CommonPCMFormat::float32, 48000, 2, false);
+	const auto bytesPerFrame = format.mBytesPerFrame * format.mChannelsPerFrame;
+
+	for(auto tracksHeadOffset : { false, true }) {
+		for(auto frameCount : kFrameCounts) {
+			for(auto position : { InsertPosition::head, InsertPosition::middle, InsertPosition::tail }) {
+				Parameters parameters{ {"channels", 2}, {"frames", frameCount}, {"position", Name(position)}, {"head_offset", tracksHeadOffset} };
+				harness.Add("CABufferList/InsertTrim", parameters, frameCount * bytesPerFrame, frameCount, [=](uint64_t iterations) {
+					return InsertTrim(format, frameCount, position, tracksHeadOffset, iterations);
+				});
+			}
+
+			Parameters parameters{ {"channels", 2}, {"frames", frameCount}, {"head_offset", tracksHeadOffset} };
+			harness.Add("CABufferList/AppendTrimFirst", parameters, frameCount * bytesPerFrame, frameCount, [=](uint64_t iterations) {
+				return AppendTrimFirst(format, frameCount, tracksHeadOffset, iterations);
+			});
+		}
+	}
+}
@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <new>
+#import <stdexcept>
+#import <string>
+
+#import "SFBBenchmarkHarness.hpp"
+#import "SFBCABufferList.hpp"
+#import "SFBCARingBuffer.hpp"
+
+namespace {
+
+/// The capacity of the ring buffers in frames
+constexpr uint32_t kCapacityFrames = 16384;
+/// The frame counts read and written
+constexpr uint32_t kFrameCounts[] = { 256, 1024, 4096 };
+/// The channel counts of the audio
+constexpr uint32_t kChannelCounts[] = { 2, 8 };
+
+/// The position of a read relative to the buffer's time bounds
+enum class ReadPosition {
+	/// All frames are in the buffer
+	inside,
+	/// The first half of the frames have been overwritten
+	beforeStart,
+	/// The second half of the frames haven't been written
+	afterEnd,
+	/// No frames are in the buffer
+	outside,
+};
+
+/// Returns the parameter value for @c position
+std::string Name(ReadPosition position)
+{
+	switch(position) {
+		case ReadPosition::inside:		return "inside";
+		case ReadPosition::beforeStart:	return "before_start";
+		case ReadPosition::afterEnd:	return "after_end";
+		case ReadPosition::outside:		return "outside";
+	}
+	return {};
+}
+
+/// Allocates @c ringBuffer and writes twice its capacity so its time bounds span the whole buffer
+void Fill(SFB::CARingBuffer& ringBuffer, const SFB::CAStreamBasicDescription& format)
+{
+	if(!ringBuffer.Allocate(format, kCapacityFrames))
+		throw std::bad_alloc();
+
+	SFB::CABufferList buffer(format, kCapacityFrames);
+	buffer.SetFrameLength(kCapacityFrames);
+	for(int64_t timeStamp = 0; timeStamp < 2 * kCapacityFrames; timeStamp += kCapacityFrames) {
+		if(!ringBuffer.Write(buffer, kCapacityFrames, timeStamp))
+			throw std::runtime_error("CARingBuffer::Write failed");
+	}
+}
+
+/// Reads @c frameCount frames at @c position @c iterations times
+SFB::Benchmarks::Nanoseconds TimestampedRead(const SFB::CAStreamBasicDescription& format, uint32_t frameCount, ReadPosition position, uint64_t iterations)
+{
+	SFB::CARingBuffer ringBuffer;
+	Fill(ringBuffer, format);
+
+	int64_t startTime, endTime;
+	if(!ringBuffer.GetTimeBounds(startTime, endTime))
+		throw std::runtime_error("CARingBuffer::GetTimeBounds failed");
+
+	int64_t timeStamp = 0;
+	switch(position) {
+		case ReadPosition::inside:		timeStamp = startTime + (endTime - startTime - frameCount) / 2;	break;
+		case ReadPosition::beforeStart:	timeStamp = startTime - frameCount / 2;							break;
+		case ReadPosition::afterEnd:	timeStamp = endTime - frameCount / 2;							break;
+		case ReadPosition::outside:		timeStamp = endTime + frameCount;								break;
+	}
+
+	SFB::CABufferList buffer(format, frameCount);
+	return SFB::Benchmarks::Time([&] {
+		for(uint64_t i = 0; i < iterations; ++i) {
+			buffer.SetFrameLength(buffer.FrameCapacity());
+			auto result = ringBuffer.Read(buffer, frameCount, timeStamp);
+			SFB::Benchmarks::DoNotOptimize(result);
+		}
+		SFB::Benchmarks::ClobberMemory();
+	});
+}
+
+/// Writes @c iterations consecutive chunks of @c frameCount frames
+SFB::Benchmarks::Nanoseconds SequentialWrite(const SFB::CAStreamBasicDescription& format, uint32_t frameCount, uint64_t iterations)
+{
+	SFB::CARingBuffer ringBuffer;
+	if(!ringBuffer.Allocate(format, kCapacityFrames))
+		throw std::bad_alloc();
+
+	SFB::CABufferList buffer(format, frameCount);
+	buffer.SetFrameLength(frameCount);
+	return SFB::Benchmarks::Time([&] {
+		int64_t timeStamp = 0;
+		for(uint64_t i = 0; i < iterations; ++i) {
+			ringBuffer.Write(buffer, frameCount, timeStamp);
+			timeStamp += frameCount;
+		}
+		SFB::Benchmarks::ClobberMemory();
+	});
+}
+
+}
+
+void SFB::Benchmarks::RegisterCARingBufferBenchmarks(Harness& harness)
+{
+	for(auto channelCount : kChannelCounts) {
+		const CAStreamBasicDescription format(CommonPCMFormat::float32, 48000, channelCount, false);
+		const auto bytesPerFrame = format.mBytesPerFrame * channelCount;
+		for(auto frameCount : kFrameCounts) {
+			for(auto position : { ReadPosition::inside, ReadPosition::beforeStart, ReadPosition::afterEnd, ReadPosition::outside }) {
+				Parameters parameters{ {"channels", channelCount}, {"frames", frameCount}, {"position", Name(position)} };
+				harness.Add("CARingBuffer/TimestampedRead", parameters, frameCount * bytesPerFrame, frameCount, [=](uint64_t iterations) {
+					return TimestampedRead(format, frameCount, position, iterations);
+				});
+			}
+
+			Parameters parameters{ {"channels", channelCount}, {"frames", frameCount} };
+			harness.Add("CARingBuffer/Write", parameters, frameCount * bytesPerFrame, frameCount, [=](uint64_t iterations) {
+				return SequentialWrite(format, frameCount, iterations);
+			});
+		}
+	}
+}
@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <cstdint>
+#import <cstring>
+#import <type_traits>
+
+#import "SFBHardwareInterferenceSize.hpp"
+
+namespace SFB {
+
+/// A value shared between one writer and any number of readers without locks
+///
+/// Each store writes the next of @c SlotCount slots and then publishes it, so the writer never waits and readers
+/// copy the most recently published value. Each slot carries the version of the value it holds, which the writer
+/// invalidates before overwriting the slot; a reader that copies a slot while it is overwritten detects this after
+/// the copy and retries. Additional slots reduce the likelihood of a retry when the writer stores frequently, and
+/// a slot occupies a cache line so storing the next value doesn't disturb readers of the current one.
+///
+/// @code
+/// struct Bounds { int64_t mStart; int64_t mEnd; };
+/// SFB::AtomicSnapshot<Bounds> bounds;
+/// // Writer
+/// bounds.Store({ start, end });
+/// // Reader
+/// Bounds b;
+/// if(bounds.Load(b))
+///     Use(b.mStart, b.mEnd);
+/// @endcode
+/// @tparam T A trivially copyable type
+/// @tparam SlotCount The number of slots, which must be a power of two greater than one
+template <typename T, uint32_t SlotCount = 32>
+class AtomicSnapshot
+{
+
+	static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+	static_assert(SlotCount > 1 && (SlotCount & (SlotCount - 1)) == 0, "SlotCount must be a power of two greater than one");
+	static_assert(std::atomic_uint64_t::is_always_lock_free, "Lock-free 64-bit atomics are required");
+
+public:
+
+	/// The default maximum number of attempts made by @c Load()
+	static constexpr uint32_t sDefaultLoadAttempts = 8;
+
+#pragma mark Creation and Destruction
+
+	/// Creates an @c AtomicSnapshot containing a value-initialized @c T
+	AtomicSnapshot() noexcept
+	{
+		Reset();
+	}
+
+	/// Creates an @c AtomicSnapshot containing @c value
+	explicit AtomicSnapshot(const T& value) noexcept
+	{
+		Reset(value);
+	}
+
+	// This class is non-copyable
+	AtomicSnapshot(const AtomicSnapshot& rhs) = delete;
+
+	// This class is non-assignable
+	AtomicSnapshot& operator=(const AtomicSnapshot& rhs) = delete;
+
+	/// Destructor
+	~AtomicSnapshot() = default;
+
+	// This class is non-movable
+	AtomicSnapshot(AtomicSnapshot&& rhs) = delete;
+
+	// This class is non-move assignable
+	AtomicSnapshot& operator=(AtomicSnapshot&& rhs) = delete;
+
+	/// Replaces the value and discards the history of stores
+	/// @note This method is not thread safe and must not be called while the @c AtomicSnapshot is in use
+	void Reset(const T& value = T{}) noexcept
+	{
+		for(auto& slot : mSlots) {
+			std::memcpy(&slot.mValue, &value, sizeof(T));
+			slot.mVersion.store(sInvalidVersion, std::memory_order_relaxed);
+		}
+		mSlots[0].mVersion.store(0, std::memory_order_relaxed);
+		mVersion.store(0, std::memory_order_release);
+	}
+
+#pragma mark Writing
+
+	/// Publishes @c value
+	/// @note This method is wait-free and must only be called from the writer
+	void Store(const T& value) noexcept
+	{
+		// Only the writer modifies the version
+		auto nextVersion = mVersion.load(std::memory_order_relaxed) + 1;
+		auto& slot = mSlots[nextVersion & sSlotMask];
+
+		// A reader still copying this slot from a previous lap observes the invalid version after its copy
+		slot.mVersion.store(sInvalidVersion, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		std::memcpy(&slot.mValue, &value, sizeof(T));
+		slot.mVersion.store(nextVersion, std::memory_order_release);
+
+		mVersion.store(nextVersion, std::memory_order_release);
+	}
+
+	/// Returns the most recently stored value
+	/// @note This method must only be called from the writer
+	inline const T& WriterValue() const noexcept
+	{
+		return mSlots[mVersion.load(std::memory_order_relaxed) & sSlotMask].mValue;
+	}
+
+#pragma mark Reading
+
+	/// Copies the most recently published value to @c value
+	/// @note This method is lock-free and may be called from any thread
+	/// @param value A @c T to receive the value
+	/// @param maximumAttempts The maximum number of copies to attempt before giving up
+	/// @return @c true on success, @c false if every attempt was overwritten by the writer. On failure the contents of @c value are unspecified.
+	bool Load(T& value, uint32_t maximumAttempts = sDefaultLoadAttempts) const noexcept
+	{
+		for(uint32_t i = 0; i < maximumAttempts; ++i) {
+			auto version = mVersion.load(std::memory_order_acquire);
+			const auto& slot = mSlots[version & sSlotMask];
+
+			std::memcpy(&value, &slot.mValue, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if(slot.mVersion.load(std::memory_order_relaxed) == version)
+				return true;
+		}
+
+		return false;
+	}
+
+	/// Returns the number of values stored since creation or the last call to @c Reset()
+	inline uint64_t Version() const noexcept
+	{
+		return mVersion.load(std::memory_order_acquire);
+	}
+
+private:
+
+	/// The version of a slot being overwritten
+	static constexpr uint64_t sInvalidVersion = UINT64_MAX;
+	/// Mask used to wrap versions to slots
+	/// @note Equal to @c SlotCount-1
+	static constexpr uint64_t sSlotMask = SlotCount - 1;
+
+	/// A published value
+	struct alignas(DestructiveInterferenceSize) Slot {
+		/// The version of @c mValue or @c sInvalidVersion while it is being written
+		std::atomic_uint64_t mVersion;
+		/// The value
+		T mValue;
+	};
+
+	/// The slots
+	Slot mSlots[SlotCount];
+	/// The version of the most recently published value
+	alignas(DestructiveInterferenceSize) std::atomic_uint64_t mVersion;
+
+};
+
+} // namespace SFB
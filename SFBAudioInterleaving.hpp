@@ -0,0 +1,213 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <cstddef>
+#import <cstdint>
+#import <cstring>
+#import <type_traits>
+#import <utility>
+
+namespace SFB {
+
+namespace detail {
+
+/// A packed sample of @c N bytes with no SIMD support
+template <std::size_t N>
+struct PackedSample {
+	uint8_t mBytes[N];
+};
+
+/// A 128-bit vector of @c T
+template <typename T>
+struct Vector128 {
+	typedef T type __attribute__((vector_size(16)));
+	/// The number of elements in the vector
+	static constexpr std::size_t sCount = 16 / sizeof(T);
+};
+
+/// Returns the interleaved low halves of @c a and @c b: a0 b0 a1 b1 ...
+template <typename T, std::size_t... I>
+inline typename Vector128<T>::type InterleaveLow(typename Vector128<T>::type a, typename Vector128<T>::type b, std::index_sequence<I...>) noexcept
+{
+	constexpr auto N = Vector128<T>::sCount;
+	return __builtin_shufflevector(a, b, ((I & 1) ? N + I / 2 : I / 2)...);
+}
+
+/// Returns the interleaved high halves of @c a and @c b: a(n/2) b(n/2) a(n/2+1) b(n/2+1) ...
+template <typename T, std::size_t... I>
+inline typename Vector128<T>::type InterleaveHigh(typename Vector128<T>::type a, typename Vector128<T>::type b, std::index_sequence<I...>) noexcept
+{
+	constexpr auto N = Vector128<T>::sCount;
+	return __builtin_shufflevector(a, b, ((I & 1) ? N + N / 2 + I / 2 : N / 2 + I / 2)...);
+}
+
+/// Returns the even elements of the concatenation of @c a and @c b
+template <typename T, std::size_t... I>
+inline typename Vector128<T>::type EvenElements(typename Vector128<T>::type a, typename Vector128<T>::type b, std::index_sequence<I...>) noexcept
+{
+	return __builtin_shufflevector(a, b, (2 * I)...);
+}
+
+/// Returns the odd elements of the concatenation of @c a and @c b
+template <typename T, std::size_t... I>
+inline typename Vector128<T>::type OddElements(typename Vector128<T>::type a, typename Vector128<T>::type b, std::index_sequence<I...>) noexcept
+{
+	return __builtin_shufflevector(a, b, (2 * I + 1)...);
+}
+
+/// Interleaves two channels of @c T using 128-bit vectors
+template <typename T>
+inline void InterleaveStereo(const T * const _Nonnull left, const T * const _Nonnull right, T * const _Nonnull dst, uint32_t frameCount) noexcept
+{
+	using V = typename Vector128<T>::type;
+	constexpr auto N = Vector128<T>::sCount;
+	constexpr auto indexes = std::make_index_sequence<N>();
+
+	uint32_t i = 0;
+	for(; i + N <= frameCount; i += N) {
+		V l, r;
+		std::memcpy(&l, left + i, sizeof(V));
+		std::memcpy(&r, right + i, sizeof(V));
+		V lo = InterleaveLow<T>(l, r, indexes);
+		V hi = InterleaveHigh<T>(l, r, indexes);
+		std::memcpy(dst + 2 * i, &lo, sizeof(V));
+		std::memcpy(dst + 2 * i + N, &hi, sizeof(V));
+	}
+
+	for(; i < frameCount; ++i) {
+		dst[2 * i] = left[i];
+		dst[2 * i + 1] = right[i];
+	}
+}
+
+/// Deinterleaves two channels of @c T using 128-bit vectors
+template <typename T>
+inline void DeinterleaveStereo(const T * const _Nonnull src, T * const _Nonnull left, T * const _Nonnull right, uint32_t frameCount) noexcept
+{
+	using V = typename Vector128<T>::type;
+	constexpr auto N = Vector128<T>::sCount;
+	constexpr auto indexes = std::make_index_sequence<N>();
+
+	uint32_t i = 0;
+	for(; i + N <= frameCount; i += N) {
+		V a, b;
+		std::memcpy(&a, src + 2 * i, sizeof(V));
+		std::memcpy(&b, src + 2 * i + N, sizeof(V));
+		V l = EvenElements<T>(a, b, indexes);
+		V r = OddElements<T>(a, b, indexes);
+		std::memcpy(left + i, &l, sizeof(V));
+		std::memcpy(right + i, &r, sizeof(V));
+	}
+
+	for(; i < frameCount; ++i) {
+		left[i] = src[2 * i];
+		right[i] = src[2 * i + 1];
+	}
+}
+
+/// Interleaves @c channelCount channels of @c T
+template <typename T>
+inline void InterleaveSamples(const void * const _Nonnull * const _Nonnull src, uint32_t srcOffset, void * const _Nonnull dst, uint32_t channelCount, uint32_t frameCount) noexcept
+{
+	auto output = static_cast<T *>(dst);
+
+	if constexpr(std::is_arithmetic_v<T>) {
+		if(channelCount == 2) {
+			InterleaveStereo(reinterpret_cast<const T *>(static_cast<const uint8_t *>(src[0]) + srcOffset), reinterpret_cast<const T *>(static_cast<const uint8_t *>(src[1]) + srcOffset), output, frameCount);
+			return;
+		}
+	}
+
+	for(uint32_t channel = 0; channel < channelCount; ++channel) {
+		auto input = reinterpret_cast<const T *>(static_cast<const uint8_t *>(src[channel]) + srcOffset);
+		for(uint32_t i = 0; i < frameCount; ++i)
+			output[i * channelCount + channel] = input[i];
+	}
+}
+
+/// Deinterleaves @c channelCount channels of @c T
+template <typename T>
+inline void DeinterleaveSamples(const void * const _Nonnull src, void * const _Nonnull * const _Nonnull dst, uint32_t dstOffset, uint32_t channelCount, uint32_t frameCount) noexcept
+{
+	auto input = static_cast<const T *>(src);
+
+	if constexpr(std::is_arithmetic_v<T>) {
+		if(channelCount == 2) {
+			DeinterleaveStereo(input, reinterpret_cast<T *>(static_cast<uint8_t *>(dst[0]) + dstOffset), reinterpret_cast<T *>(static_cast<uint8_t *>(dst[1]) + dstOffset), frameCount);
+			return;
+		}
+	}
+
+	for(uint32_t channel = 0; channel < channelCount; ++channel) {
+		auto output = reinterpret_cast<T *>(static_cast<uint8_t *>(dst[channel]) + dstOffset);
+		for(uint32_t i = 0; i < frameCount; ++i)
+			output[i] = input[i * channelCount + channel];
+	}
+}
+
+} // namespace detail
+
+/// Interleaves audio
+///
+/// Samples of 1, 2, 4, and 8 bytes are copied using 128-bit vector shuffles for stereo and strided loops otherwise.
+/// @note The buffers must be aligned to @c sampleSize
+/// @param src The non-interleaved source buffers, one per channel
+/// @param srcOffset The byte offset in each buffer in @c src to begin reading
+/// @param dst The interleaved destination buffer
+/// @param channelCount The number of channels
+/// @param sampleSize The size of a single sample in bytes
+/// @param frameCount The number of frames to interleave
+inline void Interleave(const void * const _Nonnull * const _Nonnull src, uint32_t srcOffset, void * const _Nonnull dst, uint32_t channelCount, uint32_t sampleSize, uint32_t frameCount) noexcept
+{
+	switch(sampleSize) {
+		case 1: 	detail::InterleaveSamples<uint8_t>(src, srcOffset, dst, channelCount, frameCount);					break;
+		case 2: 	detail::InterleaveSamples<uint16_t>(src, srcOffset, dst, channelCount, frameCount);					break;
+		case 3: 	detail::InterleaveSamples<detail::PackedSample<3>>(src, srcOffset, dst, channelCount, frameCount);	break;
+		case 4: 	detail::InterleaveSamples<uint32_t>(src, srcOffset, dst, channelCount, frameCount);					break;
+		case 8: 	detail::InterleaveSamples<uint64_t>(src, srcOffset, dst, channelCount, frameCount);					break;
+		default:
+			for(uint32_t channel = 0; channel < channelCount; ++channel) {
+				auto input = static_cast<const uint8_t *>(src[channel]) + srcOffset;
+				auto output = static_cast<uint8_t *>(dst) + channel * sampleSize;
+				for(uint32_t i = 0; i < frameCount; ++i)
+					std::memcpy(output + i * channelCount * sampleSize, input + i * sampleSize, sampleSize);
+			}
+			break;
+	}
+}
+
+/// Deinterleaves audio
+///
+/// Samples of 1, 2, 4, and 8 bytes are copied using 128-bit vector shuffles for stereo and strided loops otherwise.
+/// @note The buffers must be aligned to @c sampleSize
+/// @param src The interleaved source buffer
+/// @param dst The non-interleaved destination buffers, one per channel
+/// @param dstOffset The byte offset in each buffer in @c dst to begin writing
+/// @param channelCount The number of channels
+/// @param sampleSize The size of a single sample in bytes
+/// @param frameCount The number of frames to deinterleave
+inline void Deinterleave(const void * const _Nonnull src, void * const _Nonnull * const _Nonnull dst, uint32_t dstOffset, uint32_t channelCount, uint32_t sampleSize, uint32_t frameCount) noexcept
+{
+	switch(sampleSize) {
+		case 1: 	detail::DeinterleaveSamples<uint8_t>(src, dst, dstOffset, channelCount, frameCount);					break;
+		case 2: 	detail::DeinterleaveSamples<uint16_t>(src, dst, dstOffset, channelCount, frameCount);					break;
+		case 3: 	detail::DeinterleaveSamples<detail::PackedSample<3>>(src, dst, dstOffset, channelCount, frameCount);	break;
+		case 4: 	detail::DeinterleaveSamples<uint32_t>(src, dst, dstOffset, channelCount, frameCount);					break;
+		case 8: 	detail::DeinterleaveSamples<uint64_t>(src, dst, dstOffset, channelCount, frameCount);					break;
+		default:
+			for(uint32_t channel = 0; channel < channelCount; ++channel) {
+				auto input = static_cast<const uint8_t *>(src) + channel * sampleSize;
+				auto output = static_cast<uint8_t *>(dst[channel]) + dstOffset;
+				for(uint32_t i = 0; i < frameCount; ++i)
+					std::memcpy(output + i * sampleSize, input + i * channelCount * sampleSize, sampleSize);
+			}
+			break;
+	}
+}
+
+} // namespace SFB
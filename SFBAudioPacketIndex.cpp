@@ -0,0 +1,381 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstring>
+#import <limits>
+#import <stdexcept>
+
+#import "SFBAudioPacketIndex.hpp"
+#import "SFBByteStream.hpp"
+#import "SFBWritableByteStream.hpp"
+
+namespace {
+
+/// The maximum number of packets read per call to @c AudioFileReadPacketData while building an index
+constexpr UInt32 kIndexingBatchPacketCount = 4096;
+/// The maximum number of bytes read per call to @c AudioFileReadPacketData while building an index
+constexpr UInt32 kIndexingBatchByteCount = 1024 * 1024;
+
+/// The identifier of a serialized index
+constexpr uint32_t kSerializedIndexMagic = 'SFPI';
+/// The version of the serialized index format
+constexpr uint32_t kSerializedIndexVersion = 2;
+/// The size of the serialized index header
+constexpr size_t kSerializedIndexHeaderSize = (8 * sizeof(uint32_t)) + (5 * sizeof(uint64_t));
+
+/// Returns the byte offset of @c packet in the audio data of @c audioFile
+/// @param audioFile The audio file
+/// @param packet The packet number
+/// @param estimatedByteOffset The byte offset to use if @c AudioFile can only estimate the offset
+/// @throws @c std::system_error
+SInt64 ByteOffsetOfPacket(const SFB::CAAudioFile& audioFile, SInt64 packet, SInt64 estimatedByteOffset)
+{
+	AudioBytePacketTranslation translation{};
+	translation.mPacket = packet;
+	UInt32 size = sizeof(translation);
+	audioFile.GetProperty(kAudioFilePropertyPacketToByte, size, &translation);
+	if(translation.mFlags & kBytePacketTranslationFlag_IsEstimate)
+		return estimatedByteOffset;
+	return translation.mByte;
+}
+
+}
+
+#pragma mark AudioPacketBuffer
+
+void SFB::AudioPacketBuffer::Reserve(UInt32 packetCapacity, UInt32 byteCapacity)
+{
+	if(mPacketDescriptions.size() < packetCapacity)
+		mPacketDescriptions.resize(packetCapacity);
+	if(mData.size() < byteCapacity)
+		mData.resize(byteCapacity);
+}
+
+#pragma mark AudioPacketIndex
+
+SFB::AudioPacketIndex SFB::AudioPacketIndex::CreateForFile(CAAudioFile& audioFile)
+{
+	if(!audioFile)
+		throw std::invalid_argument("Audio file not open");
+
+	auto format = audioFile.FileDataFormat();
+
+	AudioPacketIndex index;
+	index.mFormatID = format.mFormatID;
+	index.mSampleRate = format.mSampleRate;
+	index.mBytesPerPacket = format.mBytesPerPacket;
+	index.mFramesPerPacket = format.mFramesPerPacket;
+	index.mPacketCount = static_cast<SInt64>(audioFile.AudioDataPacketCount());
+	index.mFilePacketCount = index.mPacketCount;
+	index.mAudioDataByteCount = static_cast<SInt64>(audioFile.AudioDataByteCount());
+
+	if(index.mPacketCount <= 0)
+		throw std::invalid_argument("Audio file contains no packets");
+
+	if(index.mBytesPerPacket)
+		index.mMaximumPacketSize = index.mBytesPerPacket;
+
+	// Without a constant packet size or frame count read the packet descriptions once
+	if(!index.mBytesPerPacket || !index.mFramesPerPacket) {
+		UInt32 maximumPacketSize = 0;
+		UInt32 size = sizeof(maximumPacketSize);
+		audioFile.GetProperty(kAudioFilePropertyMaximumPacketSize, size, &maximumPacketSize);
+		if(maximumPacketSize == 0)
+			throw std::invalid_argument("Audio file maximum packet size unknown");
+
+		auto packetCount = static_cast<size_t>(index.mPacketCount);
+		if(!index.mBytesPerPacket) {
+			index.mPacketByteOffsets.reserve(packetCount);
+			index.mPacketByteSizes.reserve(packetCount);
+		}
+		if(!index.mFramesPerPacket) {
+			index.mPacketFrameOffsets.reserve(packetCount + 1);
+			index.mPacketFrameOffsets.push_back(0);
+		}
+
+		// Size each batch by bytes so formats with large maximum packet sizes don't require an enormous buffer
+		auto batchPacketCount = std::clamp(kIndexingBatchByteCount / maximumPacketSize, UInt32{1}, kIndexingBatchPacketCount);
+		AudioPacketBuffer buffer;
+		buffer.Reserve(batchPacketCount, static_cast<UInt32>(static_cast<UInt64>(batchPacketCount) * maximumPacketSize));
+
+		SInt64 packet = 0;
+		SInt64 byteOffset = 0;
+		while(packet < index.mPacketCount) {
+			auto packetsToRead = static_cast<UInt32>(std::min(static_cast<SInt64>(batchPacketCount), index.mPacketCount - packet));
+			auto bytesToRead = static_cast<UInt32>(buffer.mData.size());
+			auto result = audioFile.ReadPacketData(false, bytesToRead, buffer.mPacketDescriptions.data(), packet, packetsToRead, buffer.mData.data());
+			if(packetsToRead == 0)
+				break;
+
+			for(UInt32 i = 0; i < packetsToRead; ++i) {
+				const auto& packetDescription = buffer.mPacketDescriptions[i];
+				if(!index.mBytesPerPacket) {
+					byteOffset = ByteOffsetOfPacket(audioFile, packet + i, byteOffset);
+					index.mPacketByteOffsets.push_back(static_cast<UInt64>(byteOffset));
+					index.mPacketByteSizes.push_back(packetDescription.mDataByteSize);
+					index.mMaximumPacketSize = std::max(index.mMaximumPacketSize, packetDescription.mDataByteSize);
+					byteOffset += packetDescription.mDataByteSize;
+				}
+				if(!index.mFramesPerPacket)
+					index.mPacketFrameOffsets.push_back(index.mPacketFrameOffsets.back() + packetDescription.mVariableFramesInPacket);
+			}
+
+			packet += packetsToRead;
+			if(result == kAudioFileEndOfFileError)
+				break;
+		}
+
+		// The packet count may be an estimate
+		index.mPacketCount = packet;
+		if(index.mPacketCount == 0)
+			throw std::invalid_argument("Audio file contains no packets");
+	}
+
+	auto totalFrameCount = index.PacketStartingFrame(index.mPacketCount);
+	index.mValidFrameCount = totalFrameCount;
+
+	AudioFilePacketTableInfo packetTableInfo{};
+	UInt32 size = sizeof(packetTableInfo);
+	if(AudioFileGetProperty(audioFile, kAudioFilePropertyPacketTableInfo, &size, &packetTableInfo) == noErr) {
+		if(packetTableInfo.mNumberValidFrames > 0 && packetTableInfo.mPrimingFrames >= 0 && packetTableInfo.mRemainderFrames >= 0 && packetTableInfo.mPrimingFrames + packetTableInfo.mNumberValidFrames <= totalFrameCount) {
+			index.mValidFrameCount = packetTableInfo.mNumberValidFrames;
+			index.mPrimingFrames = static_cast<UInt32>(packetTableInfo.mPrimingFrames);
+			index.mRemainderFrames = static_cast<UInt32>(packetTableInfo.mRemainderFrames);
+		}
+	}
+
+	return index;
+}
+
+#pragma mark Persistence
+
+std::vector<uint8_t> SFB::AudioPacketIndex::Serialize() const
+{
+	auto packetCount = static_cast<size_t>(mPacketCount);
+	auto size = kSerializedIndexHeaderSize;
+	if(!mBytesPerPacket)
+		size += packetCount * (sizeof(UInt64) + sizeof(UInt32));
+	if(!mFramesPerPacket)
+		size += (packetCount + 1) * sizeof(UInt64);
+
+	std::vector<uint8_t> data(size);
+	WritableByteStream stream(data.data(), data.size());
+
+	uint64_t sampleRate;
+	static_assert(sizeof(sampleRate) == sizeof(mSampleRate));
+	std::memcpy(&sampleRate, &mSampleRate, sizeof(sampleRate));
+
+	stream.WriteLE(kSerializedIndexMagic);
+	stream.WriteLE(kSerializedIndexVersion);
+	stream.WriteLE(static_cast<uint32_t>(mFormatID));
+	stream.WriteLE(static_cast<uint32_t>(mBytesPerPacket));
+	stream.WriteLE(static_cast<uint32_t>(mFramesPerPacket));
+	stream.WriteLE(static_cast<uint32_t>(mPrimingFrames));
+	stream.WriteLE(static_cast<uint32_t>(mRemainderFrames));
+	stream.WriteLE(static_cast<uint32_t>(mMaximumPacketSize));
+	stream.WriteLE(sampleRate);
+	stream.WriteLE(static_cast<uint64_t>(mPacketCount));
+	stream.WriteLE(static_cast<uint64_t>(mFilePacketCount));
+	stream.WriteLE(static_cast<uint64_t>(mAudioDataByteCount));
+	stream.WriteLE(static_cast<uint64_t>(mValidFrameCount));
+
+	if(!mBytesPerPacket) {
+		stream.WriteLE(mPacketByteOffsets.data(), mPacketByteOffsets.size());
+		stream.WriteLE(mPacketByteSizes.data(), mPacketByteSizes.size());
+	}
+	if(!mFramesPerPacket)
+		stream.WriteLE(mPacketFrameOffsets.data(), mPacketFrameOffsets.size());
+
+	return data;
+}
+
+SFB::AudioPacketIndex SFB::AudioPacketIndex::Deserialize(const void *buf, size_t len)
+{
+	ByteStream stream(buf, len);
+
+	if(stream.ReadLE<uint32_t>() != kSerializedIndexMagic || stream.ReadLE<uint32_t>() != kSerializedIndexVersion)
+		throw std::invalid_argument("Not a serialized audio packet index");
+
+	if(stream.Remaining() < kSerializedIndexHeaderSize - (2 * sizeof(uint32_t)))
+		throw std::invalid_argument("Truncated audio packet index");
+
+	AudioPacketIndex index;
+	index.mFormatID = stream.ReadLE<uint32_t>();
+	index.mBytesPerPacket = stream.ReadLE<uint32_t>();
+	index.mFramesPerPacket = stream.ReadLE<uint32_t>();
+	index.mPrimingFrames = stream.ReadLE<uint32_t>();
+	index.mRemainderFrames = stream.ReadLE<uint32_t>();
+	index.mMaximumPacketSize = stream.ReadLE<uint32_t>();
+
+	auto sampleRate = stream.ReadLE<uint64_t>();
+	std::memcpy(&index.mSampleRate, &sampleRate, sizeof(index.mSampleRate));
+
+	auto packetCount = stream.ReadLE<uint64_t>();
+	auto filePacketCount = stream.ReadLE<uint64_t>();
+	auto audioDataByteCount = stream.ReadLE<uint64_t>();
+	auto validFrameCount = stream.ReadLE<uint64_t>();
+
+	constexpr auto maximumCount = static_cast<uint64_t>(std::numeric_limits<SInt64>::max());
+	if(packetCount == 0 || packetCount > maximumCount || filePacketCount > maximumCount || audioDataByteCount > maximumCount || validFrameCount > maximumCount)
+		throw std::invalid_argument("Invalid audio packet index");
+
+	index.mPacketCount = static_cast<SInt64>(packetCount);
+	index.mFilePacketCount = static_cast<SInt64>(filePacketCount);
+	index.mAudioDataByteCount = static_cast<SInt64>(audioDataByteCount);
+	index.mValidFrameCount = static_cast<SInt64>(validFrameCount);
+
+	// Verify the tables are present before allocating memory for them
+	uint64_t bytesPerPacketEntry = 0;
+	if(!index.mBytesPerPacket)
+		bytesPerPacketEntry += sizeof(UInt64) + sizeof(UInt32);
+	if(!index.mFramesPerPacket)
+		bytesPerPacketEntry += sizeof(UInt64);
+	if(bytesPerPacketEntry && (packetCount > stream.Remaining() / bytesPerPacketEntry || stream.Remaining() != (packetCount * bytesPerPacketEntry) + (index.mFramesPerPacket ? 0 : sizeof(UInt64))))
+		throw std::invalid_argument("Truncated audio packet index");
+
+	auto count = static_cast<size_t>(packetCount);
+	if(!index.mBytesPerPacket) {
+		index.mPacketByteOffsets.resize(count);
+		index.mPacketByteSizes.resize(count);
+		stream.ReadLE(index.mPacketByteOffsets.data(), count);
+		stream.ReadLE(index.mPacketByteSizes.data(), count);
+
+		for(size_t i = 0; i < count; ++i) {
+			if(index.mPacketByteOffsets[i] + index.mPacketByteSizes[i] > audioDataByteCount)
+				throw std::invalid_argument("Invalid audio packet index");
+		}
+	}
+	if(!index.mFramesPerPacket) {
+		index.mPacketFrameOffsets.resize(count + 1);
+		stream.ReadLE(index.mPacketFrameOffsets.data(), count + 1);
+
+		if(index.mPacketFrameOffsets.front() != 0 || !std::is_sorted(index.mPacketFrameOffsets.begin(), index.mPacketFrameOffsets.end()))
+			throw std::invalid_argument("Invalid audio packet index");
+	}
+
+	if(static_cast<UInt64>(index.mPrimingFrames) + validFrameCount > static_cast<UInt64>(index.PacketStartingFrame(index.mPacketCount)))
+		throw std::invalid_argument("Invalid audio packet index");
+
+	return index;
+}
+
+bool SFB::AudioPacketIndex::Matches(const CAAudioFile& audioFile) const
+{
+	if(!audioFile || mPacketCount == 0)
+		return false;
+
+	auto format = audioFile.FileDataFormat();
+	return format.mFormatID == mFormatID && format.mSampleRate == mSampleRate && format.mBytesPerPacket == mBytesPerPacket && format.mFramesPerPacket == mFramesPerPacket && static_cast<SInt64>(audioFile.AudioDataPacketCount()) == mFilePacketCount && static_cast<SInt64>(audioFile.AudioDataByteCount()) == mAudioDataByteCount;
+}
+
+#pragma mark Random Access
+
+bool SFB::AudioPacketIndex::PositionOfFrame(SInt64 frame, FramePosition& position) const noexcept
+{
+	if(frame < 0 || frame >= mValidFrameCount)
+		return false;
+
+	auto absoluteFrame = frame + mPrimingFrames;
+	if(mFramesPerPacket) {
+		position.mPacket = absoluteFrame / mFramesPerPacket;
+		position.mFrameOffset = static_cast<UInt32>(absoluteFrame % mFramesPerPacket);
+	}
+	else {
+		// The first packet starting after the frame follows the packet containing it
+		auto iter = std::upper_bound(mPacketFrameOffsets.begin(), mPacketFrameOffsets.end(), static_cast<UInt64>(absoluteFrame));
+		position.mPacket = std::distance(mPacketFrameOffsets.begin(), iter) - 1;
+		position.mFrameOffset = static_cast<UInt32>(static_cast<UInt64>(absoluteFrame) - mPacketFrameOffsets[static_cast<size_t>(position.mPacket)]);
+	}
+
+	return true;
+}
+
+UInt32 SFB::AudioPacketIndex::ReadPackets(CAAudioFile& audioFile, SInt64 startingPacket, UInt32 packetCount, AudioPacketBuffer& buffer) const
+{
+	buffer.Clear();
+
+	if(startingPacket < 0 || startingPacket >= mPacketCount || packetCount == 0)
+		return 0;
+
+	packetCount = static_cast<UInt32>(std::min(static_cast<SInt64>(packetCount), mPacketCount - startingPacket));
+
+	// Determine whether the packets can be read in a single contiguous read
+	auto firstByte = PacketByteOffset(startingPacket);
+	auto nextByte = firstByte;
+	bool isContiguous = true;
+	for(UInt32 i = 0; i < packetCount; ++i) {
+		auto packet = startingPacket + i;
+		if(PacketByteOffset(packet) != nextByte)
+			isContiguous = false;
+		nextByte = PacketByteOffset(packet) + PacketByteSize(packet);
+		// Limit the read to the maximum size of a single read
+		if(nextByte - firstByte > std::numeric_limits<UInt32>::max()) {
+			packetCount = std::max(i, 1u);
+			break;
+		}
+	}
+
+	UInt32 byteCapacity = 0;
+	for(UInt32 i = 0; i < packetCount; ++i)
+		byteCapacity += PacketByteSize(startingPacket + i);
+
+	buffer.Reserve(packetCount, byteCapacity);
+
+	UInt32 bytesRead = byteCapacity;
+	UInt32 packetsRead = packetCount;
+	if(isContiguous) {
+		audioFile.ReadBytes(false, firstByte, bytesRead, buffer.mData.data());
+
+		// Only complete packets are returned
+		packetsRead = 0;
+		for(UInt32 i = 0; i < packetCount; ++i) {
+			auto packet = startingPacket + i;
+			auto startOffset = PacketByteOffset(packet) - firstByte;
+			auto byteSize = PacketByteSize(packet);
+			if(startOffset + byteSize > bytesRead)
+				break;
+
+			auto& packetDescription = buffer.mPacketDescriptions[i];
+			packetDescription.mStartOffset = startOffset;
+			packetDescription.mVariableFramesInPacket = mFramesPerPacket ? 0 : static_cast<UInt32>(PacketStartingFrame(packet + 1) - PacketStartingFrame(packet));
+			packetDescription.mDataByteSize = byteSize;
+			++packetsRead;
+		}
+		if(packetsRead > 0) {
+			const auto& lastPacketDescription = buffer.mPacketDescriptions[packetsRead - 1];
+			bytesRead = static_cast<UInt32>(lastPacketDescription.mStartOffset) + lastPacketDescription.mDataByteSize;
+		}
+		else
+			bytesRead = 0;
+	}
+	else
+		audioFile.ReadPacketData(false, bytesRead, buffer.mPacketDescriptions.data(), startingPacket, packetsRead, buffer.mData.data());
+
+	buffer.mStartingPacket = startingPacket;
+	buffer.mPacketCount = packetsRead;
+	buffer.mByteSize = bytesRead;
+
+	return packetsRead;
+}
+
+UInt32 SFB::AudioPacketIndex::ReadPacketsContainingFrames(CAAudioFile& audioFile, SInt64 frame, UInt32 frameCount, AudioPacketBuffer& buffer, UInt32& framesToSkip, UInt32 prerollPackets) const
+{
+	FramePosition first;
+	if(frameCount == 0 || !PositionOfFrame(frame, first)) {
+		buffer.Clear();
+		return 0;
+	}
+
+	FramePosition last;
+	PositionOfFrame(std::min(frame + frameCount, mValidFrameCount) - 1, last);
+
+	auto startingPacket = std::max(first.mPacket - static_cast<SInt64>(prerollPackets), static_cast<SInt64>(0));
+	auto packetCount = std::min(last.mPacket - startingPacket + 1, static_cast<SInt64>(std::numeric_limits<UInt32>::max()));
+
+	framesToSkip = static_cast<UInt32>(PacketStartingFrame(first.mPacket) - PacketStartingFrame(startingPacket)) + first.mFrameOffset;
+	return ReadPackets(audioFile, startingPacket, static_cast<UInt32>(packetCount), buffer);
+}
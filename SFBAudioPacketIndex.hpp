@@ -0,0 +1,322 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <cstddef>
+#import <vector>
+
+#import <AudioToolbox/AudioFile.h>
+
+#import "SFBCAAudioFile.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// Packets of audio data read from an audio file
+///
+/// The storage is retained between reads so once the buffer has grown to the size of the largest read, reading
+/// into it performs no heap allocation.
+class AudioPacketBuffer
+{
+
+public:
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c AudioPacketBuffer
+	AudioPacketBuffer() noexcept = default;
+
+	// This class is non-copyable
+	AudioPacketBuffer(const AudioPacketBuffer& rhs) = delete;
+
+	// This class is non-assignable
+	AudioPacketBuffer& operator=(const AudioPacketBuffer& rhs) = delete;
+
+	/// Destructor
+	~AudioPacketBuffer() = default;
+
+	/// Move constructor
+	AudioPacketBuffer(AudioPacketBuffer&& rhs) noexcept = default;
+
+	/// Move assignment operator
+	AudioPacketBuffer& operator=(AudioPacketBuffer&& rhs) noexcept = default;
+
+#pragma mark Buffer management
+
+	/// Ensures storage exists for at least @c packetCapacity packets containing @c byteCapacity bytes
+	/// @throws @c std::bad_alloc
+	void Reserve(UInt32 packetCapacity, UInt32 byteCapacity);
+
+	/// Empties the buffer without releasing its storage
+	inline void Clear() noexcept
+	{
+		mStartingPacket = 0;
+		mPacketCount = 0;
+		mByteSize = 0;
+	}
+
+#pragma mark Packet access
+
+	/// Returns the number of the first packet in the buffer
+	inline SInt64 StartingPacket() const noexcept
+	{
+		return mStartingPacket;
+	}
+
+	/// Returns the number of packets in the buffer
+	inline UInt32 PacketCount() const noexcept
+	{
+		return mPacketCount;
+	}
+
+	/// Returns the number of bytes of packet data in the buffer
+	inline UInt32 ByteSize() const noexcept
+	{
+		return mByteSize;
+	}
+
+	/// Returns the packet data
+	inline const void * _Nullable Data() const noexcept
+	{
+		return mData.data();
+	}
+
+	/// Returns the descriptions of the packets in the buffer
+	inline const AudioStreamPacketDescription * _Nullable PacketDescriptions() const noexcept
+	{
+		return mPacketDescriptions.data();
+	}
+
+private:
+
+	friend class AudioPacketIndex;
+
+	/// The packet data
+	std::vector<uint8_t> mData;
+	/// The packet descriptions
+	std::vector<AudioStreamPacketDescription> mPacketDescriptions;
+	/// The number of the first packet
+	SInt64 mStartingPacket = 0;
+	/// The number of valid packets
+	UInt32 mPacketCount = 0;
+	/// The number of valid bytes
+	UInt32 mByteSize = 0;
+
+};
+
+/// An in-memory index of the packets in an audio file providing frame-accurate random access
+///
+/// The index is built once by reading the file's packet table and thereafter maps frames to packets and packets to
+/// byte ranges without querying @c AudioFile. Contiguous packets are read with a single @c AudioFileReadBytes call,
+/// so reading the packets containing an arbitrary frame costs one lookup and one read. An index may be serialized
+/// and stored alongside the file to avoid rebuilding it.
+///
+/// Each packet of a variable bit rate format requires 12 bytes, plus 8 bytes if the format has a variable number of
+/// frames per packet. Constant bit rate formats require no per-packet storage.
+///
+/// @code
+/// auto index = SFB::AudioPacketIndex::CreateForFile(file);
+/// SFB::AudioPacketBuffer buffer;
+/// UInt32 framesToSkip;
+/// index.ReadPacketsContainingFrames(file, frame, 4096, buffer, framesToSkip, 1);
+/// @endcode
+class AudioPacketIndex
+{
+
+public:
+
+	/// The location of an audio frame
+	struct FramePosition {
+		/// The packet containing the frame
+		SInt64 mPacket;
+		/// The offset of the frame in the decoded packet
+		UInt32 mFrameOffset;
+	};
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c AudioPacketIndex
+	AudioPacketIndex() noexcept = default;
+
+	/// Copy constructor
+	AudioPacketIndex(const AudioPacketIndex& rhs) = default;
+
+	/// Assignment operator
+	AudioPacketIndex& operator=(const AudioPacketIndex& rhs) = default;
+
+	/// Destructor
+	~AudioPacketIndex() = default;
+
+	/// Move constructor
+	AudioPacketIndex(AudioPacketIndex&& rhs) noexcept = default;
+
+	/// Move assignment operator
+	AudioPacketIndex& operator=(AudioPacketIndex&& rhs) noexcept = default;
+
+	/// Creates an @c AudioPacketIndex for the packets in @c audioFile
+	/// @note For variable bit rate formats this reads all the audio data in @c audioFile once
+	/// @throws @c std::system_error
+	/// @throws @c std::invalid_argument if @c audioFile isn't open or contains no packets
+	/// @throws @c std::bad_alloc
+	static AudioPacketIndex CreateForFile(CAAudioFile& audioFile);
+
+#pragma mark Persistence
+
+	/// Returns a serialized representation of the index
+	/// @throws @c std::bad_alloc
+	std::vector<uint8_t> Serialize() const;
+
+	/// Creates an @c AudioPacketIndex from the serialized representation in @c buf
+	/// @param buf The data returned by @c Serialize()
+	/// @param len The length of @c buf in bytes
+	/// @throws @c std::invalid_argument if @c buf doesn't contain a valid serialized index
+	/// @throws @c std::bad_alloc
+	static AudioPacketIndex Deserialize(const void * _Nullable buf, size_t len);
+
+	/// Returns @c true if the index describes the audio data in @c audioFile
+	///
+	/// This compares the format, packet count, and audio data size recorded in the index to those of @c audioFile and
+	/// can be used to detect a persisted index that is out of date.
+	/// @throws @c std::system_error
+	bool Matches(const CAAudioFile& audioFile) const;
+
+#pragma mark Index Information
+
+	/// Returns @c true if this @c AudioPacketIndex is not empty
+	inline explicit operator bool() const noexcept
+	{
+		return mPacketCount > 0;
+	}
+
+	/// Returns @c true if this @c AudioPacketIndex is empty
+	inline bool operator!() const noexcept
+	{
+		return !operator bool();
+	}
+
+	/// Returns the number of packets
+	inline SInt64 PacketCount() const noexcept
+	{
+		return mPacketCount;
+	}
+
+	/// Returns the number of valid audio frames, excluding priming and remainder frames
+	inline SInt64 FrameCount() const noexcept
+	{
+		return mValidFrameCount;
+	}
+
+	/// Returns the number of priming frames at the beginning of the audio data
+	inline UInt32 PrimingFrames() const noexcept
+	{
+		return mPrimingFrames;
+	}
+
+	/// Returns the number of remainder frames at the end of the audio data
+	inline UInt32 RemainderFrames() const noexcept
+	{
+		return mRemainderFrames;
+	}
+
+	/// Returns the size of the largest packet in bytes
+	inline UInt32 MaximumPacketSize() const noexcept
+	{
+		return mMaximumPacketSize;
+	}
+
+	/// Returns the byte offset of @c packet in the audio data
+	/// @note @c packet must be less than @c PacketCount()
+	inline SInt64 PacketByteOffset(SInt64 packet) const noexcept
+	{
+		return mBytesPerPacket ? packet * mBytesPerPacket : static_cast<SInt64>(mPacketByteOffsets[static_cast<size_t>(packet)]);
+	}
+
+	/// Returns the size of @c packet in bytes
+	/// @note @c packet must be less than @c PacketCount()
+	inline UInt32 PacketByteSize(SInt64 packet) const noexcept
+	{
+		return mBytesPerPacket ? mBytesPerPacket : mPacketByteSizes[static_cast<size_t>(packet)];
+	}
+
+	/// Returns the number of the first frame of @c packet, including priming frames
+	/// @note @c packet must be less than or equal to @c PacketCount()
+	inline SInt64 PacketStartingFrame(SInt64 packet) const noexcept
+	{
+		return mFramesPerPacket ? packet * mFramesPerPacket : static_cast<SInt64>(mPacketFrameOffsets[static_cast<size_t>(packet)]);
+	}
+
+#pragma mark Random Access
+
+	/// Returns the location of @c frame
+	/// @param frame A valid frame number, excluding priming frames
+	/// @param position A @c FramePosition to receive the location of @c frame
+	/// @return @c true on success, @c false if @c frame is out of range
+	bool PositionOfFrame(SInt64 frame, FramePosition& position) const noexcept;
+
+	/// Reads up to @c packetCount packets starting at @c startingPacket from @c audioFile into @c buffer
+	///
+	/// Contiguous packets are read in a single call to @c AudioFileReadBytes and their descriptions are supplied by
+	/// the index. Otherwise the packets are read using @c AudioFileReadPacketData.
+	/// @param audioFile The audio file described by the index
+	/// @param startingPacket The first packet to read
+	/// @param packetCount The desired number of packets
+	/// @param buffer The buffer to receive the packets
+	/// @return The number of packets read
+	/// @throws @c std::system_error
+	/// @throws @c std::bad_alloc
+	UInt32 ReadPackets(CAAudioFile& audioFile, SInt64 startingPacket, UInt32 packetCount, AudioPacketBuffer& buffer) const;
+
+	/// Reads the packets required to decode @c frameCount frames starting at @c frame from @c audioFile into @c buffer
+	/// @param audioFile The audio file described by the index
+	/// @param frame The first desired frame, excluding priming frames
+	/// @param frameCount The desired number of frames
+	/// @param buffer The buffer to receive the packets
+	/// @param framesToSkip On success the number of decoded frames preceding @c frame in @c buffer
+	/// @param prerollPackets The number of packets preceding the packet containing @c frame required by the decoder
+	/// @return The number of packets read
+	/// @throws @c std::system_error
+	/// @throws @c std::bad_alloc
+	UInt32 ReadPacketsContainingFrames(CAAudioFile& audioFile, SInt64 frame, UInt32 frameCount, AudioPacketBuffer& buffer, UInt32& framesToSkip, UInt32 prerollPackets = 0) const;
+
+private:
+
+	/// The format ID of the audio data
+	AudioFormatID mFormatID = 0;
+	/// The sample rate of the audio data
+	Float64 mSampleRate = 0;
+	/// The number of bytes per packet or @c 0 if variable
+	UInt32 mBytesPerPacket = 0;
+	/// The number of frames per packet or @c 0 if variable
+	UInt32 mFramesPerPacket = 0;
+	/// The number of packets
+	SInt64 mPacketCount = 0;
+	/// The number of packets reported by the audio file, which may be an estimate
+	SInt64 mFilePacketCount = 0;
+	/// The size of the audio data in bytes
+	SInt64 mAudioDataByteCount = 0;
+	/// The number of valid frames
+	SInt64 mValidFrameCount = 0;
+	/// The number of priming frames
+	UInt32 mPrimingFrames = 0;
+	/// The number of remainder frames
+	UInt32 mRemainderFrames = 0;
+	/// The size of the largest packet
+	UInt32 mMaximumPacketSize = 0;
+
+	/// The byte offset of each packet if @c mBytesPerPacket is @c 0
+	std::vector<UInt64> mPacketByteOffsets;
+	/// The size of each packet if @c mBytesPerPacket is @c 0
+	std::vector<UInt32> mPacketByteSizes;
+	/// The first frame of each packet followed by the total number of frames if @c mFramesPerPacket is @c 0
+	std::vector<UInt64> mPacketFrameOffsets;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
@@ -0,0 +1,591 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cmath>
+#import <cstring>
+#import <exception>
+#import <new>
+#import <stdexcept>
+#import <utility>
+
+#import <os/log.h>
+
+#import "SFBAudioPipeline.hpp"
+
+namespace {
+
+/// The minimum interval between polls for nodes able to run
+constexpr int64_t kMinimumPollInterval = NSEC_PER_MSEC;
+/// The maximum interval between polls for nodes able to run
+constexpr int64_t kMaximumPollInterval = 10 * NSEC_PER_MSEC;
+
+/// Returns @c true if @c format is empty
+inline bool IsEmptyFormat(const SFB::CAStreamBasicDescription& format) noexcept
+{
+	return format.mFormatID == 0;
+}
+
+/// Copies @c frameCount frames from @c bufferList to @c buffer
+bool CopyToBuffer(const AudioBufferList& bufferList, SFB::CABufferList& buffer, UInt32 frameCount) noexcept
+{
+	if(bufferList.mNumberBuffers != buffer->mNumberBuffers || frameCount > buffer.FrameCapacity())
+		return false;
+
+	auto byteSize = frameCount * buffer.Format().mBytesPerFrame;
+	for(UInt32 i = 0; i < bufferList.mNumberBuffers; ++i)
+		std::memcpy(buffer->mBuffers[i].mData, bufferList.mBuffers[i].mData, byteSize);
+
+	return buffer.SetFrameLength(frameCount);
+}
+
+/// Copies the contents of @c buffer to @c bufferList
+/// @return The number of frames copied
+UInt32 CopyFromBuffer(const SFB::CABufferList& buffer, AudioBufferList& bufferList) noexcept
+{
+	if(bufferList.mNumberBuffers != buffer->mNumberBuffers)
+		return 0;
+
+	auto byteSize = buffer.FrameLength() * buffer.Format().mBytesPerFrame;
+	for(UInt32 i = 0; i < bufferList.mNumberBuffers; ++i)
+		std::memcpy(bufferList.mBuffers[i].mData, buffer->mBuffers[i].mData, byteSize);
+
+	return buffer.FrameLength();
+}
+
+/// Fills the buffers in @c bufferList with silence
+void FillWithSilence(AudioBufferList& bufferList) noexcept
+{
+	for(UInt32 i = 0; i < bufferList.mNumberBuffers; ++i)
+		std::memset(bufferList.mBuffers[i].mData, 0, bufferList.mBuffers[i].mDataByteSize);
+}
+
+/// Reads up to @c frameCount frames from @c ringBuffer to @c buffer
+/// @return The number of frames read
+UInt32 ReadToBuffer(SFB::AudioRingBuffer& ringBuffer, SFB::CABufferList& buffer, UInt32 frameCount) noexcept
+{
+	buffer.SetFrameLength(buffer.FrameCapacity());
+	auto framesRead = ringBuffer.Read(buffer, std::min(frameCount, buffer.FrameCapacity()));
+	buffer.SetFrameLength(framesRead);
+	return framesRead;
+}
+
+}
+
+#pragma mark ExtAudioFileSourceNode
+
+SFB::ExtAudioFileSourceNode::ExtAudioFileSourceNode(CAExtAudioFile&& extAudioFile)
+: mExtAudioFile(std::move(extAudioFile))
+{
+	mFormat = mExtAudioFile.ClientDataFormat();
+}
+
+SFB::AudioPipelineNode::Status SFB::ExtAudioFileSourceNode::Process(const CABufferList *input, CABufferList *output)
+{
+	if(!output)
+		return Status::failed;
+
+	mExtAudioFile.Read(*output);
+	return output->FrameLength() > 0 ? Status::ok : Status::endOfStream;
+}
+
+#pragma mark ExtAudioFileSinkNode
+
+SFB::ExtAudioFileSinkNode::ExtAudioFileSinkNode(CAExtAudioFile&& extAudioFile)
+: mExtAudioFile(std::move(extAudioFile))
+{
+	mFormat = mExtAudioFile.ClientDataFormat();
+}
+
+SFB::AudioPipelineNode::Status SFB::ExtAudioFileSinkNode::Process(const CABufferList *input, CABufferList *output)
+{
+	if(!input)
+		return Status::failed;
+
+	if(input->FrameLength() > 0)
+		mExtAudioFile.Write(input->FrameLength(), *input);
+	return Status::ok;
+}
+
+#pragma mark PCMConverterNode
+
+SFB::PCMConverterNode::PCMConverterNode(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat, PCMConverter::Dither dither)
+: mConverter(sourceFormat, destinationFormat, dither)
+{}
+
+SFB::AudioPipelineNode::Status SFB::PCMConverterNode::Process(const CABufferList *input, CABufferList *output) noexcept
+{
+	if(!input || !output)
+		return Status::failed;
+
+	return mConverter.Convert(*input, *output) == input->FrameLength() ? Status::ok : Status::failed;
+}
+
+#pragma mark ChannelMixerNode
+
+SFB::ChannelMixerNode::ChannelMixerNode(ChannelMixer mixer, Float64 sampleRate) noexcept
+: mMixer(std::move(mixer)), mInputFormat(CommonPCMFormat::float32, sampleRate, mMixer.SourceChannelCount(), false), mOutputFormat(CommonPCMFormat::float32, sampleRate, mMixer.DestinationChannelCount(), false)
+{}
+
+SFB::AudioPipelineNode::Status SFB::ChannelMixerNode::Process(const CABufferList *input, CABufferList *output) noexcept
+{
+	if(!input || !output)
+		return Status::failed;
+
+	return mMixer.Mix(*input, *output) ? Status::ok : Status::failed;
+}
+
+#pragma mark Creation and Destruction
+
+SFB::AudioPipeline::AudioPipeline(double latency, UInt32 chunkFrameCount)
+: mLatency(std::max(latency, 0.0)), mChunkFrameCount(chunkFrameCount), mMaximumRealTimeFrameCount(0), mFirstWorkerNode(0), mLastWorkerNode(0), mWorkerQueue(nullptr), mWorkerGroup(nullptr), mTimerQueue(nullptr), mTimer(nullptr), mFinishedSemaphore(0), mIsStarted(false), mIsStopping(false), mInputEnded(false), mIsFinished(false), mFailed(false)
+{
+	if(chunkFrameCount == 0)
+		throw std::invalid_argument("chunkFrameCount must be nonzero");
+
+	mWorkerQueue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+
+	mWorkerGroup = dispatch_group_create();
+	if(!mWorkerGroup)
+		throw std::runtime_error("Unable to create the dispatch group");
+
+	mTimerQueue = dispatch_queue_create("org.sbooth.AudioPipeline", DISPATCH_QUEUE_SERIAL);
+	if(!mTimerQueue) {
+#if !__has_feature(objc_arc)
+		dispatch_release(mWorkerGroup);
+#endif
+		throw std::runtime_error("Unable to create the dispatch queue");
+	}
+}
+
+SFB::AudioPipeline::~AudioPipeline()
+{
+	Stop();
+
+#if !__has_feature(objc_arc)
+	if(mTimer)
+		dispatch_release(mTimer);
+	dispatch_release(mTimerQueue);
+	dispatch_release(mWorkerGroup);
+#endif
+}
+
+#pragma mark Configuration
+
+void SFB::AudioPipeline::AppendNode(std::unique_ptr<AudioPipelineNode> node)
+{
+	if(mIsStarted)
+		throw std::logic_error("Nodes can't be added to a started pipeline");
+	if(!node)
+		throw std::invalid_argument("node is null");
+
+	if(!mNodes.empty()) {
+		auto inputFormat = node->InputFormat();
+		if(IsEmptyFormat(inputFormat))
+			throw std::invalid_argument("A source must be the first node");
+
+		auto previousOutputFormat = mNodes.back()->OutputFormat();
+		if(IsEmptyFormat(previousOutputFormat))
+			throw std::invalid_argument("A sink must be the last node");
+		if(previousOutputFormat != inputFormat)
+			throw std::invalid_argument("The node's input format doesn't match the output format of the preceding node");
+	}
+
+	mNodes.push_back(std::move(node));
+}
+
+SFB::CAStreamBasicDescription SFB::AudioPipeline::InputFormat() const
+{
+	return mNodes.empty() ? CAStreamBasicDescription{} : mNodes.front()->InputFormat();
+}
+
+SFB::CAStreamBasicDescription SFB::AudioPipeline::OutputFormat() const
+{
+	return mNodes.empty() ? CAStreamBasicDescription{} : mNodes.back()->OutputFormat();
+}
+
+#pragma mark Processing
+
+void SFB::AudioPipeline::Start(UInt32 maximumRealTimeFrameCount)
+{
+	if(mIsStarted)
+		throw std::logic_error("The pipeline has already been started");
+	if(mNodes.empty())
+		throw std::invalid_argument("The pipeline has no nodes");
+	if(maximumRealTimeFrameCount == 0)
+		throw std::invalid_argument("maximumRealTimeFrameCount must be nonzero");
+
+	const auto nodeCount = mNodes.size();
+	const auto hasSource = IsEmptyFormat(mNodes.front()->InputFormat());
+	const auto hasSink = IsEmptyFormat(mNodes.back()->OutputFormat());
+
+	// Real-time safe nodes preserving the frame count can be processed by Write() or Read()
+	auto isRealTimeNode = [&](std::size_t index) {
+		const auto& node = *mNodes[index];
+		return node.IsRealTimeSafe() && node.OutputFrameCapacity(maximumRealTimeFrameCount) == maximumRealTimeFrameCount;
+	};
+
+	std::size_t firstWorkerNode = 0;
+	if(!hasSource) {
+		while(firstWorkerNode < nodeCount - (hasSink ? 1 : 0) && isRealTimeNode(firstWorkerNode))
+			++firstWorkerNode;
+	}
+
+	std::size_t lastWorkerNode = nodeCount;
+	if(!hasSink) {
+		while(lastWorkerNode > std::max(firstWorkerNode, std::size_t(hasSource ? 1 : 0)) && isRealTimeNode(lastWorkerNode - 1))
+			--lastWorkerNode;
+	}
+
+	// Connect the worker nodes with ring buffers holding the latency budget of audio
+	std::vector<std::unique_ptr<AudioRingBuffer>> edges(nodeCount + 1);
+	for(auto i = firstWorkerNode; i <= lastWorkerNode; ++i) {
+		if((i == 0 && hasSource) || (i == nodeCount && hasSink))
+			continue;
+
+		auto format = i < nodeCount ? mNodes[i]->InputFormat() : mNodes.back()->OutputFormat();
+		if(!format.IsPCM() || format.mBytesPerFrame == 0)
+			throw std::invalid_argument("Audio between nodes must be linear PCM");
+
+		auto capacity = std::max(static_cast<UInt32>(std::ceil(mLatency * format.mSampleRate)), 2 * std::max(mChunkFrameCount, maximumRealTimeFrameCount));
+		if(i > firstWorkerNode)
+			capacity = std::max(capacity, 2 * mNodes[i - 1]->OutputFrameCapacity(mChunkFrameCount));
+
+		edges[i] = std::make_unique<AudioRingBuffer>();
+		if(!edges[i]->Allocate(format, capacity))
+			throw std::bad_alloc();
+	}
+
+	// Preallocate the buffers used on the real-time thread
+	auto acquireBuffers = [&](std::size_t first, std::size_t last) {
+		std::vector<CABufferList> buffers;
+		buffers.reserve(last - first + 1);
+		for(auto i = first; i <= last; ++i) {
+			auto format = i == first ? mNodes[i]->InputFormat() : mNodes[i - 1]->OutputFormat();
+			auto buffer = mBufferPool.Acquire(format, maximumRealTimeFrameCount);
+			if(!buffer)
+				throw std::bad_alloc();
+			buffers.push_back(std::move(buffer));
+		}
+		return buffers;
+	};
+
+	std::vector<CABufferList> inputBuffers;
+	if(firstWorkerNode > 0)
+		inputBuffers = acquireBuffers(0, firstWorkerNode);
+
+	std::vector<CABufferList> outputBuffers;
+	if(lastWorkerNode < nodeCount)
+		outputBuffers = acquireBuffers(lastWorkerNode, nodeCount);
+
+	auto stages = std::make_unique<Stage[]>(nodeCount);
+	for(std::size_t i = 0; i < nodeCount; ++i) {
+		stages[i].mPipeline = this;
+		stages[i].mIndex = i;
+		stages[i].mIsScheduled.store(false, std::memory_order_relaxed);
+		stages[i].mIsFinished.store(false, std::memory_order_relaxed);
+	}
+
+	mTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, mTimerQueue);
+	if(!mTimer)
+		throw std::runtime_error("Unable to create the dispatch timer");
+
+	mMaximumRealTimeFrameCount = maximumRealTimeFrameCount;
+	mStages = std::move(stages);
+	mEdges = std::move(edges);
+	mFirstWorkerNode = firstWorkerNode;
+	mLastWorkerNode = lastWorkerNode;
+	mInputBuffers = std::move(inputBuffers);
+	mOutputBuffers = std::move(outputBuffers);
+	mIsStarted = true;
+
+	// A pipeline without worker nodes finishes with its input
+	if(mFirstWorkerNode == mLastWorkerNode && hasSink)
+		mIsFinished.store(true, std::memory_order_release);
+
+	auto interval = std::clamp(static_cast<int64_t>(mLatency * NSEC_PER_SEC / 4), kMinimumPollInterval, kMaximumPollInterval);
+	dispatch_set_context(mTimer, this);
+	dispatch_source_set_event_handler_f(mTimer, Poll);
+	dispatch_source_set_timer(mTimer, DISPATCH_TIME_NOW, static_cast<uint64_t>(interval), static_cast<uint64_t>(interval / 2));
+	dispatch_resume(mTimer);
+}
+
+void SFB::AudioPipeline::Stop() noexcept
+{
+	if(!mIsStarted || mIsStopping.exchange(true, std::memory_order_acq_rel))
+		return;
+
+	dispatch_source_cancel(mTimer);
+	// Wait for any poll in progress, then for the nodes it or the workers scheduled
+	dispatch_sync_f(mTimerQueue, nullptr, [](void *) {});
+	dispatch_group_wait(mWorkerGroup, DISPATCH_TIME_FOREVER);
+
+	if(!mIsFinished.exchange(true, std::memory_order_acq_rel))
+		mFinishedSemaphore.Signal();
+}
+
+bool SFB::AudioPipeline::WaitUntilFinished(dispatch_time_t timeout) noexcept
+{
+	if(IsFinished())
+		return true;
+
+	if(!mFinishedSemaphore.Wait(timeout))
+		return false;
+
+	// Wake any other waiting threads
+	mFinishedSemaphore.Signal();
+	return true;
+}
+
+#pragma mark Real-Time Input and Output
+
+UInt32 SFB::AudioPipeline::Write(const AudioBufferList * const bufferList, UInt32 frameCount) noexcept
+{
+	if(!bufferList || frameCount == 0 || frameCount > mMaximumRealTimeFrameCount || mFirstWorkerNode >= mEdges.size())
+		return 0;
+
+	const auto& edge = mEdges[mFirstWorkerNode];
+	if(!edge || mInputEnded.load(std::memory_order_relaxed) || mFailed.load(std::memory_order_relaxed))
+		return 0;
+
+	auto framesToWrite = std::min(frameCount, edge->FramesAvailableToWrite());
+	if(framesToWrite == 0)
+		return 0;
+
+	if(mInputBuffers.empty())
+		return edge->Write(bufferList, framesToWrite);
+
+	if(!CopyToBuffer(*bufferList, mInputBuffers.front(), framesToWrite))
+		return 0;
+
+	auto buffer = ProcessRealTimeNodes(0, mInputBuffers);
+	if(!buffer)
+		return 0;
+
+	return edge->Write(*buffer, buffer->FrameLength());
+}
+
+void SFB::AudioPipeline::EndInput() noexcept
+{
+	mInputEnded.store(true, std::memory_order_release);
+
+	if(mIsStarted && mFirstWorkerNode == mLastWorkerNode && !mIsFinished.exchange(true, std::memory_order_acq_rel))
+		mFinishedSemaphore.Signal();
+}
+
+UInt32 SFB::AudioPipeline::Read(AudioBufferList * const bufferList, UInt32 frameCount) noexcept
+{
+	if(!bufferList)
+		return 0;
+
+	// The pipeline isn't running or frameCount is invalid
+	if(frameCount == 0 || frameCount > mMaximumRealTimeFrameCount || mLastWorkerNode >= mEdges.size() || !mEdges[mLastWorkerNode]) {
+		FillWithSilence(*bufferList);
+		return 0;
+	}
+
+	const auto& edge = mEdges[mLastWorkerNode];
+
+	UInt32 framesRead = 0;
+	if(!mFailed.load(std::memory_order_relaxed)) {
+		if(mOutputBuffers.empty())
+			framesRead = edge->Read(bufferList, frameCount);
+		else {
+			auto& input = mOutputBuffers.front();
+			ReadToBuffer(*edge, input, frameCount);
+			if(!input.IsEmpty()) {
+				if(auto buffer = ProcessRealTimeNodes(mLastWorkerNode, mOutputBuffers); buffer)
+					framesRead = CopyFromBuffer(*buffer, *bufferList);
+			}
+		}
+	}
+
+	// Fill the remainder with silence
+	const auto& format = mOutputBuffers.empty() ? edge->Format() : mOutputBuffers.back().Format();
+	auto byteOffset = framesRead * format.mBytesPerFrame;
+	auto byteSize = frameCount * format.mBytesPerFrame;
+	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i) {
+		std::memset(static_cast<uint8_t *>(bufferList->mBuffers[i].mData) + byteOffset, 0, byteSize - byteOffset);
+		bufferList->mBuffers[i].mDataByteSize = byteSize;
+	}
+
+	return framesRead;
+}
+
+#pragma mark Internals
+
+void SFB::AudioPipeline::ProcessStage(void *context) noexcept
+{
+	auto& stage = *static_cast<Stage *>(context);
+	auto& pipeline = *stage.mPipeline;
+
+	pipeline.Run(stage.mIndex);
+
+	// A neighboring node may have made this node runnable after Run() returned but before it could be rescheduled
+	stage.mIsScheduled.store(false, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(pipeline.IsRunnable(stage.mIndex))
+		pipeline.Schedule(stage.mIndex);
+}
+
+void SFB::AudioPipeline::Poll(void *context) noexcept
+{
+	auto& pipeline = *static_cast<AudioPipeline *>(context);
+	for(auto i = pipeline.mFirstWorkerNode; i < pipeline.mLastWorkerNode; ++i) {
+		if(pipeline.IsRunnable(i))
+			pipeline.Schedule(i);
+	}
+}
+
+void SFB::AudioPipeline::Schedule(std::size_t index) noexcept
+{
+	if(mIsStopping.load(std::memory_order_acquire))
+		return;
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto& stage = mStages[index];
+	if(stage.mIsScheduled.exchange(true, std::memory_order_acq_rel))
+		return;
+
+	dispatch_group_async_f(mWorkerGroup, mWorkerQueue, &stage, ProcessStage);
+}
+
+bool SFB::AudioPipeline::IsRunnable(std::size_t index) const noexcept
+{
+	if(mStages[index].mIsFinished.load(std::memory_order_acquire) || mIsStopping.load(std::memory_order_acquire) || mFailed.load(std::memory_order_acquire))
+		return false;
+
+	auto frameCount = mChunkFrameCount;
+	if(const auto& input = mEdges[index]; input) {
+		// The upstream state must be read first so no audio written before it finished is overlooked
+		auto upstreamFinished = UpstreamFinished(index);
+		auto framesAvailable = input->FramesAvailableToRead();
+		// A node with no more input is run to finish it
+		if(framesAvailable == 0)
+			return upstreamFinished;
+		if(framesAvailable < mChunkFrameCount && !upstreamFinished)
+			return false;
+		frameCount = std::min(framesAvailable, mChunkFrameCount);
+	}
+
+	if(const auto& output = mEdges[index + 1]; output)
+		return output->FramesAvailableToWrite() >= mNodes[index]->OutputFrameCapacity(frameCount);
+
+	return true;
+}
+
+bool SFB::AudioPipeline::UpstreamFinished(std::size_t index) const noexcept
+{
+	if(index == mFirstWorkerNode)
+		return mInputEnded.load(std::memory_order_acquire);
+	return mStages[index - 1].mIsFinished.load(std::memory_order_acquire);
+}
+
+void SFB::AudioPipeline::Run(std::size_t index) noexcept
+{
+	auto& node = *mNodes[index];
+	const auto& input = mEdges[index];
+	const auto& output = mEdges[index + 1];
+
+	// Buffers are acquired when first needed and returned to the pool when the node is unable to run
+	CABufferList inputBuffer;
+	CABufferList outputBuffer;
+
+	while(!mIsStopping.load(std::memory_order_acquire) && !mFailed.load(std::memory_order_acquire)) {
+		auto frameCount = mChunkFrameCount;
+		if(input) {
+			auto upstreamFinished = UpstreamFinished(index);
+			auto framesAvailable = input->FramesAvailableToRead();
+			if(framesAvailable == 0 && upstreamFinished) {
+				Finish(index);
+				return;
+			}
+			if(framesAvailable == 0 || (framesAvailable < mChunkFrameCount && !upstreamFinished))
+				return;
+			frameCount = std::min(framesAvailable, mChunkFrameCount);
+		}
+
+		if(output && output->FramesAvailableToWrite() < node.OutputFrameCapacity(frameCount))
+			return;
+
+		if(input) {
+			if(!inputBuffer && !(inputBuffer = mBufferPool.Acquire(input->Format(), mChunkFrameCount))) {
+				os_log_error(OS_LOG_DEFAULT, "Unable to acquire an input buffer for audio pipeline node %zu", index);
+				Fail();
+				return;
+			}
+			ReadToBuffer(*input, inputBuffer, frameCount);
+		}
+
+		if(output) {
+			if(!outputBuffer && !(outputBuffer = mBufferPool.Acquire(output->Format(), node.OutputFrameCapacity(mChunkFrameCount)))) {
+				os_log_error(OS_LOG_DEFAULT, "Unable to acquire an output buffer for audio pipeline node %zu", index);
+				Fail();
+				return;
+			}
+			outputBuffer.Clear();
+		}
+
+		AudioPipelineNode::Status status;
+		try {
+			status = node.Process(input ? &inputBuffer : nullptr, output ? &outputBuffer : nullptr);
+		}
+		catch(const std::exception& e) {
+			os_log_error(OS_LOG_DEFAULT, "Error processing audio pipeline node %zu: %{public}s", index, e.what());
+			status = AudioPipelineNode::Status::failed;
+		}
+
+		if(status == AudioPipelineNode::Status::failed) {
+			Fail();
+			return;
+		}
+
+		if(output && !outputBuffer.IsEmpty()) {
+			output->Write(outputBuffer, outputBuffer.FrameLength());
+			if(index + 1 < mLastWorkerNode)
+				Schedule(index + 1);
+		}
+
+		// Reading made space available to the preceding node
+		if(input && index > mFirstWorkerNode)
+			Schedule(index - 1);
+
+		if(status == AudioPipelineNode::Status::endOfStream) {
+			Finish(index);
+			return;
+		}
+	}
+}
+
+void SFB::AudioPipeline::Finish(std::size_t index) noexcept
+{
+	mStages[index].mIsFinished.store(true, std::memory_order_release);
+
+	if(index + 1 < mLastWorkerNode)
+		Schedule(index + 1);
+	else if(!mIsFinished.exchange(true, std::memory_order_acq_rel))
+		mFinishedSemaphore.Signal();
+}
+
+void SFB::AudioPipeline::Fail() noexcept
+{
+	if(!mFailed.exchange(true, std::memory_order_acq_rel) && !mIsFinished.exchange(true, std::memory_order_acq_rel))
+		mFinishedSemaphore.Signal();
+}
+
+const SFB::CABufferList * SFB::AudioPipeline::ProcessRealTimeNodes(std::size_t first, std::vector<CABufferList>& buffers) noexcept
+{
+	for(std::size_t i = 0; i + 1 < buffers.size(); ++i) {
+		auto& output = buffers[i + 1];
+		output.Clear();
+		if(mNodes[first + i]->Process(&buffers[i], &output) == AudioPipelineNode::Status::failed) {
+			Fail();
+			return nullptr;
+		}
+	}
+
+	return &buffers.back();
+}
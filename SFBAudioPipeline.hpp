@@ -0,0 +1,457 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <cstddef>
+#import <memory>
+#import <vector>
+
+#import <dispatch/dispatch.h>
+
+#import "SFBAudioRingBuffer.hpp"
+#import "SFBCABufferList.hpp"
+#import "SFBCABufferListPool.hpp"
+#import "SFBCAExtAudioFile.hpp"
+#import "SFBCAStreamBasicDescription.hpp"
+#import "SFBChannelMixer.hpp"
+#import "SFBDispatchSemaphore.hpp"
+#import "SFBPCMConverter.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A processing stage of an @c AudioPipeline
+///
+/// A node consumes audio in @c InputFormat() and produces audio in @c OutputFormat(). A source has an empty input
+/// format and a sink has an empty output format. @c Process() is never called concurrently for the same node but may
+/// be called from a different thread each time.
+class AudioPipelineNode
+{
+
+public:
+
+	/// The result of processing
+	enum class Status {
+		/// The audio was processed
+		ok,
+		/// The node will produce no more audio
+		endOfStream,
+		/// Processing failed and the pipeline should stop
+		failed,
+	};
+
+	/// Destructor
+	virtual ~AudioPipelineNode() = default;
+
+	/// Returns the format of the audio consumed by @c Process(), or an empty format for a source
+	virtual CAStreamBasicDescription InputFormat() const = 0;
+
+	/// Returns the format of the audio produced by @c Process(), or an empty format for a sink
+	virtual CAStreamBasicDescription OutputFormat() const = 0;
+
+	/// Returns the maximum number of frames produced by processing @c inputFrameCount frames
+	///
+	/// For a source @c inputFrameCount is the number of frames requested.
+	virtual UInt32 OutputFrameCapacity(UInt32 inputFrameCount) const noexcept
+	{
+		return inputFrameCount;
+	}
+
+	/// Returns @c true if @c Process() is real-time safe and may be called from the device thread
+	virtual bool IsRealTimeSafe() const noexcept
+	{
+		return false;
+	}
+
+	/// Processes audio
+	/// @param input The audio to process, which must be consumed completely, or @c nullptr for a source
+	/// @param output An empty buffer with the capacity for @c OutputFrameCapacity() frames to receive the processed
+	/// audio, or @c nullptr for a sink
+	/// @return The processing status
+	/// @throws Any exception derived from @c std::exception to stop the pipeline. A real-time safe node must not throw.
+	virtual Status Process(const CABufferList * _Nullable input, CABufferList * _Nullable output) = 0;
+
+};
+
+/// A source node decoding audio from a @c CAExtAudioFile in its client data format
+class ExtAudioFileSourceNode : public AudioPipelineNode
+{
+
+public:
+
+	/// Creates an @c ExtAudioFileSourceNode reading from @c extAudioFile
+	/// @throws @c std::system_error
+	explicit ExtAudioFileSourceNode(CAExtAudioFile&& extAudioFile);
+
+	CAStreamBasicDescription InputFormat() const override
+	{
+		return {};
+	}
+
+	CAStreamBasicDescription OutputFormat() const override
+	{
+		return mFormat;
+	}
+
+	Status Process(const CABufferList * _Nullable input, CABufferList * _Nullable output) override;
+
+private:
+
+	/// The file
+	CAExtAudioFile mExtAudioFile;
+	/// The client data format of @c mExtAudioFile
+	CAStreamBasicDescription mFormat;
+
+};
+
+/// A sink node encoding audio to a @c CAExtAudioFile from its client data format
+class ExtAudioFileSinkNode : public AudioPipelineNode
+{
+
+public:
+
+	/// Creates an @c ExtAudioFileSinkNode writing to @c extAudioFile
+	/// @throws @c std::system_error
+	explicit ExtAudioFileSinkNode(CAExtAudioFile&& extAudioFile);
+
+	CAStreamBasicDescription InputFormat() const override
+	{
+		return mFormat;
+	}
+
+	CAStreamBasicDescription OutputFormat() const override
+	{
+		return {};
+	}
+
+	Status Process(const CABufferList * _Nullable input, CABufferList * _Nullable output) override;
+
+	/// Returns the file
+	/// @note The file may only be used after the pipeline has finished or stopped
+	inline CAExtAudioFile& ExtAudioFile() noexcept
+	{
+		return mExtAudioFile;
+	}
+
+private:
+
+	/// The file
+	CAExtAudioFile mExtAudioFile;
+	/// The client data format of @c mExtAudioFile
+	CAStreamBasicDescription mFormat;
+
+};
+
+/// A real-time safe node converting between linear PCM sample formats using a @c PCMConverter
+class PCMConverterNode : public AudioPipelineNode
+{
+
+public:
+
+	/// Creates a @c PCMConverterNode converting from @c sourceFormat to @c destinationFormat
+	/// @throws @c std::invalid_argument if the conversion is not supported
+	PCMConverterNode(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat, PCMConverter::Dither dither = PCMConverter::Dither::none);
+
+	CAStreamBasicDescription InputFormat() const override
+	{
+		return mConverter.SourceFormat();
+	}
+
+	CAStreamBasicDescription OutputFormat() const override
+	{
+		return mConverter.DestinationFormat();
+	}
+
+	bool IsRealTimeSafe() const noexcept override
+	{
+		return true;
+	}
+
+	Status Process(const CABufferList * _Nullable input, CABufferList * _Nullable output) noexcept override;
+
+private:
+
+	/// The converter
+	PCMConverter mConverter;
+
+};
+
+/// A real-time safe node mixing non-interleaved 32-bit float audio using a @c ChannelMixer
+class ChannelMixerNode : public AudioPipelineNode
+{
+
+public:
+
+	/// Creates a @c ChannelMixerNode mixing audio at @c sampleRate with @c mixer
+	ChannelMixerNode(ChannelMixer mixer, Float64 sampleRate) noexcept;
+
+	CAStreamBasicDescription InputFormat() const override
+	{
+		return mInputFormat;
+	}
+
+	CAStreamBasicDescription OutputFormat() const override
+	{
+		return mOutputFormat;
+	}
+
+	bool IsRealTimeSafe() const noexcept override
+	{
+		return true;
+	}
+
+	Status Process(const CABufferList * _Nullable input, CABufferList * _Nullable output) noexcept override;
+
+private:
+
+	/// The mixer
+	ChannelMixer mMixer;
+	/// The format of the audio to mix
+	CAStreamBasicDescription mInputFormat;
+	/// The format of the mixed audio
+	CAStreamBasicDescription mOutputFormat;
+
+};
+
+/// A chain of @c AudioPipelineNode objects connected by ring buffers
+///
+/// Each pair of adjacent nodes processed on different threads is connected by an @c AudioRingBuffer holding the
+/// pipeline's latency budget of audio. Nodes that aren't real-time safe are processed on the global concurrent
+/// dispatch queue, which runs independent nodes on different processors at once, so decoding, conversion, mixing,
+/// and encoding proceed in parallel. A node is processed whenever its input ring contains a chunk of audio and its
+/// output ring has space for the result.
+///
+/// A pipeline without a source receives audio from @c Write() and a pipeline without a sink delivers audio from
+/// @c Read(). Both are real-time safe and process any real-time safe nodes at the start or end of the chain on the
+/// calling thread. Neither schedules work; a timer on a private queue polls for nodes able to run.
+///
+/// Buffers used by worker nodes are acquired from a @c CABufferListPool shared by all nodes, so once the pipeline is
+/// running no audio buffers are allocated.
+///
+/// @code
+/// SFB::AudioPipeline pipeline;
+/// pipeline.AppendNode(std::make_unique<SFB::ExtAudioFileSourceNode>(std::move(source)));
+/// pipeline.AppendNode(std::make_unique<SFB::ChannelMixerNode>(std::move(mixer), 44100));
+/// pipeline.AppendNode(std::make_unique<SFB::ExtAudioFileSinkNode>(std::move(destination)));
+/// pipeline.Start();
+/// pipeline.WaitUntilFinished();
+/// @endcode
+class AudioPipeline
+{
+
+public:
+
+	/// The default number of frames processed at once by worker nodes
+	static constexpr UInt32 sDefaultChunkFrameCount = 4096;
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c AudioPipeline
+	/// @param latency The amount of audio buffered between nodes, in seconds
+	/// @param chunkFrameCount The number of frames processed at once by worker nodes
+	/// @throws @c std::invalid_argument if @c chunkFrameCount is @c 0
+	/// @throws @c std::runtime_error
+	explicit AudioPipeline(double latency = 0.5, UInt32 chunkFrameCount = sDefaultChunkFrameCount);
+
+	// This class is non-copyable
+	AudioPipeline(const AudioPipeline& rhs) = delete;
+
+	// This class is non-assignable
+	AudioPipeline& operator=(const AudioPipeline& rhs) = delete;
+
+	/// Stops processing and destroys the @c AudioPipeline
+	~AudioPipeline();
+
+	// This class is non-movable
+	AudioPipeline(AudioPipeline&& rhs) = delete;
+
+	// This class is non-move assignable
+	AudioPipeline& operator=(AudioPipeline&& rhs) = delete;
+
+#pragma mark Configuration
+
+	/// Appends @c node to the chain
+	/// @throws @c std::invalid_argument if @c node's input format doesn't match the output format of the last node,
+	/// if @c node is a source and isn't the first node, or if the last node is a sink
+	/// @throws @c std::logic_error if the pipeline has been started
+	void AppendNode(std::unique_ptr<AudioPipelineNode> node);
+
+	/// Returns the number of nodes
+	inline std::size_t NodeCount() const noexcept
+	{
+		return mNodes.size();
+	}
+
+	/// Returns the node at @c index
+	/// @note @c index must be less than @c NodeCount()
+	inline AudioPipelineNode& Node(std::size_t index) const noexcept
+	{
+		return *mNodes[index];
+	}
+
+	/// Returns the format of the audio accepted by @c Write(), or an empty format if the first node is a source
+	CAStreamBasicDescription InputFormat() const;
+
+	/// Returns the format of the audio returned by @c Read(), or an empty format if the last node is a sink
+	CAStreamBasicDescription OutputFormat() const;
+
+#pragma mark Processing
+
+	/// Allocates the ring buffers and begins processing
+	/// @param maximumRealTimeFrameCount The largest number of frames passed to @c Read() or @c Write()
+	/// @throws @c std::invalid_argument if the pipeline has no nodes or audio between nodes isn't linear PCM
+	/// @throws @c std::logic_error if the pipeline has been started
+	/// @throws @c std::bad_alloc
+	/// @throws @c std::runtime_error
+	void Start(UInt32 maximumRealTimeFrameCount = 4096);
+
+	/// Stops processing and waits for nodes being processed to finish
+	void Stop() noexcept;
+
+	/// Returns @c true if the last worker node has reached the end of its audio, processing failed, or the pipeline was stopped
+	///
+	/// The audio remaining in the last ring buffer of a pipeline without a sink is still available to @c Read().
+	inline bool IsFinished() const noexcept
+	{
+		return mIsFinished.load(std::memory_order_acquire);
+	}
+
+	/// Returns @c true if processing failed
+	inline bool Failed() const noexcept
+	{
+		return mFailed.load(std::memory_order_acquire);
+	}
+
+	/// Waits until @c IsFinished() returns @c true
+	/// @param timeout The maximum duration to block
+	/// @return @c true if the pipeline finished, @c false if the timeout occurred
+	bool WaitUntilFinished(dispatch_time_t timeout = DISPATCH_TIME_FOREVER) noexcept;
+
+#pragma mark Real-Time Input and Output
+
+	/// Processes audio through the real-time safe nodes at the start of the chain and writes it to the first ring buffer
+	/// @note This method is real-time safe and may only be called from a single thread
+	/// @param bufferList An @c AudioBufferList in @c InputFormat()
+	/// @param frameCount The number of frames to write, which must not exceed @c maximumRealTimeFrameCount
+	/// @return The number of frames actually written
+	UInt32 Write(const AudioBufferList * const _Nonnull bufferList, UInt32 frameCount) noexcept;
+
+	/// Signals that @c Write() will not be called again so the worker nodes may finish
+	void EndInput() noexcept;
+
+	/// Reads audio from the last ring buffer and processes it through the real-time safe nodes at the end of the chain
+	///
+	/// Frames not yet processed are filled with silence. If the pipeline isn't running or @c frameCount is invalid the
+	/// buffers in @c bufferList are filled with silence up to their @c mDataByteSize.
+	/// @note This method is real-time safe and may only be called from a single thread
+	/// @param bufferList An @c AudioBufferList in @c OutputFormat() with the capacity for @c frameCount frames
+	/// @param frameCount The number of frames to read, which must not exceed @c maximumRealTimeFrameCount
+	/// @return The number of frames of audio read, excluding silence
+	UInt32 Read(AudioBufferList * const _Nonnull bufferList, UInt32 frameCount) noexcept;
+
+private:
+
+	/// Processing state for a node
+	struct Stage {
+		/// The pipeline containing the node
+		AudioPipeline * _Nullable mPipeline;
+		/// The index of the node
+		std::size_t mIndex;
+		/// Whether the node is scheduled or being processed on the worker queue
+		std::atomic_bool mIsScheduled;
+		/// Whether the node has reached the end of its audio
+		std::atomic_bool mIsFinished;
+	};
+
+	/// Processes a worker node on the worker queue
+	static void ProcessStage(void * _Nullable context) noexcept;
+
+	/// Schedules every worker node able to run
+	static void Poll(void * _Nullable context) noexcept;
+
+	/// Schedules the worker node at @c index if it isn't already scheduled
+	void Schedule(std::size_t index) noexcept;
+
+	/// Returns @c true if the worker node at @c index is able to run
+	bool IsRunnable(std::size_t index) const noexcept;
+
+	/// Returns @c true if the node preceding the node at @c index will produce no more audio
+	bool UpstreamFinished(std::size_t index) const noexcept;
+
+	/// Processes the worker node at @c index until it is unable to run
+	void Run(std::size_t index) noexcept;
+
+	/// Marks the node at @c index as finished
+	void Finish(std::size_t index) noexcept;
+
+	/// Marks processing as failed
+	void Fail() noexcept;
+
+	/// Processes the audio in the first element of @c buffers through the real-time nodes starting at @c first
+	///
+	/// The output of each node is stored in the following element of @c buffers.
+	/// @return The buffer containing the processed audio or @c nullptr on error
+	const CABufferList * _Nullable ProcessRealTimeNodes(std::size_t first, std::vector<CABufferList>& buffers) noexcept;
+
+	/// The amount of audio buffered between nodes, in seconds
+	double mLatency;
+	/// The number of frames processed at once by worker nodes
+	UInt32 mChunkFrameCount;
+	/// The largest number of frames passed to @c Read() or @c Write()
+	UInt32 mMaximumRealTimeFrameCount;
+
+	/// The nodes
+	std::vector<std::unique_ptr<AudioPipelineNode>> mNodes;
+	/// The processing state of each node
+	std::unique_ptr<Stage[]> mStages;
+	/// The input of each node followed by the output of the last node, or @c nullptr if not needed
+	std::vector<std::unique_ptr<AudioRingBuffer>> mEdges;
+
+	/// The index of the first worker node
+	/// @note Nodes before this are processed by @c Write()
+	std::size_t mFirstWorkerNode;
+	/// The index following the last worker node
+	/// @note Nodes starting at this index are processed by @c Read()
+	std::size_t mLastWorkerNode;
+
+	/// The pool supplying buffers to worker nodes
+	CABufferListPool mBufferPool;
+	/// Buffers used by @c Write()
+	std::vector<CABufferList> mInputBuffers;
+	/// Buffers used by @c Read()
+	std::vector<CABufferList> mOutputBuffers;
+
+	/// The queue processing worker nodes
+	dispatch_queue_t mWorkerQueue;
+	/// The group tracking worker nodes being processed
+	dispatch_group_t mWorkerGroup;
+	/// The queue polling for nodes able to run
+	dispatch_queue_t mTimerQueue;
+	/// The timer polling for nodes able to run
+	dispatch_source_t _Nullable mTimer;
+
+	/// Signaled when processing finishes
+	DispatchSemaphore mFinishedSemaphore;
+
+	/// Whether the pipeline has been started
+	bool mIsStarted;
+	/// Whether processing is stopping
+	std::atomic_bool mIsStopping;
+	/// Whether @c EndInput() was called
+	std::atomic_bool mInputEnded;
+	/// Whether processing finished
+	std::atomic_bool mIsFinished;
+	/// Whether processing failed
+	std::atomic_bool mFailed;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
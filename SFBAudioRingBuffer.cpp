@@ -10,6 +10,9 @@
 #import <limits>
 
 #import "SFBAudioRingBuffer.hpp"
+#import "SFBMirroredMemory.hpp"
+#import "SFBAudioInterleaving.hpp"
+#import "SFBPCMConverter.hpp"
 
 namespace {
 
@@ -43,6 +46,68 @@ inline void FetchABL(AudioBufferList * const _Nonnull bufferList, uint32_t dstOf
 	}
 }
 
+/// Copies audio from @c buffers to an interleaved buffer
+/// @param dst The interleaved destination buffer
+/// @param buffers The source buffers in @c format
+/// @param srcOffset The byte offset in @c buffers to begin reading
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void FetchInterleaved(void * const _Nonnull dst, const uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t srcOffset, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		std::memcpy(dst, buffers[0] + srcOffset, frameCount * format.mBytesPerFrame);
+	else
+		SFB::Interleave(reinterpret_cast<const void * const *>(buffers), srcOffset, dst, format.mChannelsPerFrame, format.mBytesPerFrame, frameCount);
+}
+
+/// Copies audio from @c buffers to non-interleaved buffers
+/// @param dst The non-interleaved destination buffers
+/// @param dstOffset The byte offset in @c dst to begin writing
+/// @param buffers The source buffers in @c format
+/// @param srcOffset The byte offset in @c buffers to begin reading
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void FetchNonInterleaved(void * const _Nonnull * const _Nonnull dst, uint32_t dstOffset, const uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t srcOffset, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		SFB::Deinterleave(buffers[0] + srcOffset, dst, dstOffset, format.mChannelsPerFrame, format.mBytesPerFrame / format.mChannelsPerFrame, frameCount);
+	else {
+		for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i)
+			std::memcpy(static_cast<uint8_t *>(dst[i]) + dstOffset, buffers[i] + srcOffset, frameCount * format.mBytesPerFrame);
+	}
+}
+
+/// Copies audio from an interleaved buffer to @c buffers
+/// @param buffers The destination buffers in @c format
+/// @param dstOffset The byte offset in @c buffers to begin writing
+/// @param src The interleaved source buffer
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void StoreInterleaved(uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t dstOffset, const void * const _Nonnull src, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		std::memcpy(buffers[0] + dstOffset, src, frameCount * format.mBytesPerFrame);
+	else
+		SFB::Deinterleave(src, reinterpret_cast<void * const *>(buffers), dstOffset, format.mChannelsPerFrame, format.mBytesPerFrame, frameCount);
+}
+
+/// Copies audio from non-interleaved buffers to @c buffers
+/// @param buffers The destination buffers in @c format
+/// @param dstOffset The byte offset in @c buffers to begin writing
+/// @param src The non-interleaved source buffers
+/// @param srcOffset The byte offset in @c src to begin reading
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void StoreNonInterleaved(uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t dstOffset, const void * const _Nonnull * const _Nonnull src, uint32_t srcOffset, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		SFB::Interleave(src, srcOffset, buffers[0] + dstOffset, format.mChannelsPerFrame, format.mBytesPerFrame / format.mChannelsPerFrame, frameCount);
+	else {
+		for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i)
+			std::memcpy(buffers[i] + dstOffset, static_cast<const uint8_t *>(src[i]) + srcOffset, frameCount * format.mBytesPerFrame);
+	}
+}
+
 /// Returns the smallest power of two value greater than @c x
 /// @param x A value in the range [2..2147483648]
 /// @return The smallest power of two greater than @c x
@@ -53,27 +118,54 @@ inline constexpr uint32_t NextPowerOfTwo(uint32_t x) noexcept
 	return static_cast<uint32_t>(1 << (32 - __builtin_clz(x - 1)));
 }
 
+/// Returns the number of frames available for reading
+/// @param writePointer The write location
+/// @param readPointer The read location
+/// @param capacityFrames The buffer capacity in frames
+/// @param capacityFramesMask The buffer capacity in frames minus one
+inline constexpr uint32_t ReadableFrames(uint32_t writePointer, uint32_t readPointer, uint32_t capacityFrames, uint32_t capacityFramesMask) noexcept
+{
+	if(writePointer > readPointer)
+		return writePointer - readPointer;
+	else
+		return (writePointer - readPointer + capacityFrames) & capacityFramesMask;
+}
+
+/// Returns the number of frames available for writing
+/// @param writePointer The write location
+/// @param readPointer The read location
+/// @param capacityFrames The buffer capacity in frames
+/// @param capacityFramesMask The buffer capacity in frames minus one
+inline constexpr uint32_t WritableFrames(uint32_t writePointer, uint32_t readPointer, uint32_t capacityFrames, uint32_t capacityFramesMask) noexcept
+{
+	if(writePointer > readPointer)
+		return ((readPointer - writePointer + capacityFrames) & capacityFramesMask) - 1;
+	else if(writePointer < readPointer)
+		return (readPointer - writePointer) - 1;
+	else
+		return capacityFrames - 1;
+}
+
 }
 
 #pragma mark Creation and Destruction
 
 SFB::AudioRingBuffer::AudioRingBuffer() noexcept
-: mBuffers(nullptr), mCapacityFrames(0), mCapacityFramesMask(0), mWritePointer(0), mReadPointer(0)
+: mBuffers(nullptr), mCapacityFrames(0), mCapacityFramesMask(0), mIsMirrored(false), mWritePointer(0), mCachedReadPointer(0), mReadPointer(0), mCachedWritePointer(0)
 {
 	assert(mWritePointer.is_lock_free());
 }
 
 SFB::AudioRingBuffer::~AudioRingBuffer()
 {
-	std::free(mBuffers);
+	Deallocate();
 }
 
 #pragma mark Buffer Management
 
-bool SFB::AudioRingBuffer::Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames) noexcept
+bool SFB::AudioRingBuffer::Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames, bool mirrored) noexcept
 {
-	// Only non-interleaved formats are supported
-	if(format.IsInterleaved() || capacityFrames < 2 || capacityFrames > 0x80000000)
+	if(capacityFrames < 2 || capacityFrames > 0x80000000)
 		return false;
 
 	Deallocate();
@@ -81,32 +173,67 @@ bool SFB::AudioRingBuffer::Allocate(const CAStreamBasicDescription& format, uint
 	// Round up to the next power of two
 	capacityFrames = NextPowerOfTwo(static_cast<uint32_t>(capacityFrames));
 
-	mFormat = format;
+	auto capacityBytes = static_cast<uint64_t>(capacityFrames) * format.mBytesPerFrame;
+
+	if(mirrored) {
+		// Mirrored regions must be a multiple of the granularity, which is a power of two
+		auto granularity = MirroredRegionGranularity();
+		while(capacityBytes % granularity) {
+			if(capacityFrames == 0x80000000)
+				return false;
+			capacityFrames *= 2;
+			capacityBytes *= 2;
+		}
+	}
 
-	mCapacityFrames = capacityFrames;
-	mCapacityFramesMask = capacityFrames - 1;
+	if(capacityBytes > std::numeric_limits<uint32_t>::max())
+		return false;
 
-	uint32_t capacityBytes = capacityFrames * format.mBytesPerFrame;
+	auto channelStreamCount = format.ChannelStreamCount();
 
-	// One memory allocation holds everything- first the pointers followed by the deinterleaved channels
-	uint32_t allocationSize = (capacityBytes + sizeof(uint8_t *)) * format.mChannelsPerFrame;
-	uint8_t *memoryChunk = static_cast<uint8_t *>(std::malloc(allocationSize));
-	if(!memoryChunk)
-		return false;
+	if(mirrored) {
+		// The pointers are allocated separately from the mirrored channel buffers, which are zero-filled
+		mBuffers = static_cast<uint8_t **>(std::malloc(channelStreamCount * sizeof(uint8_t *)));
+		if(!mBuffers)
+			return false;
 
-	// Zero the entire allocation
-	std::memset(memoryChunk, 0, allocationSize);
+		auto regions = static_cast<uint8_t *>(AllocateMirroredRegions(capacityBytes, channelStreamCount));
+		if(!regions) {
+			std::free(mBuffers);
+			mBuffers = nullptr;
+			return false;
+		}
 
-	// Assign the pointers and channel buffers
-	mBuffers = reinterpret_cast<uint8_t **>(memoryChunk);
-	memoryChunk += format.mChannelsPerFrame * sizeof(uint8_t *);
-	for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i) {
-		mBuffers[i] = memoryChunk;
-		memoryChunk += capacityBytes;
+		for(UInt32 i = 0; i < channelStreamCount; ++i)
+			mBuffers[i] = regions + 2 * capacityBytes * i;
+	}
+	else {
+		// One memory allocation holds everything- first the pointers followed by the channel buffers
+		auto allocationSize = (capacityBytes + sizeof(uint8_t *)) * channelStreamCount;
+		uint8_t *memoryChunk = static_cast<uint8_t *>(std::malloc(allocationSize));
+		if(!memoryChunk)
+			return false;
+
+		// Zero the entire allocation
+		std::memset(memoryChunk, 0, allocationSize);
+
+		// Assign the pointers and channel buffers
+		mBuffers = reinterpret_cast<uint8_t **>(memoryChunk);
+		memoryChunk += channelStreamCount * sizeof(uint8_t *);
+		for(UInt32 i = 0; i < channelStreamCount; ++i) {
+			mBuffers[i] = memoryChunk;
+			memoryChunk += capacityBytes;
+		}
 	}
 
-	mReadPointer = 0;
-	mWritePointer = 0;
+	mFormat = format;
+
+	mCapacityFrames = capacityFrames;
+	mCapacityFramesMask = capacityFrames - 1;
+
+	mIsMirrored = mirrored;
+
+	Reset();
 
 	return true;
 }
@@ -114,6 +241,8 @@ bool SFB::AudioRingBuffer::Allocate(const CAStreamBasicDescription& format, uint
 void SFB::AudioRingBuffer::Deallocate() noexcept
 {
 	if(mBuffers) {
+		if(mIsMirrored)
+			DeallocateMirroredRegions(mBuffers[0], mCapacityFrames * mFormat.mBytesPerFrame, mFormat.ChannelStreamCount());
 		std::free(mBuffers);
 		mBuffers = nullptr;
 
@@ -121,9 +250,9 @@ void SFB::AudioRingBuffer::Deallocate() noexcept
 
 		mCapacityFrames = 0;
 		mCapacityFramesMask = 0;
+		mIsMirrored = false;
 
-		mReadPointer = 0;
-		mWritePointer = 0;
+		Reset();
 	}
 }
 
@@ -131,30 +260,22 @@ void SFB::AudioRingBuffer::Reset() noexcept
 {
 	mReadPointer = 0;
 	mWritePointer = 0;
+	mCachedReadPointer = 0;
+	mCachedWritePointer = 0;
 }
 
 uint32_t SFB::AudioRingBuffer::FramesAvailableToRead() const noexcept
 {
 	auto writePointer = mWritePointer.load(std::memory_order_acquire);
 	auto readPointer = mReadPointer.load(std::memory_order_acquire);
-
-	if(writePointer > readPointer)
-		return writePointer - readPointer;
-	else
-		return (writePointer - readPointer + mCapacityFrames) & mCapacityFramesMask;
+	return ReadableFrames(writePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
 }
 
 uint32_t SFB::AudioRingBuffer::FramesAvailableToWrite() const noexcept
 {
 	auto writePointer = mWritePointer.load(std::memory_order_acquire);
 	auto readPointer = mReadPointer.load(std::memory_order_acquire);
-
-	if(writePointer > readPointer)
-		return ((readPointer - writePointer + mCapacityFrames) & mCapacityFramesMask) - 1;
-	else if(writePointer < readPointer)
-		return (readPointer - writePointer) - 1;
-	else
-		return mCapacityFrames - 1;
+	return WritableFrames(writePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
 }
 
 #pragma mark Reading and Writing Audio
@@ -164,20 +285,24 @@ uint32_t SFB::AudioRingBuffer::Read(AudioBufferList * const bufferList, uint32_t
 	if(!bufferList || frameCount == 0)
 		return 0;
 
-	auto writePointer = mWritePointer.load(std::memory_order_acquire);
-	auto readPointer = mReadPointer.load(std::memory_order_acquire);
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
 
-	uint32_t framesAvailable;
-	if(writePointer > readPointer)
-		framesAvailable = writePointer - readPointer;
-	else
-		framesAvailable = (writePointer - readPointer + mCapacityFrames) & mCapacityFramesMask;
+	// Only reload the write location if the cached value doesn't satisfy the request
+	auto framesAvailable = ReadableFrames(mCachedWritePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	if(framesAvailable < frameCount) {
+		mCachedWritePointer = mWritePointer.load(std::memory_order_acquire);
+		framesAvailable = ReadableFrames(mCachedWritePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordRead(frameCount, framesAvailable);
+#endif
 
 	if(framesAvailable == 0)
 		return 0;
 
 	auto framesToRead = std::min(framesAvailable, frameCount);
-	if(readPointer + framesToRead > mCapacityFrames) {
+	if(!mIsMirrored && readPointer + framesToRead > mCapacityFrames) {
 		auto framesAfterReadPointer = mCapacityFrames - readPointer;
 		auto bytesAfterReadPointer = framesAfterReadPointer * mFormat.mBytesPerFrame;
 		FetchABL(bufferList, 0, mBuffers, readPointer * mFormat.mBytesPerFrame, bytesAfterReadPointer);
@@ -201,22 +326,24 @@ uint32_t SFB::AudioRingBuffer::Write(const AudioBufferList * const bufferList, u
 	if(!bufferList || frameCount == 0)
 		return 0;
 
-	auto writePointer = mWritePointer.load(std::memory_order_acquire);
-	auto readPointer = mReadPointer.load(std::memory_order_acquire);
+	auto writePointer = mWritePointer.load(std::memory_order_relaxed);
 
-	uint32_t framesAvailable;
-	if(writePointer > readPointer)
-		framesAvailable = ((readPointer - writePointer + mCapacityFrames) & mCapacityFramesMask) - 1;
-	else if(writePointer < readPointer)
-		framesAvailable = (readPointer - writePointer) - 1;
-	else
-		framesAvailable = mCapacityFrames - 1;
+	// Only reload the read location if the cached value doesn't satisfy the request
+	auto framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	if(framesAvailable < frameCount) {
+		mCachedReadPointer = mReadPointer.load(std::memory_order_acquire);
+		framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWrite(frameCount, framesAvailable, mCapacityFrames - 1);
+#endif
 
 	if(framesAvailable == 0)
 		return 0;
 
 	auto framesToWrite = std::min(framesAvailable, frameCount);
-	if(writePointer + framesToWrite > mCapacityFrames) {
+	if(!mIsMirrored && writePointer + framesToWrite > mCapacityFrames) {
 		auto framesAfterWritePointer = mCapacityFrames - writePointer;
 		auto bytesAfterWritePointer = framesAfterWritePointer * mFormat.mBytesPerFrame;
 		StoreABL(mBuffers, writePointer * mFormat.mBytesPerFrame, bufferList, 0, bytesAfterWritePointer);
@@ -227,5 +354,267 @@ uint32_t SFB::AudioRingBuffer::Write(const AudioBufferList * const bufferList, u
 
 	mWritePointer.store((writePointer + framesToWrite) & mCapacityFramesMask, std::memory_order_release);
 
+	NotifyWaiter();
+
+	return framesToWrite;
+}
+
+uint32_t SFB::AudioRingBuffer::Write(const AudioBufferList * const bufferList, uint32_t frameCount, PCMConverter& converter) noexcept
+{
+	if(!bufferList || frameCount == 0 || converter.DestinationFormat() != mFormat)
+		return 0;
+
+	// Never convert more frames than the source buffers contain
+	const auto& sourceFormat = converter.SourceFormat();
+	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+		frameCount = std::min(frameCount, bufferList->mBuffers[i].mDataByteSize / sourceFormat.mBytesPerFrame);
+	if(frameCount == 0)
+		return 0;
+
+	auto writePointer = mWritePointer.load(std::memory_order_relaxed);
+
+	// Only reload the read location if the cached value doesn't satisfy the request
+	auto framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	if(framesAvailable < frameCount) {
+		mCachedReadPointer = mReadPointer.load(std::memory_order_acquire);
+		framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWrite(frameCount, framesAvailable, mCapacityFrames - 1);
+#endif
+
+	if(framesAvailable == 0)
+		return 0;
+
+	auto framesToWrite = std::min(framesAvailable, frameCount);
+	if(!mIsMirrored && writePointer + framesToWrite > mCapacityFrames) {
+		auto framesAfterWritePointer = mCapacityFrames - writePointer;
+		converter.Convert(bufferList, 0, mBuffers, writePointer, framesAfterWritePointer);
+		converter.Convert(bufferList, framesAfterWritePointer, mBuffers, 0, framesToWrite - framesAfterWritePointer);
+	}
+	else
+		converter.Convert(bufferList, 0, mBuffers, writePointer, framesToWrite);
+
+	mWritePointer.store((writePointer + framesToWrite) & mCapacityFramesMask, std::memory_order_release);
+
+	NotifyWaiter();
+
+	return framesToWrite;
+}
+
+uint32_t SFB::AudioRingBuffer::ReadInterleaved(void * const buffer, uint32_t frameCount) noexcept
+{
+	if(!buffer || frameCount == 0)
+		return 0;
+
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
+
+	// Only reload the write location if the cached value doesn't satisfy the request
+	auto framesAvailable = ReadableFrames(mCachedWritePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	if(framesAvailable < frameCount) {
+		mCachedWritePointer = mWritePointer.load(std::memory_order_acquire);
+		framesAvailable = ReadableFrames(mCachedWritePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordRead(frameCount, framesAvailable);
+#endif
+
+	if(framesAvailable == 0)
+		return 0;
+
+	auto framesToRead = std::min(framesAvailable, frameCount);
+	if(!mIsMirrored && readPointer + framesToRead > mCapacityFrames) {
+		auto framesAfterReadPointer = mCapacityFrames - readPointer;
+		auto bytesPerInterleavedFrame = (mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount()) * mFormat.mChannelsPerFrame;
+		FetchInterleaved(buffer, mBuffers, readPointer * mFormat.mBytesPerFrame, mFormat, framesAfterReadPointer);
+		FetchInterleaved(static_cast<uint8_t *>(buffer) + framesAfterReadPointer * bytesPerInterleavedFrame, mBuffers, 0, mFormat, framesToRead - framesAfterReadPointer);
+	}
+	else
+		FetchInterleaved(buffer, mBuffers, readPointer * mFormat.mBytesPerFrame, mFormat, framesToRead);
+
+	mReadPointer.store((readPointer + framesToRead) & mCapacityFramesMask, std::memory_order_release);
+
+	return framesToRead;
+}
+
+uint32_t SFB::AudioRingBuffer::ReadNonInterleaved(void * const * const buffers, uint32_t frameCount) noexcept
+{
+	if(!buffers || frameCount == 0)
+		return 0;
+
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
+
+	// Only reload the write location if the cached value doesn't satisfy the request
+	auto framesAvailable = ReadableFrames(mCachedWritePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	if(framesAvailable < frameCount) {
+		mCachedWritePointer = mWritePointer.load(std::memory_order_acquire);
+		framesAvailable = ReadableFrames(mCachedWritePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordRead(frameCount, framesAvailable);
+#endif
+
+	if(framesAvailable == 0)
+		return 0;
+
+	auto framesToRead = std::min(framesAvailable, frameCount);
+	if(!mIsMirrored && readPointer + framesToRead > mCapacityFrames) {
+		auto framesAfterReadPointer = mCapacityFrames - readPointer;
+		auto bytesPerSample = mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount();
+		FetchNonInterleaved(buffers, 0, mBuffers, readPointer * mFormat.mBytesPerFrame, mFormat, framesAfterReadPointer);
+		FetchNonInterleaved(buffers, framesAfterReadPointer * bytesPerSample, mBuffers, 0, mFormat, framesToRead - framesAfterReadPointer);
+	}
+	else
+		FetchNonInterleaved(buffers, 0, mBuffers, readPointer * mFormat.mBytesPerFrame, mFormat, framesToRead);
+
+	mReadPointer.store((readPointer + framesToRead) & mCapacityFramesMask, std::memory_order_release);
+
+	return framesToRead;
+}
+
+uint32_t SFB::AudioRingBuffer::WriteInterleaved(const void * const buffer, uint32_t frameCount) noexcept
+{
+	if(!buffer || frameCount == 0)
+		return 0;
+
+	auto writePointer = mWritePointer.load(std::memory_order_relaxed);
+
+	// Only reload the read location if the cached value doesn't satisfy the request
+	auto framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	if(framesAvailable < frameCount) {
+		mCachedReadPointer = mReadPointer.load(std::memory_order_acquire);
+		framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWrite(frameCount, framesAvailable, mCapacityFrames - 1);
+#endif
+
+	if(framesAvailable == 0)
+		return 0;
+
+	auto framesToWrite = std::min(framesAvailable, frameCount);
+	if(!mIsMirrored && writePointer + framesToWrite > mCapacityFrames) {
+		auto framesAfterWritePointer = mCapacityFrames - writePointer;
+		auto bytesPerInterleavedFrame = (mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount()) * mFormat.mChannelsPerFrame;
+		StoreInterleaved(mBuffers, writePointer * mFormat.mBytesPerFrame, buffer, mFormat, framesAfterWritePointer);
+		StoreInterleaved(mBuffers, 0, static_cast<const uint8_t *>(buffer) + framesAfterWritePointer * bytesPerInterleavedFrame, mFormat, framesToWrite - framesAfterWritePointer);
+	}
+	else
+		StoreInterleaved(mBuffers, writePointer * mFormat.mBytesPerFrame, buffer, mFormat, framesToWrite);
+
+	mWritePointer.store((writePointer + framesToWrite) & mCapacityFramesMask, std::memory_order_release);
+
+	NotifyWaiter();
+
 	return framesToWrite;
 }
+
+uint32_t SFB::AudioRingBuffer::WriteNonInterleaved(const void * const * const buffers, uint32_t frameCount) noexcept
+{
+	if(!buffers || frameCount == 0)
+		return 0;
+
+	auto writePointer = mWritePointer.load(std::memory_order_relaxed);
+
+	// Only reload the read location if the cached value doesn't satisfy the request
+	auto framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	if(framesAvailable < frameCount) {
+		mCachedReadPointer = mReadPointer.load(std::memory_order_acquire);
+		framesAvailable = WritableFrames(writePointer, mCachedReadPointer, mCapacityFrames, mCapacityFramesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWrite(frameCount, framesAvailable, mCapacityFrames - 1);
+#endif
+
+	if(framesAvailable == 0)
+		return 0;
+
+	auto framesToWrite = std::min(framesAvailable, frameCount);
+	if(!mIsMirrored && writePointer + framesToWrite > mCapacityFrames) {
+		auto framesAfterWritePointer = mCapacityFrames - writePointer;
+		auto bytesPerSample = mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount();
+		StoreNonInterleaved(mBuffers, writePointer * mFormat.mBytesPerFrame, buffers, 0, mFormat, framesAfterWritePointer);
+		StoreNonInterleaved(mBuffers, 0, buffers, framesAfterWritePointer * bytesPerSample, mFormat, framesToWrite - framesAfterWritePointer);
+	}
+	else
+		StoreNonInterleaved(mBuffers, writePointer * mFormat.mBytesPerFrame, buffers, 0, mFormat, framesToWrite);
+
+	mWritePointer.store((writePointer + framesToWrite) & mCapacityFramesMask, std::memory_order_release);
+
+	NotifyWaiter();
+
+	return framesToWrite;
+}
+
+void SFB::AudioRingBuffer::AdvanceReadPosition(uint32_t frameCount) noexcept
+{
+	mReadPointer.store((mReadPointer.load(std::memory_order_relaxed) + frameCount) & mCapacityFramesMask, std::memory_order_release);
+}
+
+void SFB::AudioRingBuffer::AdvanceWritePosition(uint32_t frameCount) noexcept
+{
+	mWritePointer.store((mWritePointer.load(std::memory_order_relaxed) + frameCount) & mCapacityFramesMask, std::memory_order_release);
+	NotifyWaiter();
+}
+
+const SFB::AudioRingBuffer::ReadBufferPair SFB::AudioRingBuffer::ReadVector() const noexcept
+{
+	auto writePointer = mWritePointer.load(std::memory_order_acquire);
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
+
+	auto framesAvailable = ReadableFrames(writePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	auto endOfRead = readPointer + framesAvailable;
+
+	if(!mIsMirrored && endOfRead > mCapacityFrames)
+		return { { mBuffers, readPointer * mFormat.mBytesPerFrame, mCapacityFrames - readPointer }, { mBuffers, 0, endOfRead & mCapacityFramesMask } };
+	else
+		return { { mBuffers, readPointer * mFormat.mBytesPerFrame, framesAvailable }, {} };
+}
+
+const SFB::AudioRingBuffer::WriteBufferPair SFB::AudioRingBuffer::WriteVector() const noexcept
+{
+	auto writePointer = mWritePointer.load(std::memory_order_relaxed);
+	auto readPointer = mReadPointer.load(std::memory_order_acquire);
+
+	auto framesAvailable = WritableFrames(writePointer, readPointer, mCapacityFrames, mCapacityFramesMask);
+	auto endOfWrite = writePointer + framesAvailable;
+
+	if(!mIsMirrored && endOfWrite > mCapacityFrames)
+		return { { mBuffers, writePointer * mFormat.mBytesPerFrame, mCapacityFrames - writePointer }, { mBuffers, 0, endOfWrite & mCapacityFramesMask } };
+	else
+		return { { mBuffers, writePointer * mFormat.mBytesPerFrame, framesAvailable }, {} };
+}
+
+#pragma mark Waiting
+
+bool SFB::AudioRingBuffer::WaitForFrames(uint32_t frameCount, dispatch_time_t timeout) noexcept
+{
+	if(frameCount == 0 || frameCount >= mCapacityFrames)
+		return false;
+
+	auto readPointer = mReadPointer.load(std::memory_order_relaxed);
+	return mWaiter.Wait(frameCount, timeout, [&] {
+		return ReadableFrames(mWritePointer.load(std::memory_order_acquire), readPointer, mCapacityFrames, mCapacityFramesMask);
+	});
+}
+
+uint32_t SFB::AudioRingBuffer::ReadBlocking(AudioBufferList * const bufferList, uint32_t frameCount, dispatch_time_t timeout) noexcept
+{
+	if(!bufferList || frameCount == 0)
+		return 0;
+
+	WaitForFrames(frameCount, timeout);
+	return Read(bufferList, frameCount);
+}
+
+void SFB::AudioRingBuffer::NotifyWaiter() noexcept
+{
+	mWaiter.Notify([&] {
+		return ReadableFrames(mWritePointer.load(std::memory_order_relaxed), mReadPointer.load(std::memory_order_acquire), mCapacityFrames, mCapacityFramesMask);
+	});
+}
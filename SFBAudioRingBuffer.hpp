@@ -7,16 +7,27 @@
 #pragma once
 
 #import <atomic>
+#import <utility>
 
 #import <CoreAudioTypes/CoreAudioTypes.h>
+#import <dispatch/dispatch.h>
 
 #import "SFBCAStreamBasicDescription.hpp"
+#import "SFBHardwareInterferenceSize.hpp"
+#import "SFBMirroredMemory.hpp"
+#import "SFBRingBufferStatistics.hpp"
+#import "SFBRingBufferWaiter.hpp"
 
 namespace SFB {
 
-/// A ring buffer supporting non-interleaved audio.
+class PCMConverter;
+
+/// A ring buffer supporting interleaved and non-interleaved audio.
 ///
 /// This class is thread safe when used from one reader thread and one writer thread (single producer, single consumer model).
+///
+/// The read and write locations are stored on separate cache lines and each side keeps a private copy of the other
+/// side's location, which is reloaded only when the copy indicates the buffer is too empty or too full.
 class AudioRingBuffer
 {
 
@@ -46,13 +57,18 @@ public:
 #pragma mark Buffer management
 
 	/// Allocates space for audio data.
-	/// @note Only interleaved formats are supported.
+	///
+	/// A mirrored buffer maps each channel buffer twice in consecutive virtual memory so any read or write of up to the
+	/// buffer's capacity is a single contiguous span. The capacity of a mirrored buffer is rounded up so each channel
+	/// buffer is a multiple of @c MirroredRegionGranularity().
+	/// @note Interleaved and non-interleaved formats are supported.
 	/// @note This method is not thread safe.
 	/// @note Capacities from 2 to 2,147,483,648 (0x80000000) frames are supported
 	/// @param format The format of the audio that will be written to and read from this buffer.
 	/// @param capacityFrames The desired capacity, in frames
+	/// @param mirrored Whether to allocate mirrored memory
 	/// @return @c true on success, @c false on error
-	bool Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames) noexcept;
+	bool Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames, bool mirrored = false) noexcept;
 
 	/// Frees the resources used by this @c AudioRingBuffer
 	/// @note This method is not thread safe.
@@ -76,6 +92,12 @@ public:
 		return mFormat;
 	}
 
+	/// Returns @c true if this @c AudioRingBuffer uses mirrored memory
+	inline bool IsMirrored() const noexcept
+	{
+		return mIsMirrored;
+	}
+
 	/// Returns the number of frames available for reading
 	uint32_t FramesAvailableToRead() const noexcept;
 
@@ -85,19 +107,210 @@ public:
 #pragma mark Reading and writing audio
 
 	/// Reads audio from the @c AudioRingBuffer and advances the read pointer.
+	///
+	/// Audio is copied only up to the @c mDataByteSize of each buffer in @c bufferList and any remainder is discarded, so
+	/// the byte sizes must be set to the buffers' capacity before reading and @c frameCount must fit. On return the byte
+	/// sizes are set to the size of the audio read.
+	/// @note The layout of @c bufferList must match @c Format()
 	/// @param bufferList An @c AudioBufferList to receive the audio
 	/// @param frameCount The desired number of frames to read
 	/// @return The number of frames actually read
 	uint32_t Read(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount) noexcept;
 
 	/// Writes audio to the @c AudioRingBuffer and advances the write pointer.
+	/// @note The layout of @c bufferList must match @c Format()
 	/// @param bufferList An @c AudioBufferList containing the audio to copy
 	/// @param frameCount The desired number of frames to write
 	/// @return The number of frames actually written
 	uint32_t Write(const AudioBufferList * const _Nonnull bufferList, uint32_t frameCount) noexcept;
 
+	/// Converts audio with @c converter, writes it to the @c AudioRingBuffer, and advances the write pointer.
+	///
+	/// Audio is converted directly into the ring buffer without intermediate copies.
+	/// @note The layout of @c bufferList must match @c converter.SourceFormat() and @c converter.DestinationFormat() must equal @c Format()
+	/// @param bufferList An @c AudioBufferList containing the audio to convert
+	/// @param frameCount The desired number of frames to write
+	/// @param converter The @c PCMConverter to use
+	/// @return The number of frames actually written
+	uint32_t Write(const AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, PCMConverter& converter) noexcept;
+
+
+	/// Reads interleaved audio from the @c AudioRingBuffer and advances the read pointer.
+	///
+	/// If the buffer's format is non-interleaved the audio is interleaved during the copy.
+	/// @param buffer A buffer to receive @c frameCount frames of interleaved audio
+	/// @param frameCount The desired number of frames to read
+	/// @return The number of frames actually read
+	uint32_t ReadInterleaved(void * const _Nonnull buffer, uint32_t frameCount) noexcept;
+
+	/// Reads non-interleaved audio from the @c AudioRingBuffer and advances the read pointer.
+	///
+	/// If the buffer's format is interleaved the audio is deinterleaved during the copy.
+	/// @param buffers An array of @c Format().mChannelsPerFrame buffers each receiving @c frameCount frames of audio
+	/// @param frameCount The desired number of frames to read
+	/// @return The number of frames actually read
+	uint32_t ReadNonInterleaved(void * const _Nonnull * const _Nonnull buffers, uint32_t frameCount) noexcept;
+
+	/// Writes interleaved audio to the @c AudioRingBuffer and advances the write pointer.
+	///
+	/// If the buffer's format is non-interleaved the audio is deinterleaved during the copy.
+	/// @param buffer A buffer containing @c frameCount frames of interleaved audio
+	/// @param frameCount The desired number of frames to write
+	/// @return The number of frames actually written
+	uint32_t WriteInterleaved(const void * const _Nonnull buffer, uint32_t frameCount) noexcept;
+
+	/// Writes non-interleaved audio to the @c AudioRingBuffer and advances the write pointer.
+	///
+	/// If the buffer's format is interleaved the audio is interleaved during the copy.
+	/// @param buffers An array of @c Format().mChannelsPerFrame buffers each containing @c frameCount frames of audio
+	/// @param frameCount The desired number of frames to write
+	/// @return The number of frames actually written
+	uint32_t WriteNonInterleaved(const void * const _Nonnull * const _Nonnull buffers, uint32_t frameCount) noexcept;
+
+
+	/// Advance the read position by the specified number of frames
+	void AdvanceReadPosition(uint32_t frameCount) noexcept;
+
+	/// Advance the write position by the specified number of frames
+	void AdvanceWritePosition(uint32_t frameCount) noexcept;
+
+
+	/// A read-only region of audio located at the same frame offset in every channel buffer
+	struct ReadBuffer {
+		/// The channel buffers
+		const uint8_t * const _Nonnull * const _Nullable mBuffers;
+		/// The byte offset of the region in each channel buffer
+		const uint32_t mByteOffset;
+		/// The number of frames of valid audio in the region
+		const uint32_t mFrameCount;
+
+		/// Construct an empty @c ReadBuffer
+		ReadBuffer() noexcept
+		: ReadBuffer(nullptr, 0, 0)
+		{}
+
+		/// Construct a @c ReadBuffer for the specified channel buffers, offset, and frame count
+		/// @param buffers The channel buffers
+		/// @param byteOffset The byte offset of the region in each channel buffer
+		/// @param frameCount The number of frames of valid audio in the region
+		ReadBuffer(const uint8_t * const _Nonnull * const _Nullable buffers, uint32_t byteOffset, uint32_t frameCount) noexcept
+		: mBuffers(buffers), mByteOffset(byteOffset), mFrameCount(frameCount)
+		{}
+
+		/// Returns the location of the region in channel buffer @c channel
+		/// @note @c channel must be less than @c Format().ChannelStreamCount()
+		inline const void * _Nullable Channel(uint32_t channel) const noexcept
+		{
+			if(!mBuffers || mFrameCount == 0)
+				return nullptr;
+			return mBuffers[channel] + mByteOffset;
+		}
+	};
+
+	/// A pair of @c ReadBuffer objects
+	using ReadBufferPair = std::pair<const ReadBuffer, const ReadBuffer>;
+
+	/// Returns the read vector containing the current readable audio
+	/// @note If the buffer is mirrored the second @c ReadBuffer is always empty
+	const ReadBufferPair ReadVector() const noexcept;
+
+
+	/// A write-only region of audio located at the same frame offset in every channel buffer
+	struct WriteBuffer {
+		/// The channel buffers
+		uint8_t * const _Nonnull * const _Nullable mBuffers;
+		/// The byte offset of the region in each channel buffer
+		const uint32_t mByteOffset;
+		/// The capacity of the region in frames
+		const uint32_t mFrameCapacity;
+
+		/// Construct an empty @c WriteBuffer
+		WriteBuffer() noexcept
+		: WriteBuffer(nullptr, 0, 0)
+		{}
+
+		/// Construct a @c WriteBuffer for the specified channel buffers, offset, and capacity
+		/// @param buffers The channel buffers
+		/// @param byteOffset The byte offset of the region in each channel buffer
+		/// @param frameCapacity The capacity of the region in frames
+		WriteBuffer(uint8_t * const _Nonnull * const _Nullable buffers, uint32_t byteOffset, uint32_t frameCapacity) noexcept
+		: mBuffers(buffers), mByteOffset(byteOffset), mFrameCapacity(frameCapacity)
+		{}
+
+		/// Returns the location of the region in channel buffer @c channel
+		/// @note @c channel must be less than @c Format().ChannelStreamCount()
+		inline void * _Nullable Channel(uint32_t channel) const noexcept
+		{
+			if(!mBuffers || mFrameCapacity == 0)
+				return nullptr;
+			return mBuffers[channel] + mByteOffset;
+		}
+	};
+
+	/// A pair of @c WriteBuffer objects
+	using WriteBufferPair = std::pair<const WriteBuffer, const WriteBuffer>;
+
+	/// Returns the write vector containing the current writable space
+	/// @note If the buffer is mirrored the second @c WriteBuffer is always empty
+	const WriteBufferPair WriteVector() const noexcept;
+
+#pragma mark Waiting
+
+	/// Enables @c WaitForFrames() and @c ReadBlocking()
+	///
+	/// When waiting is enabled the writer checks for a waiting reader after each write and signals a semaphore only if
+	/// the reader's threshold was reached. The writer never blocks.
+	/// @note This method is not thread safe.
+	/// @return @c true on success, @c false on error
+	inline bool EnableWaiting() noexcept
+	{
+		return mWaiter.Enable();
+	}
+
+	/// Waits for at least @c frameCount frames to become available for reading
+	/// @note Only the reader may call this method
+	/// @param frameCount The desired number of frames, from 1 to @c CapacityFrames()-1
+	/// @param timeout The time after which to stop waiting
+	/// @return @c true if at least @c frameCount frames are available, @c false on timeout, if @c frameCount is out of range, or if waiting isn't enabled
+	bool WaitForFrames(uint32_t frameCount, dispatch_time_t timeout = DISPATCH_TIME_FOREVER) noexcept;
+
+	/// Waits for at least @c frameCount frames to become available and reads them, advancing the read pointer.
+	///
+	/// If @c frameCount frames aren't available before @c timeout the available frames are read.
+	/// @note Only the reader may call this method
+	/// @note The layout of @c bufferList must match @c Format()
+	/// @param bufferList An @c AudioBufferList to receive the audio
+	/// @param frameCount The desired number of frames to read, from 1 to @c CapacityFrames()-1
+	/// @param timeout The time after which to stop waiting
+	/// @return The number of frames actually read
+	uint32_t ReadBlocking(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, dispatch_time_t timeout = DISPATCH_TIME_FOREVER) noexcept;
+
+#pragma mark Statistics
+
+	/// Returns the statistics for this @c AudioRingBuffer in frames
+	/// @note Statistics are collected only when @c SFB_RING_BUFFER_STATISTICS is nonzero; otherwise all values are zero
+	inline RingBufferStatistics GetStatistics() const noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		return mStatistics.Snapshot();
+#else
+		return {};
+#endif
+	}
+
+	/// Discards the statistics for this @c AudioRingBuffer
+	inline void ResetStatistics() noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		mStatistics.Reset();
+#endif
+	}
+
 private:
 
+	/// Wakes the reader if it is waiting for the frames now available
+	void NotifyWaiter() noexcept;
+
 	/// The format of the audio
 	CAStreamBasicDescription mFormat;
 
@@ -109,11 +322,26 @@ private:
 	/// Mask used to wrap read and write locations
 	/// @note Equal to @c mCapacityFrames-1
 	uint32_t mCapacityFramesMask;
+	/// Whether the channel buffers are mirrored
+	bool mIsMirrored;
 
 	/// The offset in frames of the write location
-	std::atomic_uint32_t mWritePointer;
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mWritePointer;
+	/// The writer's copy of @c mReadPointer
+	uint32_t mCachedReadPointer;
+
 	/// The offset in frames of the read location
-	std::atomic_uint32_t mReadPointer;
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mReadPointer;
+	/// The reader's copy of @c mWritePointer
+	uint32_t mCachedWritePointer;
+
+	/// Wakes a reader waiting for audio
+	alignas(DestructiveInterferenceSize) RingBufferWaiter mWaiter;
+
+#if SFB_RING_BUFFER_STATISTICS
+	/// The buffer's statistics
+	alignas(DestructiveInterferenceSize) RingBufferStatisticsCollector mStatistics;
+#endif
 
 };
 
@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2021 - 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <exception>
+#import <stdexcept>
+
+#import <pthread.h>
+
+#import <os/log.h>
+
+#import "SFBAudioUnitRecorder.hpp"
+
+SFB::AudioUnitRecorder::AudioUnitRecorder(AudioUnit au, CFURLRef outputFileURL, AudioFileTypeID fileType, const AudioStreamBasicDescription& format, UInt32 busNumber, UInt32 ringBufferFrameCapacity, UInt32 writeBatchFrameCount)
+: mAudioUnit(au), mBusNumber(busNumber), mRingBufferFrameCapacity(ringBufferFrameCapacity), mWriteBatchFrameCount(writeBatchFrameCount), mSemaphore(0), mKeepWriting(false)
+{
+	if(!au)
+		throw std::invalid_argument("au == nullptr");
+	if(ringBufferFrameCapacity == 0 || writeBatchFrameCount == 0)
+		throw std::invalid_argument("ringBufferFrameCapacity == 0 || writeBatchFrameCount == 0");
+	mOutput.ExtAudioFile().CreateWithURL(outputFileURL, fileType, format, nullptr, kAudioFileFlags_EraseFile);
+}
+
+SFB::AudioUnitRecorder::~AudioUnitRecorder()
+{
+	try {
+		Stop();
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error stopping recording: %{public}s", e.what());
+	}
+}
+
+void SFB::AudioUnitRecorder::Start()
+{
+	if(!mOutput.ExtAudioFile().IsValid() || IsRecording())
+		return;
+
+	// All allocations occur here, before the render callback is installed
+	if(!mOutput.IsPrepared()) {
+		CAStreamBasicDescription clientFormat;
+		UInt32 size = sizeof(clientFormat);
+		OSStatus result = AudioUnitGetProperty(mAudioUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, mBusNumber, &clientFormat, &size);
+		ThrowIfCAAudioUnitError(result, "AudioUnitGetProperty");
+		mOutput.Prepare(clientFormat, mRingBufferFrameCapacity, mWriteBatchFrameCount);
+	}
+
+	mKeepWriting.store(true, std::memory_order_release);
+	mWriterThread = std::thread(&AudioUnitRecorder::WriterThreadEntry, this);
+
+	auto result = AudioUnitAddRenderNotify(mAudioUnit, RenderCallback, this);
+	if(result != noErr) {
+		mKeepWriting.store(false, std::memory_order_release);
+		mSemaphore.Signal();
+		mWriterThread.join();
+		ThrowIfCAAudioUnitError(result, "AudioUnitAddRenderNotify");
+	}
+}
+
+void SFB::AudioUnitRecorder::Stop()
+{
+	if(!IsRecording())
+		return;
+
+	OSStatus result = AudioUnitRemoveRenderNotify(mAudioUnit, RenderCallback, this);
+
+	// The writer thread drains the ring buffer before exiting
+	mKeepWriting.store(false, std::memory_order_release);
+	mSemaphore.Signal();
+	mWriterThread.join();
+
+	ThrowIfCAAudioUnitError(result, "AudioUnitRemoveRenderNotify");
+}
+
+SFB::AudioUnitRecorder::Statistics SFB::AudioUnitRecorder::GetStatistics() const noexcept
+{
+	return mOutput.GetStatistics();
+}
+
+void SFB::AudioUnitRecorder::ResetStatistics() noexcept
+{
+	mOutput.ResetStatistics();
+}
+
+OSStatus SFB::AudioUnitRecorder::RenderCallback(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp, UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+	AudioUnitRecorder *THIS = static_cast<AudioUnitRecorder *>(inRefCon);
+	if(*ioActionFlags & kAudioUnitRenderAction_PostRender) {
+		if(THIS->mBusNumber == inBusNumber && !(*ioActionFlags & kAudioUnitRenderAction_PostRenderError)) {
+			THIS->mOutput.Store(ioData, inNumberFrames);
+
+			// Wake the writer thread once a full batch is available
+			if(THIS->mOutput.HasFullBatch())
+				THIS->mSemaphore.Signal();
+		}
+	}
+	return noErr;
+}
+
+void SFB::AudioUnitRecorder::WriterThreadEntry() noexcept
+{
+	pthread_setname_np("org.sbooth.AudioUnitRecorder");
+
+	while(mKeepWriting.load(std::memory_order_acquire)) {
+		mSemaphore.Wait(dispatch_time(DISPATCH_TIME_NOW, detail::RecorderOutput::sWriterTimeout));
+		mOutput.Drain();
+	}
+
+	// Write any audio rendered before the render callback was removed
+	mOutput.Drain();
+}
@@ -6,24 +6,36 @@
 
 #pragma once
 
-#import <stdexcept>
-
-#import <os/log.h>
+#import <atomic>
+#import <thread>
 
 #import <AudioToolbox/AudioUnit.h>
 
-#import "SFBCAExtAudioFile.hpp"
+#import "SFBDispatchSemaphore.hpp"
+#import "SFBRecorderOutput.hpp"
 
 CF_ASSUME_NONNULL_BEGIN
 
 namespace SFB {
 
 /// A class that asynchronously writes the output from an @c AudioUnit to a file
+///
+/// Rendered audio is copied to a preallocated @c AudioRingBuffer on the render thread. A dedicated writer thread
+/// drains the ring buffer and writes the audio to the file in large batches. The render thread never allocates, locks,
+/// or throws; audio that doesn't fit in the ring buffer is discarded and counted.
 class AudioUnitRecorder
 {
 
 public:
 
+	/// Recording statistics
+	using Statistics = detail::RecorderOutput::Statistics;
+
+	/// The default ring buffer capacity in frames
+	static constexpr UInt32 sDefaultRingBufferFrameCapacity = 32768;
+	/// The default number of frames written to the file at once
+	static constexpr UInt32 sDefaultWriteBatchFrameCount = 4096;
+
 	/// Default constructor
 	AudioUnitRecorder() noexcept = delete;
 
@@ -33,8 +45,8 @@ public:
 	/// Assignment operator
 	AudioUnitRecorder& operator=(const AudioUnitRecorder& rhs) noexcept = delete;
 
-	/// Destructor
-	~AudioUnitRecorder() = default;
+	/// Stops recording and destroys the @c AudioUnitRecorder
+	~AudioUnitRecorder();
 
 	/// Move constructor
 	AudioUnitRecorder(AudioUnitRecorder&& rhs) noexcept = delete;
@@ -48,66 +60,63 @@ public:
 	/// @param fileType The type of the file to create
 	/// @param format The format of the audio data to be written to the file
 	/// @param busNumber The bus number of @c au to record
-	AudioUnitRecorder(AudioUnit au, CFURLRef outputFileURL, AudioFileTypeID fileType, const AudioStreamBasicDescription& format, UInt32 busNumber = 0)
-	: mClientFormatIsSet(false), mAudioUnit(au), mBusNumber(busNumber)
-	{
-		if(!au)
-			throw std::invalid_argument("au == nullptr");
-		mExtAudioFile.CreateWithURL(outputFileURL, fileType, format, nullptr, kAudioFileFlags_EraseFile);
-	}
+	/// @param ringBufferFrameCapacity The minimum capacity of the ring buffer in frames
+	/// @param writeBatchFrameCount The maximum number of frames written to the file at once
+	/// @throws @c std::invalid_argument
+	/// @throws @c std::system_error
+	AudioUnitRecorder(AudioUnit au, CFURLRef outputFileURL, AudioFileTypeID fileType, const AudioStreamBasicDescription& format, UInt32 busNumber = 0, UInt32 ringBufferFrameCapacity = sDefaultRingBufferFrameCapacity, UInt32 writeBatchFrameCount = sDefaultWriteBatchFrameCount);
 
 	/// Starts recording
-	void Start() {
-		if(mExtAudioFile.IsValid()) {
-			if(!mClientFormatIsSet) {
-				AudioStreamBasicDescription clientFormat;
-				UInt32 size = sizeof(clientFormat);
-				OSStatus result = AudioUnitGetProperty(mAudioUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, mBusNumber, &clientFormat, &size);
-				ThrowIfCAAudioUnitError(result, "AudioUnitGetProperty");
-				mExtAudioFile.SetClientDataFormat(clientFormat);
-				mClientFormatIsSet = true;
-			}
-			mExtAudioFile.WriteAsync(0, nullptr);
-			auto result = AudioUnitAddRenderNotify(mAudioUnit, RenderCallback, this);
-			ThrowIfCAAudioUnitError(result, "AudioUnitAddRenderNotify");
-		}
-	}
+	///
+	/// The ring buffer and write buffer are allocated the first time recording starts.
+	/// @throws @c std::bad_alloc
+	/// @throws @c std::system_error
+	void Start();
 
 	/// Stops recording
-	void Stop() {
-		if(mExtAudioFile.IsValid()) {
-			OSStatus result = AudioUnitRemoveRenderNotify(mAudioUnit, RenderCallback, this);
-			ThrowIfCAAudioUnitError(result, "AudioUnitRemoveRenderNotify");
-		}
+	///
+	/// Audio remaining in the ring buffer is written to the file before this method returns.
+	/// @throws @c std::system_error
+	void Stop();
+
+	/// Returns @c true if recording
+	inline bool IsRecording() const noexcept
+	{
+		return mWriterThread.joinable();
 	}
 
+	/// Returns the recording statistics
+	/// @note Each value is read atomically but the values are not read as a group
+	Statistics GetStatistics() const noexcept;
+
+	/// Resets the recording statistics
+	void ResetStatistics() noexcept;
+
 private:
 
-	/// Asynchronously writes rendered audio to the file
-	static OSStatus RenderCallback(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp, UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData)
-	{
-		AudioUnitRecorder *THIS = static_cast<AudioUnitRecorder *>(inRefCon);
-		if(*ioActionFlags & kAudioUnitRenderAction_PostRender) {
-			if(THIS->mBusNumber == inBusNumber && !(*ioActionFlags & kAudioUnitRenderAction_PostRenderError)) {
-				try {
-					THIS->mExtAudioFile.WriteAsync(inNumberFrames, ioData);
-				}
-				catch(const std::exception& e) {
-					os_log_debug(OS_LOG_DEFAULT, "Error writing frames: %{public}s", e.what());
-				}
-			}
-		}
-		return noErr;
-	}
+	/// Copies rendered audio to the ring buffer
+	static OSStatus RenderCallback(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp, UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData);
+
+	/// The writer thread entry point
+	void WriterThreadEntry() noexcept;
 
-	/// The underlying @c ExtAudioFile
-	CAExtAudioFile mExtAudioFile;
-	/// @c true if the @c ExtAudioFile client format is set
-	bool mClientFormatIsSet;
+	/// The file receiving the rendered audio
+	detail::RecorderOutput mOutput;
 	/// The @c AudioUnit to record
 	AudioUnit mAudioUnit;
 	/// The bus number of @c mAudioUnit to record
 	UInt32 mBusNumber;
+	/// The minimum capacity of the ring buffer in frames
+	UInt32 mRingBufferFrameCapacity;
+	/// The maximum number of frames written to the file at once
+	UInt32 mWriteBatchFrameCount;
+
+	/// Signaled when there is audio to write or the writer thread should exit
+	DispatchSemaphore mSemaphore;
+	/// The writer thread
+	std::thread mWriterThread;
+	/// @c false if the writer thread should exit
+	std::atomic_bool mKeepWriting;
 
 };
 
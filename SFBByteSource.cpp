@@ -0,0 +1,272 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstring>
+#import <exception>
+#import <limits>
+#import <stdexcept>
+
+#import <os/log.h>
+
+#import "SFBByteSource.hpp"
+#import "SFBCAAudioFile.hpp"
+#import "SFBCAExtAudioFile.hpp"
+
+#pragma mark ByteSource
+
+OSStatus SFB::ByteSource::AudioFileReadProc(void *inClientData, SInt64 inPosition, UInt32 requestCount, void *buffer, UInt32 *actualCount) noexcept
+{
+	*actualCount = 0;
+	if(inPosition < 0)
+		return kAudioFilePositionError;
+
+	try {
+		*actualCount = static_cast<UInt32>(static_cast<ByteSource *>(inClientData)->Read(static_cast<UInt64>(inPosition), buffer, requestCount));
+		return noErr;
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error reading %u bytes at offset %lld: %{public}s", requestCount, inPosition, e.what());
+		return kAudioFileUnspecifiedError;
+	}
+}
+
+SInt64 SFB::ByteSource::AudioFileGetSizeProc(void *inClientData) noexcept
+{
+	try {
+		return static_cast<SInt64>(static_cast<ByteSource *>(inClientData)->Size());
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error getting size: %{public}s", e.what());
+		return 0;
+	}
+}
+
+void SFB::ByteSource::OpenAudioFile(CAAudioFile& audioFile, AudioFileTypeID fileTypeHint)
+{
+	audioFile.OpenWithCallbacks(this, AudioFileReadProc, nullptr, AudioFileGetSizeProc, nullptr, fileTypeHint);
+}
+
+void SFB::ByteSource::OpenExtAudioFile(CAExtAudioFile& extAudioFile, CAAudioFile& audioFile, AudioFileTypeID fileTypeHint)
+{
+	OpenAudioFile(audioFile, fileTypeHint);
+	extAudioFile.WrapAudioFileID(audioFile, false);
+}
+
+#pragma mark MemoryByteSource
+
+SFB::MemoryByteSource::MemoryByteSource(const void *buf, std::size_t len)
+: mData(static_cast<const uint8_t *>(buf)), mLength(len)
+{
+	if(!buf && len > 0)
+		throw std::invalid_argument("buf == nullptr && len > 0");
+}
+
+SFB::MemoryByteSource::MemoryByteSource(std::vector<uint8_t>&& data) noexcept
+: mStorage(std::move(data))
+{
+	mData = mStorage.data();
+	mLength = mStorage.size();
+}
+
+UInt64 SFB::MemoryByteSource::Size() noexcept
+{
+	return mLength;
+}
+
+std::size_t SFB::MemoryByteSource::Read(UInt64 offset, void *buffer, std::size_t count) noexcept
+{
+	if(offset >= mLength)
+		return 0;
+	count = std::min(count, mLength - static_cast<std::size_t>(offset));
+	std::memcpy(buffer, mData + offset, count);
+	return count;
+}
+
+#pragma mark MappedByteSource
+
+SFB::MappedByteSource::MappedByteSource(CFURLRef url)
+: mFile(url)
+{}
+
+UInt64 SFB::MappedByteSource::Size() noexcept
+{
+	return mFile.Size();
+}
+
+std::size_t SFB::MappedByteSource::Read(UInt64 offset, void *buffer, std::size_t count) noexcept
+{
+	if(offset >= mFile.Size())
+		return 0;
+	count = std::min(count, mFile.Size() - static_cast<std::size_t>(offset));
+	std::memcpy(buffer, static_cast<const uint8_t *>(mFile.Data()) + offset, count);
+	return count;
+}
+
+#pragma mark GrowableByteSource
+
+SFB::GrowableByteSource::GrowableByteSource(UInt64 expectedSize)
+: mExpectedSize(expectedSize), mIsFinished(false), mFailed(false)
+{
+	if(expectedSize > std::numeric_limits<std::size_t>::max())
+		throw std::bad_alloc();
+	mData.reserve(static_cast<std::size_t>(expectedSize));
+}
+
+void SFB::GrowableByteSource::Append(const void *buf, std::size_t len)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto bytes = static_cast<const uint8_t *>(buf);
+		mData.insert(mData.end(), bytes, bytes + len);
+	}
+	mCondition.notify_all();
+}
+
+void SFB::GrowableByteSource::Finish() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mIsFinished = true;
+	}
+	mCondition.notify_all();
+}
+
+void SFB::GrowableByteSource::Fail() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFailed = true;
+	}
+	mCondition.notify_all();
+}
+
+std::size_t SFB::GrowableByteSource::AvailableBytes() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mData.size();
+}
+
+UInt64 SFB::GrowableByteSource::Size()
+{
+	if(mExpectedSize > 0)
+		return mExpectedSize;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCondition.wait(lock, [this] { return mIsFinished || mFailed; });
+	if(!mIsFinished)
+		throw std::runtime_error("The transfer failed");
+	return mData.size();
+}
+
+std::size_t SFB::GrowableByteSource::Read(UInt64 offset, void *buffer, std::size_t count)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCondition.wait(lock, [&] { return mIsFinished || mFailed || mData.size() >= offset + count; });
+
+	if(mData.size() < offset + count && !mIsFinished)
+		throw std::runtime_error("The transfer failed");
+
+	if(offset >= mData.size())
+		return 0;
+	count = std::min(count, mData.size() - static_cast<std::size_t>(offset));
+	std::memcpy(buffer, mData.data() + offset, count);
+	return count;
+}
+
+#pragma mark CachingByteSource
+
+SFB::CachingByteSource::CachingByteSource(ByteSource& source, std::size_t blockSize, std::size_t blockCount)
+: mSource(source), mBlockSize(blockSize), mBlockCount(blockCount), mHitCount(0), mMissCount(0)
+{
+	if(blockSize == 0 || blockCount == 0)
+		throw std::invalid_argument("blockSize == 0 || blockCount == 0");
+}
+
+UInt64 SFB::CachingByteSource::Size()
+{
+	return mSource.Size();
+}
+
+std::size_t SFB::CachingByteSource::Read(UInt64 offset, void *buffer, std::size_t count)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	std::size_t bytesRead = 0;
+	while(bytesRead < count) {
+		auto position = offset + bytesRead;
+		const auto& block = GetBlock(position / mBlockSize);
+
+		auto blockOffset = static_cast<std::size_t>(position % mBlockSize);
+		if(blockOffset >= block.mLength)
+			break;
+
+		auto bytesToCopy = std::min(count - bytesRead, block.mLength - blockOffset);
+		std::memcpy(static_cast<uint8_t *>(buffer) + bytesRead, block.mData.get() + blockOffset, bytesToCopy);
+		bytesRead += bytesToCopy;
+
+		// A short block is the last block
+		if(block.mLength < mBlockSize)
+			break;
+	}
+
+	return bytesRead;
+}
+
+uint64_t SFB::CachingByteSource::HitCount() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mHitCount;
+}
+
+uint64_t SFB::CachingByteSource::MissCount() const noexcept
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMissCount;
+}
+
+void SFB::CachingByteSource::Purge() noexcept
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBlocksByIndex.clear();
+	mBlocks.clear();
+}
+
+const SFB::CachingByteSource::Block& SFB::CachingByteSource::GetBlock(UInt64 index)
+{
+	auto iter = mBlocksByIndex.find(index);
+	if(iter != mBlocksByIndex.end()) {
+		++mHitCount;
+		mBlocks.splice(mBlocks.begin(), mBlocks, iter->second);
+		return mBlocks.front();
+	}
+
+	++mMissCount;
+
+	// Reuse the storage of the least recently used block
+	std::unique_ptr<uint8_t []> data;
+	if(mBlocks.size() == mBlockCount) {
+		data = std::move(mBlocks.back().mData);
+		mBlocksByIndex.erase(mBlocks.back().mIndex);
+		mBlocks.pop_back();
+	}
+	else
+		data = std::make_unique<uint8_t []>(mBlockSize);
+
+	// Read the entire block; a short read only occurs at the end of the source
+	std::size_t length = 0;
+	while(length < mBlockSize) {
+		auto bytesRead = mSource.Read(index * mBlockSize + length, data.get() + length, mBlockSize - length);
+		if(bytesRead == 0)
+			break;
+		length += bytesRead;
+	}
+
+	mBlocks.push_front({ index, length, std::move(data) });
+	mBlocksByIndex[index] = mBlocks.begin();
+
+	return mBlocks.front();
+}
@@ -0,0 +1,276 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <condition_variable>
+#import <cstddef>
+#import <cstdint>
+#import <list>
+#import <memory>
+#import <mutex>
+#import <unordered_map>
+#import <vector>
+
+#import <AudioToolbox/AudioFile.h>
+
+#import "SFBMemoryMappedFile.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+class CAAudioFile;
+class CAExtAudioFile;
+
+/// A random-access source of bytes
+///
+/// A @c ByteSource may provide the data for an @c AudioFile opened with callbacks, allowing audio to be decoded
+/// directly from memory or from a network transfer in progress.
+///
+/// @code
+/// SFB::MemoryByteSource source(data, length);
+/// SFB::CAAudioFile audioFile;
+/// SFB::CAExtAudioFile extAudioFile;
+/// source.OpenExtAudioFile(extAudioFile, audioFile);
+/// @endcode
+/// @note A @c ByteSource must outlive any @c AudioFile reading from it
+class ByteSource
+{
+
+public:
+
+	/// An @c AudioFile_ReadProc reading from the @c ByteSource passed as @c inClientData
+	static OSStatus AudioFileReadProc(void *inClientData, SInt64 inPosition, UInt32 requestCount, void *buffer, UInt32 *actualCount) noexcept;
+
+	/// An @c AudioFile_GetSizeProc returning the size of the @c ByteSource passed as @c inClientData
+	static SInt64 AudioFileGetSizeProc(void *inClientData) noexcept;
+
+#pragma mark Creation and Destruction
+
+	/// Creates a @c ByteSource
+	ByteSource() noexcept = default;
+
+	// This class is non-copyable
+	ByteSource(const ByteSource& rhs) = delete;
+
+	// This class is non-assignable
+	ByteSource& operator=(const ByteSource& rhs) = delete;
+
+	/// Destroys the @c ByteSource
+	virtual ~ByteSource() = default;
+
+	// This class is non-movable
+	ByteSource(ByteSource&& rhs) = delete;
+
+	// This class is non-move assignable
+	ByteSource& operator=(ByteSource&& rhs) = delete;
+
+#pragma mark Reading
+
+	/// Returns the number of bytes in the source
+	/// @throws @c std::exception
+	virtual UInt64 Size() = 0;
+
+	/// Reads bytes from the source
+	/// @param offset The offset of the first byte to read
+	/// @param buffer A buffer to receive the bytes
+	/// @param count The desired number of bytes to read
+	/// @return The number of bytes read, which is less than @c count only at the end of the source
+	/// @throws @c std::exception
+	virtual std::size_t Read(UInt64 offset, void *buffer, std::size_t count) = 0;
+
+#pragma mark Audio Files
+
+	/// Opens @c audioFile for reading from this source
+	/// @param audioFile The @c CAAudioFile to open
+	/// @param fileTypeHint A hint for the type of the audio file or @c 0 for none
+	/// @throws @c std::system_error
+	void OpenAudioFile(CAAudioFile& audioFile, AudioFileTypeID fileTypeHint = 0);
+
+	/// Opens @c extAudioFile for reading from this source
+	/// @note @c audioFile must outlive @c extAudioFile
+	/// @param extAudioFile The @c CAExtAudioFile to open
+	/// @param audioFile The @c CAAudioFile wrapped by @c extAudioFile
+	/// @param fileTypeHint A hint for the type of the audio file or @c 0 for none
+	/// @throws @c std::system_error
+	void OpenExtAudioFile(CAExtAudioFile& extAudioFile, CAAudioFile& audioFile, AudioFileTypeID fileTypeHint = 0);
+
+};
+
+/// A @c ByteSource reading from memory
+class MemoryByteSource : public ByteSource
+{
+
+public:
+
+	/// Creates a @c MemoryByteSource reading from @c buf
+	/// @note @c buf is not copied and must outlive the @c MemoryByteSource
+	/// @param buf The bytes to read
+	/// @param len The length of @c buf in bytes
+	/// @throws @c std::invalid_argument if @c buf==nullptr and @c len>0
+	MemoryByteSource(const void * _Nullable buf, std::size_t len);
+
+	/// Creates a @c MemoryByteSource reading from @c data
+	/// @param data The bytes to read
+	explicit MemoryByteSource(std::vector<uint8_t>&& data) noexcept;
+
+	UInt64 Size() noexcept override;
+	std::size_t Read(UInt64 offset, void *buffer, std::size_t count) noexcept override;
+
+private:
+
+	/// The storage for owned bytes
+	std::vector<uint8_t> mStorage;
+	/// The bytes
+	const uint8_t * _Nullable mData;
+	/// The number of bytes
+	std::size_t mLength;
+
+};
+
+/// A @c ByteSource reading from a memory-mapped file
+class MappedByteSource : public ByteSource
+{
+
+public:
+
+	/// Creates a @c MappedByteSource reading from the file at @c url
+	/// @throws @c std::invalid_argument if @c url is not a file URL
+	/// @throws @c std::system_error
+	explicit MappedByteSource(CFURLRef url);
+
+	UInt64 Size() noexcept override;
+	std::size_t Read(UInt64 offset, void *buffer, std::size_t count) noexcept override;
+
+private:
+
+	/// The mapped file
+	MemoryMappedFile mFile;
+
+};
+
+/// A @c ByteSource reading from a buffer that grows as bytes arrive
+///
+/// Bytes are appended from any thread, typically as a network transfer progresses. A read of bytes that haven't
+/// arrived blocks until they are appended or the transfer is finished or fails.
+class GrowableByteSource : public ByteSource
+{
+
+public:
+
+	/// Creates a @c GrowableByteSource
+	/// @param expectedSize The number of bytes expected or @c 0 if unknown
+	/// @throws @c std::bad_alloc
+	explicit GrowableByteSource(UInt64 expectedSize = 0);
+
+	/// Appends bytes to the source and wakes any blocked readers
+	/// @throws @c std::bad_alloc
+	void Append(const void *buf, std::size_t len);
+
+	/// Marks the source as complete
+	void Finish() noexcept;
+
+	/// Marks the transfer as failed; pending and future reads of bytes that haven't arrived throw
+	void Fail() noexcept;
+
+	/// Returns the number of bytes that have arrived
+	std::size_t AvailableBytes() const noexcept;
+
+	/// Returns the expected size or, if unknown, blocks until the source is complete
+	/// @throws @c std::runtime_error if the transfer failed
+	UInt64 Size() override;
+
+	/// @throws @c std::runtime_error if the transfer failed before the requested bytes arrived
+	std::size_t Read(UInt64 offset, void *buffer, std::size_t count) override;
+
+private:
+
+	/// The expected number of bytes or @c 0 if unknown
+	const UInt64 mExpectedSize;
+	/// The bytes that have arrived
+	std::vector<uint8_t> mData;
+	/// @c true if all bytes have arrived
+	bool mIsFinished;
+	/// @c true if the transfer failed
+	bool mFailed;
+	/// The lock protecting the data and state
+	mutable std::mutex mMutex;
+	/// The condition signaled when bytes arrive or the state changes
+	std::condition_variable mCondition;
+
+};
+
+/// A @c ByteSource caching fixed-size blocks of another @c ByteSource
+///
+/// The least recently used block is evicted when the cache is full.
+/// @note The cached @c ByteSource must outlive the @c CachingByteSource
+class CachingByteSource : public ByteSource
+{
+
+public:
+
+	/// The default block size in bytes
+	static constexpr std::size_t sDefaultBlockSize = 65536;
+	/// The default maximum number of cached blocks
+	static constexpr std::size_t sDefaultBlockCount = 64;
+
+	/// Creates a @c CachingByteSource
+	/// @param source The @c ByteSource to cache
+	/// @param blockSize The size of each block in bytes
+	/// @param blockCount The maximum number of blocks to cache
+	/// @throws @c std::invalid_argument if @c blockSize or @c blockCount is @c 0
+	CachingByteSource(ByteSource& source, std::size_t blockSize = sDefaultBlockSize, std::size_t blockCount = sDefaultBlockCount);
+
+	UInt64 Size() override;
+	std::size_t Read(UInt64 offset, void *buffer, std::size_t count) override;
+
+	/// Returns the number of block reads satisfied from the cache
+	uint64_t HitCount() const noexcept;
+
+	/// Returns the number of block reads from the cached @c ByteSource
+	uint64_t MissCount() const noexcept;
+
+	/// Discards all cached blocks
+	void Purge() noexcept;
+
+private:
+
+	/// A cached block
+	struct Block {
+		/// The index of the block
+		UInt64 mIndex;
+		/// The number of valid bytes in the block
+		std::size_t mLength;
+		/// The block's bytes
+		std::unique_ptr<uint8_t []> mData;
+	};
+
+	/// Returns the block at @c index, reading it if necessary
+	const Block& GetBlock(UInt64 index);
+
+	/// The cached @c ByteSource
+	ByteSource& mSource;
+	/// The size of each block in bytes
+	const std::size_t mBlockSize;
+	/// The maximum number of cached blocks
+	const std::size_t mBlockCount;
+	/// Cached blocks from most to least recently used
+	std::list<Block> mBlocks;
+	/// Cached blocks by index
+	std::unordered_map<UInt64, std::list<Block>::iterator> mBlocksByIndex;
+	/// The number of block reads satisfied from the cache
+	uint64_t mHitCount;
+	/// The number of block reads from @c mSource
+	uint64_t mMissCount;
+	/// The lock protecting the cache
+	mutable std::mutex mMutex;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
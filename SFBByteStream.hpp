@@ -7,9 +7,12 @@
 #pragma once
 
 #import <algorithm>
+#import <cstring>
 #import <stdexcept>
 #import <type_traits>
 
+#import <libkern/OSByteOrder.h>
+
 namespace SFB {
 
 /// A @c ByteStream provides heterogeneous typed access to an untyped buffer.
@@ -224,6 +227,56 @@ public:
 		return ReadSwapped(value) ? value : 0;
 	}
 
+	/// Reads an array of unsigned little endian integral types converted to host byte ordering and advances the read position
+	///
+	/// The bounds are checked once and no values are read unless all are available.
+	/// @tparam T The unsigned integral type to read
+	/// @param values The destination array
+	/// @param count The number of values to read
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type ReadLE(T * const _Nonnull values, size_t count) noexcept
+	{
+		if(!ReadValues(values, count))
+			return false;
+		if(OSHostByteOrder() != OSLittleEndian)
+			SwapBytes(values, count);
+		return true;
+	}
+
+	/// Reads an array of unsigned big endian integral types converted to host byte ordering and advances the read position
+	///
+	/// The bounds are checked once and no values are read unless all are available.
+	/// @tparam T The unsigned integral type to read
+	/// @param values The destination array
+	/// @param count The number of values to read
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type ReadBE(T * const _Nonnull values, size_t count) noexcept
+	{
+		if(!ReadValues(values, count))
+			return false;
+		if(OSHostByteOrder() != OSBigEndian)
+			SwapBytes(values, count);
+		return true;
+	}
+
+	/// Reads an array of unsigned integral types, swaps their byte ordering, and advances the read position
+	///
+	/// The bounds are checked once and no values are read unless all are available.
+	/// @tparam T The unsigned integral type to read
+	/// @param values The destination array
+	/// @param count The number of values to read
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type ReadSwapped(T * const _Nonnull values, size_t count) noexcept
+	{
+		if(!ReadValues(values, count))
+			return false;
+		SwapBytes(values, count);
+		return true;
+	}
+
 	/// Reads bytes and advances the read position
 	/// @param buf The destination buffer or @c nullptr to discard the bytes
 	/// @param count The number of bytes to read
@@ -237,6 +290,33 @@ public:
 		return bytesToCopy;
 	}
 
+	/// Returns a @c ByteStream for a range of the buffer without copying
+	///
+	/// The range is clamped to the buffer. The returned object's read position is @c 0 and this object's read position
+	/// is unchanged.
+	/// @param offset The offset of the first byte in the range
+	/// @param count The number of bytes in the range
+	/// @return A @c ByteStream sharing this object's buffer
+	ByteStream Subrange(size_t offset, size_t count) const noexcept
+	{
+		offset = std::min(offset, mBufferLength);
+		count = std::min(count, mBufferLength - offset);
+		return ByteStream(mBuffer, offset, count);
+	}
+
+	/// Returns a @c ByteStream for the next bytes without copying and advances the read position
+	/// @param span The destination @c ByteStream sharing this object's buffer
+	/// @param count The number of bytes to read
+	/// @return @c true on success, @c false if fewer than @c count bytes remain
+	bool ReadSpan(ByteStream& span, size_t count) noexcept
+	{
+		if(count > Remaining())
+			return false;
+		span = ByteStream(mBuffer, mReadPosition, count);
+		mReadPosition += count;
+		return true;
+	}
+
 	/// Advances the read position
 	/// @param count The number of bytes to skip
 	/// @return The number of bytes actually skipped
@@ -288,6 +368,39 @@ public:
 
 private:
 
+	/// Creates a @c ByteStream for @c len bytes of @c buf starting at @c offset
+	ByteStream(const void * _Nullable buf, size_t offset, size_t len) noexcept
+	: mBuffer(buf ? static_cast<const uint8_t *>(buf) + offset : nullptr), mBufferLength(len), mReadPosition(0)
+	{}
+
+	/// Reads an array of integral types and advances the read position
+	template <typename T>
+	bool ReadValues(T * const _Nonnull values, size_t count) noexcept
+	{
+		// Dividing avoids overflow in count * sizeof(T)
+		if(count > Remaining() / sizeof(T))
+			return false;
+		Read(values, count * sizeof(T));
+		return true;
+	}
+
+	/// Swaps the byte ordering of an array of unsigned integral types
+	///
+	/// The loop has no dependencies between iterations so the compiler vectorizes it.
+	template <typename T>
+	static void SwapBytes(T * const _Nonnull values, size_t count) noexcept
+	{
+		static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "Unsupported integral type size");
+		for(size_t i = 0; i < count; ++i) {
+			if constexpr(sizeof(T) == 2)
+				values[i] = static_cast<T>(OSSwapInt16(values[i]));
+			else if constexpr(sizeof(T) == 4)
+				values[i] = static_cast<T>(OSSwapInt32(values[i]));
+			else if constexpr(sizeof(T) == 8)
+				values[i] = static_cast<T>(OSSwapInt64(values[i]));
+		}
+	}
+
 	/// The wrapped buffer
 	const void * _Nullable mBuffer;
 	/// The number of bytes in @c mBuffer
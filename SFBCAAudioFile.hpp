@@ -264,6 +264,36 @@ public:
 		return fileDataFormat;
 	}
 
+	/// Returns the byte offset of the audio data in the file (@c kAudioFilePropertyDataOffset)
+	/// @throw @c std::system_error
+	SInt64 DataOffset() const
+	{
+		SInt64 dataOffset;
+		UInt32 size = sizeof(dataOffset);
+		GetProperty(kAudioFilePropertyDataOffset, size, &dataOffset);
+		return dataOffset;
+	}
+
+	/// Returns the number of bytes of audio data in the file (@c kAudioFilePropertyAudioDataByteCount)
+	/// @throw @c std::system_error
+	UInt64 AudioDataByteCount() const
+	{
+		UInt64 byteCount;
+		UInt32 size = sizeof(byteCount);
+		GetProperty(kAudioFilePropertyAudioDataByteCount, size, &byteCount);
+		return byteCount;
+	}
+
+	/// Returns the number of packets of audio data in the file (@c kAudioFilePropertyAudioDataPacketCount)
+	/// @throw @c std::system_error
+	UInt64 AudioDataPacketCount() const
+	{
+		UInt64 packetCount;
+		UInt32 size = sizeof(packetCount);
+		GetProperty(kAudioFilePropertyAudioDataPacketCount, size, &packetCount);
+		return packetCount;
+	}
+
 #pragma mark Global Properties
 
 	/// Gets the size of a global audio file property.
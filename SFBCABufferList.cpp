@@ -5,11 +5,159 @@
 //
 
 #import <algorithm>
+#import <cmath>
 #import <cstdlib>
+#import <cstring>
 #import <limits>
 #import <new>
+#import <stdexcept>
+
+#import <Accelerate/Accelerate.h>
 
 #import "SFBCABufferList.hpp"
+#import "SFBCABufferListPool.hpp"
+
+namespace {
+
+/// The number of samples examined at once by the signal analysis functions
+constexpr std::size_t kScanBlockSize = 1024;
+
+/// Returns @c true if @c (sample&mask)==value for all @c sampleCount samples in @c buffer
+///
+/// The samples are compared in blocks that compilers can vectorize, stopping after the first block containing a mismatch.
+template <typename T>
+bool AllSamplesMatch(const void * const _Nonnull buffer, std::size_t sampleCount, T mask, T value) noexcept
+{
+	auto samples = static_cast<const T *>(buffer);
+	while(sampleCount) {
+		auto count = std::min(sampleCount, kScanBlockSize);
+		T difference = 0;
+		for(std::size_t i = 0; i < count; ++i)
+			difference |= (samples[i] & mask) ^ value;
+		if(difference)
+			return false;
+		samples += count;
+		sampleCount -= count;
+	}
+	return true;
+}
+
+/// Returns @c true if all @c sampleCount packed 24-bit samples in @c buffer are equal to @c value
+/// @param value The three bytes of a silent sample in memory order
+bool AllPackedSamplesMatch(const void * const _Nonnull buffer, std::size_t sampleCount, const uint8_t value[3]) noexcept
+{
+	// Silence for signed samples is all zero bytes
+	if(!value[0] && !value[1] && !value[2])
+		return AllSamplesMatch<uint8_t>(buffer, 3 * sampleCount, 0xff, 0);
+
+	auto samples = static_cast<const uint8_t *>(buffer);
+	while(sampleCount) {
+		auto count = std::min(sampleCount, kScanBlockSize);
+		uint8_t difference = 0;
+		for(std::size_t i = 0; i < count; ++i)
+			difference |= (samples[3 * i] ^ value[0]) | (samples[3 * i + 1] ^ value[1]) | (samples[3 * i + 2] ^ value[2]);
+		if(difference)
+			return false;
+		samples += 3 * count;
+		sampleCount -= count;
+	}
+	return true;
+}
+
+/// Sample formats supported by the signal analysis functions
+enum class ScanFormat {
+	/// The format is not supported
+	unsupported,
+	/// Native-endian @c float
+	float32,
+	/// Native-endian @c double
+	float64,
+	/// Native-endian @c int16_t
+	int16,
+	/// Native-endian @c int32_t
+	int32,
+};
+
+/// Returns the @c ScanFormat corresponding to @c format
+ScanFormat ScanFormatForFormat(const SFB::CAStreamBasicDescription& format) noexcept
+{
+	if(!format.IsPCM() || !format.IsNativeEndian() || format.mBitsPerChannel != 8 * format.SampleWordSize())
+		return ScanFormat::unsupported;
+
+	if(format.IsFloat()) {
+		if(format.mBitsPerChannel == 32)
+			return ScanFormat::float32;
+		else if(format.mBitsPerChannel == 64)
+			return ScanFormat::float64;
+	}
+	else if(format.IsSignedInteger()) {
+		if(format.mBitsPerChannel == 16)
+			return ScanFormat::int16;
+		else if(format.mBitsPerChannel == 32)
+			return ScanFormat::int32;
+	}
+
+	return ScanFormat::unsupported;
+}
+
+/// Converts blocks of @c sampleCount samples spaced @c stride samples apart to normalized @c float and calls @c process
+/// for each block
+///
+/// @c process is called as @c process(const float *samples, vDSP_Stride stride, vDSP_Length count) and
+/// returns @c false to stop
+/// @return @c false if @c process stopped, @c true otherwise
+template <typename F>
+bool ForEachBlock(const void * const _Nonnull buffer, vDSP_Stride stride, vDSP_Length sampleCount, ScanFormat format, F&& process) noexcept
+{
+	// Float samples are processed in place
+	if(format == ScanFormat::float32) {
+		auto samples = static_cast<const float *>(buffer);
+		while(sampleCount) {
+			auto count = std::min(sampleCount, static_cast<vDSP_Length>(kScanBlockSize));
+			if(!process(samples, stride, count))
+				return false;
+			samples += count * stride;
+			sampleCount -= count;
+		}
+		return true;
+	}
+
+	float block[kScanBlockSize];
+	auto samples = static_cast<const uint8_t *>(buffer);
+
+	while(sampleCount) {
+		auto count = std::min(sampleCount, static_cast<vDSP_Length>(kScanBlockSize));
+		switch(format) {
+			case ScanFormat::float64:
+				vDSP_vdpsp(reinterpret_cast<const double *>(samples), stride, block, 1, count);
+				samples += count * stride * sizeof(double);
+				break;
+			case ScanFormat::int16: {
+				vDSP_vflt16(reinterpret_cast<const short *>(samples), stride, block, 1, count);
+				const float scale = 1.f / 32768.f;
+				vDSP_vsmul(block, 1, &scale, block, 1, count);
+				samples += count * stride * sizeof(int16_t);
+				break;
+			}
+			case ScanFormat::int32: {
+				vDSP_vflt32(reinterpret_cast<const int *>(samples), stride, block, 1, count);
+				const float scale = 1.f / 2147483648.f;
+				vDSP_vsmul(block, 1, &scale, block, 1, count);
+				samples += count * stride * sizeof(int32_t);
+				break;
+			}
+			default:
+				return false;
+		}
+		if(!process(block, 1, count))
+			return false;
+		sampleCount -= count;
+	}
+
+	return true;
+}
+
+}
 
 AudioBufferList * SFB::AllocateAudioBufferList(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept
 {
@@ -38,22 +186,59 @@ AudioBufferList * SFB::AllocateAudioBufferList(const CAStreamBasicDescription& f
 	return abl;
 }
 
+AudioBufferList * SFB::AllocateAlignedAudioBufferList(const CAStreamBasicDescription& format, UInt32 frameCapacity, std::size_t alignment) noexcept
+{
+	if(alignment == 0 || (alignment & (alignment - 1)) || alignment % sizeof(void *))
+		return nullptr;
+
+	if(format.mBytesPerFrame == 0 || frameCapacity > (std::numeric_limits<UInt32>::max() / format.mBytesPerFrame))
+		return nullptr;
+
+	auto bufferDataSize = format.FrameCountToByteSize(frameCapacity);
+	auto bufferCount = format.ChannelStreamCount();
+
+	// Round the header and each buffer up to a multiple of the alignment
+	auto bufferListSize = (offsetof(AudioBufferList, mBuffers) + (sizeof(AudioBuffer) * bufferCount) + alignment - 1) & ~(alignment - 1);
+	auto bufferStride = (static_cast<std::size_t>(bufferDataSize) + alignment - 1) & ~(alignment - 1);
+	auto allocationSize = bufferListSize + (bufferStride * bufferCount);
+
+	void *memory = nullptr;
+	if(posix_memalign(&memory, alignment, allocationSize))
+		return nullptr;
+
+	std::memset(memory, 0, allocationSize);
+
+	auto abl = static_cast<AudioBufferList *>(memory);
+	abl->mNumberBuffers = bufferCount;
+
+	for(UInt32 i = 0; i < bufferCount; ++i) {
+		abl->mBuffers[i].mNumberChannels = format.InterleavedChannelCount();
+		abl->mBuffers[i].mData = static_cast<uint8_t *>(memory) + bufferListSize + (bufferStride * i);
+		abl->mBuffers[i].mDataByteSize = bufferDataSize;
+	}
+
+	return abl;
+}
+
 SFB::CABufferList::CABufferList() noexcept
-: mBufferList(nullptr), mFrameCapacity(0), mFrameLength(0)
+: mBufferList(nullptr), mFrameCapacity(0), mFrameLength(0), mPool(nullptr), mHeadOffset(0), mTracksHeadOffset(false)
 {}
 
 SFB::CABufferList::~CABufferList()
 {
-	std::free(mBufferList);
+	Deallocate();
 }
 
 SFB::CABufferList::CABufferList(CABufferList&& rhs) noexcept
-: mBufferList(rhs.mBufferList), mFormat(rhs.mFormat), mFrameCapacity(rhs.mFrameCapacity), mFrameLength(rhs.mFrameLength)
+: mBufferList(rhs.mBufferList), mFormat(rhs.mFormat), mFrameCapacity(rhs.mFrameCapacity), mFrameLength(rhs.mFrameLength), mPool(rhs.mPool), mHeadOffset(rhs.mHeadOffset), mTracksHeadOffset(rhs.mTracksHeadOffset)
 {
 	rhs.mBufferList = nullptr;
 	rhs.mFormat.Reset();
 	rhs.mFrameCapacity = 0;
 	rhs.mFrameLength = 0;
+	rhs.mPool = nullptr;
+	rhs.mHeadOffset = 0;
+	rhs.mTracksHeadOffset = false;
 }
 
 SFB::CABufferList& SFB::CABufferList::operator=(CABufferList&& rhs) noexcept
@@ -65,11 +250,17 @@ SFB::CABufferList& SFB::CABufferList::operator=(CABufferList&& rhs) noexcept
 		mFormat = rhs.mFormat;
 		mFrameCapacity = rhs.mFrameCapacity;
 		mFrameLength = rhs.mFrameLength;
+		mPool = rhs.mPool;
+		mHeadOffset = rhs.mHeadOffset;
+		mTracksHeadOffset = rhs.mTracksHeadOffset;
 
 		rhs.mBufferList = nullptr;
 		rhs.mFormat.Reset();
 		rhs.mFrameCapacity = 0;
 		rhs.mFrameLength = 0;
+		rhs.mPool = nullptr;
+		rhs.mHeadOffset = 0;
+		rhs.mTracksHeadOffset = false;
 	}
 
 	return *this;
@@ -105,13 +296,20 @@ bool SFB::CABufferList::Allocate(const CAStreamBasicDescription& format, UInt32
 void SFB::CABufferList::Deallocate() noexcept
 {
 	if(mBufferList) {
-		std::free(mBufferList);
+		// Restore the mData pointers to the start of the buffers
+		SetHeadOffset(0);
+
+		if(mPool)
+			mPool->Recycle(mBufferList, mFormat, mFrameCapacity);
+		else
+			std::free(mBufferList);
 		mBufferList = nullptr;
 
 		mFormat.Reset();
 
 		mFrameCapacity = 0;
 		mFrameLength = 0;
+		mPool = nullptr;
 	}
 }
 
@@ -120,6 +318,12 @@ bool SFB::CABufferList::SetFrameLength(UInt32 frameLength) noexcept
 	if(!mBufferList || frameLength > mFrameCapacity)
 		return false;
 
+	// With no valid frames the entire capacity is available without moving anything
+	if(frameLength == 0)
+		SetHeadOffset(0);
+	else if(mHeadOffset + frameLength > mFrameCapacity)
+		Compact();
+
 	mFrameLength = frameLength;
 
 	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i)
@@ -140,14 +344,37 @@ bool SFB::CABufferList::InferFrameLengthFromABL()
 	}
 
 	auto frameLength = buffer0ByteSize / mFormat.mBytesPerFrame;
-	if(frameLength > mFrameCapacity)
-		throw std::logic_error("mBufferList->mBuffers[0].mBytesPerFrame / mFormat.mBytesPerFrame > mFrameCapacity");
+	if(frameLength > mFrameCapacity - mHeadOffset)
+		throw std::logic_error("mBufferList->mBuffers[0].mBytesPerFrame / mFormat.mBytesPerFrame > mFrameCapacity - mHeadOffset");
 
 	mFrameLength = frameLength;
 
 	return true;
 }
 
+void SFB::CABufferList::SetTracksHeadOffset(bool tracksHeadOffset) noexcept
+{
+	if(!tracksHeadOffset)
+		Compact();
+	mTracksHeadOffset = tracksHeadOffset;
+}
+
+void SFB::CABufferList::Compact() noexcept
+{
+	if(!mBufferList || mHeadOffset == 0)
+		return;
+
+	if(mFrameLength) {
+		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+			const auto src = static_cast<const uint8_t *>(mBufferList->mBuffers[i].mData);
+			auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) - (mHeadOffset * mFormat.mBytesPerFrame);
+			std::memmove(dst, src, mFrameLength * mFormat.mBytesPerFrame);
+		}
+	}
+
+	SetHeadOffset(0);
+}
+
 #pragma mark Buffer Utilities
 
 UInt32 SFB::CABufferList::InsertFromBuffer(const CABufferList& buffer, UInt32 readOffset, UInt32 frameLength, UInt32 writeOffset) noexcept
@@ -161,17 +388,9 @@ UInt32 SFB::CABufferList::InsertFromBuffer(const CABufferList& buffer, UInt32 re
 
 	auto framesToInsert = std::min(mFrameCapacity - mFrameLength, std::min(frameLength, buffer.mFrameLength - readOffset));
 
-	auto framesToMove = mFrameLength - writeOffset;
-	if(framesToMove) {
-		auto moveToOffset = writeOffset + framesToInsert;
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-			auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) + (moveToOffset * mFormat.mBytesPerFrame);
-			const auto src = static_cast<const uint8_t *>(mBufferList->mBuffers[i].mData) + (writeOffset * mFormat.mBytesPerFrame);
-			std::memmove(dst, src, framesToMove * mFormat.mBytesPerFrame);
-		}
-	}
-
 	if(framesToInsert) {
+		MakeSpace(writeOffset, framesToInsert);
+
 		for(UInt32 i = 0; i < buffer.mBufferList->mNumberBuffers; ++i) {
 			auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) + (writeOffset * mFormat.mBytesPerFrame);
 			const auto src = static_cast<const uint8_t *>(buffer.mBufferList->mBuffers[i].mData) + (readOffset * mFormat.mBytesPerFrame);
@@ -192,7 +411,19 @@ UInt32 SFB::CABufferList::TrimAtOffset(UInt32 offset, UInt32 frameLength) noexce
 	auto framesToTrim = std::min(frameLength, mFrameLength - offset);
 
 	auto framesToMove = mFrameLength - (offset + framesToTrim);
-	if(framesToMove) {
+
+	// Move the frames before offset forward if there are fewer of them
+	if(mTracksHeadOffset && offset < framesToMove) {
+		if(offset) {
+			for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+				auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) + (framesToTrim * mFormat.mBytesPerFrame);
+				const auto src = static_cast<const uint8_t *>(mBufferList->mBuffers[i].mData);
+				std::memmove(dst, src, offset * mFormat.mBytesPerFrame);
+			}
+		}
+		SetHeadOffset(mHeadOffset + framesToTrim);
+	}
+	else if(framesToMove) {
 		auto moveFromOffset = offset + framesToTrim;
 		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
 			auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) + (offset * mFormat.mBytesPerFrame);
@@ -217,17 +448,9 @@ UInt32 SFB::CABufferList::InsertSilence(UInt32 offset, UInt32 frameLength) noexc
 
 	auto framesToZero = std::min(mFrameCapacity - mFrameLength, frameLength);
 
-	auto framesToMove = mFrameLength - offset;
-	if(framesToMove) {
-		auto moveToOffset = offset + framesToZero;
-		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
-			auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) + (moveToOffset * mFormat.mBytesPerFrame);
-			const auto src = static_cast<const uint8_t *>(mBufferList->mBuffers[i].mData) + (offset * mFormat.mBytesPerFrame);
-			std::memmove(dst, src, framesToMove * mFormat.mBytesPerFrame);
-		}
-	}
-
 	if(framesToZero) {
+		MakeSpace(offset, framesToZero);
+
 		// For floating-point numbers this code is non-portable: the C standard doesn't require IEEE 754 compliance
 		// However, setting all bits to 0 using memset() on macOS results in a floating-point value of 0
 		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
@@ -241,6 +464,143 @@ UInt32 SFB::CABufferList::InsertSilence(UInt32 offset, UInt32 frameLength) noexc
 	return framesToZero;
 }
 
+#pragma mark Signal Analysis
+
+bool SFB::CABufferList::IsDigitalSilence() const noexcept
+{
+	if(!mBufferList || !mFormat.IsPCM())
+		return false;
+
+	if(mFrameLength == 0)
+		return true;
+
+	auto wordSize = mFormat.SampleWordSize();
+	auto sampleCount = static_cast<std::size_t>(mFrameLength) * (mFormat.mBytesPerFrame / wordSize);
+
+	// The value of silent samples after masking, which for floating point ignores the sign bit so -0 is silent
+	uint64_t mask = ~static_cast<uint64_t>(0);
+	uint64_t silence = 0;
+
+	if(mFormat.IsFloat()) {
+		if(wordSize != 4 && wordSize != 8)
+			return false;
+		mask = ~(static_cast<uint64_t>(1) << ((wordSize * 8) - 1));
+	}
+	else if(!mFormat.IsSignedInteger()) {
+		// Unsigned silence is the midpoint of the sample range
+		auto shift = (wordSize * 8) - mFormat.mBitsPerChannel;
+		silence = static_cast<uint64_t>(1) << ((mFormat.mBitsPerChannel - 1) + (mFormat.IsAlignedHigh() ? shift : 0));
+	}
+
+	if(wordSize == 3) {
+		uint8_t value[3];
+		if(mFormat.IsBigEndian()) {
+			value[0] = static_cast<uint8_t>(silence >> 16);
+			value[1] = static_cast<uint8_t>(silence >> 8);
+			value[2] = static_cast<uint8_t>(silence);
+		}
+		else {
+			value[0] = static_cast<uint8_t>(silence);
+			value[1] = static_cast<uint8_t>(silence >> 8);
+			value[2] = static_cast<uint8_t>(silence >> 16);
+		}
+		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+			if(!AllPackedSamplesMatch(mBufferList->mBuffers[i].mData, sampleCount, value))
+				return false;
+		}
+		return true;
+	}
+
+	// Compare samples in their stored byte order
+	auto swap = !mFormat.IsNativeEndian();
+
+	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+		auto data = mBufferList->mBuffers[i].mData;
+		bool match;
+		switch(wordSize) {
+			case 1:
+				match = AllSamplesMatch<uint8_t>(data, sampleCount, static_cast<uint8_t>(mask), static_cast<uint8_t>(silence));
+				break;
+			case 2: {
+				auto m = static_cast<uint16_t>(mask), v = static_cast<uint16_t>(silence);
+				match = AllSamplesMatch<uint16_t>(data, sampleCount, swap ? __builtin_bswap16(m) : m, swap ? __builtin_bswap16(v) : v);
+				break;
+			}
+			case 4: {
+				auto m = static_cast<uint32_t>(mask), v = static_cast<uint32_t>(silence);
+				match = AllSamplesMatch<uint32_t>(data, sampleCount, swap ? __builtin_bswap32(m) : m, swap ? __builtin_bswap32(v) : v);
+				break;
+			}
+			case 8:
+				match = AllSamplesMatch<uint64_t>(data, sampleCount, swap ? __builtin_bswap64(mask) : mask, swap ? __builtin_bswap64(silence) : silence);
+				break;
+			default:
+				return false;
+		}
+		if(!match)
+			return false;
+	}
+
+	return true;
+}
+
+bool SFB::CABufferList::IsSilent(float threshold) const noexcept
+{
+	auto format = ScanFormatForFormat(mFormat);
+	if(!mBufferList || format == ScanFormat::unsupported)
+		return false;
+
+	auto stride = mFormat.InterleavedChannelCount();
+	auto sampleCount = static_cast<vDSP_Length>(mFrameLength) * stride;
+
+	// For silence detection the channels don't need to be distinguished
+	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+		auto silent = ForEachBlock(mBufferList->mBuffers[i].mData, 1, sampleCount, format, [threshold](const float *samples, vDSP_Stride sampleStride, vDSP_Length count) {
+			float peak;
+			vDSP_maxmgv(samples, sampleStride, &peak, count);
+			return peak <= threshold;
+		});
+		if(!silent)
+			return false;
+	}
+
+	return true;
+}
+
+bool SFB::CABufferList::GetLevels(float * const peakLevels, float * const rmsLevels) const noexcept
+{
+	auto format = ScanFormatForFormat(mFormat);
+	if(!mBufferList || !peakLevels || !rmsLevels || format == ScanFormat::unsupported)
+		return false;
+
+	auto wordSize = mFormat.SampleWordSize();
+	auto isInterleaved = mFormat.IsInterleaved();
+	auto stride = mFormat.InterleavedChannelCount();
+
+	for(UInt32 channel = 0; channel < mFormat.mChannelsPerFrame; ++channel) {
+		const void *samples = isInterleaved ? static_cast<const uint8_t *>(mBufferList->mBuffers[0].mData) + channel * wordSize : mBufferList->mBuffers[channel].mData;
+
+		// The peak and sum of squares are computed for each block while it is in cache
+		float peak = 0;
+		double sumOfSquares = 0;
+		ForEachBlock(samples, stride, mFrameLength, format, [&](const float *blockSamples, vDSP_Stride sampleStride, vDSP_Length count) {
+			float blockPeak, blockSumOfSquares;
+			vDSP_maxmgv(blockSamples, sampleStride, &blockPeak, count);
+			vDSP_svesq(blockSamples, sampleStride, &blockSumOfSquares, count);
+			peak = std::max(peak, blockPeak);
+			sumOfSquares += blockSumOfSquares;
+			return true;
+		});
+
+		peakLevels[channel] = peak;
+		rmsLevels[channel] = mFrameLength ? static_cast<float>(std::sqrt(sumOfSquares / mFrameLength)) : 0;
+	}
+
+	return true;
+}
+
+#pragma mark AudioBufferList Access
+
 bool SFB::CABufferList::AdoptABL(AudioBufferList *bufferList, const AudioStreamBasicDescription& format, UInt32 frameCapacity, UInt32 frameLength) noexcept
 {
 	if(!bufferList || frameLength > frameCapacity)
@@ -251,6 +611,7 @@ bool SFB::CABufferList::AdoptABL(AudioBufferList *bufferList, const AudioStreamB
 	mBufferList = bufferList;
 	mFormat = format;
 	mFrameCapacity = frameCapacity;
+	mHeadOffset = 0;
 	SetFrameLength(frameLength);
 
 	return true;
@@ -258,12 +619,61 @@ bool SFB::CABufferList::AdoptABL(AudioBufferList *bufferList, const AudioStreamB
 
 AudioBufferList * SFB::CABufferList::RelinquishABL() noexcept
 {
+	Compact();
+
 	auto bufferList = mBufferList;
 
 	mBufferList = nullptr;
 	mFormat.Reset();
 	mFrameCapacity = 0;
 	mFrameLength = 0;
+	mPool = nullptr;
 
 	return bufferList;
 }
+
+#pragma mark Internals
+
+void SFB::CABufferList::SetHeadOffset(UInt32 headOffset) noexcept
+{
+	if(!mBufferList || headOffset == mHeadOffset)
+		return;
+
+	for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+		auto start = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) - (mHeadOffset * mFormat.mBytesPerFrame);
+		mBufferList->mBuffers[i].mData = start + (headOffset * mFormat.mBytesPerFrame);
+	}
+
+	mHeadOffset = headOffset;
+}
+
+void SFB::CABufferList::MakeSpace(UInt32 offset, UInt32 frameLength) noexcept
+{
+	auto framesToMove = mFrameLength - offset;
+
+	// Move the frames before offset backward if there are fewer of them and space is available
+	if(mTracksHeadOffset && offset < framesToMove && frameLength <= mHeadOffset) {
+		SetHeadOffset(mHeadOffset - frameLength);
+		if(offset) {
+			for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+				auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData);
+				const auto src = static_cast<const uint8_t *>(mBufferList->mBuffers[i].mData) + (frameLength * mFormat.mBytesPerFrame);
+				std::memmove(dst, src, offset * mFormat.mBytesPerFrame);
+			}
+		}
+		return;
+	}
+
+	// Compact only when the space after the last frame is insufficient
+	if(mHeadOffset + mFrameLength + frameLength > mFrameCapacity)
+		Compact();
+
+	if(framesToMove) {
+		auto moveToOffset = offset + frameLength;
+		for(UInt32 i = 0; i < mBufferList->mNumberBuffers; ++i) {
+			auto dst = static_cast<uint8_t *>(mBufferList->mBuffers[i].mData) + (moveToOffset * mFormat.mBytesPerFrame);
+			const auto src = static_cast<const uint8_t *>(mBufferList->mBuffers[i].mData) + (offset * mFormat.mBytesPerFrame);
+			std::memmove(dst, src, framesToMove * mFormat.mBytesPerFrame);
+		}
+	}
+}
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#import <cstddef>
+
 #import <CoreAudioTypes/CoreAudioTypes.h>
 
 #import "SFBCAStreamBasicDescription.hpp"
@@ -19,7 +21,23 @@ namespace SFB {
 /// @return A newly-allocated @c AudioBufferList or @c nullptr
 AudioBufferList * _Nullable AllocateAudioBufferList(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept;
 
+/// Allocates and returns a new @c AudioBufferList with aligned buffers in a single allocation
+/// @note The allocation is performed using @c posix_memalign and should be deallocated using @c std::free
+/// @param format The format of the audio the @c AudioBufferList will hold
+/// @param frameCapacity The desired buffer capacity in audio frames
+/// @param alignment The alignment of each buffer's data, which must be a power of two and a multiple of @c sizeof(void*)
+/// @return A newly-allocated @c AudioBufferList or @c nullptr
+AudioBufferList * _Nullable AllocateAlignedAudioBufferList(const CAStreamBasicDescription& format, UInt32 frameCapacity, std::size_t alignment) noexcept;
+
+class CABufferListPool;
+
 /// A class wrapping a Core Audio @c AudioBufferList with a specific format, frame capacity, and frame length
+///
+/// By default frames are always stored at the start of the buffers and removing or inserting frames moves the frames
+/// following them. When head offset tracking is enabled the frames may instead begin at an offset from the start of
+/// the buffers and the @c mData pointers of the internal @c AudioBufferList are adjusted to point to the first frame.
+/// Trimming frames from or inserting frames near the start then moves only the frames preceding them. The frames are
+/// moved back to the start of the buffers when space is needed at the end.
 class CABufferList
 {
 	
@@ -122,6 +140,27 @@ public:
 		return mFormat;
 	}
 
+
+	/// Returns @c true if this @c CABufferList tracks a head offset instead of moving frames to the start of the buffers
+	inline bool TracksHeadOffset() const noexcept
+	{
+		return mTracksHeadOffset;
+	}
+
+	/// Sets whether this @c CABufferList tracks a head offset instead of moving frames to the start of the buffers
+	/// @note Disabling head offset tracking moves the frames to the start of the buffers
+	/// @param tracksHeadOffset Whether to track a head offset
+	void SetTracksHeadOffset(bool tracksHeadOffset) noexcept;
+
+	/// Returns the offset in audio frames of the first valid frame from the start of the buffers
+	inline UInt32 HeadOffset() const noexcept
+	{
+		return mHeadOffset;
+	}
+
+	/// Moves the valid audio frames to the start of the buffers
+	void Compact() noexcept;
+
 #pragma mark Buffer utilities
 
 	/// Prepends the contents of @c buffer
@@ -253,9 +292,35 @@ public:
 	/// @return The number of frames of silence inserted
 	UInt32 InsertSilence(UInt32 offset, UInt32 frameLength) noexcept;
 
+#pragma mark Signal analysis
+
+	/// Returns @c true if this @c CABufferList contains only digital silence
+	///
+	/// The samples are compared in blocks so the comparison may be vectorized, stopping at the first block containing a
+	/// non-silent sample.
+	/// @note Returns @c true if the buffer is empty and @c false for non-PCM formats
+	bool IsDigitalSilence() const noexcept;
+
+	/// Returns @c true if the magnitude of every sample is at most @c threshold
+	///
+	/// The scan stops at the first block containing a sample exceeding @c threshold.
+	/// @note Only native-endian @c float, @c double, @c int16_t, and @c int32_t formats are supported
+	/// @param threshold The maximum magnitude of a silent sample as a linear amplitude, where full scale is @c 1
+	/// @return @c true if the audio is silent, @c false if it is not or the format is unsupported
+	bool IsSilent(float threshold) const noexcept;
+
+	/// Computes the peak and RMS level of each channel in a single pass
+	/// @note Only native-endian @c float, @c double, @c int16_t, and @c int32_t formats are supported
+	/// @note The levels are linear amplitudes, where full scale is @c 1
+	/// @param peakLevels An array of @c Format().mChannelsPerFrame values to receive the peak level of each channel
+	/// @param rmsLevels An array of @c Format().mChannelsPerFrame values to receive the RMS level of each channel
+	/// @return @c true on success, @c false if the format is unsupported
+	bool GetLevels(float * const _Nonnull peakLevels, float * const _Nonnull rmsLevels) const noexcept;
+
 #pragma mark AudioBufferList access
 
 	/// Adopts an existing @c AudioBufferList
+	/// @note If this @c CABufferList was acquired from a @c CABufferListPool its current @c AudioBufferList is returned to the pool
 	/// @note The @c CABufferList assumes responsiblity for deallocating @c bufferList using @c std::free
 	/// @param bufferList The @c AudioBufferList to adopt
 	/// @param format The format of @c bufferList
@@ -265,6 +330,8 @@ public:
 	bool AdoptABL(AudioBufferList * _Nonnull bufferList, const AudioStreamBasicDescription& format, UInt32 frameCapacity, UInt32 frameLength) noexcept;
 
 	/// Relinquishes ownership of the object's internal @c AudioBufferList and returns it
+	/// @note The valid frames are moved to the start of the buffers
+	/// @note An @c AudioBufferList acquired from a @c CABufferListPool is not returned to the pool
 	/// @note The caller assumes responsiblity for deallocating the returned @c AudioBufferList using @c std::free
 	AudioBufferList * _Nullable RelinquishABL() noexcept;
 
@@ -318,8 +385,23 @@ public:
 		return mBufferList;
 	}
 
+	/// Returns @c true if this object's internal @c AudioBufferList will be returned to a @c CABufferListPool
+	inline bool IsPooled() const noexcept
+	{
+		return mPool != nullptr;
+	}
+
 private:
 
+	/// Sets the head offset and adjusts the @c mData pointers without moving any frames
+	void SetHeadOffset(UInt32 headOffset) noexcept;
+
+	/// Makes space for @c frameLength frames at @c offset by moving the frames before or after @c offset
+	/// @note The frame length is not modified
+	void MakeSpace(UInt32 offset, UInt32 frameLength) noexcept;
+
+	friend class CABufferListPool;
+
 	/// The underlying @c AudioChannelLayout struct
 	AudioBufferList * _Nullable mBufferList;
 	/// The format of @c mBufferList
@@ -328,6 +410,12 @@ private:
 	UInt32 mFrameCapacity;
 	/// The number of valid frames in @c mBufferList
 	UInt32 mFrameLength;
+	/// The pool to which @c mBufferList is returned on deallocation
+	CABufferListPool * _Nullable mPool;
+	/// The offset in frames of the first valid frame in @c mBufferList
+	UInt32 mHeadOffset;
+	/// Whether a head offset is tracked
+	bool mTracksHeadOffset;
 
 };
 
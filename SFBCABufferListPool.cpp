@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstdlib>
+#import <exception>
+#import <mutex>
+#import <utility>
+
+#import "SFBCABufferListPool.hpp"
+
+#pragma mark Creation and Destruction
+
+SFB::CABufferListPool::CABufferListPool(std::size_t maximumCachedBuffers) noexcept
+: mParent(nullptr), mMaximumCachedBuffers(maximumCachedBuffers)
+{}
+
+SFB::CABufferListPool::CABufferListPool(CABufferListPool& parent, std::size_t maximumCachedBuffers) noexcept
+: mParent(&parent), mMaximumCachedBuffers(maximumCachedBuffers), mOwningThread(std::this_thread::get_id())
+{}
+
+SFB::CABufferListPool::~CABufferListPool()
+{
+	Purge();
+}
+
+#pragma mark Buffer Management
+
+SFB::CABufferList SFB::CABufferListPool::Acquire(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept
+{
+	CABufferList buffer;
+
+	auto bufferList = Take(format, frameCapacity);
+	if(!bufferList)
+		bufferList = AllocateAlignedAudioBufferList(format, frameCapacity, sAlignment);
+	if(!bufferList)
+		return buffer;
+
+	// Match the state of a newly-allocated buffer
+	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+		bufferList->mBuffers[i].mDataByteSize = format.FrameCountToByteSize(frameCapacity);
+
+	buffer.mBufferList = bufferList;
+	buffer.mFormat = format;
+	buffer.mFrameCapacity = frameCapacity;
+	buffer.mFrameLength = 0;
+	buffer.mPool = this;
+
+	return buffer;
+}
+
+void SFB::CABufferListPool::Purge() noexcept
+{
+	std::unique_lock<UnfairLock> lock(mLock, std::defer_lock);
+	if(!mParent)
+		lock.lock();
+
+	for(auto& bucket : mBuckets) {
+		for(auto bufferList : bucket.mBufferLists) {
+			if(mParent)
+				mParent->Recycle(bufferList, bucket.mFormat, bucket.mFrameCapacity);
+			else
+				std::free(bufferList);
+		}
+	}
+
+	mBuckets.clear();
+}
+
+std::size_t SFB::CABufferListPool::CachedBufferCount() const noexcept
+{
+	std::unique_lock<UnfairLock> lock(mLock, std::defer_lock);
+	if(!mParent)
+		lock.lock();
+
+	std::size_t count = 0;
+	for(const auto& bucket : mBuckets)
+		count += bucket.mBufferLists.size();
+	return count;
+}
+
+#pragma mark Internals
+
+AudioBufferList * SFB::CABufferListPool::Take(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept
+{
+	{
+		std::unique_lock<UnfairLock> lock(mLock, std::defer_lock);
+		if(!mParent)
+			lock.lock();
+
+		auto bucket = FindBucket(format, frameCapacity);
+		if(bucket && !bucket->mBufferLists.empty()) {
+			auto bufferList = bucket->mBufferLists.back();
+			bucket->mBufferLists.pop_back();
+			return bufferList;
+		}
+	}
+
+	if(mParent)
+		return mParent->Take(format, frameCapacity);
+
+	return nullptr;
+}
+
+void SFB::CABufferListPool::Recycle(AudioBufferList *bufferList, const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept
+{
+	// A cache is unsynchronized so buffers destroyed on another thread are returned to the parent
+	if(mParent && mOwningThread != std::this_thread::get_id()) {
+		mParent->Recycle(bufferList, format, frameCapacity);
+		return;
+	}
+
+	{
+		std::unique_lock<UnfairLock> lock(mLock, std::defer_lock);
+		if(!mParent)
+			lock.lock();
+
+		auto bucket = FindBucket(format, frameCapacity);
+		if(!bucket && mMaximumCachedBuffers > 0) {
+			// Allocation only occurs the first time a format and frame capacity are recycled
+			try {
+				Bucket newBucket{ format, frameCapacity, {} };
+				newBucket.mBufferLists.reserve(mMaximumCachedBuffers);
+				mBuckets.push_back(std::move(newBucket));
+				bucket = &mBuckets.back();
+			}
+			catch(const std::exception&) {}
+		}
+
+		// Never grow a bucket beyond its reserved capacity
+		if(bucket && bucket->mBufferLists.size() < std::min(mMaximumCachedBuffers, bucket->mBufferLists.capacity())) {
+			bucket->mBufferLists.push_back(bufferList);
+			return;
+		}
+	}
+
+	if(mParent)
+		mParent->Recycle(bufferList, format, frameCapacity);
+	else
+		std::free(bufferList);
+}
+
+SFB::CABufferListPool::Bucket * SFB::CABufferListPool::FindBucket(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept
+{
+	for(auto& bucket : mBuckets) {
+		if(bucket.mFrameCapacity == frameCapacity && bucket.mFormat == format)
+			return &bucket;
+	}
+	return nullptr;
+}
@@ -0,0 +1,127 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <cstddef>
+#import <thread>
+#import <vector>
+
+#import "SFBCABufferList.hpp"
+#import "SFBUnfairLock.hpp"
+
+namespace SFB {
+
+/// A pool of reusable @c AudioBufferList allocations keyed by format and frame capacity
+///
+/// A @c CABufferList acquired from a pool returns its @c AudioBufferList to the pool when it is deallocated or destroyed
+/// instead of freeing it. Once the pool contains buffers for the formats and capacities in use, acquiring and
+/// recycling buffers performs no heap allocation.
+///
+/// The data of each buffer in a pooled @c AudioBufferList is aligned to @c sAlignment bytes.
+///
+/// A pool created without a parent is thread safe. A pool created with a parent is a cache for use by the thread that
+/// created it: it is not thread safe, but requires no locking. Buffers not available in the cache are acquired from the
+/// parent and buffers exceeding the cache's limit are returned to the parent, as are buffers destroyed on a thread other
+/// than the cache's thread.
+///
+/// @code
+/// SFB::CABufferListPool pool;
+/// // On a worker thread
+/// SFB::CABufferListPool cache(pool);
+/// auto buffer = cache.Acquire(format, 4096);
+/// @endcode
+/// @note A pool must outlive every @c CABufferList acquired from it
+class CABufferListPool
+{
+
+public:
+
+	/// The alignment of pooled buffer data
+	static constexpr std::size_t sAlignment = 64;
+
+#pragma mark Creation and Destruction
+
+	/// Creates a new thread safe @c CABufferListPool
+	/// @param maximumCachedBuffers The maximum number of unused buffers kept for each format and frame capacity
+	explicit CABufferListPool(std::size_t maximumCachedBuffers = 64) noexcept;
+
+	/// Creates a new @c CABufferListPool caching buffers from @c parent for use by the calling thread
+	/// @param parent The pool to use when this pool is empty or full
+	/// @param maximumCachedBuffers The maximum number of unused buffers kept for each format and frame capacity
+	explicit CABufferListPool(CABufferListPool& parent, std::size_t maximumCachedBuffers = 8) noexcept;
+
+	// This class is non-copyable
+	CABufferListPool(const CABufferListPool& rhs) = delete;
+
+	// This class is non-assignable
+	CABufferListPool& operator=(const CABufferListPool& rhs) = delete;
+
+	/// Destroys the @c CABufferListPool and releases all unused buffers
+	~CABufferListPool();
+
+	// This class is non-movable
+	CABufferListPool(CABufferListPool&& rhs) = delete;
+
+	// This class is non-move assignable
+	CABufferListPool& operator=(CABufferListPool&& rhs) = delete;
+
+#pragma mark Buffer management
+
+	/// Returns an empty @c CABufferList, reusing a previously recycled @c AudioBufferList if one is available
+	/// @param format The format of the audio the @c CABufferList will hold
+	/// @param frameCapacity The desired buffer capacity in audio frames
+	/// @note A pool with a parent must only be used by the thread that created it, although a @c CABufferList
+	/// acquired from it may be destroyed on any thread
+	/// @return A @c CABufferList with a frame length of @c 0, or an empty @c CABufferList on error
+	CABufferList Acquire(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept;
+
+	/// Releases all unused buffers
+	///
+	/// A pool with a parent returns its unused buffers to the parent.
+	void Purge() noexcept;
+
+	/// Returns the number of unused buffers in this @c CABufferListPool
+	std::size_t CachedBufferCount() const noexcept;
+
+private:
+
+	friend class CABufferList;
+
+	/// Removes and returns an unused @c AudioBufferList, or returns @c nullptr if none are available
+	AudioBufferList * _Nullable Take(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept;
+
+	/// Returns @c bufferList to the pool
+	void Recycle(AudioBufferList * _Nonnull bufferList, const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept;
+
+	/// Unused buffers with the same format and frame capacity
+	struct Bucket {
+		/// The format of the buffers
+		CAStreamBasicDescription mFormat;
+		/// The frame capacity of the buffers
+		UInt32 mFrameCapacity;
+		/// The unused buffers
+		/// @note Capacity for the maximum number of buffers is reserved when the bucket is created
+		std::vector<AudioBufferList *> mBufferLists;
+	};
+
+	/// Returns the bucket for @c format and @c frameCapacity, or @c nullptr if none exists
+	Bucket * _Nullable FindBucket(const CAStreamBasicDescription& format, UInt32 frameCapacity) noexcept;
+
+	/// The pool used when this pool is empty or full
+	CABufferListPool * _Nullable mParent;
+	/// The maximum number of unused buffers per bucket
+	std::size_t mMaximumCachedBuffers;
+	/// The buckets
+	std::vector<Bucket> mBuckets;
+	/// The lock protecting @c mBuckets when @c mParent is @c nullptr
+	mutable UnfairLock mLock;
+	/// The thread using this pool when @c mParent is not @c nullptr
+	std::thread::id mOwningThread;
+
+};
+
+} // namespace SFB
@@ -7,6 +7,7 @@
 #import <cstdlib>
 #import <cstring>
 #import <new>
+#import <utility>
 
 #import <AudioToolbox/AudioFormat.h>
 
@@ -20,43 +21,6 @@ constexpr size_t ChannelLayoutSize(UInt32 numberChannelDescriptions) noexcept
 	return offsetof(AudioChannelLayout, mChannelDescriptions) + (numberChannelDescriptions * sizeof(AudioChannelDescription));
 }
 
-/// Allocates an @c AudioChannelLayout
-/// @param numberChannelDescriptions The number of channel descriptions that will be stored in the channel layout
-/// @return An @c AudioChannelLayout
-/// @throws @c std::bad_alloc
-AudioChannelLayout * CreateChannelLayout(UInt32 numberChannelDescriptions)
-{
-	size_t layoutSize = ChannelLayoutSize(numberChannelDescriptions);
-	AudioChannelLayout *channelLayout = static_cast<AudioChannelLayout *>(std::malloc(layoutSize));
-	if(!channelLayout)
-		throw std::bad_alloc();
-
-	std::memset(channelLayout, 0, layoutSize);
-
-	channelLayout->mNumberChannelDescriptions = numberChannelDescriptions;
-
-	return channelLayout;
-}
-
-/// Creates and returns a copy of @c rhs
-/// @param rhs The @c AudioChannelLayout to copy
-/// @return An @c AudioChannelLayout
-/// @throws @c std::bad_alloc
-AudioChannelLayout * CopyChannelLayout(const AudioChannelLayout * _Nullable rhs)
-{
-	if(!rhs)
-		return nullptr;
-
-	size_t layoutSize = ChannelLayoutSize(rhs->mNumberChannelDescriptions);
-	AudioChannelLayout *channelLayout = static_cast<AudioChannelLayout *>(std::malloc(layoutSize));
-	if(!channelLayout)
-		throw std::bad_alloc();
-
-	std::memcpy(channelLayout, rhs, layoutSize);
-
-	return channelLayout;
-}
-
 /// Returns the string representation of an @c AudioChannelLayoutTag
 constexpr const char * GetChannelLayoutTagName(AudioChannelLayoutTag layoutTag) noexcept
 {
@@ -281,7 +245,7 @@ const SFB::CAChannelLayout SFB::CAChannelLayout::Stereo 	= CAChannelLayout(kAudi
 SFB::CAChannelLayout SFB::CAChannelLayout::ChannelLayoutWithBitmap(UInt32 channelBitmap)
 {
 	CAChannelLayout channelLayout{};
-	channelLayout.mChannelLayout = CreateChannelLayout(0);
+	channelLayout.AllocateLayout(0);
 	channelLayout.mChannelLayout->mChannelLayoutTag = kAudioChannelLayoutTag_UseChannelBitmap;
 	channelLayout.mChannelLayout->mChannelBitmap = channelBitmap;
 	return channelLayout;
@@ -294,36 +258,60 @@ SFB::CAChannelLayout::CAChannelLayout(const CAChannelLayout& rhs)
 }
 
 SFB::CAChannelLayout& SFB::CAChannelLayout::operator=(const CAChannelLayout& rhs)
+{
+	if(this != &rhs)
+		CopyLayout(rhs.mChannelLayout);
+	return *this;
+}
+
+SFB::CAChannelLayout::CAChannelLayout(CAChannelLayout&& rhs) noexcept
+: CAChannelLayout{}
+{
+	*this = std::move(rhs);
+}
+
+SFB::CAChannelLayout& SFB::CAChannelLayout::operator=(CAChannelLayout&& rhs) noexcept
 {
 	if(this != &rhs) {
-		std::free(mChannelLayout);
-		mChannelLayout = CopyChannelLayout(rhs.mChannelLayout);
+		FreeLayout();
+		// An inline layout can't be transferred and is copied instead
+		if(rhs.UsesInlineStorage()) {
+			std::memcpy(mInlineStorage, rhs.mInlineStorage, rhs.Size());
+			mChannelLayout = reinterpret_cast<AudioChannelLayout *>(mInlineStorage);
+		}
+		else
+			mChannelLayout = rhs.mChannelLayout;
+		rhs.mChannelLayout = nullptr;
 	}
 	return *this;
 }
 
 SFB::CAChannelLayout::CAChannelLayout(AudioChannelLayoutTag layoutTag)
-: mChannelLayout(CreateChannelLayout(0))
+: CAChannelLayout{}
 {
+	AllocateLayout(0);
 	mChannelLayout->mChannelLayoutTag = layoutTag;
 }
 
 SFB::CAChannelLayout::CAChannelLayout(std::vector<AudioChannelLabel> channelLabels)
-: mChannelLayout(CreateChannelLayout(static_cast<UInt32>(channelLabels.size())))
+: CAChannelLayout{}
 {
+	AllocateLayout(static_cast<UInt32>(channelLabels.size()));
 	mChannelLayout->mChannelLayoutTag = kAudioChannelLayoutTag_UseChannelDescriptions;
 	for(std::vector<AudioChannelLabel>::size_type i = 0; i != channelLabels.size(); ++i)
 		mChannelLayout->mChannelDescriptions[i].mChannelLabel = channelLabels[i];
 }
 
 SFB::CAChannelLayout::CAChannelLayout(const AudioChannelLayout *rhs)
-: mChannelLayout(CopyChannelLayout(rhs))
-{}
+: CAChannelLayout{}
+{
+	CopyLayout(rhs);
+}
 
 SFB::CAChannelLayout& SFB::CAChannelLayout::operator=(const AudioChannelLayout *rhs)
 {
-	std::free(mChannelLayout);
-	mChannelLayout = CopyChannelLayout(rhs);
+	if(rhs != mChannelLayout)
+		CopyLayout(rhs);
 	return *this;
 }
 
@@ -395,9 +383,44 @@ bool SFB::CAChannelLayout::MapToLayout(const CAChannelLayout& outputLayout, std:
 	return true;
 }
 
+bool SFB::CAChannelLayout::MatrixMixMapToLayout(const CAChannelLayout& outputLayout, std::vector<Float32>& mixMap) const
+{
+	// No valid mix map exists for empty/unknown layouts
+	if(!mChannelLayout || !outputLayout.mChannelLayout)
+		return false;
+
+	const AudioChannelLayout *layouts [] = {
+		mChannelLayout,
+		outputLayout.mChannelLayout
+	};
+
+	auto inputChannelCount = ChannelCount();
+	auto outputChannelCount = outputLayout.ChannelCount();
+	if(inputChannelCount == 0 || outputChannelCount == 0)
+		return false;
+
+	std::vector<Float32> rawMixMap(inputChannelCount * outputChannelCount);
+	UInt32 propertySize = static_cast<UInt32>(rawMixMap.size() * sizeof(Float32));
+	OSStatus result = AudioFormatGetProperty(kAudioFormatProperty_MatrixMixMap, sizeof(layouts), static_cast<void *>(layouts), &propertySize, rawMixMap.data());
+
+	if(noErr != result)
+		return false;
+
+	mixMap = std::move(rawMixMap);
+
+	return true;
+}
+
 AudioChannelLayout * SFB::CAChannelLayout::RelinquishACL() noexcept
 {
 	auto channelLayout = mChannelLayout;
+	if(channelLayout && UsesInlineStorage()) {
+		auto layoutSize = Size();
+		channelLayout = static_cast<AudioChannelLayout *>(std::malloc(layoutSize));
+		if(!channelLayout)
+			return nullptr;
+		std::memcpy(channelLayout, mChannelLayout, layoutSize);
+	}
 	mChannelLayout = nullptr;
 	return channelLayout;
 }
@@ -438,3 +461,58 @@ SFB::CFString SFB::CAChannelLayout::Description(const char * const prefix) const
 
 	return CFString(static_cast<CFStringRef>(result.Relinquish()));
 }
+
+void SFB::CAChannelLayout::AllocateLayout(UInt32 numberChannelDescriptions)
+{
+	auto layoutSize = ChannelLayoutSize(numberChannelDescriptions);
+
+	AudioChannelLayout *channelLayout;
+	if(layoutSize <= sInlineStorageSize) {
+		FreeLayout();
+		channelLayout = reinterpret_cast<AudioChannelLayout *>(mInlineStorage);
+	}
+	else {
+		channelLayout = static_cast<AudioChannelLayout *>(std::malloc(layoutSize));
+		if(!channelLayout)
+			throw std::bad_alloc();
+		FreeLayout();
+	}
+
+	std::memset(channelLayout, 0, layoutSize);
+	channelLayout->mNumberChannelDescriptions = numberChannelDescriptions;
+
+	mChannelLayout = channelLayout;
+}
+
+void SFB::CAChannelLayout::CopyLayout(const AudioChannelLayout *rhs)
+{
+	if(!rhs) {
+		FreeLayout();
+		return;
+	}
+
+	auto layoutSize = ChannelLayoutSize(rhs->mNumberChannelDescriptions);
+
+	AudioChannelLayout *channelLayout;
+	if(layoutSize <= sInlineStorageSize) {
+		FreeLayout();
+		channelLayout = reinterpret_cast<AudioChannelLayout *>(mInlineStorage);
+	}
+	else {
+		channelLayout = static_cast<AudioChannelLayout *>(std::malloc(layoutSize));
+		if(!channelLayout)
+			throw std::bad_alloc();
+		FreeLayout();
+	}
+
+	std::memcpy(channelLayout, rhs, layoutSize);
+
+	mChannelLayout = channelLayout;
+}
+
+void SFB::CAChannelLayout::FreeLayout() noexcept
+{
+	if(!UsesInlineStorage())
+		std::free(mChannelLayout);
+	mChannelLayout = nullptr;
+}
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#import <cstddef>
+#import <cstdlib>
 #import <vector>
 
 #import <CoreAudioTypes/CoreAudioTypes.h>
@@ -20,11 +22,20 @@ namespace SFB {
 size_t AudioChannelLayoutSize(const AudioChannelLayout * _Nullable channelLayout) noexcept;
 
 /// A class wrapping a Core Audio @c AudioChannelLayout
+///
+/// Channel layouts with up to @c sInlineChannelDescriptionCount channel descriptions are stored inline and creating,
+/// copying, or moving them doesn't allocate memory. Larger layouts are allocated using @c std::malloc.
 class CAChannelLayout
 {
 
 public:
 
+	/// The maximum number of channel descriptions in a layout stored inline
+	static constexpr UInt32 sInlineChannelDescriptionCount = 16;
+
+	/// The size in bytes of the inline storage, the size of the largest @c AudioChannelLayout stored inline
+	static constexpr size_t sInlineStorageSize = offsetof(AudioChannelLayout, mChannelDescriptions) + (sInlineChannelDescriptionCount * sizeof(AudioChannelDescription));
+
 	/// Mono layout
 	static const CAChannelLayout Mono;
 
@@ -54,25 +65,15 @@ public:
 	/// Destroys the @c CAChannelLayout and release all associated resources.
 	inline ~CAChannelLayout()
 	{
-		std::free(mChannelLayout);
+		if(!UsesInlineStorage())
+			std::free(mChannelLayout);
 	}
 
 	/// Move constructor
-	CAChannelLayout(CAChannelLayout&& rhs) noexcept
-	: mChannelLayout(rhs.mChannelLayout)
-	{
-		rhs.mChannelLayout = nullptr;
-	}
+	CAChannelLayout(CAChannelLayout&& rhs) noexcept;
 
 	/// Move assignment operator
-	CAChannelLayout& operator=(CAChannelLayout&& rhs) noexcept
-	{
-		if(this != &rhs) {
-			mChannelLayout = rhs.mChannelLayout;
-			rhs.mChannelLayout = nullptr;
-		}
-		return *this;
-	}
+	CAChannelLayout& operator=(CAChannelLayout&& rhs) noexcept;
 
 
 	/// Creates a @c CAChannelLayout
@@ -113,6 +114,13 @@ public:
 	/// @return @c true on success, @c false otherwise
 	bool MapToLayout(const CAChannelLayout& outputLayout, std::vector<SInt32>& channelMap) const;
 
+	/// Creates a matrix of mixing coefficients for converting audio from this channel layout
+	/// @note The coefficient for input channel @c i and output channel @c o is at index @c i*outputLayout.ChannelCount()+o
+	/// @param outputLayout The output channel layout
+	/// @param mixMap A @c std::vector to receive the mixing coefficients on success
+	/// @return @c true on success, @c false otherwise
+	bool MatrixMixMapToLayout(const CAChannelLayout& outputLayout, std::vector<Float32>& mixMap) const;
+
 #pragma mark AudioChannelLayout access
 
 	/// Returns the size in bytes of this object's internal @c AudioChannelLayout
@@ -121,8 +129,16 @@ public:
 		return AudioChannelLayoutSize(mChannelLayout);
 	}
 
+	/// Returns @c true if this object's internal @c AudioChannelLayout is stored inline
+	inline bool UsesInlineStorage() const noexcept
+	{
+		return mChannelLayout == reinterpret_cast<const AudioChannelLayout *>(mInlineStorage);
+	}
+
 	/// Relinquishes ownership of the object's internal @c AudioChannelLayout and returns it
 	/// @note The caller assumes responsiblity for deallocating the returned @c AudioChannelLayout using @c std::free
+	/// @note A layout stored inline is copied to memory allocated with @c std::malloc; if the allocation fails the layout
+	/// is retained and @c nullptr is returned
 	AudioChannelLayout * _Nullable RelinquishACL() noexcept;
 
 	/// Retrieves a const pointer to this object's internal @c AudioChannelLayout
@@ -163,8 +179,21 @@ public:
 
 private:
 
-	/// The underlying @c AudioChannelLayout struct
+	/// Replaces the internal @c AudioChannelLayout with a zeroed layout containing @c numberChannelDescriptions channel descriptions
+	/// @throws @c std::bad_alloc
+	void AllocateLayout(UInt32 numberChannelDescriptions);
+
+	/// Replaces the internal @c AudioChannelLayout with a copy of @c rhs
+	/// @throws @c std::bad_alloc
+	void CopyLayout(const AudioChannelLayout * _Nullable rhs);
+
+	/// Frees the internal @c AudioChannelLayout
+	void FreeLayout() noexcept;
+
+	/// The underlying @c AudioChannelLayout struct, which may point to @c mInlineStorage
 	AudioChannelLayout * _Nullable mChannelLayout;
+	/// Storage for small channel layouts
+	alignas(AudioChannelLayout) uint8_t mInlineStorage [sInlineStorageSize];
 
 };
 
@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <cstring>
+#import <mutex>
+#import <stdexcept>
+
+#import "SFBCAChannelMap.hpp"
+
+namespace {
+
+/// Returns @c true if @c lhs and @c rhs contain identical bytes
+bool LayoutsAreIdentical(const SFB::CAChannelLayout& lhs, const SFB::CAChannelLayout& rhs) noexcept
+{
+	if(!lhs || !rhs)
+		return !lhs && !rhs;
+	auto size = lhs.Size();
+	return size == rhs.Size() && std::memcmp(lhs.ACL(), rhs.ACL(), size) == 0;
+}
+
+}
+
+#pragma mark CAChannelMap
+
+SFB::CAChannelMap::CAChannelMap(const CAChannelLayout& sourceLayout, const CAChannelLayout& destinationLayout)
+{
+	auto sourceChannelCount = sourceLayout.ChannelCount();
+	if(sourceChannelCount == 0 || !sourceLayout.MapToLayout(destinationLayout, mChannelMap))
+		throw std::invalid_argument("Unable to map channel layouts");
+
+	mSourceChannelCount = static_cast<UInt32>(sourceChannelCount);
+
+	mIsIdentity = mChannelMap.size() == sourceChannelCount;
+	for(std::vector<SInt32>::size_type i = 0; i < mChannelMap.size(); ++i) {
+		// Audio Toolbox may return indexes outside the source layout for channels it can't map
+		if(mChannelMap[i] < 0 || static_cast<UInt32>(mChannelMap[i]) >= mSourceChannelCount)
+			mChannelMap[i] = sUnmappedChannel;
+		if(mChannelMap[i] != static_cast<SInt32>(i))
+			mIsIdentity = false;
+	}
+}
+
+bool SFB::CAChannelMap::Apply(const AudioBufferList& source, AudioBufferList& destination, void *silence) const noexcept
+{
+	if(mChannelMap.empty() || source.mNumberBuffers != mSourceChannelCount || destination.mNumberBuffers != mChannelMap.size())
+		return false;
+
+	auto byteSize = source.mBuffers[0].mDataByteSize;
+	for(UInt32 i = 0; i < destination.mNumberBuffers; ++i) {
+		auto sourceChannel = mChannelMap[i];
+		if(sourceChannel == sUnmappedChannel)
+			destination.mBuffers[i] = { 1, silence ? byteSize : 0, silence };
+		else
+			destination.mBuffers[i] = source.mBuffers[sourceChannel];
+	}
+
+	return true;
+}
+
+bool SFB::CAChannelMap::Apply(const CABufferList& source, AudioBufferList& destination, void *silence) const noexcept
+{
+	if(!source || (source.Format().IsInterleaved() && source.Format().mChannelsPerFrame > 1))
+		return false;
+	return Apply(*source.ABL(), destination, silence);
+}
+
+#pragma mark CAChannelMapCache
+
+std::shared_ptr<const SFB::CAChannelMap> SFB::CAChannelMapCache::ChannelMap(const CAChannelLayout& sourceLayout, const CAChannelLayout& destinationLayout)
+{
+	{
+		std::lock_guard<UnfairLock> lock(mLock);
+		for(const auto& entry : mEntries) {
+			if(LayoutsAreIdentical(entry.mSourceLayout, sourceLayout) && LayoutsAreIdentical(entry.mDestinationLayout, destinationLayout))
+				return entry.mChannelMap;
+		}
+	}
+
+	// The map is created without holding the lock since it queries Audio Toolbox
+	auto channelMap = std::make_shared<const CAChannelMap>(sourceLayout, destinationLayout);
+
+	std::lock_guard<UnfairLock> lock(mLock);
+	// Another thread may have cached an equivalent map in the meantime
+	for(const auto& entry : mEntries) {
+		if(LayoutsAreIdentical(entry.mSourceLayout, sourceLayout) && LayoutsAreIdentical(entry.mDestinationLayout, destinationLayout))
+			return entry.mChannelMap;
+	}
+	mEntries.push_back({ sourceLayout, destinationLayout, channelMap });
+	return channelMap;
+}
+
+std::size_t SFB::CAChannelMapCache::Size() const noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	return mEntries.size();
+}
+
+void SFB::CAChannelMapCache::Clear() noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	mEntries.clear();
+}
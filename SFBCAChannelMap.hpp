@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <memory>
+#import <vector>
+
+#import <CoreAudioTypes/CoreAudioTypes.h>
+
+#import "SFBCABufferList.hpp"
+#import "SFBCAChannelLayout.hpp"
+#import "SFBUnfairLock.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A precomputed mapping of the channels of a source channel layout to the channels of a destination channel layout
+///
+/// The map is derived once using @c kAudioFormatProperty_ChannelMap and can then be applied to non-interleaved audio by
+/// pointing each destination buffer at the corresponding source buffer, without copying audio or querying Audio Toolbox.
+///
+/// @code
+/// SFB::CAChannelMap map(fileLayout, deviceLayout);
+/// // On the render thread
+/// map.Apply(*sourceBufferList, ioData, silence);
+/// @endcode
+class CAChannelMap
+{
+
+public:
+
+	/// The value of @c SourceChannel() for destination channels without a source channel
+	static constexpr SInt32 sUnmappedChannel = -1;
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c CAChannelMap
+	CAChannelMap() noexcept = default;
+
+	/// Copy constructor
+	CAChannelMap(const CAChannelMap& rhs) = default;
+
+	/// Assignment operator
+	CAChannelMap& operator=(const CAChannelMap& rhs) = default;
+
+	/// Destructor
+	~CAChannelMap() = default;
+
+	/// Move constructor
+	CAChannelMap(CAChannelMap&& rhs) noexcept = default;
+
+	/// Move assignment operator
+	CAChannelMap& operator=(CAChannelMap&& rhs) noexcept = default;
+
+	/// Creates a @c CAChannelMap mapping @c sourceLayout to @c destinationLayout
+	/// @throws @c std::invalid_argument if no channel map exists between @c sourceLayout and @c destinationLayout
+	/// @throws @c std::bad_alloc
+	CAChannelMap(const CAChannelLayout& sourceLayout, const CAChannelLayout& destinationLayout);
+
+#pragma mark Map Access
+
+	/// Returns @c true if this @c CAChannelMap is not empty
+	inline explicit operator bool() const noexcept
+	{
+		return !mChannelMap.empty();
+	}
+
+	/// Returns @c true if this @c CAChannelMap is empty
+	inline bool operator!() const noexcept
+	{
+		return !operator bool();
+	}
+
+	/// Returns the number of source channels
+	inline UInt32 SourceChannelCount() const noexcept
+	{
+		return mSourceChannelCount;
+	}
+
+	/// Returns the number of destination channels
+	inline UInt32 DestinationChannelCount() const noexcept
+	{
+		return static_cast<UInt32>(mChannelMap.size());
+	}
+
+	/// Returns the source channel for @c destinationChannel or @c sUnmappedChannel if none
+	/// @note @c destinationChannel must be less than @c DestinationChannelCount()
+	inline SInt32 SourceChannel(UInt32 destinationChannel) const noexcept
+	{
+		return mChannelMap[destinationChannel];
+	}
+
+	/// Returns the channel map, containing the source channel of each destination channel
+	inline const std::vector<SInt32>& ChannelMap() const noexcept
+	{
+		return mChannelMap;
+	}
+
+	/// Returns @c true if every destination channel maps to the source channel with the same index
+	inline bool IsIdentity() const noexcept
+	{
+		return mIsIdentity;
+	}
+
+#pragma mark Remapping
+
+	/// Points the buffers of @c destination at the buffers of @c source containing the corresponding channels
+	///
+	/// This method neither allocates memory nor copies audio and may be called from a real-time thread.
+	/// @note @c source and @c destination must be non-interleaved
+	/// @param source A buffer list with @c SourceChannelCount() buffers
+	/// @param destination A buffer list with @c DestinationChannelCount() buffers to receive the buffer pointers
+	/// @param silence A buffer of silence at least as large as the buffers of @c source used for unmapped channels, or
+	/// @c nullptr to set their data to @c nullptr
+	/// @return @c true on success, @c false if the buffer counts don't match the map
+	bool Apply(const AudioBufferList& source, AudioBufferList& destination, void * _Nullable silence = nullptr) const noexcept;
+
+	/// Points the buffers of @c destination at the buffers of @c source containing the corresponding channels
+	/// @note @c source must be non-interleaved
+	/// @param source A buffer list with @c SourceChannelCount() channels
+	/// @param destination A buffer list with @c DestinationChannelCount() buffers to receive the buffer pointers
+	/// @param silence A buffer of silence at least as large as the buffers of @c source used for unmapped channels, or
+	/// @c nullptr to set their data to @c nullptr
+	/// @return @c true on success, @c false if @c source is interleaved or the channel counts don't match the map
+	bool Apply(const CABufferList& source, AudioBufferList& destination, void * _Nullable silence = nullptr) const noexcept;
+
+private:
+
+	/// The source channel of each destination channel
+	std::vector<SInt32> mChannelMap;
+	/// The number of source channels
+	UInt32 mSourceChannelCount = 0;
+	/// Whether the map is the identity map
+	bool mIsIdentity = false;
+
+};
+
+/// A cache of @c CAChannelMap objects keyed by source and destination channel layout
+///
+/// Layouts are compared bytewise, so looking up a cached map doesn't query Audio Toolbox.
+/// @note This class is thread safe
+class CAChannelMapCache
+{
+
+public:
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c CAChannelMapCache
+	CAChannelMapCache() noexcept = default;
+
+	// This class is non-copyable
+	CAChannelMapCache(const CAChannelMapCache& rhs) = delete;
+
+	// This class is non-assignable
+	CAChannelMapCache& operator=(const CAChannelMapCache& rhs) = delete;
+
+	/// Destructor
+	~CAChannelMapCache() = default;
+
+	// This class is non-movable
+	CAChannelMapCache(CAChannelMapCache&& rhs) = delete;
+
+	// This class is non-move assignable
+	CAChannelMapCache& operator=(CAChannelMapCache&& rhs) = delete;
+
+#pragma mark Lookup
+
+	/// Returns the channel map from @c sourceLayout to @c destinationLayout, creating and caching it if necessary
+	/// @throws @c std::invalid_argument if no channel map exists between @c sourceLayout and @c destinationLayout
+	/// @throws @c std::bad_alloc
+	std::shared_ptr<const CAChannelMap> ChannelMap(const CAChannelLayout& sourceLayout, const CAChannelLayout& destinationLayout);
+
+	/// Returns the number of cached channel maps
+	std::size_t Size() const noexcept;
+
+	/// Removes all cached channel maps
+	void Clear() noexcept;
+
+private:
+
+	/// A cached channel map
+	struct Entry {
+		/// The source layout
+		CAChannelLayout mSourceLayout;
+		/// The destination layout
+		CAChannelLayout mDestinationLayout;
+		/// The channel map
+		std::shared_ptr<const CAChannelMap> mChannelMap;
+	};
+
+	/// The lock protecting @c mEntries
+	mutable UnfairLock mLock;
+	/// The cached channel maps
+	std::vector<Entry> mEntries;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
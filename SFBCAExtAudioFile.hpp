@@ -238,7 +238,7 @@ public:
 	void WriteAsync(UInt32 inNumberFrames, const AudioBufferList * _Nullable ioData)
 	{
 		auto result = ExtAudioFileWriteAsync(mExtAudioFile, inNumberFrames, ioData);
-		ThrowIfCAExtAudioFileError(result, "ExtAudioFileOpenURL");
+		ThrowIfCAExtAudioFileError(result, "ExtAudioFileWriteAsync");
 	}
 
 	/// Seeks to a specific frame position.
@@ -313,6 +313,12 @@ public:
 	CAChannelLayout FileChannelLayout() const
 	{
 		auto size = GetPropertyInfo(kExtAudioFileProperty_FileChannelLayout, nullptr);
+		// Small layouts are read to the stack and copied to the channel layout's inline storage
+		if(size <= CAChannelLayout::sInlineStorageSize) {
+			alignas(AudioChannelLayout) uint8_t buffer [CAChannelLayout::sInlineStorageSize];
+			GetProperty(kExtAudioFileProperty_FileChannelLayout, size, buffer);
+			return reinterpret_cast<const AudioChannelLayout *>(buffer);
+		}
 		std::unique_ptr<AudioChannelLayout, free_deleter> layout{static_cast<AudioChannelLayout *>(std::malloc(size))};
 		if(!layout)
 			throw std::bad_alloc();
@@ -364,6 +370,12 @@ public:
 	CAChannelLayout ClientChannelLayout() const
 	{
 		auto size = GetPropertyInfo(kExtAudioFileProperty_ClientChannelLayout, nullptr);
+		// Small layouts are read to the stack and copied to the channel layout's inline storage
+		if(size <= CAChannelLayout::sInlineStorageSize) {
+			alignas(AudioChannelLayout) uint8_t buffer [CAChannelLayout::sInlineStorageSize];
+			GetProperty(kExtAudioFileProperty_ClientChannelLayout, size, buffer);
+			return reinterpret_cast<const AudioChannelLayout *>(buffer);
+		}
 		std::unique_ptr<AudioChannelLayout, free_deleter> layout{static_cast<AudioChannelLayout *>(std::malloc(size))};
 		if(!layout)
 			throw std::bad_alloc();
@@ -5,11 +5,15 @@
 //
 
 #import <algorithm>
+#import <array>
+#import <cmath>
 #import <cstdlib>
 #import <cstring>
 #import <limits>
 
 #import "SFBCARingBuffer.hpp"
+#import "SFBMirroredMemory.hpp"
+#import "SFBAudioInterleaving.hpp"
 
 namespace {
 
@@ -67,6 +71,68 @@ inline void FetchABL(AudioBufferList * const _Nonnull bufferList, uint32_t dstOf
 	}
 }
 
+/// Copies audio from @c buffers to an interleaved buffer
+/// @param dst The interleaved destination buffer
+/// @param buffers The source buffers in @c format
+/// @param srcOffset The byte offset in @c buffers to begin reading
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void FetchInterleaved(void * const _Nonnull dst, const uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t srcOffset, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		std::memcpy(dst, buffers[0] + srcOffset, frameCount * format.mBytesPerFrame);
+	else
+		SFB::Interleave(reinterpret_cast<const void * const *>(buffers), srcOffset, dst, format.mChannelsPerFrame, format.mBytesPerFrame, frameCount);
+}
+
+/// Copies audio from @c buffers to non-interleaved buffers
+/// @param dst The non-interleaved destination buffers
+/// @param dstOffset The byte offset in @c dst to begin writing
+/// @param buffers The source buffers in @c format
+/// @param srcOffset The byte offset in @c buffers to begin reading
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void FetchNonInterleaved(void * const _Nonnull * const _Nonnull dst, uint32_t dstOffset, const uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t srcOffset, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		SFB::Deinterleave(buffers[0] + srcOffset, dst, dstOffset, format.mChannelsPerFrame, format.mBytesPerFrame / format.mChannelsPerFrame, frameCount);
+	else {
+		for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i)
+			std::memcpy(static_cast<uint8_t *>(dst[i]) + dstOffset, buffers[i] + srcOffset, frameCount * format.mBytesPerFrame);
+	}
+}
+
+/// Copies audio from an interleaved buffer to @c buffers
+/// @param buffers The destination buffers in @c format
+/// @param dstOffset The byte offset in @c buffers to begin writing
+/// @param src The interleaved source buffer
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void StoreInterleaved(uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t dstOffset, const void * const _Nonnull src, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		std::memcpy(buffers[0] + dstOffset, src, frameCount * format.mBytesPerFrame);
+	else
+		SFB::Deinterleave(src, reinterpret_cast<void * const *>(buffers), dstOffset, format.mChannelsPerFrame, format.mBytesPerFrame, frameCount);
+}
+
+/// Copies audio from non-interleaved buffers to @c buffers
+/// @param buffers The destination buffers in @c format
+/// @param dstOffset The byte offset in @c buffers to begin writing
+/// @param src The non-interleaved source buffers
+/// @param srcOffset The byte offset in @c src to begin reading
+/// @param format The format of @c buffers
+/// @param frameCount The number of frames to copy
+inline void StoreNonInterleaved(uint8_t * const _Nonnull * const _Nonnull buffers, uint32_t dstOffset, const void * const _Nonnull * const _Nonnull src, uint32_t srcOffset, const SFB::CAStreamBasicDescription& format, uint32_t frameCount) noexcept
+{
+	if(format.IsInterleaved())
+		SFB::Interleave(src, srcOffset, buffers[0] + dstOffset, format.mChannelsPerFrame, format.mBytesPerFrame / format.mChannelsPerFrame, frameCount);
+	else {
+		for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i)
+			std::memcpy(buffers[i] + dstOffset, static_cast<const uint8_t *>(src[i]) + srcOffset, frameCount * format.mBytesPerFrame);
+	}
+}
+
 /// Returns the smallest power of two value greater than @c x
 /// @param x A value in the range [2..2147483648]
 /// @return The smallest power of two greater than @c x
@@ -77,27 +143,84 @@ inline constexpr uint32_t NextPowerOfTwo(uint32_t x) noexcept
 	return static_cast<uint32_t>(1 << (32 - __builtin_clz(x - 1)));
 }
 
+/// The number of frames on each side of a fractional sample time used by windowed sinc interpolation
+constexpr int64_t kSincHalfWidth = 16;
+/// The number of taps in the windowed sinc filter
+constexpr int64_t kSincTapCount = 2 * kSincHalfWidth;
+/// The number of fractional phases tabulated for the windowed sinc filter
+constexpr uint32_t kSincPhaseCount = 128;
+/// The filter cutoff relative to the Nyquist frequency
+constexpr double kSincCutoff = 0.93;
+/// The Kaiser window shape parameter
+constexpr double kSincKaiserBeta = 8;
+
+/// Returns the zeroth-order modified Bessel function of the first kind evaluated at @c x
+inline double BesselI0(double x) noexcept
+{
+	double sum = 1;
+	double term = 1;
+	for(auto k = 1; k < 64 && term > sum * 1e-17; ++k) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+/// The windowed sinc filter coefficients
+///
+/// Row @c j contains the taps for a fractional sample time of @c j/kSincPhaseCount, applied to the frames beginning
+/// @c kSincHalfWidth-1 frames before the integer sample time. An extra row allows interpolation between phases.
+/// Each row is normalized for unity gain at DC.
+using SincTable = std::array<double, (kSincPhaseCount + 1) * kSincTapCount>;
+
+/// Returns the windowed sinc filter coefficients, computing them on first use
+const SincTable& WindowedSincTable() noexcept
+{
+	static const SincTable table = [] {
+		SincTable t;
+		auto i0Beta = BesselI0(kSincKaiserBeta);
+		for(uint32_t j = 0; j <= kSincPhaseCount; ++j) {
+			auto row = t.data() + j * kSincTapCount;
+			double sum = 0;
+			for(int64_t k = 0; k < kSincTapCount; ++k) {
+				auto x = static_cast<double>(k - (kSincHalfWidth - 1)) - static_cast<double>(j) / kSincPhaseCount;
+				auto r = x / kSincHalfWidth;
+				double h = 0;
+				if(r > -1 && r < 1) {
+					auto window = BesselI0(kSincKaiserBeta * std::sqrt(1 - r * r)) / i0Beta;
+					auto sinc = x == 0 ? 1 : std::sin(M_PI * kSincCutoff * x) / (M_PI * kSincCutoff * x);
+					h = kSincCutoff * sinc * window;
+				}
+				row[k] = h;
+				sum += h;
+			}
+			for(int64_t k = 0; k < kSincTapCount; ++k)
+				row[k] /= sum;
+		}
+		return t;
+	}();
+	return table;
+}
+
 }
 
 #pragma mark Creation and Destruction
 
 SFB::CARingBuffer::CARingBuffer() noexcept
-: mBuffers(nullptr), mCapacityFrames(0), mCapacityFramesMask(0)
+: mBuffers(nullptr), mCapacityFrames(0), mCapacityFramesMask(0), mIsMirrored(false)
 {
-	assert(mTimeBoundsQueueCounter.is_lock_free());
 }
 
 SFB::CARingBuffer::~CARingBuffer()
 {
-	std::free(mBuffers);
+	Deallocate();
 }
 
 #pragma mark Buffer Management
 
-bool SFB::CARingBuffer::Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames) noexcept
+bool SFB::CARingBuffer::Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames, bool mirrored) noexcept
 {
-	// Only non-interleaved formats are supported
-	if(format.IsInterleaved() || capacityFrames < 2 || capacityFrames > 0x80000000)
+	if(capacityFrames < 2 || capacityFrames > 0x80000000)
 		return false;
 
 	Deallocate();
@@ -105,38 +228,70 @@ bool SFB::CARingBuffer::Allocate(const CAStreamBasicDescription& format, uint32_
 	// Round up to the next power of two
 	capacityFrames = NextPowerOfTwo(static_cast<uint32_t>(capacityFrames));
 
-	mFormat = format;
+	auto capacityBytes = static_cast<uint64_t>(capacityFrames) * format.mBytesPerFrame;
 
-	mCapacityFrames = capacityFrames;
-	mCapacityFramesMask = capacityFrames - 1;
-
-	uint32_t capacityBytes = capacityFrames * format.mBytesPerFrame;
+	if(mirrored) {
+		// Mirrored regions must be a multiple of the granularity, which is a power of two
+		auto granularity = MirroredRegionGranularity();
+		while(capacityBytes % granularity) {
+			if(capacityFrames == 0x80000000)
+				return false;
+			capacityFrames *= 2;
+			capacityBytes *= 2;
+		}
+	}
 
-	// One memory allocation holds everything- first the pointers followed by the deinterleaved channels
-	uint32_t allocationSize = (capacityBytes + sizeof(uint8_t *)) * format.mChannelsPerFrame;
-	uint8_t *memoryChunk = static_cast<uint8_t *>(std::malloc(allocationSize));
-	if(!memoryChunk)
+	if(capacityBytes > std::numeric_limits<uint32_t>::max())
 		return false;
 
-	// Zero the entire allocation
-	std::memset(memoryChunk, 0, allocationSize);
+	auto channelStreamCount = format.ChannelStreamCount();
 
-	// Assign the pointers and channel buffers
-	mBuffers = reinterpret_cast<uint8_t **>(memoryChunk);
-	memoryChunk += format.mChannelsPerFrame * sizeof(uint8_t *);
-	for(UInt32 i = 0; i < format.mChannelsPerFrame; ++i) {
-		mBuffers[i] = memoryChunk;
-		memoryChunk += capacityBytes;
-	}
+	if(mirrored) {
+		// The pointers are allocated separately from the mirrored channel buffers, which are zero-filled
+		mBuffers = static_cast<uint8_t **>(std::malloc(channelStreamCount * sizeof(uint8_t *)));
+		if(!mBuffers)
+			return false;
+
+		auto regions = static_cast<uint8_t *>(AllocateMirroredRegions(capacityBytes, channelStreamCount));
+		if(!regions) {
+			std::free(mBuffers);
+			mBuffers = nullptr;
+			return false;
+		}
 
-	// Zero the time bounds queue
-	for(uint32_t i = 0; i < sTimeBoundsQueueSize; ++i) {
-		mTimeBoundsQueue[i].mStartTime = 0;
-		mTimeBoundsQueue[i].mEndTime = 0;
-		mTimeBoundsQueue[i].mUpdateCounter = 0;
+		for(UInt32 i = 0; i < channelStreamCount; ++i)
+			mBuffers[i] = regions + 2 * capacityBytes * i;
 	}
+	else {
+		// One memory allocation holds everything- first the pointers followed by the channel buffers
+		auto allocationSize = (capacityBytes + sizeof(uint8_t *)) * channelStreamCount;
+		uint8_t *memoryChunk = static_cast<uint8_t *>(std::malloc(allocationSize));
+		if(!memoryChunk)
+			return false;
+
+		// Zero the entire allocation
+		std::memset(memoryChunk, 0, allocationSize);
+
+		// Assign the pointers and channel buffers
+		mBuffers = reinterpret_cast<uint8_t **>(memoryChunk);
+		memoryChunk += channelStreamCount * sizeof(uint8_t *);
+		for(UInt32 i = 0; i < channelStreamCount; ++i) {
+			mBuffers[i] = memoryChunk;
+			memoryChunk += capacityBytes;
+		}
+	}
+
+	mFormat = format;
+
+	mCapacityFrames = capacityFrames;
+	mCapacityFramesMask = capacityFrames - 1;
+
+	mIsMirrored = mirrored;
 
-	mTimeBoundsQueueCounter = 0;
+	mTimeBounds.Reset();
+
+	// Compute the filter coefficients now instead of during a read
+	WindowedSincTable();
 
 	return true;
 }
@@ -144,6 +299,8 @@ bool SFB::CARingBuffer::Allocate(const CAStreamBasicDescription& format, uint32_
 void SFB::CARingBuffer::Deallocate() noexcept
 {
 	if(mBuffers) {
+		if(mIsMirrored)
+			DeallocateMirroredRegions(mBuffers[0], mCapacityFrames * mFormat.mBytesPerFrame, mFormat.ChannelStreamCount());
 		std::free(mBuffers);
 		mBuffers = nullptr;
 
@@ -151,57 +308,53 @@ void SFB::CARingBuffer::Deallocate() noexcept
 
 		mCapacityFrames = 0;
 		mCapacityFramesMask = 0;
+		mIsMirrored = false;
 
-		for(uint32_t i = 0; i < sTimeBoundsQueueSize; ++i) {
-			mTimeBoundsQueue[i].mStartTime = 0;
-			mTimeBoundsQueue[i].mEndTime = 0;
-			mTimeBoundsQueue[i].mUpdateCounter = 0;
-		}
-
-		mTimeBoundsQueueCounter = 0;
+		mTimeBounds.Reset();
 	}
 }
 
 bool SFB::CARingBuffer::GetTimeBounds(int64_t& startTime, int64_t& endTime) const noexcept
 {
-	for(auto i = 0; i < 8; ++i) {
-		auto currentCounter = mTimeBoundsQueueCounter.load(std::memory_order_acquire);
-		auto currentIndex = currentCounter & sTimeBoundsQueueMask;
-
-		const SFB::CARingBuffer::TimeBounds * const bounds = mTimeBoundsQueue + currentIndex;
-
-		startTime = bounds->mStartTime;
-		endTime = bounds->mEndTime;
+	TimeBounds bounds;
+	if(!mTimeBounds.Load(bounds))
+		return false;
 
-		auto counter = bounds->mUpdateCounter.load(std::memory_order_acquire);
-		if(counter == currentCounter)
-			return true;
-	}
+	startTime = bounds.mStartTime;
+	endTime = bounds.mEndTime;
 
-	return false;
+	return true;
 }
 
 #pragma mark Reading and Writing Audio
 
-bool SFB::CARingBuffer::Read(AudioBufferList * const bufferList, uint32_t frameCount, int64_t startRead) noexcept
+bool SFB::CARingBuffer::Read(AudioBufferList * const bufferList, uint32_t frameCount, int64_t startRead) const noexcept
+{
+	int64_t startTime = 0, endTime = 0;
+	auto result = CopyToBufferList(bufferList, frameCount, startRead, startTime, endTime);
+	RecordRead(startRead, frameCount, startTime, endTime, result);
+	return result == CopyResult::success;
+}
+
+SFB::CARingBuffer::CopyResult SFB::CARingBuffer::CopyToBufferList(AudioBufferList * const bufferList, uint32_t frameCount, int64_t startRead, int64_t& startTime, int64_t& endTime) const noexcept
 {
 	if(frameCount == 0)
-		return true;
+		return CopyResult::success;
 
 	if(!bufferList || frameCount > mCapacityFrames || startRead < 0)
-		return false;
+		return CopyResult::error;
 
 	auto endRead = startRead + static_cast<int64_t>(frameCount);
 
 	auto startRead0 = startRead;
 	auto endRead0 = endRead;
 
-	if(!ClampTimesToBounds(startRead, endRead))
-		return false;
+	if(!ClampTimesToBounds(startRead, endRead, startTime, endTime))
+		return CopyResult::error;
 
 	if(startRead == endRead) {
 		ZeroABL(bufferList, 0, frameCount * mFormat.mBytesPerFrame);
-		return true;
+		return CopyResult::success;
 	}
 
 	auto byteSize = static_cast<uint32_t>(endRead - startRead) * mFormat.mBytesPerFrame;
@@ -218,7 +371,11 @@ bool SFB::CARingBuffer::Read(AudioBufferList * const bufferList, uint32_t frameC
 	auto offset1 = FrameByteOffset(endRead);
 	uint32_t byteCount;
 
-	if(offset0 < offset1) {
+	if(mIsMirrored) {
+		byteCount = byteSize;
+		FetchABL(bufferList, destStartByteOffset, mBuffers, offset0, byteCount);
+	}
+	else if(offset0 < offset1) {
 		byteCount = offset1 - offset0;
 		FetchABL(bufferList, destStartByteOffset, mBuffers, offset0, byteCount);
 	}
@@ -232,7 +389,8 @@ bool SFB::CARingBuffer::Read(AudioBufferList * const bufferList, uint32_t frameC
 	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
 		bufferList->mBuffers[i].mDataByteSize = static_cast<UInt32>(byteCount);
 
-	return true;
+	// Fail if the writer overwrote any of the audio during the copy
+	return RangeIsValid(startRead, endRead) ? CopyResult::success : CopyResult::overwritten;
 }
 
 bool SFB::CARingBuffer::Write(const AudioBufferList * const bufferList, uint32_t frameCount, int64_t startWrite) noexcept
@@ -245,6 +403,375 @@ bool SFB::CARingBuffer::Write(const AudioBufferList * const bufferList, uint32_t
 
 	auto endWrite = startWrite + static_cast<int64_t>(frameCount);
 
+	PrepareForWrite(startWrite, endWrite);
+
+	auto offset0 = FrameByteOffset(startWrite);
+	auto offset1 = FrameByteOffset(endWrite);
+	if(mIsMirrored)
+		StoreABL(mBuffers, offset0, bufferList, 0, frameCount * mFormat.mBytesPerFrame);
+	else if(offset0 < offset1)
+		StoreABL(mBuffers, offset0, bufferList, 0, offset1 - offset0);
+	else {
+		auto byteCount = (mCapacityFrames * mFormat.mBytesPerFrame) - offset0;
+		StoreABL(mBuffers, offset0, bufferList, 0, byteCount);
+		StoreABL(mBuffers, 0, bufferList, byteCount, offset1);
+	}
+
+	// Update the end time
+	SetTimeBounds(StartTime(), endWrite);
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWriteOccupancy(static_cast<uint64_t>(endWrite - StartTime()));
+#endif
+
+	return true;
+}
+
+bool SFB::CARingBuffer::ReadInterleaved(void * const buffer, uint32_t frameCount, int64_t startRead) const noexcept
+{
+	int64_t startTime = 0, endTime = 0;
+	auto result = CopyInterleaved(buffer, frameCount, startRead, startTime, endTime);
+	RecordRead(startRead, frameCount, startTime, endTime, result);
+	return result == CopyResult::success;
+}
+
+SFB::CARingBuffer::CopyResult SFB::CARingBuffer::CopyInterleaved(void * const buffer, uint32_t frameCount, int64_t startRead, int64_t& startTime, int64_t& endTime) const noexcept
+{
+	if(frameCount == 0)
+		return CopyResult::success;
+
+	if(!buffer || frameCount > mCapacityFrames || startRead < 0)
+		return CopyResult::error;
+
+	auto endRead = startRead + static_cast<int64_t>(frameCount);
+
+	auto startRead0 = startRead;
+	auto endRead0 = endRead;
+
+	if(!ClampTimesToBounds(startRead, endRead, startTime, endTime))
+		return CopyResult::error;
+
+	auto bytesPerInterleavedFrame = (mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount()) * mFormat.mChannelsPerFrame;
+	auto dst = static_cast<uint8_t *>(buffer);
+
+	if(startRead == endRead) {
+		std::memset(dst, 0, frameCount * bytesPerInterleavedFrame);
+		return CopyResult::success;
+	}
+
+	auto framesToRead = static_cast<uint32_t>(endRead - startRead);
+
+	auto destStartFrameOffset = static_cast<uint32_t>(std::max(static_cast<int64_t>(0), startRead - startRead0));
+	if(destStartFrameOffset > 0)
+		std::memset(dst, 0, destStartFrameOffset * bytesPerInterleavedFrame);
+
+	auto destEndFrames = static_cast<uint32_t>(std::max(static_cast<int64_t>(0), endRead0 - endRead));
+	if(destEndFrames > 0)
+		std::memset(dst + (destStartFrameOffset + framesToRead) * bytesPerInterleavedFrame, 0, destEndFrames * bytesPerInterleavedFrame);
+
+	auto offset0 = FrameByteOffset(startRead);
+	auto framesAfterOffset0 = mCapacityFrames - static_cast<uint32_t>(static_cast<uint64_t>(startRead) & mCapacityFramesMask);
+
+	if(mIsMirrored || framesToRead <= framesAfterOffset0)
+		FetchInterleaved(dst + destStartFrameOffset * bytesPerInterleavedFrame, mBuffers, offset0, mFormat, framesToRead);
+	else {
+		FetchInterleaved(dst + destStartFrameOffset * bytesPerInterleavedFrame, mBuffers, offset0, mFormat, framesAfterOffset0);
+		FetchInterleaved(dst + (destStartFrameOffset + framesAfterOffset0) * bytesPerInterleavedFrame, mBuffers, 0, mFormat, framesToRead - framesAfterOffset0);
+	}
+
+	// Fail if the writer overwrote any of the audio during the copy
+	return RangeIsValid(startRead, endRead) ? CopyResult::success : CopyResult::overwritten;
+}
+
+bool SFB::CARingBuffer::ReadNonInterleaved(void * const * const buffers, uint32_t frameCount, int64_t startRead) const noexcept
+{
+	int64_t startTime = 0, endTime = 0;
+	auto result = CopyNonInterleaved(buffers, frameCount, startRead, startTime, endTime);
+	RecordRead(startRead, frameCount, startTime, endTime, result);
+	return result == CopyResult::success;
+}
+
+SFB::CARingBuffer::CopyResult SFB::CARingBuffer::CopyNonInterleaved(void * const * const buffers, uint32_t frameCount, int64_t startRead, int64_t& startTime, int64_t& endTime) const noexcept
+{
+	if(frameCount == 0)
+		return CopyResult::success;
+
+	if(!buffers || frameCount > mCapacityFrames || startRead < 0)
+		return CopyResult::error;
+
+	auto endRead = startRead + static_cast<int64_t>(frameCount);
+
+	auto startRead0 = startRead;
+	auto endRead0 = endRead;
+
+	if(!ClampTimesToBounds(startRead, endRead, startTime, endTime))
+		return CopyResult::error;
+
+	auto bytesPerSample = mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount();
+	auto dst = reinterpret_cast<uint8_t * const *>(buffers);
+
+	if(startRead == endRead) {
+		ZeroRange(dst, mFormat.mChannelsPerFrame, 0, frameCount * bytesPerSample);
+		return CopyResult::success;
+	}
+
+	auto framesToRead = static_cast<uint32_t>(endRead - startRead);
+
+	auto destStartFrameOffset = static_cast<uint32_t>(std::max(static_cast<int64_t>(0), startRead - startRead0));
+	if(destStartFrameOffset > 0)
+		ZeroRange(dst, mFormat.mChannelsPerFrame, 0, destStartFrameOffset * bytesPerSample);
+
+	auto destEndFrames = static_cast<uint32_t>(std::max(static_cast<int64_t>(0), endRead0 - endRead));
+	if(destEndFrames > 0)
+		ZeroRange(dst, mFormat.mChannelsPerFrame, (destStartFrameOffset + framesToRead) * bytesPerSample, destEndFrames * bytesPerSample);
+
+	auto offset0 = FrameByteOffset(startRead);
+	auto framesAfterOffset0 = mCapacityFrames - static_cast<uint32_t>(static_cast<uint64_t>(startRead) & mCapacityFramesMask);
+
+	if(mIsMirrored || framesToRead <= framesAfterOffset0)
+		FetchNonInterleaved(buffers, destStartFrameOffset * bytesPerSample, mBuffers, offset0, mFormat, framesToRead);
+	else {
+		FetchNonInterleaved(buffers, destStartFrameOffset * bytesPerSample, mBuffers, offset0, mFormat, framesAfterOffset0);
+		FetchNonInterleaved(buffers, (destStartFrameOffset + framesAfterOffset0) * bytesPerSample, mBuffers, 0, mFormat, framesToRead - framesAfterOffset0);
+	}
+
+	// Fail if the writer overwrote any of the audio during the copy
+	return RangeIsValid(startRead, endRead) ? CopyResult::success : CopyResult::overwritten;
+}
+
+bool SFB::CARingBuffer::WriteInterleaved(const void * const buffer, uint32_t frameCount, int64_t startWrite) noexcept
+{
+	if(frameCount == 0)
+		return true;
+
+	if(!buffer || frameCount > mCapacityFrames || startWrite < 0)
+		return false;
+
+	auto endWrite = startWrite + static_cast<int64_t>(frameCount);
+
+	PrepareForWrite(startWrite, endWrite);
+
+	auto offset0 = FrameByteOffset(startWrite);
+	auto framesAfterOffset0 = mCapacityFrames - static_cast<uint32_t>(static_cast<uint64_t>(startWrite) & mCapacityFramesMask);
+
+	if(mIsMirrored || frameCount <= framesAfterOffset0)
+		StoreInterleaved(mBuffers, offset0, buffer, mFormat, frameCount);
+	else {
+		auto bytesPerInterleavedFrame = (mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount()) * mFormat.mChannelsPerFrame;
+		StoreInterleaved(mBuffers, offset0, buffer, mFormat, framesAfterOffset0);
+		StoreInterleaved(mBuffers, 0, static_cast<const uint8_t *>(buffer) + framesAfterOffset0 * bytesPerInterleavedFrame, mFormat, frameCount - framesAfterOffset0);
+	}
+
+	// Update the end time
+	SetTimeBounds(StartTime(), endWrite);
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWriteOccupancy(static_cast<uint64_t>(endWrite - StartTime()));
+#endif
+
+	return true;
+}
+
+bool SFB::CARingBuffer::WriteNonInterleaved(const void * const * const buffers, uint32_t frameCount, int64_t startWrite) noexcept
+{
+	if(frameCount == 0)
+		return true;
+
+	if(!buffers || frameCount > mCapacityFrames || startWrite < 0)
+		return false;
+
+	auto endWrite = startWrite + static_cast<int64_t>(frameCount);
+
+	PrepareForWrite(startWrite, endWrite);
+
+	auto offset0 = FrameByteOffset(startWrite);
+	auto framesAfterOffset0 = mCapacityFrames - static_cast<uint32_t>(static_cast<uint64_t>(startWrite) & mCapacityFramesMask);
+
+	if(mIsMirrored || frameCount <= framesAfterOffset0)
+		StoreNonInterleaved(mBuffers, offset0, buffers, 0, mFormat, frameCount);
+	else {
+		auto bytesPerSample = mFormat.mBytesPerFrame / mFormat.InterleavedChannelCount();
+		StoreNonInterleaved(mBuffers, offset0, buffers, 0, mFormat, framesAfterOffset0);
+		StoreNonInterleaved(mBuffers, 0, buffers, framesAfterOffset0 * bytesPerSample, mFormat, frameCount - framesAfterOffset0);
+	}
+
+	// Update the end time
+	SetTimeBounds(StartTime(), endWrite);
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWriteOccupancy(static_cast<uint64_t>(endWrite - StartTime()));
+#endif
+
+	return true;
+}
+
+#pragma mark Resampling
+
+bool SFB::CARingBuffer::ReadResampled(AudioBufferList * const bufferList, uint32_t frameCount, double timeStamp, double rate, InterpolationQuality quality) const noexcept
+{
+	if(frameCount == 0)
+		return true;
+
+	if(!bufferList || !(timeStamp >= 0) || !(rate > 0) || !std::isfinite(timeStamp) || !std::isfinite(rate))
+		return false;
+
+	auto wordSize = mFormat.SampleWordSize();
+	if(!mFormat.IsFloat() || !mFormat.IsNativeEndian() || (wordSize != sizeof(float) && wordSize != sizeof(double)))
+		return false;
+
+	if(bufferList->mNumberBuffers != mFormat.ChannelStreamCount())
+		return false;
+	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i) {
+		if(bufferList->mBuffers[i].mDataByteSize < frameCount * mFormat.mBytesPerFrame)
+			return false;
+	}
+
+	// Determine the range of frames contributing to the output
+	auto endTimeStamp = timeStamp + (frameCount - 1) * rate;
+	auto margin = quality == InterpolationQuality::windowedSinc ? kSincHalfWidth : 1;
+	auto startRead = static_cast<int64_t>(timeStamp) - (margin - 1);
+	auto endRead = static_cast<int64_t>(endTimeStamp) + margin + 1;
+
+	if(endRead - startRead > static_cast<int64_t>(mCapacityFrames))
+		return false;
+
+	int64_t startTime, endTime;
+	if(!GetTimeBounds(startTime, endTime))
+		return false;
+
+	if(wordSize == sizeof(float))
+		Resample<float>(bufferList, frameCount, timeStamp, rate, quality, startTime, endTime);
+	else
+		Resample<double>(bufferList, frameCount, timeStamp, rate, quality, startTime, endTime);
+
+	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+		bufferList->mBuffers[i].mDataByteSize = frameCount * mFormat.mBytesPerFrame;
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordReadOccupancy(static_cast<uint64_t>(endTime - startTime));
+#endif
+
+	// Frames outside the time bounds were not read
+	startRead = std::max(startRead, startTime);
+	endRead = std::min(endRead, endTime);
+	if(startRead >= endRead)
+		return true;
+
+	// Fail if the writer overwrote any of the audio during the copy
+	if(!RangeIsValid(startRead, endRead)) {
+#if SFB_RING_BUFFER_STATISTICS
+		mStatistics.RecordReadOverrun();
+#endif
+		return false;
+	}
+
+	return true;
+}
+
+#pragma mark Readers
+
+SFB::CARingBuffer::Reader::Reader(const CARingBuffer& ringBuffer) noexcept
+: mRingBuffer(ringBuffer), mSampleTime(0), mOverrunCount(0), mFramesDropped(0)
+{
+	int64_t startTime, endTime;
+	if(mRingBuffer.GetTimeBounds(startTime, endTime))
+		mSampleTime = endTime;
+}
+
+int64_t SFB::CARingBuffer::Reader::Lag() const noexcept
+{
+	int64_t startTime, endTime;
+	if(!mRingBuffer.GetTimeBounds(startTime, endTime))
+		return 0;
+	return endTime - mSampleTime;
+}
+
+template <typename F>
+SFB::CARingBuffer::ReadResult SFB::CARingBuffer::Reader::PerformRead(uint32_t frameCount, F&& read) noexcept
+{
+	if(frameCount > mRingBuffer.CapacityFrames())
+		return ReadResult::error;
+
+	auto result = ReadResult::error;
+	int64_t startTime = 0, endTime = 0;
+	uint64_t framesSkipped = 0;
+
+	// A read fails if the writer overwrites the audio during the copy, in which case the next attempt is an overrun
+	for(auto i = 0; i < 8; ++i) {
+		if(!mRingBuffer.GetTimeBounds(startTime, endTime))
+			return ReadResult::error;
+
+		// Skip to the oldest audio still in the buffer
+		if(mSampleTime < startTime) {
+			++mOverrunCount;
+			framesSkipped += static_cast<uint64_t>(startTime - mSampleTime);
+			mSampleTime = startTime;
+		}
+
+		if(endTime - mSampleTime < static_cast<int64_t>(frameCount)) {
+			result = ReadResult::insufficientData;
+			break;
+		}
+
+		auto copyResult = read(mSampleTime, startTime, endTime);
+		// The copy fetches the time bounds again and zero fills any frames overwritten since they were checked above,
+		// so a range that was clamped must be treated as overwritten
+		if(copyResult == CopyResult::success && mSampleTime < startTime)
+			copyResult = CopyResult::overwritten;
+		if(copyResult == CopyResult::error)
+			return ReadResult::error;
+		if(copyResult == CopyResult::success) {
+			mSampleTime += frameCount;
+			result = framesSkipped > 0 ? ReadResult::overrun : ReadResult::success;
+			break;
+		}
+	}
+
+	mFramesDropped += framesSkipped;
+
+	// Statistics are recorded once for the read regardless of the number of attempts
+#if SFB_RING_BUFFER_STATISTICS
+	auto& statistics = mRingBuffer.mStatistics;
+	statistics.RecordReadOccupancy(static_cast<uint64_t>(endTime - startTime));
+	if(framesSkipped > 0 || result == ReadResult::error)
+		statistics.RecordReadOverrun();
+	if(result == ReadResult::insufficientData)
+		statistics.RecordUnderrun(frameCount - static_cast<uint64_t>(std::max(endTime - mSampleTime, static_cast<int64_t>(0))));
+#endif
+
+	return result;
+}
+
+SFB::CARingBuffer::ReadResult SFB::CARingBuffer::Reader::Read(AudioBufferList * const bufferList, uint32_t frameCount) noexcept
+{
+	return PerformRead(frameCount, [&](int64_t sampleTime, int64_t& startTime, int64_t& endTime) {
+		return mRingBuffer.CopyToBufferList(bufferList, frameCount, sampleTime, startTime, endTime);
+	});
+}
+
+SFB::CARingBuffer::ReadResult SFB::CARingBuffer::Reader::ReadInterleaved(void * const buffer, uint32_t frameCount) noexcept
+{
+	return PerformRead(frameCount, [&](int64_t sampleTime, int64_t& startTime, int64_t& endTime) {
+		return mRingBuffer.CopyInterleaved(buffer, frameCount, sampleTime, startTime, endTime);
+	});
+}
+
+SFB::CARingBuffer::ReadResult SFB::CARingBuffer::Reader::ReadNonInterleaved(void * const * const buffers, uint32_t frameCount) noexcept
+{
+	return PerformRead(frameCount, [&](int64_t sampleTime, int64_t& startTime, int64_t& endTime) {
+		return mRingBuffer.CopyNonInterleaved(buffers, frameCount, sampleTime, startTime, endTime);
+	});
+}
+
+#pragma mark Internals
+
+void SFB::CARingBuffer::SetTimeBounds(int64_t startTime, int64_t endTime) noexcept
+{
+	mTimeBounds.Store({ startTime, endTime });
+}
+
+void SFB::CARingBuffer::PrepareForWrite(int64_t startWrite, int64_t endWrite) noexcept
+{
 	// Going backwards, throw everything out
 	if(startWrite < EndTime())
 		SetTimeBounds(startWrite, startWrite);
@@ -258,57 +785,107 @@ bool SFB::CARingBuffer::Write(const AudioBufferList * const bufferList, uint32_t
 		SetTimeBounds(newStart, newEnd);
 	}
 
-	uint32_t offset0, offset1;
-	auto curEnd = EndTime();
+	// Publish the new bounds before modifying any audio so readers can detect overwritten audio
+	std::atomic_thread_fence(std::memory_order_release);
 
+	auto curEnd = EndTime();
 	if(startWrite > curEnd) {
-		// Zero the range of samples being skipped
-		offset0 = FrameByteOffset(curEnd);
-		offset1 = FrameByteOffset(startWrite);
-		if(offset0 < offset1)
+		// Zero the range of samples being skipped, at most one buffer's worth
+		auto skipStart = std::max(curEnd, startWrite - static_cast<int64_t>(mCapacityFrames));
+		auto offset0 = FrameByteOffset(skipStart);
+		auto offset1 = FrameByteOffset(startWrite);
+		if(mIsMirrored)
+			ZeroRange(mBuffers, mFormat.ChannelStreamCount(), offset0, static_cast<uint32_t>(startWrite - skipStart) * mFormat.mBytesPerFrame);
+		else if(offset0 < offset1)
 			ZeroRange(mBuffers, mFormat.ChannelStreamCount(), offset0, offset1 - offset0);
 		else {
 			ZeroRange(mBuffers, mFormat.ChannelStreamCount(), offset0, (mCapacityFrames * mFormat.mBytesPerFrame) - offset0);
 			ZeroRange(mBuffers, mFormat.ChannelStreamCount(), 0, offset1);
 		}
-
-		offset0 = offset1;
-	}
-	else
-		offset0 = FrameByteOffset(startWrite);
-
-	offset1 = FrameByteOffset(endWrite);
-	if(offset0 < offset1)
-		StoreABL(mBuffers, offset0, bufferList, 0, offset1 - offset0);
-	else {
-		auto byteCount = (mCapacityFrames * mFormat.mBytesPerFrame) - offset0;
-		StoreABL(mBuffers, offset0, bufferList, 0, byteCount);
-		StoreABL(mBuffers, 0, bufferList, byteCount, offset1);
 	}
+}
 
-	// Update the end time
-	SetTimeBounds(StartTime(), endWrite);
+template <typename T>
+void SFB::CARingBuffer::Resample(AudioBufferList * const bufferList, uint32_t frameCount, double timeStamp, double rate, InterpolationQuality quality, int64_t startTime, int64_t endTime) const noexcept
+{
+	auto channelCount = mFormat.mChannelsPerFrame;
+	auto stride = mFormat.InterleavedChannelCount();
+	auto isInterleaved = mFormat.IsInterleaved();
+
+	// Sample n of channel c is located at src[c][n * stride] for non-interleaved formats and src[0][n * stride + c] for interleaved formats
+	const T * const * src = reinterpret_cast<const T * const *>(mBuffers);
+	auto sourceSample = [&](UInt32 c, int64_t frame) -> T {
+		if(frame < startTime || frame >= endTime)
+			return 0;
+		auto samples = isInterleaved ? src[0] + c : src[c];
+		return samples[(static_cast<uint64_t>(frame) & mCapacityFramesMask) * stride];
+	};
+
+	const auto& table = WindowedSincTable();
+	T coefficients[kSincTapCount];
+
+	for(uint32_t i = 0; i < frameCount; ++i) {
+		auto t = timeStamp + i * rate;
+		auto frame = static_cast<int64_t>(t);
+		auto fraction = static_cast<T>(t - static_cast<double>(frame));
+
+		if(quality == InterpolationQuality::linear) {
+			for(UInt32 c = 0; c < channelCount; ++c) {
+				auto a = sourceSample(c, frame);
+				auto b = sourceSample(c, frame + 1);
+				auto dst = isInterleaved ? static_cast<T *>(bufferList->mBuffers[0].mData) + c : static_cast<T *>(bufferList->mBuffers[c].mData);
+				dst[i * stride] = a + fraction * (b - a);
+			}
+			continue;
+		}
 
-	return true;
+		// Interpolate the filter coefficients between the two nearest tabulated phases
+		auto phase = static_cast<double>(fraction) * kSincPhaseCount;
+		auto phaseIndex = std::min(static_cast<uint32_t>(phase), kSincPhaseCount - 1);
+		auto phaseFraction = phase - phaseIndex;
+		auto row0 = table.data() + phaseIndex * kSincTapCount;
+		auto row1 = row0 + kSincTapCount;
+		for(int64_t k = 0; k < kSincTapCount; ++k)
+			coefficients[k] = static_cast<T>(row0[k] + phaseFraction * (row1[k] - row0[k]));
+
+		auto firstFrame = frame - (kSincHalfWidth - 1);
+		auto inBounds = firstFrame >= startTime && firstFrame + kSincTapCount <= endTime;
+		auto firstOffset = static_cast<uint64_t>(firstFrame) & mCapacityFramesMask;
+		auto contiguous = mIsMirrored || firstOffset + kSincTapCount <= mCapacityFrames;
+
+		for(UInt32 c = 0; c < channelCount; ++c) {
+			T sum = 0;
+			if(inBounds && contiguous) {
+				auto samples = (isInterleaved ? src[0] + c : src[c]) + firstOffset * stride;
+				for(int64_t k = 0; k < kSincTapCount; ++k)
+					sum += coefficients[k] * samples[k * stride];
+			}
+			else {
+				for(int64_t k = 0; k < kSincTapCount; ++k)
+					sum += coefficients[k] * sourceSample(c, firstFrame + k);
+			}
+			auto dst = isInterleaved ? static_cast<T *>(bufferList->mBuffers[0].mData) + c : static_cast<T *>(bufferList->mBuffers[c].mData);
+			dst[i * stride] = sum;
+		}
+	}
 }
 
-#pragma mark Internals
-
-void SFB::CARingBuffer::SetTimeBounds(int64_t startTime, int64_t endTime) noexcept
+bool SFB::CARingBuffer::RangeIsValid(int64_t startRead, int64_t endRead) const noexcept
 {
-	auto nextCounter = mTimeBoundsQueueCounter.load(std::memory_order_acquire) + 1;
-	auto nextIndex = nextCounter & sTimeBoundsQueueMask;
+	// Order the preceding copy before reloading the time bounds.
+	// PrepareForWrite() publishes new bounds before modifying any audio so a copy that observed modified audio
+	// will also observe bounds excluding it.
+	std::atomic_thread_fence(std::memory_order_acquire);
 
-	mTimeBoundsQueue[nextIndex].mStartTime = startTime;
-	mTimeBoundsQueue[nextIndex].mEndTime = endTime;
-	mTimeBoundsQueue[nextIndex].mUpdateCounter.store(nextCounter, std::memory_order_release);
+	int64_t startTime, endTime;
+	if(!GetTimeBounds(startTime, endTime))
+		return false;
 
-	mTimeBoundsQueueCounter.store(nextCounter, std::memory_order_release);
+	return startRead >= startTime && endRead <= endTime;
 }
 
-bool SFB::CARingBuffer::ClampTimesToBounds(int64_t& startRead, int64_t& endRead) const noexcept
+bool SFB::CARingBuffer::ClampTimesToBounds(int64_t& startRead, int64_t& endRead, int64_t& startTime, int64_t& endTime) const noexcept
 {
-	int64_t startTime, endTime;
 	if(!GetTimeBounds(startTime, endTime))
 		return false;
 
@@ -322,3 +899,18 @@ bool SFB::CARingBuffer::ClampTimesToBounds(int64_t& startRead, int64_t& endRead)
 
 	return true;
 }
+
+void SFB::CARingBuffer::RecordRead(int64_t startRead, uint32_t frameCount, int64_t startTime, int64_t endTime, CopyResult result) const noexcept
+{
+#if SFB_RING_BUFFER_STATISTICS
+	if(frameCount == 0 || result == CopyResult::error)
+		return;
+
+	// Frames after the end time haven't been written yet and frames before the start time have been overwritten
+	auto endRead = startRead + static_cast<int64_t>(frameCount);
+	mStatistics.RecordReadOccupancy(static_cast<uint64_t>(endTime - startTime));
+	mStatistics.RecordTimestampedRead(static_cast<uint64_t>(std::clamp(endRead - endTime, static_cast<int64_t>(0), static_cast<int64_t>(frameCount))), static_cast<uint64_t>(std::clamp(startTime - startRead, static_cast<int64_t>(0), static_cast<int64_t>(frameCount))));
+	if(result == CopyResult::overwritten)
+		mStatistics.RecordReadOverrun();
+#endif
+}
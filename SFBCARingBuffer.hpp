@@ -10,13 +10,20 @@
 
 #import <CoreAudioTypes/CoreAudioTypes.h>
 
+#import "SFBAtomicSnapshot.hpp"
 #import "SFBCAStreamBasicDescription.hpp"
+#import "SFBHardwareInterferenceSize.hpp"
+#import "SFBMirroredMemory.hpp"
+#import "SFBRingBufferStatistics.hpp"
 
 namespace SFB {
 
-/// A ring buffer supporting timestamped non-interleaved audio based on Apple's @c CARingBuffer.
+/// A ring buffer supporting timestamped interleaved and non-interleaved audio based on Apple's @c CARingBuffer.
 ///
-/// This class is thread safe when used from one reader thread and one writer thread (single producer, single consumer model).
+/// This class is thread safe when used from one writer thread and any number of reader threads (single producer, multiple
+/// consumer model). Reading never modifies the buffer, so readers don't block each other or the writer. A reader that
+/// falls more than the buffer's capacity behind the writer has its audio overwritten; this is detected after the copy
+/// and reported as an error. A @c Reader tracks an individual reader's position, lag, and overruns.
 class CARingBuffer
 {
 
@@ -46,13 +53,18 @@ public:
 #pragma mark Buffer management
 
 	/// Allocates space for audio data.
-	/// @note Only interleaved formats are supported.
+	///
+	/// A mirrored buffer maps each channel buffer twice in consecutive virtual memory so any read or write of up to the
+	/// buffer's capacity is a single contiguous span. The capacity of a mirrored buffer is rounded up so each channel
+	/// buffer is a multiple of @c MirroredRegionGranularity().
+	/// @note Interleaved and non-interleaved formats are supported.
 	/// @note This method is not thread safe.
 	/// @note Capacities from 2 to 2,147,483,648 (0x80000000) frames are supported
 	/// @param format The format of the audio that will be written to and read from this buffer.
 	/// @param capacityFrames The desired capacity, in frames
+	/// @param mirrored Whether to allocate mirrored memory
 	/// @return @c true on success, @c false on error
-	bool Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames) noexcept;
+	bool Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames, bool mirrored = false) noexcept;
 
 	/// Frees the resources used by this @c CARingBuffer
 	/// @note This method is not thread safe.
@@ -71,6 +83,12 @@ public:
 		return mFormat;
 	}
 
+	/// Returns @c true if this @c CARingBuffer uses mirrored memory
+	inline bool IsMirrored() const noexcept
+	{
+		return mIsMirrored;
+	}
+
 	/// Gets the time bounds of the audio contained in this @c CARingBuffer
 	/// @param startTime The starting sample time of audio contained in the buffer
 	/// @param endTime The end sample time of audio contained in the buffer
@@ -85,20 +103,204 @@ public:
 	/// gap effectively empties the buffer before storing the new data.
 	/// @note Negative time stamps are not supported
 	/// @note If @c timeStamp is less than the previous sample time the behavior is undefined
+	/// @note The layout of @c bufferList must match @c Format()
 	/// @param bufferList An @c AudioBufferList to receive the audio
 	/// @param frameCount The desired number of frames to read
 	/// @param timeStamp The starting sample time
-	/// @return @c true on success, @c false on error
-	bool Read(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, int64_t timeStamp) noexcept;
+	/// @return @c true on success, @c false on error or if the audio was overwritten during the read
+	bool Read(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, int64_t timeStamp) const noexcept;
 
 	/// Writes audio to the @c CARingBuffer
 	/// @note Negative time stamps are not supported
+	/// @note The layout of @c bufferList must match @c Format()
 	/// @param bufferList An @c AudioBufferList containing the audio to copy
 	/// @param frameCount The desired number of frames to write
 	/// @param timeStamp The starting sample time
 	/// @return @c true on success, @c false on error
 	bool Write(const AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, int64_t timeStamp) noexcept;
 
+
+	/// Reads interleaved audio from the @c CARingBuffer
+	///
+	/// If the buffer's format is non-interleaved the audio is interleaved during the copy. Frames outside the buffer's
+	/// time bounds are filled with silence.
+	/// @note Negative time stamps are not supported
+	/// @param buffer A buffer to receive @c frameCount frames of interleaved audio
+	/// @param frameCount The desired number of frames to read
+	/// @param timeStamp The starting sample time
+	/// @return @c true on success, @c false on error or if the audio was overwritten during the read
+	bool ReadInterleaved(void * const _Nonnull buffer, uint32_t frameCount, int64_t timeStamp) const noexcept;
+
+	/// Reads non-interleaved audio from the @c CARingBuffer
+	///
+	/// If the buffer's format is interleaved the audio is deinterleaved during the copy. Frames outside the buffer's
+	/// time bounds are filled with silence.
+	/// @note Negative time stamps are not supported
+	/// @param buffers An array of @c Format().mChannelsPerFrame buffers each receiving @c frameCount frames of audio
+	/// @param frameCount The desired number of frames to read
+	/// @param timeStamp The starting sample time
+	/// @return @c true on success, @c false on error or if the audio was overwritten during the read
+	bool ReadNonInterleaved(void * const _Nonnull * const _Nonnull buffers, uint32_t frameCount, int64_t timeStamp) const noexcept;
+
+	/// Writes interleaved audio to the @c CARingBuffer
+	///
+	/// If the buffer's format is non-interleaved the audio is deinterleaved during the copy.
+	/// @note Negative time stamps are not supported
+	/// @param buffer A buffer containing @c frameCount frames of interleaved audio
+	/// @param frameCount The desired number of frames to write
+	/// @param timeStamp The starting sample time
+	/// @return @c true on success, @c false on error
+	bool WriteInterleaved(const void * const _Nonnull buffer, uint32_t frameCount, int64_t timeStamp) noexcept;
+
+	/// Writes non-interleaved audio to the @c CARingBuffer
+	///
+	/// If the buffer's format is interleaved the audio is interleaved during the copy.
+	/// @note Negative time stamps are not supported
+	/// @param buffers An array of @c Format().mChannelsPerFrame buffers each containing @c frameCount frames of audio
+	/// @param frameCount The desired number of frames to write
+	/// @param timeStamp The starting sample time
+	/// @return @c true on success, @c false on error
+	bool WriteNonInterleaved(const void * const _Nonnull * const _Nonnull buffers, uint32_t frameCount, int64_t timeStamp) noexcept;
+
+#pragma mark Resampling
+
+	/// Interpolation methods used when reading audio at fractional sample times
+	enum class InterpolationQuality {
+		/// Linear interpolation between adjacent frames
+		linear,
+		/// Interpolation using a 32-tap Kaiser-windowed sinc filter
+		windowedSinc,
+	};
+
+	/// Reads audio from the @c CARingBuffer starting at a fractional sample time and progressing at @c rate source frames
+	/// per output frame
+	///
+	/// This allows drift between the clocks of the writer and reader to be compensated during the copy out of the buffer.
+	/// Frames outside the buffer's time bounds are treated as silence.
+	/// @note Only native-endian @c float and @c double formats are supported
+	/// @note Windowed sinc interpolation requires 15 frames before and 16 frames after each fractional sample time and is
+	/// intended for rates near @c 1
+	/// @note The layout of @c bufferList must match @c Format()
+	/// @param bufferList An @c AudioBufferList to receive the audio
+	/// @param frameCount The desired number of frames to read
+	/// @param timeStamp The starting sample time, which may be fractional
+	/// @param rate The number of source frames per output frame
+	/// @param quality The interpolation method to use
+	/// @return @c true on success, @c false on error or if the audio was overwritten during the read
+	bool ReadResampled(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, double timeStamp, double rate, InterpolationQuality quality = InterpolationQuality::linear) const noexcept;
+
+#pragma mark Readers
+
+	/// The result of a @c Reader operation
+	enum class ReadResult {
+		/// The requested audio was read
+		success,
+		/// The reader fell behind the writer and skipped to the oldest audio in the buffer before reading
+		overrun,
+		/// Less audio than requested is available; nothing was read
+		insufficientData,
+		/// An error occurred
+		error,
+	};
+
+	/// A reader's position in a @c CARingBuffer
+	///
+	/// Each reader thread should use its own @c Reader. Any number of readers may be used concurrently with each other
+	/// and with the writer.
+	class Reader
+	{
+
+	public:
+
+		/// Creates a new @c Reader positioned at the current end of @c ringBuffer
+		/// @param ringBuffer The buffer to read
+		explicit Reader(const CARingBuffer& ringBuffer) noexcept;
+
+		/// Returns the sample time of the next frame to be read
+		inline int64_t SampleTime() const noexcept
+		{
+			return mSampleTime;
+		}
+
+		/// Sets the sample time of the next frame to be read
+		inline void Seek(int64_t sampleTime) noexcept
+		{
+			mSampleTime = sampleTime;
+		}
+
+		/// Returns the number of frames written but not yet read by this reader, which may exceed the buffer's capacity
+		/// @note Returns @c 0 if the time bounds could not be determined
+		int64_t Lag() const noexcept;
+
+		/// Returns the number of times this reader fell behind the writer
+		inline uint64_t OverrunCount() const noexcept
+		{
+			return mOverrunCount;
+		}
+
+		/// Returns the number of frames skipped because this reader fell behind the writer
+		inline uint64_t FramesDropped() const noexcept
+		{
+			return mFramesDropped;
+		}
+
+		/// Reads the next @c frameCount frames and advances the reader.
+		/// @note The layout of @c bufferList must match @c Format()
+		/// @param bufferList An @c AudioBufferList to receive the audio
+		/// @param frameCount The desired number of frames to read
+		/// @return The result of the operation
+		ReadResult Read(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount) noexcept;
+
+		/// Reads the next @c frameCount frames as interleaved audio and advances the reader.
+		/// @param buffer A buffer to receive @c frameCount frames of interleaved audio
+		/// @param frameCount The desired number of frames to read
+		/// @return The result of the operation
+		ReadResult ReadInterleaved(void * const _Nonnull buffer, uint32_t frameCount) noexcept;
+
+		/// Reads the next @c frameCount frames as non-interleaved audio and advances the reader.
+		/// @param buffers An array of @c Format().mChannelsPerFrame buffers each receiving @c frameCount frames of audio
+		/// @param frameCount The desired number of frames to read
+		/// @return The result of the operation
+		ReadResult ReadNonInterleaved(void * const _Nonnull * const _Nonnull buffers, uint32_t frameCount) noexcept;
+
+	private:
+
+		/// Positions the reader, calls @c read, and advances the reader
+		template <typename F>
+		ReadResult PerformRead(uint32_t frameCount, F&& read) noexcept;
+
+		/// The buffer being read
+		const CARingBuffer& mRingBuffer;
+		/// The sample time of the next frame to read
+		int64_t mSampleTime;
+		/// The number of overruns
+		uint64_t mOverrunCount;
+		/// The number of frames dropped due to overruns
+		uint64_t mFramesDropped;
+
+	};
+
+#pragma mark Statistics
+
+	/// Returns the statistics for this @c CARingBuffer in frames
+	/// @note Statistics are collected only when @c SFB_RING_BUFFER_STATISTICS is nonzero; otherwise all values are zero
+	inline RingBufferStatistics GetStatistics() const noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		return mStatistics.Snapshot();
+#else
+		return {};
+#endif
+	}
+
+	/// Discards the statistics for this @c CARingBuffer
+	inline void ResetStatistics() noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		mStatistics.Reset();
+#endif
+	}
+
 protected:
 
 	/// Returns the byte offset of @c frameNumber
@@ -107,21 +309,62 @@ protected:
 		return (static_cast<uint64_t>(frameNumber) & mCapacityFramesMask) * mFormat.mBytesPerFrame;
 	}
 
+	/// The outcome of copying audio from the buffer
+	enum class CopyResult {
+		/// The audio was copied
+		success,
+		/// The writer overwrote some of the audio during the copy
+		overwritten,
+		/// An error occurred
+		error,
+	};
+
+	/// Copies audio to @c bufferList without recording statistics
+	/// @param startTime Receives the buffer's starting sample time used for the copy
+	/// @param endTime Receives the buffer's ending sample time used for the copy
+	CopyResult CopyToBufferList(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, int64_t startRead, int64_t& startTime, int64_t& endTime) const noexcept;
+
+	/// Copies interleaved audio to @c buffer without recording statistics
+	/// @param startTime Receives the buffer's starting sample time used for the copy
+	/// @param endTime Receives the buffer's ending sample time used for the copy
+	CopyResult CopyInterleaved(void * const _Nonnull buffer, uint32_t frameCount, int64_t startRead, int64_t& startTime, int64_t& endTime) const noexcept;
+
+	/// Copies non-interleaved audio to @c buffers without recording statistics
+	/// @param startTime Receives the buffer's starting sample time used for the copy
+	/// @param endTime Receives the buffer's ending sample time used for the copy
+	CopyResult CopyNonInterleaved(void * const _Nonnull * const _Nonnull buffers, uint32_t frameCount, int64_t startRead, int64_t& startTime, int64_t& endTime) const noexcept;
+
+	/// Records the statistics for a read of @c frameCount frames at @c startRead from the buffer spanning [@c startTime, @c endTime)
+	void RecordRead(int64_t startRead, uint32_t frameCount, int64_t startTime, int64_t endTime, CopyResult result) const noexcept;
+
 	/// Constrains @c startRead and @c endRead to valid timestamps in the buffer
-	bool ClampTimesToBounds(int64_t& startRead, int64_t& endRead) const noexcept;
+	/// @param startTime Receives the buffer's starting sample time
+	/// @param endTime Receives the buffer's ending sample time
+	bool ClampTimesToBounds(int64_t& startRead, int64_t& endRead, int64_t& startTime, int64_t& endTime) const noexcept;
+
+	/// Interpolates @c frameCount frames of @c T from the buffer into @c bufferList
+	template <typename T>
+	void Resample(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount, double timeStamp, double rate, InterpolationQuality quality, int64_t startTime, int64_t endTime) const noexcept;
+
+	/// Returns @c true if [@c startRead, @c endRead) is still within the buffer's time bounds after a copy
+	bool RangeIsValid(int64_t startRead, int64_t endRead) const noexcept;
+
+	/// Updates the time bounds for a write of [@c startWrite, @c endWrite) and zeroes any skipped frames
+	/// @note This should only be called from @c Write()
+	void PrepareForWrite(int64_t startWrite, int64_t endWrite) noexcept;
 
 	/// Returns the buffer's starting sample time
 	/// @note This should only be called from @c Write()
 	inline int64_t StartTime() const noexcept
 	{
-		return mTimeBoundsQueue[mTimeBoundsQueueCounter.load(std::memory_order_acquire) & sTimeBoundsQueueMask].mStartTime;
+		return mTimeBounds.WriterValue().mStartTime;
 	}
 
 	/// Returns the buffer's ending sample time
 	/// @note This should only be called from @c Write()
 	inline int64_t EndTime() const noexcept
 	{
-		return mTimeBoundsQueue[mTimeBoundsQueueCounter.load(std::memory_order_acquire) & sTimeBoundsQueueMask].mEndTime;
+		return mTimeBounds.WriterValue().mEndTime;
 	}
 
 	/// Sets the buffer's start and end sample times
@@ -141,6 +384,8 @@ private:
 	/// Mask used to wrap read and write locations
 	/// @note Equal to @c mCapacityFrames-1
 	uint32_t mCapacityFramesMask;
+	/// Whether the channel buffers are mirrored
+	bool mIsMirrored;
 
 	/// A range of valid sample times in the buffer
 	struct TimeBounds {
@@ -148,20 +393,15 @@ private:
 		int64_t mStartTime;
 		/// The ending sample time
 		int64_t mEndTime;
-		/// The value of @c mTimeBoundsQueueCounter when the struct was modified
-		std::atomic_uint64_t mUpdateCounter;
 	};
 
-	/// The number of elements in @c mTimeBoundsQueue
-	static const uint32_t sTimeBoundsQueueSize = 32;
-	/// Mask value used to wrap time bounds counters
-	/// @note Equal to @c sTimeBoundsQueueSize-1
-	static const uint32_t sTimeBoundsQueueMask = sTimeBoundsQueueSize - 1;
+	/// The buffer's time bounds, updated by the writer and read by any thread
+	AtomicSnapshot<TimeBounds> mTimeBounds;
 
-	/// Array of @c TimeBounds structs
-	TimeBounds mTimeBoundsQueue[sTimeBoundsQueueSize];
-	/// Monotonically increasing counter incremented when the buffer's time bounds changes
-	std::atomic_uint64_t mTimeBoundsQueueCounter;
+#if SFB_RING_BUFFER_STATISTICS
+	/// The buffer's statistics
+	alignas(DestructiveInterferenceSize) mutable RingBufferStatisticsCollector mStatistics;
+#endif
 
 };
 
@@ -0,0 +1,193 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstring>
+#import <stdexcept>
+#import <utility>
+
+#import <Accelerate/Accelerate.h>
+
+#import "SFBChannelMixer.hpp"
+
+namespace {
+
+/// Returns @c true if @c format contains @c channelCount channels of non-interleaved native-endian 32-bit float audio
+inline bool IsNonInterleavedFloat32(const SFB::CAStreamBasicDescription& format, UInt32 channelCount) noexcept
+{
+	return format.IsFloat() && format.IsNativeEndian() && format.mBitsPerChannel == 32 && format.InterleavedChannelCount() == 1 && format.ChannelStreamCount() == channelCount;
+}
+
+}
+
+SFB::ChannelMixer::ChannelMixer(const CAChannelLayout& sourceLayout, const CAChannelLayout& destinationLayout)
+{
+	if(!sourceLayout.MatrixMixMapToLayout(destinationLayout, mCoefficients))
+		throw std::invalid_argument("Unable to create mix map for channel layouts");
+
+	mSourceChannelCount = static_cast<UInt32>(sourceLayout.ChannelCount());
+	mDestinationChannelCount = static_cast<UInt32>(destinationLayout.ChannelCount());
+	PrepareTerms();
+}
+
+SFB::ChannelMixer::ChannelMixer(UInt32 sourceChannelCount, UInt32 destinationChannelCount, std::vector<Float32> coefficients)
+{
+	if(sourceChannelCount == 0 || destinationChannelCount == 0 || coefficients.size() != static_cast<size_t>(sourceChannelCount) * destinationChannelCount)
+		throw std::invalid_argument("Invalid mixing coefficients");
+
+	mCoefficients = std::move(coefficients);
+	mSourceChannelCount = sourceChannelCount;
+	mDestinationChannelCount = destinationChannelCount;
+	PrepareTerms();
+}
+
+#pragma mark Mixing
+
+bool SFB::ChannelMixer::Mix(const AudioBufferList& source, AudioBufferList& destination, UInt32 frameCount) const noexcept
+{
+	if(mCoefficients.empty() || source.mNumberBuffers != mSourceChannelCount || destination.mNumberBuffers != mDestinationChannelCount)
+		return false;
+
+	auto byteSize = frameCount * static_cast<UInt32>(sizeof(float));
+	for(UInt32 i = 0; i < source.mNumberBuffers; ++i) {
+		if(!source.mBuffers[i].mData || source.mBuffers[i].mDataByteSize < byteSize)
+			return false;
+	}
+
+	// Permutations into empty buffers only need the buffer pointers swapped
+	if(mIsPermutation && std::all_of(destination.mBuffers, destination.mBuffers + destination.mNumberBuffers, [](const AudioBuffer& buffer) { return buffer.mData == nullptr; })) {
+		for(UInt32 i = 0; i < destination.mNumberBuffers; ++i)
+			destination.mBuffers[i] = { 1, byteSize, source.mBuffers[mTerms[mTermOffsets[i]].mSourceChannel].mData };
+		return true;
+	}
+
+	for(UInt32 i = 0; i < destination.mNumberBuffers; ++i) {
+		if(!destination.mBuffers[i].mData || destination.mBuffers[i].mDataByteSize < byteSize)
+			return false;
+	}
+
+	const float *sourceChannels [mSourceChannelCount];
+	for(UInt32 i = 0; i < mSourceChannelCount; ++i)
+		sourceChannels[i] = static_cast<const float *>(source.mBuffers[i].mData);
+
+	float *destinationChannels [mDestinationChannelCount];
+	for(UInt32 i = 0; i < mDestinationChannelCount; ++i)
+		destinationChannels[i] = static_cast<float *>(destination.mBuffers[i].mData);
+
+	MixChannels(sourceChannels, destinationChannels, frameCount);
+
+	for(UInt32 i = 0; i < destination.mNumberBuffers; ++i)
+		destination.mBuffers[i].mDataByteSize = byteSize;
+
+	return true;
+}
+
+bool SFB::ChannelMixer::Mix(const CABufferList& source, CABufferList& destination) const noexcept
+{
+	if(!source || !destination || !IsNonInterleavedFloat32(source.Format(), mSourceChannelCount) || !IsNonInterleavedFloat32(destination.Format(), mDestinationChannelCount))
+		return false;
+
+	auto frameLength = source.FrameLength();
+	if(frameLength > destination.FrameCapacity())
+		return false;
+
+	const float *sourceChannels [mSourceChannelCount];
+	for(UInt32 i = 0; i < mSourceChannelCount; ++i)
+		sourceChannels[i] = static_cast<const float *>(source->mBuffers[i].mData);
+
+	float *destinationChannels [mDestinationChannelCount];
+	for(UInt32 i = 0; i < mDestinationChannelCount; ++i)
+		destinationChannels[i] = static_cast<float *>(destination->mBuffers[i].mData);
+
+	MixChannels(sourceChannels, destinationChannels, frameLength);
+
+	return destination.SetFrameLength(frameLength);
+}
+
+uint32_t SFB::ChannelMixer::Read(AudioRingBuffer& ringBuffer, AudioBufferList& destination, uint32_t frameCount) const noexcept
+{
+	if(mCoefficients.empty() || frameCount == 0 || destination.mNumberBuffers != mDestinationChannelCount || !IsNonInterleavedFloat32(ringBuffer.Format(), mSourceChannelCount))
+		return 0;
+
+	auto byteSize = frameCount * static_cast<UInt32>(sizeof(float));
+	for(UInt32 i = 0; i < destination.mNumberBuffers; ++i) {
+		if(!destination.mBuffers[i].mData || destination.mBuffers[i].mDataByteSize < byteSize)
+			return 0;
+	}
+
+	const auto [front, back] = ringBuffer.ReadVector();
+
+	const float *sourceChannels [mSourceChannelCount];
+	float *destinationChannels [mDestinationChannelCount];
+
+	// Mix each readable region directly from the ring buffer's storage
+	uint32_t framesRead = 0;
+	for(const auto& region : { front, back }) {
+		auto framesToMix = std::min(region.mFrameCount, frameCount - framesRead);
+		if(framesToMix == 0)
+			continue;
+
+		for(UInt32 i = 0; i < mSourceChannelCount; ++i)
+			sourceChannels[i] = static_cast<const float *>(region.Channel(i));
+		for(UInt32 i = 0; i < mDestinationChannelCount; ++i)
+			destinationChannels[i] = static_cast<float *>(destination.mBuffers[i].mData) + framesRead;
+
+		MixChannels(sourceChannels, destinationChannels, framesToMix);
+		framesRead += framesToMix;
+	}
+
+	ringBuffer.AdvanceReadPosition(framesRead);
+
+	for(UInt32 i = 0; i < destination.mNumberBuffers; ++i)
+		destination.mBuffers[i].mDataByteSize = framesRead * static_cast<UInt32>(sizeof(float));
+
+	return framesRead;
+}
+
+#pragma mark Internals
+
+void SFB::ChannelMixer::PrepareTerms()
+{
+	mTerms.clear();
+	mTermOffsets.clear();
+	mTermOffsets.reserve(mDestinationChannelCount + 1);
+
+	mIsPermutation = true;
+	for(UInt32 destinationChannel = 0; destinationChannel < mDestinationChannelCount; ++destinationChannel) {
+		auto firstTerm = mTerms.size();
+		mTermOffsets.push_back(static_cast<UInt32>(firstTerm));
+		for(UInt32 sourceChannel = 0; sourceChannel < mSourceChannelCount; ++sourceChannel) {
+			auto coefficient = Coefficient(sourceChannel, destinationChannel);
+			if(coefficient != 0)
+				mTerms.push_back({ sourceChannel, coefficient });
+		}
+		if(mTerms.size() - firstTerm != 1 || mTerms[firstTerm].mCoefficient != 1)
+			mIsPermutation = false;
+	}
+	mTermOffsets.push_back(static_cast<UInt32>(mTerms.size()));
+}
+
+void SFB::ChannelMixer::MixChannels(const float * const *source, float * const *destination, UInt32 frameCount) const noexcept
+{
+	for(UInt32 destinationChannel = 0; destinationChannel < mDestinationChannelCount; ++destinationChannel) {
+		auto output = destination[destinationChannel];
+		auto first = mTerms.data() + mTermOffsets[destinationChannel];
+		auto last = mTerms.data() + mTermOffsets[destinationChannel + 1];
+
+		if(first == last) {
+			vDSP_vclr(output, 1, frameCount);
+			continue;
+		}
+
+		if(first->mCoefficient == 1)
+			std::memcpy(output, source[first->mSourceChannel], frameCount * sizeof(float));
+		else
+			vDSP_vsmul(source[first->mSourceChannel], 1, &first->mCoefficient, output, 1, frameCount);
+
+		for(auto term = first + 1; term != last; ++term)
+			vDSP_vsma(source[term->mSourceChannel], 1, &term->mCoefficient, output, 1, output, 1, frameCount);
+	}
+}
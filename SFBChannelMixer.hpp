@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <vector>
+
+#import <CoreAudioTypes/CoreAudioTypes.h>
+
+#import "SFBAudioRingBuffer.hpp"
+#import "SFBCABufferList.hpp"
+#import "SFBCAChannelLayout.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A matrix mixer converting non-interleaved 32-bit float audio between channel layouts
+///
+/// The mixing coefficients are computed once using @c kAudioFormatProperty_MatrixMixMap and applied using vDSP.
+/// When every destination channel is an unscaled copy of a single source channel the mix is a permutation and
+/// may be performed by pointing the destination buffers at the source buffers instead of copying audio.
+///
+/// @code
+/// SFB::ChannelMixer mixer(SFB::CAChannelLayout(kAudioChannelLayoutTag_MPEG_5_1_A), SFB::CAChannelLayout::Stereo);
+/// // On the render thread
+/// mixer.Read(ringBuffer, *ioData, inNumberFrames);
+/// @endcode
+///
+/// @note The mixing methods neither allocate memory nor block and may be called from a real-time thread
+class ChannelMixer
+{
+
+public:
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c ChannelMixer
+	ChannelMixer() noexcept = default;
+
+	/// Copy constructor
+	ChannelMixer(const ChannelMixer& rhs) = default;
+
+	/// Assignment operator
+	ChannelMixer& operator=(const ChannelMixer& rhs) = default;
+
+	/// Destructor
+	~ChannelMixer() = default;
+
+	/// Move constructor
+	ChannelMixer(ChannelMixer&& rhs) noexcept = default;
+
+	/// Move assignment operator
+	ChannelMixer& operator=(ChannelMixer&& rhs) noexcept = default;
+
+	/// Creates a @c ChannelMixer converting audio from @c sourceLayout to @c destinationLayout
+	/// @throws @c std::invalid_argument if no mix map exists between @c sourceLayout and @c destinationLayout
+	/// @throws @c std::bad_alloc
+	ChannelMixer(const CAChannelLayout& sourceLayout, const CAChannelLayout& destinationLayout);
+
+	/// Creates a @c ChannelMixer using the specified mixing coefficients
+	/// @param sourceChannelCount The number of source channels
+	/// @param destinationChannelCount The number of destination channels
+	/// @param coefficients The mixing coefficients, with the coefficient for source channel @c s and destination channel
+	/// @c d at index @c s*destinationChannelCount+d
+	/// @throws @c std::invalid_argument if a channel count is zero or the number of coefficients is incorrect
+	/// @throws @c std::bad_alloc
+	ChannelMixer(UInt32 sourceChannelCount, UInt32 destinationChannelCount, std::vector<Float32> coefficients);
+
+#pragma mark Mixer Information
+
+	/// Returns @c true if this @c ChannelMixer is not empty
+	inline explicit operator bool() const noexcept
+	{
+		return !mCoefficients.empty();
+	}
+
+	/// Returns @c true if this @c ChannelMixer is empty
+	inline bool operator!() const noexcept
+	{
+		return !operator bool();
+	}
+
+	/// Returns the number of source channels
+	inline UInt32 SourceChannelCount() const noexcept
+	{
+		return mSourceChannelCount;
+	}
+
+	/// Returns the number of destination channels
+	inline UInt32 DestinationChannelCount() const noexcept
+	{
+		return mDestinationChannelCount;
+	}
+
+	/// Returns the mixing coefficient for @c sourceChannel in @c destinationChannel
+	/// @note @c sourceChannel must be less than @c SourceChannelCount() and @c destinationChannel must be less than @c DestinationChannelCount()
+	inline Float32 Coefficient(UInt32 sourceChannel, UInt32 destinationChannel) const noexcept
+	{
+		return mCoefficients[sourceChannel * mDestinationChannelCount + destinationChannel];
+	}
+
+	/// Returns the mixing coefficients
+	inline const std::vector<Float32>& Coefficients() const noexcept
+	{
+		return mCoefficients;
+	}
+
+	/// Returns @c true if every destination channel is an unscaled copy of a single source channel
+	inline bool IsPermutation() const noexcept
+	{
+		return mIsPermutation;
+	}
+
+#pragma mark Mixing
+
+	/// Mixes @c frameCount frames of audio from @c source to @c destination
+	///
+	/// If the mix is a permutation and the buffers in @c destination have @c nullptr data the buffers are pointed at
+	/// the corresponding buffers in @c source instead.
+	/// @note @c source and @c destination must contain non-interleaved 32-bit float audio and must not overlap
+	/// @param source A buffer list with @c SourceChannelCount() buffers of at least @c frameCount frames
+	/// @param destination A buffer list with @c DestinationChannelCount() buffers of at least @c frameCount frames
+	/// @param frameCount The number of frames to mix
+	/// @return @c true on success, @c false if the buffer counts or sizes don't match the mixer
+	bool Mix(const AudioBufferList& source, AudioBufferList& destination, UInt32 frameCount) const noexcept;
+
+	/// Mixes the audio in @c source to @c destination and sets the frame length of @c destination
+	/// @note @c source and @c destination must contain non-interleaved 32-bit float audio
+	/// @param source A buffer list with @c SourceChannelCount() channels
+	/// @param destination A buffer list with @c DestinationChannelCount() channels and a capacity of at least @c source.FrameLength()
+	/// @return @c true on success, @c false if the formats or capacity don't match the mixer
+	bool Mix(const CABufferList& source, CABufferList& destination) const noexcept;
+
+	/// Reads up to @c frameCount frames of audio from @c ringBuffer and mixes them directly into @c destination
+	/// @note The format of @c ringBuffer must be non-interleaved 32-bit float audio with @c SourceChannelCount() channels
+	/// @note This method must only be called from the ring buffer's reader
+	/// @param ringBuffer The ring buffer to read from
+	/// @param destination A buffer list with @c DestinationChannelCount() buffers of at least @c frameCount frames
+	/// @param frameCount The desired number of frames
+	/// @return The number of frames actually read and mixed
+	uint32_t Read(AudioRingBuffer& ringBuffer, AudioBufferList& destination, uint32_t frameCount) const noexcept;
+
+private:
+
+	/// A source channel contributing to a destination channel
+	struct Term {
+		/// The source channel
+		UInt32 mSourceChannel;
+		/// The mixing coefficient
+		Float32 mCoefficient;
+	};
+
+	/// Derives @c mTerms, @c mTermOffsets, and @c mIsPermutation from @c mCoefficients
+	/// @throws @c std::bad_alloc
+	void PrepareTerms();
+
+	/// Mixes @c frameCount frames from @c source to @c destination
+	/// @param source An array of @c mSourceChannelCount channel buffers
+	/// @param destination An array of @c mDestinationChannelCount channel buffers
+	/// @param frameCount The number of frames to mix
+	void MixChannels(const float * const _Nonnull * const _Nonnull source, float * const _Nonnull * const _Nonnull destination, UInt32 frameCount) const noexcept;
+
+	/// The mixing coefficients
+	std::vector<Float32> mCoefficients;
+	/// The nonzero terms of each destination channel
+	std::vector<Term> mTerms;
+	/// The index of the first term of each destination channel, followed by the total number of terms
+	std::vector<UInt32> mTermOffsets;
+	/// The number of source channels
+	UInt32 mSourceChannelCount = 0;
+	/// The number of destination channels
+	UInt32 mDestinationChannelCount = 0;
+	/// Whether the mix is a permutation
+	bool mIsPermutation = false;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
@@ -118,6 +118,42 @@ public:
 	//	kAudioDevicePropertyClockDevice                     = 'apcd',
 	//	kAudioDevicePropertyIOThreadOSWorkgroup				= 'oswg'
 
+#pragma mark IO Operations
+
+	/// Creates an IOProc ID for @c inProc
+	/// @throws @c std::system_error
+	AudioDeviceIOProcID CreateIOProcID(AudioDeviceIOProc _Nonnull inProc, void * _Nullable inClientData)
+	{
+		AudioDeviceIOProcID ioProcID = nullptr;
+		auto result = AudioDeviceCreateIOProcID(mObjectID, inProc, inClientData, &ioProcID);
+		ThrowIfCAAudioObjectError(result, "AudioDeviceCreateIOProcID");
+		return ioProcID;
+	}
+
+	/// Destroys @c inIOProcID
+	/// @throws @c std::system_error
+	void DestroyIOProcID(AudioDeviceIOProcID _Nonnull inIOProcID)
+	{
+		auto result = AudioDeviceDestroyIOProcID(mObjectID, inIOProcID);
+		ThrowIfCAAudioObjectError(result, "AudioDeviceDestroyIOProcID");
+	}
+
+	/// Starts IO for @c inIOProcID, or for the device if @c inIOProcID is @c nullptr
+	/// @throws @c std::system_error
+	void Start(AudioDeviceIOProcID _Nullable inIOProcID)
+	{
+		auto result = AudioDeviceStart(mObjectID, inIOProcID);
+		ThrowIfCAAudioObjectError(result, "AudioDeviceStart");
+	}
+
+	/// Stops IO for @c inIOProcID, or for the device if @c inIOProcID is @c nullptr
+	/// @throws @c std::system_error
+	void Stop(AudioDeviceIOProcID _Nullable inIOProcID)
+	{
+		auto result = AudioDeviceStop(mObjectID, inIOProcID);
+		ThrowIfCAAudioObjectError(result, "AudioDeviceStop");
+	}
+
 };
 
 } // namespace SFB
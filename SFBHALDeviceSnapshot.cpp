@@ -0,0 +1,207 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+
+#import "SFBHALDeviceSnapshot.hpp"
+#import "SFBCAException.hpp"
+#import "SFBCAPropertyAddress.hpp"
+
+namespace {
+
+/// Reads a fixed-size property value
+/// @return @c true on success, @c false otherwise
+template <typename T>
+bool GetPropertyData(AudioObjectID objectID, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope, T& value) noexcept
+{
+	SFB::CAPropertyAddress address(selector, scope);
+	UInt32 size = sizeof(T);
+	return AudioObjectGetPropertyData(objectID, &address, 0, nullptr, &size, &value) == noErr && size == sizeof(T);
+}
+
+/// Reads a fixed-size property value
+/// @return The property value or @c defaultValue on failure
+template <typename T>
+T GetProperty(AudioObjectID objectID, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope = kAudioObjectPropertyScopeGlobal, T defaultValue = T()) noexcept
+{
+	T value;
+	return GetPropertyData(objectID, selector, scope, value) ? value : defaultValue;
+}
+
+/// Reads a list of object IDs into @c objectIDs, reusing its storage
+/// @return The status of the operation
+OSStatus GetObjectIDs(AudioObjectID objectID, AudioObjectPropertySelector selector, std::vector<AudioObjectID>& objectIDs)
+{
+	SFB::CAPropertyAddress address(selector);
+
+	UInt32 size = 0;
+	auto result = AudioObjectGetPropertyDataSize(objectID, &address, 0, nullptr, &size);
+	if(result != noErr)
+		return result;
+
+	objectIDs.resize(size / sizeof(AudioObjectID));
+	if(objectIDs.empty())
+		return noErr;
+
+	result = AudioObjectGetPropertyData(objectID, &address, 0, nullptr, &size, objectIDs.data());
+	if(result == noErr)
+		objectIDs.resize(size / sizeof(AudioObjectID));
+	return result;
+}
+
+/// Reads a @c CFStringRef property value
+/// @return The property value or an empty @c CFString on failure
+SFB::CFString GetStringProperty(AudioObjectID objectID, AudioObjectPropertySelector selector) noexcept
+{
+	CFStringRef value = nullptr;
+	if(!GetPropertyData(objectID, selector, kAudioObjectPropertyScopeGlobal, value))
+		return {};
+	return SFB::CFString(value);
+}
+
+}
+
+SFB::HALDeviceSnapshot SFB::HALDeviceSnapshot::Capture()
+{
+	HALDeviceSnapshot snapshot;
+
+	std::vector<AudioObjectID> deviceIDs;
+	auto result = GetObjectIDs(kAudioObjectSystemObject, kAudioHardwarePropertyDevices, deviceIDs);
+	ThrowIfCAAudioObjectError(result, "AudioObjectGetPropertyData");
+
+	std::sort(deviceIDs.begin(), deviceIDs.end());
+
+	snapshot.mDevices.reserve(deviceIDs.size());
+	// Most devices have one stream per direction
+	snapshot.mStreams.reserve(2 * deviceIDs.size());
+
+	std::vector<AudioObjectID> streamIDs;
+	for(auto deviceID : deviceIDs) {
+		Device device{};
+		device.mDeviceID = deviceID;
+
+		// A device without a UID has been removed
+		device.mUID = GetStringProperty(deviceID, kAudioDevicePropertyDeviceUID);
+		if(!device.mUID)
+			continue;
+
+		// The global scope returns the streams for both directions at once
+		if(GetObjectIDs(deviceID, kAudioDevicePropertyStreams, streamIDs) != noErr)
+			continue;
+
+		device.mName = GetStringProperty(deviceID, kAudioObjectPropertyName);
+		device.mTransportType = GetProperty<UInt32>(deviceID, kAudioDevicePropertyTransportType);
+		device.mNominalSampleRate = GetProperty<Float64>(deviceID, kAudioDevicePropertyNominalSampleRate);
+		device.mBufferFrameSize = GetProperty<UInt32>(deviceID, kAudioDevicePropertyBufferFrameSize);
+		device.mInputLatency = GetProperty<UInt32>(deviceID, kAudioDevicePropertyLatency, kAudioObjectPropertyScopeInput);
+		device.mOutputLatency = GetProperty<UInt32>(deviceID, kAudioDevicePropertyLatency, kAudioObjectPropertyScopeOutput);
+		device.mInputSafetyOffset = GetProperty<UInt32>(deviceID, kAudioDevicePropertySafetyOffset, kAudioObjectPropertyScopeInput);
+		device.mOutputSafetyOffset = GetProperty<UInt32>(deviceID, kAudioDevicePropertySafetyOffset, kAudioObjectPropertyScopeOutput);
+
+		device.mFirstStream = snapshot.mStreams.size();
+		for(auto streamID : streamIDs) {
+			Stream stream{};
+			stream.mStreamID = streamID;
+			stream.mIsInput = GetProperty<UInt32>(streamID, kAudioStreamPropertyDirection) != 0;
+			stream.mIsActive = GetProperty<UInt32>(streamID, kAudioStreamPropertyIsActive, kAudioObjectPropertyScopeGlobal, 1) != 0;
+			stream.mStartingChannel = GetProperty<UInt32>(streamID, kAudioStreamPropertyStartingChannel);
+			stream.mLatency = GetProperty<UInt32>(streamID, kAudioStreamPropertyLatency);
+			stream.mVirtualFormat = GetProperty<AudioStreamBasicDescription>(streamID, kAudioStreamPropertyVirtualFormat);
+			stream.mPhysicalFormat = GetProperty<AudioStreamBasicDescription>(streamID, kAudioStreamPropertyPhysicalFormat);
+
+			if(stream.mIsInput)
+				device.mInputChannelCount += stream.mVirtualFormat.mChannelsPerFrame;
+			else
+				device.mOutputChannelCount += stream.mVirtualFormat.mChannelsPerFrame;
+
+			snapshot.mStreams.push_back(stream);
+		}
+		device.mStreamCount = snapshot.mStreams.size() - device.mFirstStream;
+
+		snapshot.mDevices.push_back(std::move(device));
+	}
+
+	snapshot.mDefaultInputDeviceID = GetProperty<AudioObjectID>(kAudioObjectSystemObject, kAudioHardwarePropertyDefaultInputDevice);
+	snapshot.mDefaultOutputDeviceID = GetProperty<AudioObjectID>(kAudioObjectSystemObject, kAudioHardwarePropertyDefaultOutputDevice);
+	snapshot.mDefaultSystemOutputDeviceID = GetProperty<AudioObjectID>(kAudioObjectSystemObject, kAudioHardwarePropertyDefaultSystemOutputDevice);
+
+	return snapshot;
+}
+
+#pragma mark Creation and Destruction
+
+SFB::HALDeviceSnapshot::HALDeviceSnapshot() noexcept
+: mDefaultInputDeviceID(kAudioObjectUnknown), mDefaultOutputDeviceID(kAudioObjectUnknown), mDefaultSystemOutputDeviceID(kAudioObjectUnknown)
+{}
+
+#pragma mark Snapshot Contents
+
+const SFB::HALDeviceSnapshot::Device * SFB::HALDeviceSnapshot::DeviceWithID(AudioObjectID deviceID) const noexcept
+{
+	auto iter = std::lower_bound(mDevices.cbegin(), mDevices.cend(), deviceID, [](const Device& device, AudioObjectID value) {
+		return device.mDeviceID < value;
+	});
+	if(iter == mDevices.cend() || iter->mDeviceID != deviceID)
+		return nullptr;
+	return &*iter;
+}
+
+const SFB::HALDeviceSnapshot::Device * SFB::HALDeviceSnapshot::DeviceWithUID(CFStringRef uid) const noexcept
+{
+	auto iter = std::find_if(mDevices.cbegin(), mDevices.cend(), [uid](const Device& device) {
+		return CFEqual(device.mUID, uid);
+	});
+	if(iter == mDevices.cend())
+		return nullptr;
+	return &*iter;
+}
+
+#pragma mark Comparison
+
+bool SFB::HALDeviceSnapshot::Stream::operator==(const Stream& rhs) const noexcept
+{
+	return mStreamID == rhs.mStreamID && mIsInput == rhs.mIsInput && mIsActive == rhs.mIsActive && mStartingChannel == rhs.mStartingChannel && mLatency == rhs.mLatency && mVirtualFormat == rhs.mVirtualFormat && mPhysicalFormat == rhs.mPhysicalFormat;
+}
+
+bool SFB::HALDeviceSnapshot::Device::operator==(const Device& rhs) const noexcept
+{
+	// Scalars are compared first to avoid calls to CFEqual()
+	return mDeviceID == rhs.mDeviceID && mTransportType == rhs.mTransportType && mNominalSampleRate == rhs.mNominalSampleRate && mBufferFrameSize == rhs.mBufferFrameSize && mInputLatency == rhs.mInputLatency && mOutputLatency == rhs.mOutputLatency && mInputSafetyOffset == rhs.mInputSafetyOffset && mOutputSafetyOffset == rhs.mOutputSafetyOffset && mInputChannelCount == rhs.mInputChannelCount && mOutputChannelCount == rhs.mOutputChannelCount && mStreamCount == rhs.mStreamCount && mUID == rhs.mUID && mName == rhs.mName;
+}
+
+SFB::HALDeviceSnapshot::Differences SFB::HALDeviceSnapshot::DifferencesFrom(const HALDeviceSnapshot& previous) const
+{
+	Differences differences;
+
+	// Both device lists are sorted by object ID
+	auto current = mDevices.cbegin();
+	auto older = previous.mDevices.cbegin();
+	while(current != mDevices.cend() || older != previous.mDevices.cend()) {
+		if(older == previous.mDevices.cend() || (current != mDevices.cend() && current->mDeviceID < older->mDeviceID)) {
+			differences.mAddedDevices.push_back(current->mDeviceID);
+			++current;
+		}
+		else if(current == mDevices.cend() || older->mDeviceID < current->mDeviceID) {
+			differences.mRemovedDevices.push_back(older->mDeviceID);
+			++older;
+		}
+		else {
+			if(*current != *older || !StreamsEqual(*current, previous, *older))
+				differences.mChangedDevices.push_back(current->mDeviceID);
+			++current;
+			++older;
+		}
+	}
+
+	return differences;
+}
+
+bool SFB::HALDeviceSnapshot::StreamsEqual(const Device& device, const HALDeviceSnapshot& other, const Device& otherDevice) const noexcept
+{
+	if(device.mStreamCount != otherDevice.mStreamCount)
+		return false;
+	return std::equal(mStreams.cbegin() + device.mFirstStream, mStreams.cbegin() + device.mFirstStream + device.mStreamCount, other.mStreams.cbegin() + otherDevice.mFirstStream);
+}
@@ -0,0 +1,219 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <vector>
+
+#import <CoreAudio/CoreAudio.h>
+
+#import "SFBCAStreamBasicDescription.hpp"
+#import "SFBCFWrapper.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// An immutable snapshot of the HAL's audio devices and their streams
+///
+/// A snapshot is captured by walking the system object once, reusing a single buffer for object lists and fetching
+/// each device's streams for both directions at once. Devices are stored sorted by object ID and the streams of all
+/// devices are stored contiguously, so two snapshots can be compared with a single linear pass.
+///
+/// @code
+/// auto previous = SFB::HALDeviceSnapshot::Capture();
+/// // After kAudioHardwarePropertyDevices changes
+/// auto current = SFB::HALDeviceSnapshot::Capture();
+/// auto changes = current.DifferencesFrom(previous);
+/// @endcode
+class HALDeviceSnapshot
+{
+
+public:
+
+	/// An audio stream
+	struct Stream {
+		/// The stream's object ID
+		AudioObjectID mStreamID;
+		/// @c true if the stream is an input stream
+		bool mIsInput;
+		/// @c true if the stream is active
+		bool mIsActive;
+		/// The stream's first channel in the device
+		UInt32 mStartingChannel;
+		/// The stream's latency in frames
+		UInt32 mLatency;
+		/// The stream's virtual format
+		CAStreamBasicDescription mVirtualFormat;
+		/// The stream's physical format
+		CAStreamBasicDescription mPhysicalFormat;
+
+		/// Returns @c true if @c rhs is equal to @c this
+		bool operator==(const Stream& rhs) const noexcept;
+
+		/// Returns @c true if @c rhs is not equal to @c this
+		inline bool operator!=(const Stream& rhs) const noexcept
+		{
+			return !operator==(rhs);
+		}
+	};
+
+	/// An audio device
+	struct Device {
+		/// The device's object ID
+		AudioObjectID mDeviceID;
+		/// The device's UID
+		CFString mUID;
+		/// The device's name
+		CFString mName;
+		/// The device's transport type
+		UInt32 mTransportType;
+		/// The device's nominal sample rate
+		Float64 mNominalSampleRate;
+		/// The device's IO buffer size in frames
+		UInt32 mBufferFrameSize;
+		/// The device's input latency in frames
+		UInt32 mInputLatency;
+		/// The device's output latency in frames
+		UInt32 mOutputLatency;
+		/// The device's input safety offset in frames
+		UInt32 mInputSafetyOffset;
+		/// The device's output safety offset in frames
+		UInt32 mOutputSafetyOffset;
+		/// The total number of input channels in the device's streams
+		UInt32 mInputChannelCount;
+		/// The total number of output channels in the device's streams
+		UInt32 mOutputChannelCount;
+		/// The index of the device's first stream in @c Streams()
+		std::size_t mFirstStream;
+		/// The number of streams belonging to the device
+		std::size_t mStreamCount;
+
+		/// Returns @c true if the device's properties, excluding its streams, are equal to those of @c rhs
+		bool operator==(const Device& rhs) const noexcept;
+
+		/// Returns @c true if the device's properties, excluding its streams, are not equal to those of @c rhs
+		inline bool operator!=(const Device& rhs) const noexcept
+		{
+			return !operator==(rhs);
+		}
+	};
+
+	/// The differences between two snapshots
+	struct Differences {
+		/// Devices present only in the newer snapshot
+		std::vector<AudioObjectID> mAddedDevices;
+		/// Devices present only in the older snapshot
+		std::vector<AudioObjectID> mRemovedDevices;
+		/// Devices present in both snapshots whose properties or streams differ
+		std::vector<AudioObjectID> mChangedDevices;
+
+		/// Returns @c true if the snapshots are equivalent
+		inline bool IsEmpty() const noexcept
+		{
+			return mAddedDevices.empty() && mRemovedDevices.empty() && mChangedDevices.empty();
+		}
+	};
+
+	/// Captures a snapshot of the current devices
+	///
+	/// Devices removed while the snapshot is captured are omitted.
+	/// @throws @c std::system_error if the device list could not be retrieved
+	/// @throws @c std::bad_alloc
+	static HALDeviceSnapshot Capture();
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c HALDeviceSnapshot
+	HALDeviceSnapshot() noexcept;
+
+	/// Copy constructor
+	HALDeviceSnapshot(const HALDeviceSnapshot& rhs) = default;
+
+	/// Assignment operator
+	HALDeviceSnapshot& operator=(const HALDeviceSnapshot& rhs) = default;
+
+	/// Destructor
+	~HALDeviceSnapshot() = default;
+
+	/// Move constructor
+	HALDeviceSnapshot(HALDeviceSnapshot&& rhs) noexcept = default;
+
+	/// Move assignment operator
+	HALDeviceSnapshot& operator=(HALDeviceSnapshot&& rhs) noexcept = default;
+
+#pragma mark Snapshot Contents
+
+	/// Returns the devices sorted by object ID
+	inline const std::vector<Device>& Devices() const noexcept
+	{
+		return mDevices;
+	}
+
+	/// Returns the streams of all devices
+	inline const std::vector<Stream>& Streams() const noexcept
+	{
+		return mStreams;
+	}
+
+	/// Returns the first of the @c device.mStreamCount streams belonging to @c device
+	inline const Stream * _Nullable StreamsForDevice(const Device& device) const noexcept
+	{
+		return device.mStreamCount > 0 ? &mStreams[device.mFirstStream] : nullptr;
+	}
+
+	/// Returns the device with object ID @c deviceID or @c nullptr if none
+	const Device * _Nullable DeviceWithID(AudioObjectID deviceID) const noexcept;
+
+	/// Returns the device with UID @c uid or @c nullptr if none
+	const Device * _Nullable DeviceWithUID(CFStringRef uid) const noexcept;
+
+	/// Returns the default input device's object ID
+	inline AudioObjectID DefaultInputDeviceID() const noexcept
+	{
+		return mDefaultInputDeviceID;
+	}
+
+	/// Returns the default output device's object ID
+	inline AudioObjectID DefaultOutputDeviceID() const noexcept
+	{
+		return mDefaultOutputDeviceID;
+	}
+
+	/// Returns the default system output device's object ID
+	inline AudioObjectID DefaultSystemOutputDeviceID() const noexcept
+	{
+		return mDefaultSystemOutputDeviceID;
+	}
+
+#pragma mark Comparison
+
+	/// Returns the differences between @c previous and this snapshot
+	/// @param previous An older snapshot
+	/// @throws @c std::bad_alloc
+	Differences DifferencesFrom(const HALDeviceSnapshot& previous) const;
+
+private:
+
+	/// Returns @c true if @c device in this snapshot and @c otherDevice in @c other have equal streams
+	bool StreamsEqual(const Device& device, const HALDeviceSnapshot& other, const Device& otherDevice) const noexcept;
+
+	/// The devices sorted by object ID
+	std::vector<Device> mDevices;
+	/// The streams of all devices
+	std::vector<Stream> mStreams;
+	/// The default input device
+	AudioObjectID mDefaultInputDeviceID;
+	/// The default output device
+	AudioObjectID mDefaultOutputDeviceID;
+	/// The default system output device
+	AudioObjectID mDefaultSystemOutputDeviceID;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
@@ -0,0 +1,267 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstddef>
+#import <exception>
+#import <new>
+
+#import <mach/mach_time.h>
+#import <os/log.h>
+
+#import "SFBHALIOProcHost.hpp"
+
+#pragma mark Creation and Destruction
+
+SFB::HALIOProcHost::HALIOProcHost(const HALAudioDevice& device) noexcept
+: mDevice(device), mIOProcID(nullptr), mNextInputSampleTime(0), mNextOutputSampleTime(0), mCycleCount(0), mOverloads(0), mOutputUnderruns(0), mRingBufferErrors(0), mStreamMismatches(0), mLastCycleDuration(0), mMaximumCycleDuration(0)
+{}
+
+SFB::HALIOProcHost::~HALIOProcHost()
+{
+	Stop();
+}
+
+#pragma mark IO Control
+
+void SFB::HALIOProcHost::Start(uint32_t ringBufferFrameCapacity)
+{
+	if(IsRunning())
+		return;
+
+	// All allocations occur here, before the IOProc is created
+	mInputBindings = BindStreams(mDevice, HALAudioObjectDirectionalScope::input, ringBufferFrameCapacity);
+	mOutputBindings = BindStreams(mDevice, HALAudioObjectDirectionalScope::output, ringBufferFrameCapacity);
+
+	mNextInputSampleTime.store(0, std::memory_order_relaxed);
+	mNextOutputSampleTime.store(0, std::memory_order_relaxed);
+
+	mDevice.AddPropertyListener(CAPropertyAddress(kAudioDeviceProcessorOverload), OverloadListener, this);
+
+	AudioDeviceIOProcID ioProcID = nullptr;
+	try {
+		ioProcID = mDevice.CreateIOProcID(IOProc, this);
+		mDevice.Start(ioProcID);
+	}
+	catch(...) {
+		if(ioProcID) {
+			try {
+				mDevice.DestroyIOProcID(ioProcID);
+			}
+			catch(const std::exception& e) {
+				os_log_error(OS_LOG_DEFAULT, "Error destroying IOProc ID: %{public}s", e.what());
+			}
+		}
+		try {
+			mDevice.RemovePropertyListener(CAPropertyAddress(kAudioDeviceProcessorOverload), OverloadListener, this);
+		}
+		catch(const std::exception& e) {
+			os_log_error(OS_LOG_DEFAULT, "Error removing property listener: %{public}s", e.what());
+		}
+		throw;
+	}
+
+	mIOProcID = ioProcID;
+}
+
+void SFB::HALIOProcHost::Stop() noexcept
+{
+	if(!IsRunning())
+		return;
+
+	try {
+		mDevice.Stop(mIOProcID);
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error stopping IO: %{public}s", e.what());
+	}
+
+	// The IOProc won't be called after its ID is destroyed
+	try {
+		mDevice.DestroyIOProcID(mIOProcID);
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error destroying IOProc ID: %{public}s", e.what());
+	}
+
+	try {
+		mDevice.RemovePropertyListener(CAPropertyAddress(kAudioDeviceProcessorOverload), OverloadListener, this);
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error removing property listener: %{public}s", e.what());
+	}
+
+	mIOProcID = nullptr;
+}
+
+#pragma mark Statistics
+
+SFB::HALIOProcHost::Statistics SFB::HALIOProcHost::GetStatistics() const noexcept
+{
+	return {
+		mCycleCount.load(std::memory_order_relaxed),
+		mOverloads.load(std::memory_order_relaxed),
+		mOutputUnderruns.load(std::memory_order_relaxed),
+		mRingBufferErrors.load(std::memory_order_relaxed),
+		mStreamMismatches.load(std::memory_order_relaxed),
+		mLastCycleDuration.load(std::memory_order_relaxed),
+		mMaximumCycleDuration.load(std::memory_order_relaxed),
+	};
+}
+
+void SFB::HALIOProcHost::ResetStatistics() noexcept
+{
+	mCycleCount.store(0, std::memory_order_relaxed);
+	mOverloads.store(0, std::memory_order_relaxed);
+	mOutputUnderruns.store(0, std::memory_order_relaxed);
+	mRingBufferErrors.store(0, std::memory_order_relaxed);
+	mStreamMismatches.store(0, std::memory_order_relaxed);
+	mLastCycleDuration.store(0, std::memory_order_relaxed);
+	mMaximumCycleDuration.store(0, std::memory_order_relaxed);
+}
+
+#pragma mark Internals
+
+std::vector<SFB::HALIOProcHost::StreamBinding> SFB::HALIOProcHost::BindStreams(const HALAudioDevice& device, HALAudioObjectDirectionalScope scope, uint32_t ringBufferFrameCapacity)
+{
+	auto streams = device.Streams(scope);
+
+	std::vector<StreamBinding> bindings;
+	bindings.reserve(streams.size());
+
+	// Each stream occupies one buffer in the IOProc's buffer list per channel stream, in stream order
+	UInt32 bufferIndex = 0;
+	for(const auto& stream : streams) {
+		auto format = stream.VirtualFormat();
+
+		StreamBinding binding;
+		binding.mRingBuffer = std::make_unique<CARingBuffer>();
+		if(!binding.mRingBuffer->Allocate(format, ringBufferFrameCapacity))
+			throw std::bad_alloc();
+
+		binding.mFirstBuffer = bufferIndex;
+		binding.mBufferCount = format.ChannelStreamCount();
+		binding.mBufferListStorage = std::make_unique<uint8_t[]>(offsetof(AudioBufferList, mBuffers) + (sizeof(AudioBuffer) * binding.mBufferCount));
+		binding.BufferList()->mNumberBuffers = binding.mBufferCount;
+
+		bufferIndex += binding.mBufferCount;
+		bindings.push_back(std::move(binding));
+	}
+
+	return bindings;
+}
+
+bool SFB::HALIOProcHost::PrepareBufferList(const StreamBinding& binding, const AudioBufferList& bufferList, UInt32& frameCount) noexcept
+{
+	if(bufferList.mNumberBuffers < binding.mFirstBuffer + binding.mBufferCount)
+		return false;
+
+	const auto& format = binding.mRingBuffer->Format();
+	auto channelCount = format.InterleavedChannelCount();
+
+	// The frame count is derived from each cycle's buffers since it may differ from the device's buffer frame size
+	frameCount = bufferList.mBuffers[binding.mFirstBuffer].mDataByteSize / format.mBytesPerFrame;
+
+	auto list = binding.BufferList();
+	for(UInt32 i = 0; i < binding.mBufferCount; ++i) {
+		const auto& buffer = bufferList.mBuffers[binding.mFirstBuffer + i];
+		if(buffer.mNumberChannels != channelCount || buffer.mDataByteSize != frameCount * format.mBytesPerFrame)
+			return false;
+		list->mBuffers[i] = buffer;
+	}
+
+	return true;
+}
+
+OSStatus SFB::HALIOProcHost::IOProc(AudioObjectID inDevice, const AudioTimeStamp *inNow, const AudioBufferList *inInputData, const AudioTimeStamp *inInputTime, AudioBufferList *outOutputData, const AudioTimeStamp *inOutputTime, void *inClientData) noexcept
+{
+	auto host = static_cast<HALIOProcHost *>(inClientData);
+
+	auto cycleStart = mach_absolute_time();
+
+	if(inInputData && inInputTime && (inInputTime->mFlags & kAudioTimeStampSampleTimeValid) && inInputTime->mSampleTime >= 0)
+		host->ProcessInput(*inInputData, *inInputTime);
+
+	if(outOutputData && inOutputTime && (inOutputTime->mFlags & kAudioTimeStampSampleTimeValid) && inOutputTime->mSampleTime >= 0)
+		host->ProcessOutput(*outOutputData, *inOutputTime);
+
+	host->mCycleCount.fetch_add(1, std::memory_order_relaxed);
+
+	// Only the IO thread modifies the cycle durations
+	auto cycleDuration = mach_absolute_time() - cycleStart;
+	host->mLastCycleDuration.store(cycleDuration, std::memory_order_relaxed);
+	if(cycleDuration > host->mMaximumCycleDuration.load(std::memory_order_relaxed))
+		host->mMaximumCycleDuration.store(cycleDuration, std::memory_order_relaxed);
+
+	return noErr;
+}
+
+OSStatus SFB::HALIOProcHost::OverloadListener(AudioObjectID inObjectID, UInt32 inNumberAddresses, const AudioObjectPropertyAddress *inAddresses, void *inClientData) noexcept
+{
+	auto host = static_cast<HALIOProcHost *>(inClientData);
+	for(UInt32 i = 0; i < inNumberAddresses; ++i) {
+		if(inAddresses[i].mSelector == kAudioDeviceProcessorOverload)
+			host->mOverloads.fetch_add(1, std::memory_order_relaxed);
+	}
+	return noErr;
+}
+
+void SFB::HALIOProcHost::ProcessInput(const AudioBufferList& inputData, const AudioTimeStamp& inputTime) noexcept
+{
+	auto sampleTime = static_cast<int64_t>(inputTime.mSampleTime);
+
+	UInt32 framesWritten = 0;
+	for(const auto& binding : mInputBindings) {
+		UInt32 frameCount;
+		if(!PrepareBufferList(binding, inputData, frameCount)) {
+			mStreamMismatches.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		if(!binding.mRingBuffer->Write(binding.BufferList(), frameCount, sampleTime))
+			mRingBufferErrors.fetch_add(1, std::memory_order_relaxed);
+		else
+			framesWritten = std::max(framesWritten, frameCount);
+	}
+
+	if(framesWritten > 0)
+		mNextInputSampleTime.store(sampleTime + framesWritten, std::memory_order_release);
+}
+
+void SFB::HALIOProcHost::ProcessOutput(AudioBufferList& outputData, const AudioTimeStamp& outputTime) noexcept
+{
+	auto sampleTime = static_cast<int64_t>(outputTime.mSampleTime);
+
+	// The HAL zeroes the output buffers before each cycle so skipped streams are silent
+	UInt32 framesRead = 0;
+	bool underrun = false;
+	for(const auto& binding : mOutputBindings) {
+		UInt32 frameCount;
+		if(!PrepareBufferList(binding, outputData, frameCount)) {
+			mStreamMismatches.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		if(frameCount == 0)
+			continue;
+
+		int64_t startTime, endTime;
+		if(!binding.mRingBuffer->GetTimeBounds(startTime, endTime) || startTime > sampleTime || endTime < sampleTime + frameCount)
+			underrun = true;
+
+		// Frames outside the ring buffer's time bounds are read as silence
+		if(!binding.mRingBuffer->Read(binding.BufferList(), frameCount, sampleTime))
+			mRingBufferErrors.fetch_add(1, std::memory_order_relaxed);
+
+		framesRead = std::max(framesRead, frameCount);
+	}
+
+	if(underrun)
+		mOutputUnderruns.fetch_add(1, std::memory_order_relaxed);
+
+	if(framesRead > 0)
+		mNextOutputSampleTime.store(sampleTime + framesRead, std::memory_order_release);
+}
@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <memory>
+#import <vector>
+
+#import "SFBCARingBuffer.hpp"
+#import "SFBHALAudioDevice.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A class running an IOProc on a @c HALAudioDevice that transfers each stream's audio to or from a @c CARingBuffer
+///
+/// Each input and output stream of the device is bound to a @c CARingBuffer in the stream's virtual format. The IOProc
+/// writes input audio to the input ring buffers and fills output buffers from the output ring buffers, using the
+/// sample times of the IO cycle's input and output time stamps as the ring buffer time stamps. Consumers of input
+/// typically use a @c CARingBuffer::Reader and producers of output write ahead of @c NextOutputSampleTime().
+///
+/// All ring buffers are allocated by @c Start(); the IOProc never blocks, allocates, or throws.
+/// @note The stream bindings are fixed when IO is started. Cycles whose buffers don't match the bindings are skipped and
+/// counted in @c Statistics::mStreamMismatches.
+class HALIOProcHost
+{
+
+public:
+
+	/// IO statistics
+	struct Statistics {
+		/// The number of IO cycles
+		uint64_t mCycleCount;
+		/// The number of processor overloads reported by the HAL
+		uint64_t mOverloads;
+		/// The number of output cycles for which the output ring buffers held too few frames
+		uint64_t mOutputUnderruns;
+		/// The number of failed ring buffer writes or reads
+		uint64_t mRingBufferErrors;
+		/// The number of IO cycles skipped because the buffers didn't match the stream bindings
+		uint64_t mStreamMismatches;
+		/// The duration of the most recent IO cycle in host time units
+		uint64_t mLastCycleDuration;
+		/// The longest IO cycle duration in host time units
+		uint64_t mMaximumCycleDuration;
+	};
+
+#pragma mark Creation and Destruction
+
+	/// Default constructor
+	HALIOProcHost() noexcept = delete;
+
+	// This class is non-copyable
+	HALIOProcHost(const HALIOProcHost& rhs) = delete;
+
+	// This class is non-assignable
+	HALIOProcHost& operator=(const HALIOProcHost& rhs) = delete;
+
+	/// Stops IO and destroys the @c HALIOProcHost
+	~HALIOProcHost();
+
+	// This class is non-movable
+	HALIOProcHost(HALIOProcHost&& rhs) = delete;
+
+	// This class is non-move assignable
+	HALIOProcHost& operator=(HALIOProcHost&& rhs) = delete;
+
+	/// Creates a @c HALIOProcHost for @c device
+	explicit HALIOProcHost(const HALAudioDevice& device) noexcept;
+
+#pragma mark IO Control
+
+	/// Allocates the ring buffers and starts IO
+	/// @note Does nothing if IO is running
+	/// @param ringBufferFrameCapacity The desired capacity of each ring buffer in frames
+	/// @throws @c std::bad_alloc
+	/// @throws @c std::system_error
+	void Start(uint32_t ringBufferFrameCapacity = 16384);
+
+	/// Stops IO
+	/// @note The ring buffers remain valid until IO is started again or the host is destroyed
+	void Stop() noexcept;
+
+	/// Returns @c true if IO is running
+	inline bool IsRunning() const noexcept
+	{
+		return mIOProcID != nullptr;
+	}
+
+	/// Returns the device
+	inline const HALAudioDevice& Device() const noexcept
+	{
+		return mDevice;
+	}
+
+#pragma mark Stream Ring Buffers
+
+	/// Returns the number of input streams bound when IO was started
+	inline std::size_t InputStreamCount() const noexcept
+	{
+		return mInputBindings.size();
+	}
+
+	/// Returns the ring buffer receiving audio from input stream @c index
+	/// @note The ring buffer's format is the stream's virtual format
+	inline const CARingBuffer& InputRingBuffer(std::size_t index) const noexcept
+	{
+		return *mInputBindings[index].mRingBuffer;
+	}
+
+	/// Returns the number of output streams bound when IO was started
+	inline std::size_t OutputStreamCount() const noexcept
+	{
+		return mOutputBindings.size();
+	}
+
+	/// Returns the ring buffer supplying audio to output stream @c index
+	/// @note The ring buffer's format is the stream's virtual format
+	/// @note Only one thread may write to the ring buffer
+	inline CARingBuffer& OutputRingBuffer(std::size_t index) noexcept
+	{
+		return *mOutputBindings[index].mRingBuffer;
+	}
+
+	/// Returns the sample time following the most recent input cycle
+	inline int64_t NextInputSampleTime() const noexcept
+	{
+		return mNextInputSampleTime.load(std::memory_order_acquire);
+	}
+
+	/// Returns the sample time following the most recent output cycle
+	///
+	/// Audio written to the output ring buffers before this time will not be played.
+	inline int64_t NextOutputSampleTime() const noexcept
+	{
+		return mNextOutputSampleTime.load(std::memory_order_acquire);
+	}
+
+#pragma mark Statistics
+
+	/// Returns the IO statistics
+	/// @note Each value is read atomically but the values are not read as a group
+	Statistics GetStatistics() const noexcept;
+
+	/// Resets the IO statistics
+	void ResetStatistics() noexcept;
+
+private:
+
+	/// A stream bound to a ring buffer
+	struct StreamBinding {
+		/// The ring buffer
+		std::unique_ptr<CARingBuffer> mRingBuffer;
+		/// The index of the stream's first buffer in the IOProc's buffer list
+		UInt32 mFirstBuffer;
+		/// The number of buffers used by the stream
+		UInt32 mBufferCount;
+		/// Storage for a buffer list referencing the stream's buffers
+		std::unique_ptr<uint8_t[]> mBufferListStorage;
+
+		/// Returns the buffer list referencing the stream's buffers
+		inline AudioBufferList * BufferList() const noexcept
+		{
+			return reinterpret_cast<AudioBufferList *>(mBufferListStorage.get());
+		}
+	};
+
+	/// Binds the device's streams in @c scope to newly allocated ring buffers
+	static std::vector<StreamBinding> BindStreams(const HALAudioDevice& device, HALAudioObjectDirectionalScope scope, uint32_t ringBufferFrameCapacity);
+
+	/// Points the buffer list of @c binding at the stream's buffers in @c bufferList
+	/// @param frameCount Receives the number of frames in the stream's buffers
+	/// @return @c true on success, @c false if @c bufferList doesn't match the binding
+	static bool PrepareBufferList(const StreamBinding& binding, const AudioBufferList& bufferList, UInt32& frameCount) noexcept;
+
+	/// The IOProc
+	static OSStatus IOProc(AudioObjectID inDevice, const AudioTimeStamp *inNow, const AudioBufferList *inInputData, const AudioTimeStamp *inInputTime, AudioBufferList *outOutputData, const AudioTimeStamp *inOutputTime, void * _Nullable inClientData) noexcept;
+
+	/// The property listener counting processor overloads
+	static OSStatus OverloadListener(AudioObjectID inObjectID, UInt32 inNumberAddresses, const AudioObjectPropertyAddress *inAddresses, void * _Nullable inClientData) noexcept;
+
+	/// Writes input to the input ring buffers
+	void ProcessInput(const AudioBufferList& inputData, const AudioTimeStamp& inputTime) noexcept;
+
+	/// Fills output from the output ring buffers
+	void ProcessOutput(AudioBufferList& outputData, const AudioTimeStamp& outputTime) noexcept;
+
+	/// The device
+	HALAudioDevice mDevice;
+	/// The IOProc ID or @c nullptr if IO isn't running
+	AudioDeviceIOProcID _Nullable mIOProcID;
+	/// The input stream bindings
+	std::vector<StreamBinding> mInputBindings;
+	/// The output stream bindings
+	std::vector<StreamBinding> mOutputBindings;
+
+	/// The sample time following the most recent input cycle
+	std::atomic<int64_t> mNextInputSampleTime;
+	/// The sample time following the most recent output cycle
+	std::atomic<int64_t> mNextOutputSampleTime;
+
+	/// The number of IO cycles
+	std::atomic_uint64_t mCycleCount;
+	/// The number of processor overloads
+	std::atomic_uint64_t mOverloads;
+	/// The number of output underruns
+	std::atomic_uint64_t mOutputUnderruns;
+	/// The number of ring buffer errors
+	std::atomic_uint64_t mRingBufferErrors;
+	/// The number of stream mismatches
+	std::atomic_uint64_t mStreamMismatches;
+	/// The duration of the most recent IO cycle
+	std::atomic_uint64_t mLastCycleDuration;
+	/// The longest IO cycle duration
+	std::atomic_uint64_t mMaximumCycleDuration;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
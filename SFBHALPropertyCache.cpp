@@ -0,0 +1,212 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <exception>
+#import <mutex>
+#import <stdexcept>
+
+#import <Block.h>
+#import <os/log.h>
+
+#import "SFBHALPropertyCache.hpp"
+
+#pragma mark Creation and Destruction
+
+SFB::HALPropertyCache::HALPropertyCache(const HALAudioObject& object)
+: mObject(object), mHits(0), mMisses(0), mInvalidations(0)
+{
+	mListenerQueue = dispatch_queue_create("org.sbooth.HALPropertyCache", DISPATCH_QUEUE_SERIAL);
+	if(!mListenerQueue)
+		throw std::runtime_error("Unable to create the dispatch queue");
+
+	// The same block must be passed when each listener is removed
+	mListenerBlock = Block_copy(^(UInt32 inNumberAddresses, const AudioObjectPropertyAddress *inAddresses) {
+		PropertiesChanged(inNumberAddresses, inAddresses);
+	});
+}
+
+SFB::HALPropertyCache::~HALPropertyCache()
+{
+	std::vector<Key> keys;
+	{
+		std::lock_guard<UnfairLock> lock(mLock);
+		for(const auto& [key, entry] : mEntries) {
+			if(entry.mListenerState == ListenerState::added)
+				keys.push_back(key);
+		}
+	}
+
+	// The lock isn't held while removing listeners because a notification in progress may be waiting for it
+	for(const auto& key : keys) {
+		CAPropertyAddress address(std::get<0>(key), std::get<1>(key), std::get<2>(key));
+		try {
+			mObject.RemovePropertyListenerBlock(address, mListenerQueue, mListenerBlock);
+		}
+		catch(const std::exception& e) {
+			os_log_error(OS_LOG_DEFAULT, "Error removing property listener: %{public}s", e.what());
+		}
+	}
+
+	// Wait for any notifications already submitted to the queue
+	dispatch_sync_f(mListenerQueue, nullptr, [](void *) {});
+
+	Block_release(mListenerBlock);
+	dispatch_release(mListenerQueue);
+}
+
+#pragma mark Cache Management
+
+bool SFB::HALPropertyCache::IsCached(const AudioObjectPropertyAddress& inAddress) const noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	auto iter = mEntries.find(MakeKey(inAddress));
+	return iter != mEntries.end() && iter->second.mIsValid;
+}
+
+SFB::HALPropertyCache::Clock::time_point SFB::HALPropertyCache::RefreshTime(const AudioObjectPropertyAddress& inAddress) const noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	auto iter = mEntries.find(MakeKey(inAddress));
+	if(iter == mEntries.end() || !iter->second.mIsValid)
+		return {};
+	return iter->second.mRefreshTime;
+}
+
+SFB::HALPropertyCache::Clock::time_point SFB::HALPropertyCache::LastRefreshTime() const noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	return mLastRefreshTime;
+}
+
+void SFB::HALPropertyCache::Invalidate(const AudioObjectPropertyAddress& inAddress) noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	auto iter = mEntries.find(MakeKey(inAddress));
+	if(iter == mEntries.end())
+		return;
+
+	iter->second.Invalidate();
+}
+
+void SFB::HALPropertyCache::InvalidateAll() noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	for(auto& [key, entry] : mEntries)
+		entry.Invalidate();
+}
+
+SFB::HALPropertyCache::Statistics SFB::HALPropertyCache::GetStatistics() const noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	return { mHits, mMisses, mInvalidations };
+}
+
+#pragma mark Internals
+
+void SFB::HALPropertyCache::PropertiesChanged(UInt32 inNumberAddresses, const AudioObjectPropertyAddress *inAddresses) noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	for(UInt32 i = 0; i < inNumberAddresses; ++i) {
+		auto iter = mEntries.find(MakeKey(inAddresses[i]));
+		if(iter == mEntries.end())
+			continue;
+
+		auto& entry = iter->second;
+		if(entry.mIsValid)
+			++mInvalidations;
+		entry.Invalidate();
+	}
+}
+
+void SFB::HALPropertyCache::GetPropertyData(const AudioObjectPropertyAddress& inAddress, UInt32 inDataSize, void *outData)
+{
+	auto copy = [&](const std::vector<uint8_t>& data) {
+		std::memcpy(outData, data.data(), std::min(static_cast<std::size_t>(inDataSize), data.size()));
+	};
+	if(CopyCachedData(inAddress, copy))
+		return;
+
+	auto generation = BeginFetch(inAddress);
+	UInt32 size = inDataSize;
+	mObject.GetPropertyData(inAddress, 0, nullptr, size, outData);
+
+	auto bytes = static_cast<const uint8_t *>(outData);
+	StoreData(inAddress, generation, std::vector<uint8_t>(bytes, bytes + size));
+}
+
+SFB::CFType SFB::HALPropertyCache::GetCFTypePropertyData(const AudioObjectPropertyAddress& inAddress)
+{
+	{
+		std::lock_guard<UnfairLock> lock(mLock);
+		auto iter = mEntries.find(MakeKey(inAddress));
+		if(iter != mEntries.end() && iter->second.mIsValid) {
+			++mHits;
+			return iter->second.mObject;
+		}
+	}
+
+	auto generation = BeginFetch(inAddress);
+	auto object = mObject.CFTypeProperty<CFTypeRef>(inAddress);
+
+	std::lock_guard<UnfairLock> lock(mLock);
+	auto& entry = mEntries[MakeKey(inAddress)];
+	if(entry.mListenerState == ListenerState::added && entry.mGeneration == generation) {
+		entry.mObject = object;
+		entry.mIsValid = true;
+		entry.mRefreshTime = Clock::now();
+		mLastRefreshTime = entry.mRefreshTime;
+	}
+
+	return object;
+}
+
+uint64_t SFB::HALPropertyCache::BeginFetch(const AudioObjectPropertyAddress& inAddress)
+{
+	uint64_t generation;
+	{
+		std::lock_guard<UnfairLock> lock(mLock);
+		++mMisses;
+		auto& entry = mEntries[MakeKey(inAddress)];
+		generation = entry.mGeneration;
+		if(entry.mListenerState != ListenerState::none)
+			return generation;
+		// Claim the listener so concurrent fetches don't add it twice
+		entry.mListenerState = ListenerState::adding;
+	}
+
+	// Without a listener the value can't be kept current so it isn't cached
+	auto state = ListenerState::added;
+	try {
+		mObject.AddPropertyListenerBlock(inAddress, mListenerQueue, mListenerBlock);
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error adding property listener: %{public}s", e.what());
+		state = ListenerState::none;
+	}
+
+	std::lock_guard<UnfairLock> lock(mLock);
+	mEntries[MakeKey(inAddress)].mListenerState = state;
+	return generation;
+}
+
+void SFB::HALPropertyCache::StoreData(const AudioObjectPropertyAddress& inAddress, uint64_t generation, std::vector<uint8_t>&& data) noexcept
+{
+	std::lock_guard<UnfairLock> lock(mLock);
+	auto iter = mEntries.find(MakeKey(inAddress));
+	if(iter == mEntries.end())
+		return;
+
+	// A change notification received during the fetch means the value may be stale
+	auto& entry = iter->second;
+	if(entry.mListenerState != ListenerState::added || entry.mGeneration != generation)
+		return;
+
+	entry.mData = std::move(data);
+	entry.mIsValid = true;
+	entry.mRefreshTime = Clock::now();
+	mLastRefreshTime = entry.mRefreshTime;
+}
@@ -0,0 +1,266 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <chrono>
+#import <cstring>
+#import <map>
+#import <mutex>
+#import <tuple>
+#import <type_traits>
+#import <vector>
+
+#import <dispatch/dispatch.h>
+
+#import "SFBHALAudioObject.hpp"
+#import "SFBUnfairLock.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// An opt-in cache of property values for a @c HALAudioObject
+///
+/// Property values are fetched from the HAL when first requested and returned from memory afterwards. A property
+/// listener is added for each cached address and a change notification invalidates the cached value so the next
+/// request fetches it again. Listeners are called on a private serial queue that is drained after the listeners are
+/// removed, so a notification in progress can't outlive the cache.
+///
+/// @code
+/// SFB::HALPropertyCache cache(deviceID);
+/// auto sampleRate = cache.ArithmeticProperty<Float64>(SFB::CAPropertyAddress(kAudioDevicePropertyNominalSampleRate));
+/// @endcode
+/// @note Qualified property requests are not cached
+/// @note This class is thread safe
+class HALPropertyCache
+{
+
+public:
+
+	/// The clock used for refresh times
+	using Clock = std::chrono::steady_clock;
+
+	/// Cache statistics
+	struct Statistics {
+		/// The number of requests satisfied from the cache
+		uint64_t mHits;
+		/// The number of requests fetched from the HAL
+		uint64_t mMisses;
+		/// The number of cached values invalidated by change notifications
+		uint64_t mInvalidations;
+	};
+
+#pragma mark Creation and Destruction
+
+	/// Default constructor
+	HALPropertyCache() noexcept = delete;
+
+	// This class is non-copyable
+	HALPropertyCache(const HALPropertyCache& rhs) = delete;
+
+	// This class is non-assignable
+	HALPropertyCache& operator=(const HALPropertyCache& rhs) = delete;
+
+	/// Removes all property listeners and destroys the @c HALPropertyCache
+	~HALPropertyCache();
+
+	// This class is non-movable
+	HALPropertyCache(HALPropertyCache&& rhs) = delete;
+
+	// This class is non-move assignable
+	HALPropertyCache& operator=(HALPropertyCache&& rhs) = delete;
+
+	/// Creates a @c HALPropertyCache for @c object
+	/// @throws @c std::runtime_error
+	explicit HALPropertyCache(const HALAudioObject& object);
+
+#pragma mark Cached Properties
+
+	/// Returns the cached object
+	inline const HALAudioObject& Object() const noexcept
+	{
+		return mObject;
+	}
+
+	/// Returns the value of an arithmetic property
+	/// @throws @c std::system_error
+	template <typename T, typename std::enable_if<std::is_arithmetic<T>::value, bool>::type = true>
+	T ArithmeticProperty(const AudioObjectPropertyAddress& inAddress)
+	{
+		T value;
+		GetPropertyData(inAddress, sizeof(T), &value);
+		return value;
+	}
+
+	/// Returns the value of a fixed-size property
+	/// @throws @c std::system_error
+	template <typename T, typename std::enable_if<std::is_trivial<T>::value, bool>::type = true>
+	T StructProperty(const AudioObjectPropertyAddress& inAddress)
+	{
+		T value;
+		GetPropertyData(inAddress, sizeof(T), &value);
+		return value;
+	}
+
+	/// Returns the value of an array property
+	/// @throws @c std::system_error
+	template <typename T, typename std::enable_if<std::is_trivial<T>::value, bool>::type = true>
+	std::vector<T> ArrayProperty(const AudioObjectPropertyAddress& inAddress)
+	{
+		std::vector<T> vec;
+		GetVariablePropertyData(inAddress, [&vec](const std::vector<uint8_t>& data) {
+			vec.resize(data.size() / sizeof(T));
+			if(!vec.empty())
+				std::memcpy(&vec[0], data.data(), vec.size() * sizeof(T));
+		});
+		return vec;
+	}
+
+	/// Returns the value of a Core Foundation property
+	/// @throws @c std::system_error
+	template <typename T, typename std::enable_if<std::is_pointer<T>::value, bool>::type = true>
+	CFWrapper<T> CFTypeProperty(const AudioObjectPropertyAddress& inAddress)
+	{
+		auto object = GetCFTypePropertyData(inAddress);
+		return CFWrapper<T>(static_cast<T>(object.Relinquish()));
+	}
+
+#pragma mark Cache Management
+
+	/// Returns @c true if a value for @c inAddress is cached
+	bool IsCached(const AudioObjectPropertyAddress& inAddress) const noexcept;
+
+	/// Returns the time the value for @c inAddress was fetched or @c Clock::time_point() if it isn't cached
+	Clock::time_point RefreshTime(const AudioObjectPropertyAddress& inAddress) const noexcept;
+
+	/// Returns the time a value was most recently fetched or @c Clock::time_point() if none have been
+	Clock::time_point LastRefreshTime() const noexcept;
+
+	/// Discards the cached value for @c inAddress
+	void Invalidate(const AudioObjectPropertyAddress& inAddress) noexcept;
+
+	/// Discards all cached values
+	void InvalidateAll() noexcept;
+
+	/// Returns the cache statistics
+	Statistics GetStatistics() const noexcept;
+
+private:
+
+	/// The map key for a property address
+	using Key = std::tuple<AudioObjectPropertySelector, AudioObjectPropertyScope, AudioObjectPropertyElement>;
+
+	/// The state of the property listener for an address
+	enum class ListenerState {
+		/// No listener has been added
+		none,
+		/// A listener is being added
+		adding,
+		/// A listener has been added
+		added,
+	};
+
+	/// A cached property value
+	struct Entry {
+		/// The bytes of a non-CF property value
+		std::vector<uint8_t> mData;
+		/// The value of a CF property
+		CFType mObject;
+		/// @c true if the value is current
+		bool mIsValid = false;
+		/// The state of the property listener for the address
+		ListenerState mListenerState = ListenerState::none;
+		/// Incremented each time the value is invalidated
+		uint64_t mGeneration = 0;
+		/// The time the value was fetched
+		Clock::time_point mRefreshTime;
+
+		/// Discards the value
+		inline void Invalidate() noexcept
+		{
+			++mGeneration;
+			mIsValid = false;
+			mData.clear();
+			mObject = nullptr;
+		}
+	};
+
+	/// Invalidates the cached values for the @c inNumberAddresses changed properties in @c inAddresses
+	void PropertiesChanged(UInt32 inNumberAddresses, const AudioObjectPropertyAddress *inAddresses) noexcept;
+
+	/// Copies a fixed-size property value to @c outData
+	void GetPropertyData(const AudioObjectPropertyAddress& inAddress, UInt32 inDataSize, void *outData);
+
+	/// Calls @c copy with the bytes of a variable-size property value
+	template <typename F>
+	void GetVariablePropertyData(const AudioObjectPropertyAddress& inAddress, F&& copy)
+	{
+		if(CopyCachedData(inAddress, copy))
+			return;
+		auto generation = BeginFetch(inAddress);
+		auto size = mObject.GetPropertyDataSize(inAddress);
+		std::vector<uint8_t> data(size);
+		if(size > 0)
+			mObject.GetPropertyData(inAddress, 0, nullptr, size, data.data());
+		data.resize(size);
+		copy(data);
+		StoreData(inAddress, generation, std::move(data));
+	}
+
+	/// Returns a CF property value
+	CFType GetCFTypePropertyData(const AudioObjectPropertyAddress& inAddress);
+
+	/// Calls @c copy with the cached bytes for @c inAddress under the lock
+	/// @return @c true if a cached value was found
+	template <typename F>
+	bool CopyCachedData(const AudioObjectPropertyAddress& inAddress, F& copy)
+	{
+		std::lock_guard<UnfairLock> lock(mLock);
+		auto iter = mEntries.find(MakeKey(inAddress));
+		if(iter == mEntries.end() || !iter->second.mIsValid)
+			return false;
+		++mHits;
+		copy(iter->second.mData);
+		return true;
+	}
+
+	/// Adds a property listener for @c inAddress if necessary and returns the current generation
+	uint64_t BeginFetch(const AudioObjectPropertyAddress& inAddress);
+
+	/// Caches @c data for @c inAddress unless it was invalidated after @c generation
+	void StoreData(const AudioObjectPropertyAddress& inAddress, uint64_t generation, std::vector<uint8_t>&& data) noexcept;
+
+	/// Returns the map key for @c inAddress
+	static inline Key MakeKey(const AudioObjectPropertyAddress& inAddress) noexcept
+	{
+		return { inAddress.mSelector, inAddress.mScope, inAddress.mElement };
+	}
+
+	/// The cached object
+	HALAudioObject mObject;
+	/// Cached values
+	std::map<Key, Entry> mEntries;
+	/// The time a value was most recently fetched
+	Clock::time_point mLastRefreshTime;
+	/// The number of requests satisfied from the cache
+	uint64_t mHits;
+	/// The number of requests fetched from the HAL
+	uint64_t mMisses;
+	/// The number of values invalidated by change notifications
+	uint64_t mInvalidations;
+	/// The lock protecting the cache
+	mutable UnfairLock mLock;
+	/// The serial queue on which the property listener is called
+	dispatch_queue_t mListenerQueue;
+	/// The property listener invalidating changed values
+	AudioObjectPropertyListenerBlock mListenerBlock;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
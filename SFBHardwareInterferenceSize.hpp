@@ -0,0 +1,21 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <cstddef>
+
+namespace SFB {
+
+/// The minimum offset between two objects to avoid false sharing
+///
+/// Data written by different threads, such as the read and write positions of a ring buffer, should be aligned to this
+/// value so the threads do not invalidate each other's cache lines.
+/// @note This is 128, the cache line size on Apple silicon and the adjacent line prefetch size on Intel. A fixed value
+/// is used instead of @c std::hardware_destructive_interference_size because it affects class layout.
+constexpr std::size_t DestructiveInterferenceSize = 128;
+
+} // namespace SFB
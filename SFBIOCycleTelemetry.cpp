@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cmath>
+#import <numeric>
+
+#import <mach/mach_time.h>
+
+#import "SFBIOCycleTelemetry.hpp"
+
+namespace {
+
+/// Returns the smallest power of two greater than or equal to @c x
+constexpr uint32_t NextPowerOfTwo(uint32_t x) noexcept
+{
+	return x <= 1 ? 1 : 1u << (32 - __builtin_clz(x - 1));
+}
+
+/// The maximum number of recent cycles retained
+constexpr uint32_t kMaximumHistoryCapacity = 1u << 20;
+
+}
+
+uint64_t SFB::IOCycleTelemetry::Histogram::Count() const noexcept
+{
+	return std::accumulate(std::cbegin(mBins), std::cend(mBins), uint64_t(0));
+}
+
+void SFB::IOCycleTelemetry::AtomicHistogram::Load(Histogram& histogram) const noexcept
+{
+	for(std::size_t i = 0; i < Histogram::sBinCount; ++i)
+		histogram.mBins[i] = mBins[i].load(std::memory_order_relaxed);
+}
+
+#pragma mark Creation and Destruction
+
+SFB::IOCycleTelemetry::IOCycleTelemetry(uint32_t historyCapacity, os_log_t log)
+: mLog(log), mCurrentCycle{}, mNextSampleTime(0), mNextSampleTimeIsValid(false), mCycleCount(0), mMissedDeadlines(0), mDiscontinuities(0)
+{
+	// A spare slot holds the cycle being stored so it never overwrites a cycle readers may copy
+	mHistoryCapacity = std::clamp(historyCapacity, 1u, kMaximumHistoryCapacity);
+	auto slotCount = NextPowerOfTwo(mHistoryCapacity + 1);
+	mHistory = std::make_unique<Cycle[]>(slotCount);
+	mHistoryMask = slotCount - 1;
+
+	for(auto histogram : { &mCycleDuration, &mDeadlineSlack, &mDeadlineLateness, &mDiscontinuity, &mRateScalarDrift }) {
+		for(auto& bin : histogram->mBins)
+			bin.store(0, std::memory_order_relaxed);
+	}
+
+	mach_timebase_info_data_t timebase;
+	mach_timebase_info(&timebase);
+	mTimebaseNumerator = timebase.numer;
+	mTimebaseDenominator = timebase.denom;
+
+	mSignpostID = os_signpost_id_make_with_pointer(mLog, this);
+}
+
+#pragma mark Recording
+
+void SFB::IOCycleTelemetry::BeginCycle(const CATimeStamp& entryTime, const CATimeStamp& cycleTime, UInt32 frameCount) noexcept
+{
+	auto& cycle = mCurrentCycle;
+	cycle = {};
+	cycle.mEntryHostTime = entryTime.HostTimeIsValid() ? entryTime.mHostTime : 0;
+	cycle.mDeadlineHostTime = cycleTime.HostTimeIsValid() ? cycleTime.mHostTime : 0;
+	cycle.mFrameCount = frameCount;
+
+	if(cycleTime.SampleTimeIsValid()) {
+		cycle.mSampleTime = cycleTime.mSampleTime;
+		if(mNextSampleTimeIsValid) {
+			cycle.mSampleTimeDiscontinuity = std::llround(cycle.mSampleTime - mNextSampleTime);
+			if(cycle.mSampleTimeDiscontinuity != 0) {
+				Increment(mDiscontinuities);
+				mDiscontinuity.Record(static_cast<uint64_t>(std::llabs(cycle.mSampleTimeDiscontinuity)));
+				os_signpost_event_emit(mLog, mSignpostID, "Discontinuity", "%lld frames", static_cast<long long>(cycle.mSampleTimeDiscontinuity));
+			}
+		}
+		mNextSampleTime = cycle.mSampleTime + frameCount;
+		mNextSampleTimeIsValid = true;
+	}
+
+	if(cycleTime.RateScalarIsValid()) {
+		cycle.mRateScalar = cycleTime.mRateScalar;
+		mRateScalarDrift.Record(static_cast<uint64_t>(std::llround(std::fabs(cycle.mRateScalar - 1) * 1e6)));
+	}
+
+	os_signpost_interval_begin(mLog, mSignpostID, "Cycle", "%u frames", frameCount);
+}
+
+void SFB::IOCycleTelemetry::EndCycle(const CATimeStamp& exitTime) noexcept
+{
+	auto& cycle = mCurrentCycle;
+	cycle.mExitHostTime = exitTime.HostTimeIsValid() ? exitTime.mHostTime : 0;
+
+	if(cycle.mEntryHostTime != 0 && cycle.mExitHostTime >= cycle.mEntryHostTime)
+		mCycleDuration.Record(HostTimeToNanoseconds(cycle.mExitHostTime - cycle.mEntryHostTime));
+
+	if(cycle.mDeadlineHostTime != 0 && cycle.mExitHostTime != 0) {
+		if(cycle.mExitHostTime <= cycle.mDeadlineHostTime)
+			mDeadlineSlack.Record(HostTimeToNanoseconds(cycle.mDeadlineHostTime - cycle.mExitHostTime));
+		else {
+			auto lateness = HostTimeToNanoseconds(cycle.mExitHostTime - cycle.mDeadlineHostTime);
+			Increment(mMissedDeadlines);
+			mDeadlineLateness.Record(lateness);
+			os_signpost_event_emit(mLog, mSignpostID, "MissedDeadline", "%llu ns late", static_cast<unsigned long long>(lateness));
+		}
+	}
+
+	// The count is published after the cycle is stored so readers can detect overwritten cycles
+	auto index = mCycleCount.load(std::memory_order_relaxed);
+	mHistory[index & mHistoryMask] = cycle;
+	mCycleCount.store(index + 1, std::memory_order_release);
+
+	os_signpost_interval_end(mLog, mSignpostID, "Cycle");
+}
+
+#pragma mark Snapshots
+
+SFB::IOCycleTelemetry::Snapshot SFB::IOCycleTelemetry::GetSnapshot() const
+{
+	Snapshot snapshot{};
+
+	const uint64_t slotCount = mHistoryMask + 1;
+	auto end = mCycleCount.load(std::memory_order_acquire);
+	auto begin = end - std::min(end, static_cast<uint64_t>(mHistoryCapacity));
+
+	snapshot.mRecentCycles.resize(end - begin);
+	for(auto i = begin; i < end; ++i)
+		snapshot.mRecentCycles[i - begin] = mHistory[i & mHistoryMask];
+
+	// Cycles stored to the same slots during the copy, including one in progress, may have been torn
+	std::atomic_thread_fence(std::memory_order_acquire);
+	auto after = mCycleCount.load(std::memory_order_relaxed);
+	if(after + 1 > begin + slotCount) {
+		auto overwritten = std::min(after + 1 - slotCount - begin, end - begin);
+		snapshot.mRecentCycles.erase(snapshot.mRecentCycles.begin(), snapshot.mRecentCycles.begin() + static_cast<std::ptrdiff_t>(overwritten));
+	}
+
+	snapshot.mCycleCount = after;
+	snapshot.mMissedDeadlines = mMissedDeadlines.load(std::memory_order_relaxed);
+	snapshot.mDiscontinuities = mDiscontinuities.load(std::memory_order_relaxed);
+	mCycleDuration.Load(snapshot.mCycleDuration);
+	mDeadlineSlack.Load(snapshot.mDeadlineSlack);
+	mDeadlineLateness.Load(snapshot.mDeadlineLateness);
+	mDiscontinuity.Load(snapshot.mDiscontinuity);
+	mRateScalarDrift.Load(snapshot.mRateScalarDrift);
+
+	return snapshot;
+}
+
+uint64_t SFB::IOCycleTelemetry::HostTimeToNanoseconds(uint64_t hostTime) const noexcept
+{
+	return static_cast<uint64_t>((static_cast<__uint128_t>(hostTime) * mTimebaseNumerator) / mTimebaseDenominator);
+}
@@ -0,0 +1,227 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <memory>
+#import <vector>
+
+#import <os/log.h>
+#import <os/signpost.h>
+
+#import "SFBCATimeStamp.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A lock-free recorder of render callback and IOProc cycle timing
+///
+/// Each cycle is bracketed by calls to @c BeginCycle() and @c EndCycle() from the real-time thread. The recorder keeps
+/// histograms of cycle duration, slack before the cycle's deadline, sample time discontinuities, and rate scalar drift
+/// along with a preallocated history of recent cycles. Any thread may call @c GetSnapshot() while cycles are recorded.
+///
+/// If a log is supplied each cycle is emitted as an @c os_signpost interval and missed deadlines and discontinuities
+/// are emitted as @c os_signpost events, allowing dropouts to be correlated with system activity in Instruments.
+///
+/// @code
+/// // In an IOProc
+/// telemetry.BeginCycle(SFB::CATimeStamp(mach_absolute_time()), *inOutputTime, frameCount);
+/// // Render audio
+/// telemetry.EndCycle(SFB::CATimeStamp(mach_absolute_time()));
+/// @endcode
+/// @note Only one thread may record cycles
+class IOCycleTelemetry
+{
+
+public:
+
+	/// A histogram with power-of-two bins
+	struct Histogram {
+		/// The number of bins
+		static constexpr std::size_t sBinCount = 65;
+
+		/// Bin @c 0 counts the value @c 0 and bin @c n counts values in [2^(n-1), 2^n)
+		uint64_t mBins[sBinCount];
+
+		/// Returns the bin for @c value
+		static inline std::size_t BinForValue(uint64_t value) noexcept
+		{
+			return value == 0 ? 0 : static_cast<std::size_t>(64 - __builtin_clzll(value));
+		}
+
+		/// Returns the total number of values in the histogram
+		uint64_t Count() const noexcept;
+	};
+
+	/// A recorded cycle
+	struct Cycle {
+		/// The host time at entry to the cycle
+		uint64_t mEntryHostTime;
+		/// The host time at exit from the cycle
+		uint64_t mExitHostTime;
+		/// The host time of the cycle's deadline or @c 0 if unknown
+		uint64_t mDeadlineHostTime;
+		/// The sample time of the cycle
+		Float64 mSampleTime;
+		/// The rate scalar of the cycle or @c 0 if unknown
+		Float64 mRateScalar;
+		/// The number of frames in the cycle
+		UInt32 mFrameCount;
+		/// The difference in frames between the cycle's sample time and the end of the previous cycle
+		int64_t mSampleTimeDiscontinuity;
+	};
+
+	/// A snapshot of the recorded telemetry
+	struct Snapshot {
+		/// The number of cycles recorded
+		uint64_t mCycleCount;
+		/// The number of cycles ending after their deadline
+		uint64_t mMissedDeadlines;
+		/// The number of cycles whose sample time didn't follow the previous cycle
+		uint64_t mDiscontinuities;
+		/// Cycle durations in nanoseconds
+		Histogram mCycleDuration;
+		/// Time remaining before the deadline in nanoseconds for cycles meeting their deadline
+		Histogram mDeadlineSlack;
+		/// Time after the deadline in nanoseconds for cycles missing their deadline
+		Histogram mDeadlineLateness;
+		/// Magnitudes of sample time discontinuities in frames
+		Histogram mDiscontinuity;
+		/// Deviations of the rate scalar from @c 1 in parts per million
+		Histogram mRateScalarDrift;
+		/// The most recent cycles, oldest first
+		std::vector<Cycle> mRecentCycles;
+	};
+
+#pragma mark Creation and Destruction
+
+	// This class is non-copyable
+	IOCycleTelemetry(const IOCycleTelemetry& rhs) = delete;
+
+	// This class is non-assignable
+	IOCycleTelemetry& operator=(const IOCycleTelemetry& rhs) = delete;
+
+	/// Destroys the @c IOCycleTelemetry
+	~IOCycleTelemetry() = default;
+
+	// This class is non-movable
+	IOCycleTelemetry(IOCycleTelemetry&& rhs) = delete;
+
+	// This class is non-move assignable
+	IOCycleTelemetry& operator=(IOCycleTelemetry&& rhs) = delete;
+
+	/// Creates an @c IOCycleTelemetry
+	/// @param historyCapacity The number of recent cycles to retain
+	/// @param log The log for signposts or @c OS_LOG_DISABLED to disable signposts
+	/// @note @c log must remain valid for the lifetime of the @c IOCycleTelemetry
+	/// @throws @c std::bad_alloc
+	explicit IOCycleTelemetry(uint32_t historyCapacity = 1024, os_log_t log = OS_LOG_DISABLED);
+
+#pragma mark Recording
+
+	/// Begins recording a cycle
+	///
+	/// The deadline is the host time of @c cycleTime, which for an IOProc is normally the output time stamp and for a
+	/// render callback the render time stamp.
+	/// @param entryTime The host time at entry to the callback
+	/// @param cycleTime The time stamp of the cycle
+	/// @param frameCount The number of frames in the cycle
+	void BeginCycle(const CATimeStamp& entryTime, const CATimeStamp& cycleTime, UInt32 frameCount) noexcept;
+
+	/// Finishes recording the cycle started by the most recent call to @c BeginCycle()
+	/// @param exitTime The host time at exit from the callback
+	void EndCycle(const CATimeStamp& exitTime) noexcept;
+
+#pragma mark Snapshots
+
+	/// Returns the number of cycles recorded
+	inline uint64_t CycleCount() const noexcept
+	{
+		return mCycleCount.load(std::memory_order_acquire);
+	}
+
+	/// Returns a snapshot of the recorded telemetry
+	/// @note The histograms and counters are read atomically but not as a group
+	/// @throws @c std::bad_alloc
+	Snapshot GetSnapshot() const;
+
+	/// Converts @c hostTime in host time units to nanoseconds
+	uint64_t HostTimeToNanoseconds(uint64_t hostTime) const noexcept;
+
+private:
+
+	/// A histogram that may be read while it is written by a single thread
+	struct AtomicHistogram {
+		/// The bins
+		std::atomic_uint64_t mBins[Histogram::sBinCount];
+
+		/// Adds @c value to the histogram
+		/// @note Only the recording thread may call this method
+		inline void Record(uint64_t value) noexcept
+		{
+			auto& bin = mBins[Histogram::BinForValue(value)];
+			bin.store(bin.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		/// Copies the histogram to @c histogram
+		void Load(Histogram& histogram) const noexcept;
+	};
+
+	/// Increments a counter written only by the recording thread
+	static inline void Increment(std::atomic_uint64_t& counter) noexcept
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	/// The recent cycles
+	std::unique_ptr<Cycle[]> mHistory;
+	/// The number of recent cycles to retain
+	uint32_t mHistoryCapacity;
+	/// Mask used to wrap history indexes
+	uint32_t mHistoryMask;
+
+	/// The log for signposts
+	os_log_t mLog;
+	/// The signpost ID for cycle intervals
+	os_signpost_id_t mSignpostID;
+
+	/// The numerator of the host time base
+	uint32_t mTimebaseNumerator;
+	/// The denominator of the host time base
+	uint32_t mTimebaseDenominator;
+
+	/// The cycle in progress
+	Cycle mCurrentCycle;
+	/// The sample time expected for the next cycle
+	Float64 mNextSampleTime;
+	/// @c true if @c mNextSampleTime is valid
+	bool mNextSampleTimeIsValid;
+
+	/// The number of cycles recorded
+	std::atomic_uint64_t mCycleCount;
+	/// The number of missed deadlines
+	std::atomic_uint64_t mMissedDeadlines;
+	/// The number of discontinuities
+	std::atomic_uint64_t mDiscontinuities;
+
+	/// Cycle durations
+	AtomicHistogram mCycleDuration;
+	/// Deadline slack
+	AtomicHistogram mDeadlineSlack;
+	/// Deadline lateness
+	AtomicHistogram mDeadlineLateness;
+	/// Discontinuity magnitudes
+	AtomicHistogram mDiscontinuity;
+	/// Rate scalar drift
+	AtomicHistogram mRateScalarDrift;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
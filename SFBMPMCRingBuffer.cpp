@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstdlib>
+#import <cstring>
+#import <limits>
+#import <new>
+#import <assert.h>
+
+#import "SFBMPMCRingBuffer.hpp"
+
+namespace {
+
+/// Returns the smallest power of two value greater than @c x
+/// @param x A value in the range [2..2147483648]
+/// @return The smallest power of two greater than @c x
+inline constexpr uint32_t NextPowerOfTwo(uint32_t x) noexcept
+{
+	assert(x > 1);
+	assert(x <= ((std::numeric_limits<uint32_t>::max() / 2) + 1));
+	return static_cast<uint32_t>(1 << (32 - __builtin_clz(x - 1)));
+}
+
+}
+
+#pragma mark Creation and Destruction
+
+SFB::MPMCRingBuffer::MPMCRingBuffer() noexcept
+: mSequences(nullptr), mElements(nullptr), mElementSize(0), mCapacityElements(0), mCapacityElementsMask(0), mWritePosition(0), mReadPosition(0)
+{
+	assert(mWritePosition.is_lock_free());
+}
+
+SFB::MPMCRingBuffer::~MPMCRingBuffer()
+{
+	std::free(mSequences);
+}
+
+#pragma mark Buffer Management
+
+bool SFB::MPMCRingBuffer::Allocate(uint32_t elementSize, uint32_t elementCount) noexcept
+{
+	if(elementSize == 0 || elementCount < 2 || elementCount > 0x80000000)
+		return false;
+
+	// Round up to the next power of two
+	elementCount = NextPowerOfTwo(static_cast<uint32_t>(elementCount));
+
+	auto capacityBytes = static_cast<uint64_t>(elementSize) * elementCount;
+	if(capacityBytes > std::numeric_limits<uint32_t>::max())
+		return false;
+
+	Deallocate();
+
+	// One memory allocation holds everything- first the sequence numbers followed by the elements
+	auto allocationSize = static_cast<size_t>((sizeof(std::atomic_uint64_t) * elementCount) + capacityBytes);
+	uint8_t *memoryChunk = static_cast<uint8_t *>(std::malloc(allocationSize));
+	if(!memoryChunk)
+		return false;
+
+	mSequences = reinterpret_cast<std::atomic_uint64_t *>(memoryChunk);
+	for(uint32_t i = 0; i < elementCount; ++i)
+		new (mSequences + i) std::atomic_uint64_t(0);
+	mElements = memoryChunk + sizeof(std::atomic_uint64_t) * elementCount;
+
+	mElementSize = elementSize;
+	mCapacityElements = elementCount;
+	mCapacityElementsMask = elementCount - 1;
+
+	Reset();
+
+	return true;
+}
+
+void SFB::MPMCRingBuffer::Deallocate() noexcept
+{
+	if(mSequences) {
+		std::free(mSequences);
+		mSequences = nullptr;
+		mElements = nullptr;
+
+		mElementSize = 0;
+		mCapacityElements = 0;
+		mCapacityElementsMask = 0;
+
+		Reset();
+	}
+}
+
+void SFB::MPMCRingBuffer::Reset() noexcept
+{
+	// A slot is ready to be written at position p when its sequence number equals p
+	for(uint32_t i = 0; i < mCapacityElements; ++i)
+		mSequences[i].store(i, std::memory_order_relaxed);
+
+	mReadPosition = 0;
+	mWritePosition = 0;
+}
+
+uint32_t SFB::MPMCRingBuffer::BytesAvailableToRead() const noexcept
+{
+	auto readPosition = mReadPosition.load(std::memory_order_acquire);
+	auto writePosition = mWritePosition.load(std::memory_order_acquire);
+
+	// The positions are read separately so a concurrent read may make the difference appear negative
+	if(writePosition <= readPosition)
+		return 0;
+	return static_cast<uint32_t>(std::min(writePosition - readPosition, static_cast<uint64_t>(mCapacityElements))) * mElementSize;
+}
+
+uint32_t SFB::MPMCRingBuffer::BytesAvailableToWrite() const noexcept
+{
+	return CapacityBytes() - BytesAvailableToRead();
+}
+
+#pragma mark Reading and Writing Data
+
+uint32_t SFB::MPMCRingBuffer::Read(void * const destinationBuffer, uint32_t byteCount) noexcept
+{
+	if(!destinationBuffer || mElementSize == 0)
+		return 0;
+
+	auto destination = static_cast<uint8_t *>(destinationBuffer);
+	auto elementCount = byteCount / mElementSize;
+
+	uint32_t elementsRead = 0;
+	while(elementsRead < elementCount && ReadElement(destination + elementsRead * mElementSize))
+		++elementsRead;
+
+	return elementsRead * mElementSize;
+}
+
+uint32_t SFB::MPMCRingBuffer::Write(const void * const sourceBuffer, uint32_t byteCount) noexcept
+{
+	if(!sourceBuffer || mElementSize == 0)
+		return 0;
+
+	auto source = static_cast<const uint8_t *>(sourceBuffer);
+	auto elementCount = byteCount / mElementSize;
+
+	uint32_t elementsWritten = 0;
+	while(elementsWritten < elementCount && WriteElement(source + elementsWritten * mElementSize))
+		++elementsWritten;
+
+	return elementsWritten * mElementSize;
+}
+
+#pragma mark Internals
+
+bool SFB::MPMCRingBuffer::ReadElement(uint8_t * const destination) noexcept
+{
+	auto position = mReadPosition.load(std::memory_order_relaxed);
+	for(;;) {
+		auto index = static_cast<uint32_t>(position & mCapacityElementsMask);
+		auto sequence = mSequences[index].load(std::memory_order_acquire);
+		auto difference = static_cast<int64_t>(sequence - (position + 1));
+
+		// The slot contains an element written at this position
+		if(difference == 0) {
+			// On failure position is updated with the current value
+			if(mReadPosition.compare_exchange_strong(position, position + 1, std::memory_order_relaxed)) {
+				std::memcpy(destination, mElements + index * mElementSize, mElementSize);
+				// Mark the slot ready to be written one lap later
+				mSequences[index].store(position + mCapacityElements, std::memory_order_release);
+				return true;
+			}
+		}
+		// The slot hasn't been written yet so the buffer is empty
+		else if(difference < 0)
+			return false;
+		// Another reader claimed this position
+		else
+			position = mReadPosition.load(std::memory_order_relaxed);
+	}
+}
+
+bool SFB::MPMCRingBuffer::WriteElement(const uint8_t * const source) noexcept
+{
+	auto position = mWritePosition.load(std::memory_order_relaxed);
+	for(;;) {
+		auto index = static_cast<uint32_t>(position & mCapacityElementsMask);
+		auto sequence = mSequences[index].load(std::memory_order_acquire);
+		auto difference = static_cast<int64_t>(sequence - position);
+
+		// The slot is free for this position
+		if(difference == 0) {
+			// On failure position is updated with the current value
+			if(mWritePosition.compare_exchange_strong(position, position + 1, std::memory_order_relaxed)) {
+				std::memcpy(mElements + index * mElementSize, source, mElementSize);
+				// Mark the slot ready to be read
+				mSequences[index].store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		// The slot still contains an element from the previous lap so the buffer is full
+		else if(difference < 0)
+			return false;
+		// Another writer claimed this position
+		else
+			position = mWritePosition.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+
+#import "SFBHardwareInterferenceSize.hpp"
+
+namespace SFB {
+
+/// A bounded ring buffer of fixed-size elements supporting multiple readers and writers.
+///
+/// This class is thread safe when used from any number of reader and writer threads (multiple producer, multiple
+/// consumer model).
+///
+/// Each element slot contains a sequence number identifying whether it is ready to be written or read. A thread claims a
+/// slot by advancing the shared write or read position with a compare-and-swap and publishes the slot by updating its
+/// sequence number. Elements are the unit of atomicity: the elements of a multi-element write may be interleaved with
+/// elements from other writers, and concurrent readers divide the available elements between them.
+///
+/// No operation blocks or waits for another thread. Failed compare-and-swaps are retried only when another thread made
+/// progress. A thread suspended between claiming and publishing a slot may cause other threads to observe the buffer as
+/// temporarily empty or full; in that case @c Read() and @c Write() return short counts instead of waiting.
+class MPMCRingBuffer
+{
+
+public:
+
+#pragma mark Creation and Destruction
+
+	/// Creates a new @c MPMCRingBuffer
+	/// @note @c Allocate() must be called before the object may be used.
+	MPMCRingBuffer() noexcept;
+
+	// This class is non-copyable
+	MPMCRingBuffer(const MPMCRingBuffer& rhs) = delete;
+
+	// This class is non-assignable
+	MPMCRingBuffer& operator=(const MPMCRingBuffer& rhs) = delete;
+
+	/// Destroys the @c MPMCRingBuffer and release all associated resources.
+	~MPMCRingBuffer();
+
+	// This class is non-movable
+	MPMCRingBuffer(MPMCRingBuffer&& rhs) = delete;
+
+	// This class is non-move assignable
+	MPMCRingBuffer& operator=(MPMCRingBuffer&& rhs) = delete;
+
+#pragma mark Buffer management
+
+	/// Allocates space for data.
+	/// @note This method is not thread safe.
+	/// @note Capacities from 2 to 2,147,483,648 (0x80000000) elements are supported
+	/// @note The total capacity in bytes may not exceed 4,294,967,295 (0xFFFFFFFF)
+	/// @param elementSize The size of a single element in bytes, for example the size of an audio frame
+	/// @param elementCount The desired capacity, in elements
+	/// @return @c true on success, @c false on error
+	bool Allocate(uint32_t elementSize, uint32_t elementCount) noexcept;
+
+	/// Frees the resources used by this @c MPMCRingBuffer
+	/// @note This method is not thread safe.
+	void Deallocate() noexcept;
+
+
+	/// Resets this @c MPMCRingBuffer to its default state.
+	/// @note This method is not thread safe.
+	void Reset() noexcept;
+
+
+	/// Returns the size of a single element in bytes
+	inline uint32_t ElementSize() const noexcept
+	{
+		return mElementSize;
+	}
+
+	/// Returns the capacity of this @c MPMCRingBuffer in bytes
+	inline uint32_t CapacityBytes() const noexcept
+	{
+		return mCapacityElements * mElementSize;
+	}
+
+	/// Returns the number of bytes available for reading
+	/// @note The value is a snapshot and may be out of date by the time it is used
+	uint32_t BytesAvailableToRead() const noexcept;
+
+	/// Returns the free space available for writing in bytes
+	/// @note The value is a snapshot and may be out of date by the time it is used
+	uint32_t BytesAvailableToWrite() const noexcept;
+
+#pragma mark Reading and writing data
+
+	/// Read data from the @c MPMCRingBuffer, advancing the read position.
+	/// @note Only whole elements are read
+	/// @param destinationBuffer An address to receive the data
+	/// @param byteCount The desired number of bytes to read
+	/// @return The number of bytes actually read, which is a multiple of @c ElementSize()
+	uint32_t Read(void * const _Nonnull destinationBuffer, uint32_t byteCount) noexcept;
+
+	/// Write data to the @c MPMCRingBuffer, advancing the write position.
+	/// @note Only whole elements are written
+	/// @param sourceBuffer An address containing the data to copy
+	/// @param byteCount The desired number of bytes to write
+	/// @return The number of bytes actually written, which is a multiple of @c ElementSize()
+	uint32_t Write(const void * const _Nonnull sourceBuffer, uint32_t byteCount) noexcept;
+
+private:
+
+	/// Claims one slot for reading, copies its element to @c destination, and releases the slot
+	bool ReadElement(uint8_t * const _Nonnull destination) noexcept;
+
+	/// Claims one slot for writing, copies @c source to it, and publishes the slot
+	bool WriteElement(const uint8_t * const _Nonnull source) noexcept;
+
+	/// The slot sequence numbers followed by the element storage, allocated in one chunk of memory
+	std::atomic_uint64_t * _Nullable mSequences;
+	/// The element storage
+	uint8_t * _Nullable mElements;
+
+	/// The size of a single element in bytes
+	uint32_t mElementSize;
+	/// The capacity in elements
+	uint32_t mCapacityElements;
+	/// Mask used to wrap positions
+	/// @note Equal to @c mCapacityElements-1
+	uint32_t mCapacityElementsMask;
+
+	/// The next position to be claimed for writing
+	alignas(DestructiveInterferenceSize) std::atomic_uint64_t mWritePosition;
+	/// The next position to be claimed for reading
+	alignas(DestructiveInterferenceSize) std::atomic_uint64_t mReadPosition;
+
+};
+
+} // namespace SFB
@@ -0,0 +1,104 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstdlib>
+#import <stdexcept>
+
+#import "SFBMappedAudioFileReader.hpp"
+#import "SFBCAAudioFile.hpp"
+
+bool SFB::MappedAudioFileReader::IsSupportedFormat(const CAStreamBasicDescription& format) noexcept
+{
+	return format.IsPCM() && format.IsInterleaved() && format.mFramesPerPacket == 1 && format.mBytesPerFrame > 0 && format.mBytesPerPacket == format.mBytesPerFrame;
+}
+
+#pragma mark Creation and Destruction
+
+SFB::MappedAudioFileReader::MappedAudioFileReader(CFURLRef url)
+: mDataOffset(0), mFrameLength(0)
+{
+	CAAudioFile audioFile;
+	audioFile.OpenURL(url, kAudioFileReadPermission, 0);
+
+	mFormat = audioFile.FileDataFormat();
+	if(!IsSupportedFormat(mFormat))
+		throw std::invalid_argument("Unsupported audio data format");
+
+	auto dataOffset = audioFile.DataOffset();
+	auto byteCount = audioFile.AudioDataByteCount();
+	audioFile.Close();
+
+	mFile = MemoryMappedFile(url);
+
+	if(dataOffset < 0 || static_cast<UInt64>(dataOffset) > mFile.Size())
+		throw std::invalid_argument("Invalid audio data offset");
+
+	// Files whose header overstates the amount of audio are truncated to the data present
+	mDataOffset = static_cast<std::size_t>(dataOffset);
+	byteCount = std::min(byteCount, static_cast<UInt64>(mFile.Size() - mDataOffset));
+	mFrameLength = static_cast<SInt64>(byteCount / mFormat.mBytesPerFrame);
+}
+
+#pragma mark Reading
+
+const void * SFB::MappedAudioFileReader::FrameData(SInt64 frame) const noexcept
+{
+	if(frame < 0 || frame >= mFrameLength)
+		return nullptr;
+	return static_cast<const uint8_t *>(mFile.Data()) + mDataOffset + static_cast<std::size_t>(frame) * mFormat.mBytesPerFrame;
+}
+
+UInt32 SFB::MappedAudioFileReader::GetFrames(AudioBufferList& bufferList, SInt64 startingFrame, UInt32 frameCount) const noexcept
+{
+	auto data = FrameData(startingFrame);
+	if(!data || bufferList.mNumberBuffers != 1)
+		return 0;
+
+	auto framesToReference = static_cast<UInt32>(std::min(static_cast<SInt64>(frameCount), mFrameLength - startingFrame));
+
+	bufferList.mBuffers[0].mNumberChannels = mFormat.mChannelsPerFrame;
+	bufferList.mBuffers[0].mData = const_cast<void *>(data);
+	bufferList.mBuffers[0].mDataByteSize = framesToReference * mFormat.mBytesPerFrame;
+
+	return framesToReference;
+}
+
+SFB::CABufferList SFB::MappedAudioFileReader::View(SInt64 startingFrame, UInt32 frameCount) const noexcept
+{
+	CABufferList view;
+
+	// Only the AudioBufferList is allocated; the audio remains in the mapping
+	auto bufferList = static_cast<AudioBufferList *>(std::malloc(sizeof(AudioBufferList)));
+	if(!bufferList)
+		return view;
+
+	bufferList->mNumberBuffers = 1;
+	auto framesReferenced = GetFrames(*bufferList, startingFrame, frameCount);
+	if(framesReferenced == 0) {
+		std::free(bufferList);
+		return view;
+	}
+
+	view.AdoptABL(bufferList, mFormat, framesReferenced, framesReferenced);
+	return view;
+}
+
+#pragma mark Paging
+
+bool SFB::MappedAudioFileReader::Advise(MemoryMappedFile::Access access) const noexcept
+{
+	return mFile.Advise(access);
+}
+
+bool SFB::MappedAudioFileReader::Prefetch(SInt64 startingFrame, UInt32 frameCount) const noexcept
+{
+	if(startingFrame < 0 || startingFrame >= mFrameLength)
+		return false;
+
+	auto frames = std::min(static_cast<SInt64>(frameCount), mFrameLength - startingFrame);
+	return mFile.Prefetch(mDataOffset + static_cast<std::size_t>(startingFrame) * mFormat.mBytesPerFrame, static_cast<std::size_t>(frames) * mFormat.mBytesPerFrame);
+}
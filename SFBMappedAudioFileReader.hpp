@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <CoreFoundation/CoreFoundation.h>
+
+#import "SFBCABufferList.hpp"
+#import "SFBCAStreamBasicDescription.hpp"
+#import "SFBMemoryMappedFile.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A reader providing zero-copy access to the audio in an uncompressed audio file
+///
+/// The location and layout of the audio data is determined using @c AudioFile and the file is memory mapped. Audio is
+/// returned as views pointing directly into the mapping so random access costs at most a page fault.
+///
+/// Files containing interleaved linear PCM with one frame per packet, such as WAVE, AIFF, and uncompressed CAF
+/// files, are supported. The format of the returned audio is the file's data format, which may not be native-endian.
+///
+/// @code
+/// SFB::MappedAudioFileReader reader(url);
+/// auto view = reader.View(48000 * 60, 4096);
+/// @endcode
+/// @note Views are invalid after the reader is destroyed. Modifications to a view are private and never written to
+/// the file.
+class MappedAudioFileReader
+{
+
+public:
+
+	/// Returns @c true if audio in @c format can be read by a @c MappedAudioFileReader
+	static bool IsSupportedFormat(const CAStreamBasicDescription& format) noexcept;
+
+#pragma mark Creation and Destruction
+
+	/// Opens the audio file at @c url and maps its audio data
+	/// @throws @c std::invalid_argument if the file's data format is not supported
+	/// @throws @c std::system_error
+	explicit MappedAudioFileReader(CFURLRef url);
+
+	// This class is non-copyable
+	MappedAudioFileReader(const MappedAudioFileReader& rhs) = delete;
+
+	// This class is non-assignable
+	MappedAudioFileReader& operator=(const MappedAudioFileReader& rhs) = delete;
+
+	/// Destructor
+	~MappedAudioFileReader() = default;
+
+	/// Move constructor
+	MappedAudioFileReader(MappedAudioFileReader&& rhs) noexcept = default;
+
+	/// Move assignment operator
+	MappedAudioFileReader& operator=(MappedAudioFileReader&& rhs) noexcept = default;
+
+#pragma mark File Information
+
+	/// Returns the format of the audio data
+	inline const CAStreamBasicDescription& Format() const noexcept
+	{
+		return mFormat;
+	}
+
+	/// Returns the number of audio frames in the file
+	inline SInt64 FrameLength() const noexcept
+	{
+		return mFrameLength;
+	}
+
+#pragma mark Reading
+
+	/// Returns the address of audio frame @c frame or @c nullptr if @c frame is out of range
+	const void * _Nullable FrameData(SInt64 frame) const noexcept;
+
+	/// Sets the single buffer in @c bufferList to reference audio frames in the file
+	///
+	/// This performs no allocation.
+	/// @param bufferList An @c AudioBufferList with one buffer
+	/// @param startingFrame The first frame to reference
+	/// @param frameCount The desired number of frames to reference
+	/// @return The number of frames referenced, which is less than @c frameCount at the end of the file
+	UInt32 GetFrames(AudioBufferList& bufferList, SInt64 startingFrame, UInt32 frameCount) const noexcept;
+
+	/// Returns a @c CABufferList referencing audio frames in the file
+	/// @param startingFrame The first frame to reference
+	/// @param frameCount The desired number of frames to reference
+	/// @return A @c CABufferList whose frame length and capacity equal the number of frames referenced, or an empty
+	/// @c CABufferList on error
+	CABufferList View(SInt64 startingFrame, UInt32 frameCount) const noexcept;
+
+#pragma mark Paging
+
+	/// Advises the system of the expected access pattern for the audio data
+	/// @return @c true on success, @c false otherwise
+	bool Advise(MemoryMappedFile::Access access) const noexcept;
+
+	/// Asks the system to page in audio frames ahead of access
+	/// @param startingFrame The first frame to page in
+	/// @param frameCount The number of frames to page in
+	/// @return @c true on success, @c false otherwise
+	bool Prefetch(SInt64 startingFrame, UInt32 frameCount) const noexcept;
+
+private:
+
+	/// The mapped file
+	MemoryMappedFile mFile;
+	/// The format of the audio data
+	CAStreamBasicDescription mFormat;
+	/// The byte offset of the audio data in @c mFile
+	std::size_t mDataOffset;
+	/// The number of audio frames in the file
+	SInt64 mFrameLength;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
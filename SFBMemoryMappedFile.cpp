@@ -0,0 +1,148 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cerrno>
+#import <climits>
+#import <stdexcept>
+#import <system_error>
+
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "SFBMemoryMappedFile.hpp"
+#import "SFBDeferredClosure.hpp"
+
+namespace {
+
+/// Returns the system page size
+std::size_t PageSize() noexcept
+{
+	static const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	return pageSize;
+}
+
+}
+
+#pragma mark Creation and Destruction
+
+SFB::MemoryMappedFile::MemoryMappedFile() noexcept
+: mData(nullptr), mSize(0)
+{}
+
+SFB::MemoryMappedFile::MemoryMappedFile(const char *path)
+: MemoryMappedFile()
+{
+	Map(path);
+}
+
+SFB::MemoryMappedFile::MemoryMappedFile(CFURLRef url)
+: MemoryMappedFile()
+{
+	char path [PATH_MAX];
+	if(!url || !CFURLGetFileSystemRepresentation(url, true, reinterpret_cast<UInt8 *>(path), sizeof path))
+		throw std::invalid_argument("url is not a file URL");
+	Map(path);
+}
+
+SFB::MemoryMappedFile::~MemoryMappedFile()
+{
+	Unmap();
+}
+
+SFB::MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& rhs) noexcept
+: mData(rhs.mData), mSize(rhs.mSize)
+{
+	rhs.mData = nullptr;
+	rhs.mSize = 0;
+}
+
+SFB::MemoryMappedFile& SFB::MemoryMappedFile::operator=(MemoryMappedFile&& rhs) noexcept
+{
+	if(this != &rhs) {
+		Unmap();
+
+		mData = rhs.mData;
+		mSize = rhs.mSize;
+
+		rhs.mData = nullptr;
+		rhs.mSize = 0;
+	}
+
+	return *this;
+}
+
+#pragma mark Mapping
+
+void SFB::MemoryMappedFile::Map(const char *path)
+{
+	Unmap();
+
+	auto fd = open(path, O_RDONLY);
+	if(fd == -1)
+		throw std::system_error(errno, std::generic_category(), "open");
+
+	// The mapping remains valid after the descriptor is closed
+	auto lambda = [fd]() {
+		close(fd);
+	};
+	DeferredClosure<decltype(lambda)> cleanup(lambda);
+
+	struct stat s;
+	if(fstat(fd, &s) == -1)
+		throw std::system_error(errno, std::generic_category(), "fstat");
+
+	// Empty files can't be mapped
+	if(s.st_size == 0)
+		throw std::system_error(EINVAL, std::generic_category(), "mmap");
+
+	auto data = mmap(nullptr, static_cast<std::size_t>(s.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category(), "mmap");
+
+	mData = data;
+	mSize = static_cast<std::size_t>(s.st_size);
+}
+
+void SFB::MemoryMappedFile::Unmap() noexcept
+{
+	if(mData) {
+		munmap(mData, mSize);
+		mData = nullptr;
+		mSize = 0;
+	}
+}
+
+#pragma mark Paging
+
+bool SFB::MemoryMappedFile::Advise(Access access) const noexcept
+{
+	if(!mData)
+		return false;
+
+	int advice = MADV_NORMAL;
+	switch(access) {
+		case Access::normal:		advice = MADV_NORMAL;		break;
+		case Access::sequential:	advice = MADV_SEQUENTIAL;	break;
+		case Access::random:		advice = MADV_RANDOM;		break;
+	}
+
+	return madvise(mData, mSize, advice) == 0;
+}
+
+bool SFB::MemoryMappedFile::Prefetch(std::size_t offset, std::size_t length) const noexcept
+{
+	if(!mData || offset >= mSize)
+		return false;
+
+	// madvise requires a page-aligned address
+	auto pageOffset = offset & ~(PageSize() - 1);
+	length = std::min(length + (offset - pageOffset), mSize - pageOffset);
+
+	return madvise(static_cast<uint8_t *>(mData) + pageOffset, length, MADV_WILLNEED) == 0;
+}
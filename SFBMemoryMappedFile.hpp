@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <cstddef>
+
+#import <CoreFoundation/CoreFoundation.h>
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A read-only memory mapping of a file
+///
+/// The file is mapped copy-on-write: the mapped pages may be modified but changes are private to the process and are
+/// never written to the file.
+class MemoryMappedFile
+{
+
+public:
+
+	/// The expected pattern of access to mapped pages
+	enum class Access {
+		/// No special treatment
+		normal,
+		/// Pages are accessed in increasing order
+		sequential,
+		/// Pages are accessed in random order
+		random,
+	};
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c MemoryMappedFile
+	MemoryMappedFile() noexcept;
+
+	/// Maps the file at @c path
+	/// @throws @c std::system_error
+	explicit MemoryMappedFile(const char *path);
+
+	/// Maps the file at @c url
+	/// @throws @c std::invalid_argument if @c url is not a file URL
+	/// @throws @c std::system_error
+	explicit MemoryMappedFile(CFURLRef url);
+
+	// This class is non-copyable
+	MemoryMappedFile(const MemoryMappedFile& rhs) = delete;
+
+	// This class is non-assignable
+	MemoryMappedFile& operator=(const MemoryMappedFile& rhs) = delete;
+
+	/// Unmaps the file
+	~MemoryMappedFile();
+
+	/// Move constructor
+	MemoryMappedFile(MemoryMappedFile&& rhs) noexcept;
+
+	/// Move assignment operator
+	MemoryMappedFile& operator=(MemoryMappedFile&& rhs) noexcept;
+
+#pragma mark Mapping
+
+	/// Maps the file at @c path, unmapping the current file if any
+	/// @throws @c std::system_error
+	void Map(const char *path);
+
+	/// Unmaps the file
+	void Unmap() noexcept;
+
+	/// Returns @c true if a file is mapped
+	inline explicit operator bool() const noexcept
+	{
+		return mData != nullptr;
+	}
+
+	/// Returns @c true if no file is mapped
+	inline bool operator!() const noexcept
+	{
+		return !operator bool();
+	}
+
+	/// Returns the address of the mapping
+	inline const void * _Nullable Data() const noexcept
+	{
+		return mData;
+	}
+
+	/// Returns the size of the mapping in bytes
+	inline std::size_t Size() const noexcept
+	{
+		return mSize;
+	}
+
+#pragma mark Paging
+
+	/// Advises the system of the expected access pattern for the entire mapping
+	/// @return @c true on success, @c false otherwise
+	bool Advise(Access access) const noexcept;
+
+	/// Asks the system to page in a range of the mapping ahead of access
+	/// @param offset The byte offset of the range
+	/// @param length The length of the range in bytes
+	/// @return @c true on success, @c false otherwise
+	bool Prefetch(std::size_t offset, std::size_t length) const noexcept;
+
+private:
+
+	/// The address of the mapping
+	void * _Nullable mData;
+	/// The size of the mapping in bytes
+	std::size_t mSize;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <mach/mach.h>
+
+#import "SFBMirroredMemory.hpp"
+
+std::size_t SFB::MirroredRegionGranularity() noexcept
+{
+	return vm_page_size;
+}
+
+void * SFB::AllocateMirroredRegions(std::size_t regionSize, std::size_t regionCount) noexcept
+{
+	if(regionSize == 0 || regionCount == 0 || regionSize % vm_page_size)
+		return nullptr;
+
+	// Reserve address space for both halves of every region
+	vm_address_t address = 0;
+	kern_return_t result = vm_allocate(mach_task_self(), &address, 2 * regionSize * regionCount, VM_FLAGS_ANYWHERE);
+	if(result != KERN_SUCCESS)
+		return nullptr;
+
+	// Map the second half of each region onto the pages of the first half
+	for(std::size_t i = 0; i < regionCount; ++i) {
+		vm_address_t region = address + 2 * regionSize * i;
+		vm_address_t mirror = region + regionSize;
+		vm_prot_t currentProtection, maximumProtection;
+		result = vm_remap(mach_task_self(), &mirror, regionSize, 0, VM_FLAGS_FIXED | VM_FLAGS_OVERWRITE, mach_task_self(), region, FALSE, &currentProtection, &maximumProtection, VM_INHERIT_DEFAULT);
+		if(result != KERN_SUCCESS || mirror != region + regionSize) {
+			vm_deallocate(mach_task_self(), address, 2 * regionSize * regionCount);
+			return nullptr;
+		}
+	}
+
+	return reinterpret_cast<void *>(address);
+}
+
+void SFB::DeallocateMirroredRegions(void *regions, std::size_t regionSize, std::size_t regionCount) noexcept
+{
+	vm_deallocate(mach_task_self(), reinterpret_cast<vm_address_t>(regions), 2 * regionSize * regionCount);
+}
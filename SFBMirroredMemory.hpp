@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <cstddef>
+
+namespace SFB {
+
+/// Returns the granularity of mirrored regions in bytes
+///
+/// The size of a mirrored region must be a multiple of this value, which is the virtual memory page size.
+std::size_t MirroredRegionGranularity() noexcept;
+
+/// Allocates zero-filled memory for @c regionCount consecutive mirrored regions of @c regionSize bytes
+///
+/// Each region occupies @c 2*regionSize bytes of address space with the second half mapped to the same physical pages as
+/// the first half, so a write to byte @c n of a region is visible at byte @c n+regionSize and vice versa. Region @c i
+/// begins at byte offset @c 2*i*regionSize.
+/// @note @c regionSize must be a multiple of @c MirroredRegionGranularity()
+/// @param regionSize The size of each region in bytes
+/// @param regionCount The number of regions
+/// @return The address of the first region or @c nullptr on error
+void * _Nullable AllocateMirroredRegions(std::size_t regionSize, std::size_t regionCount) noexcept;
+
+/// Deallocates memory allocated by @c AllocateMirroredRegions()
+/// @param regions The address of the first region
+/// @param regionSize The size of each region in bytes
+/// @param regionCount The number of regions
+void DeallocateMirroredRegions(void * _Nonnull regions, std::size_t regionSize, std::size_t regionCount) noexcept;
+
+} // namespace SFB
@@ -0,0 +1,225 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstring>
+#import <exception>
+#import <stdexcept>
+#import <utility>
+
+#import <pthread.h>
+
+#import <os/log.h>
+
+#import "SFBMultiBusAudioUnitRecorder.hpp"
+#import "SFBRecorderOutput.hpp"
+
+/// An output recording all or some of the channels of a bus to a file
+struct SFB::MultiBusAudioUnitRecorder::Output {
+	/// The file receiving the recorded audio
+	detail::RecorderOutput mRecorderOutput;
+	/// The bus number to record
+	UInt32 mBusNumber;
+	/// The channels of the bus to record, or empty to record all channels
+	std::vector<UInt32> mChannels;
+	/// The format of the bus
+	CAStreamBasicDescription mBusFormat;
+
+	/// Creates a new @c Output for @c busNumber
+	Output(UInt32 busNumber, std::vector<UInt32> channels)
+	: mBusNumber(busNumber), mChannels(std::move(channels))
+	{}
+
+	/// Copies @c frameCount frames from @c bufferList starting at @c frameOffset to @c buffer
+	void CopyChannels(const AudioBufferList * const _Nonnull bufferList, UInt32 frameOffset, const AudioRingBuffer::WriteBuffer& buffer, UInt32 frameCount) const noexcept
+	{
+		auto sampleSize = mBusFormat.SampleWordSize();
+		for(UInt32 i = 0; i < mChannels.size(); ++i) {
+			auto dst = static_cast<uint8_t *>(buffer.Channel(i));
+			auto channel = mChannels[i];
+			if(mBusFormat.IsInterleaved()) {
+				auto src = static_cast<const uint8_t *>(bufferList->mBuffers[0].mData) + frameOffset * mBusFormat.mBytesPerFrame + channel * sampleSize;
+				for(UInt32 frame = 0; frame < frameCount; ++frame, src += mBusFormat.mBytesPerFrame, dst += sampleSize)
+					std::memcpy(dst, src, sampleSize);
+			}
+			else
+				std::memcpy(dst, static_cast<const uint8_t *>(bufferList->mBuffers[channel].mData) + frameOffset * sampleSize, frameCount * sampleSize);
+		}
+	}
+
+	/// Copies rendered audio to the ring buffer
+	void Store(const AudioBufferList * const _Nonnull bufferList, UInt32 frameCount) noexcept
+	{
+		if(mChannels.empty()) {
+			mRecorderOutput.Store(bufferList, frameCount);
+			return;
+		}
+
+		mRecorderOutput.Store(frameCount, [&](AudioRingBuffer& ringBuffer) noexcept {
+			auto [front, back] = ringBuffer.WriteVector();
+			auto framesInFront = std::min(frameCount, front.mFrameCapacity);
+			CopyChannels(bufferList, 0, front, framesInFront);
+			if(frameCount > framesInFront)
+				CopyChannels(bufferList, framesInFront, back, frameCount - framesInFront);
+			ringBuffer.AdvanceWritePosition(frameCount);
+		});
+	}
+};
+
+SFB::MultiBusAudioUnitRecorder::MultiBusAudioUnitRecorder(AudioUnit au, UInt32 ringBufferFrameCapacity, UInt32 writeBatchFrameCount)
+: mAudioUnit(au), mRingBufferFrameCapacity(ringBufferFrameCapacity), mWriteBatchFrameCount(writeBatchFrameCount), mSemaphore(0), mKeepWriting(false)
+{
+	if(!au)
+		throw std::invalid_argument("au == nullptr");
+	if(ringBufferFrameCapacity == 0 || writeBatchFrameCount == 0)
+		throw std::invalid_argument("ringBufferFrameCapacity == 0 || writeBatchFrameCount == 0");
+}
+
+SFB::MultiBusAudioUnitRecorder::~MultiBusAudioUnitRecorder()
+{
+	try {
+		Stop();
+	}
+	catch(const std::exception& e) {
+		os_log_error(OS_LOG_DEFAULT, "Error stopping recording: %{public}s", e.what());
+	}
+}
+
+std::size_t SFB::MultiBusAudioUnitRecorder::AddOutput(UInt32 busNumber, CFURLRef outputFileURL, AudioFileTypeID fileType, const AudioStreamBasicDescription& format, std::vector<UInt32> channels)
+{
+	if(IsRecording())
+		throw std::logic_error("Outputs may not be added while recording");
+
+	auto output = std::make_unique<Output>(busNumber, std::move(channels));
+	output->mRecorderOutput.ExtAudioFile().CreateWithURL(outputFileURL, fileType, format, nullptr, kAudioFileFlags_EraseFile);
+	mOutputs.push_back(std::move(output));
+	return mOutputs.size() - 1;
+}
+
+void SFB::MultiBusAudioUnitRecorder::Start()
+{
+	if(mOutputs.empty() || IsRecording())
+		return;
+
+	// All allocations occur here, before the render callback is installed
+	for(auto& output : mOutputs) {
+		if(!output->mRecorderOutput.IsPrepared())
+			Prepare(*output);
+	}
+
+	UInt32 busCount = 0;
+	for(const auto& output : mOutputs)
+		busCount = std::max(busCount, output->mBusNumber + 1);
+
+	mOutputsByBus.assign(busCount, {});
+	for(auto& output : mOutputs)
+		mOutputsByBus[output->mBusNumber].push_back(output.get());
+
+	mKeepWriting.store(true, std::memory_order_release);
+	mWriterThread = std::thread(&MultiBusAudioUnitRecorder::WriterThreadEntry, this);
+
+	auto result = AudioUnitAddRenderNotify(mAudioUnit, RenderCallback, this);
+	if(result != noErr) {
+		mKeepWriting.store(false, std::memory_order_release);
+		mSemaphore.Signal();
+		mWriterThread.join();
+		ThrowIfCAAudioUnitError(result, "AudioUnitAddRenderNotify");
+	}
+}
+
+void SFB::MultiBusAudioUnitRecorder::Stop()
+{
+	if(!IsRecording())
+		return;
+
+	OSStatus result = AudioUnitRemoveRenderNotify(mAudioUnit, RenderCallback, this);
+
+	// The writer thread drains the ring buffers before exiting
+	mKeepWriting.store(false, std::memory_order_release);
+	mSemaphore.Signal();
+	mWriterThread.join();
+
+	ThrowIfCAAudioUnitError(result, "AudioUnitRemoveRenderNotify");
+}
+
+SFB::MultiBusAudioUnitRecorder::Statistics SFB::MultiBusAudioUnitRecorder::GetStatistics(std::size_t index) const noexcept
+{
+	if(index >= mOutputs.size())
+		return {};
+
+	return mOutputs[index]->mRecorderOutput.GetStatistics();
+}
+
+void SFB::MultiBusAudioUnitRecorder::ResetStatistics() noexcept
+{
+	for(auto& output : mOutputs)
+		output->mRecorderOutput.ResetStatistics();
+}
+
+OSStatus SFB::MultiBusAudioUnitRecorder::RenderCallback(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp, UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+	MultiBusAudioUnitRecorder *THIS = static_cast<MultiBusAudioUnitRecorder *>(inRefCon);
+	if(*ioActionFlags & kAudioUnitRenderAction_PostRender) {
+		if(inBusNumber < THIS->mOutputsByBus.size() && !(*ioActionFlags & kAudioUnitRenderAction_PostRenderError)) {
+			bool signal = false;
+			for(auto output : THIS->mOutputsByBus[inBusNumber]) {
+				output->Store(ioData, inNumberFrames);
+				signal = signal || output->mRecorderOutput.HasFullBatch();
+			}
+
+			// Wake the writer thread once a full batch is available
+			if(signal)
+				THIS->mSemaphore.Signal();
+		}
+	}
+	return noErr;
+}
+
+void SFB::MultiBusAudioUnitRecorder::Prepare(Output& output)
+{
+	CAStreamBasicDescription busFormat;
+	UInt32 size = sizeof(busFormat);
+	OSStatus result = AudioUnitGetProperty(mAudioUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, output.mBusNumber, &busFormat, &size);
+	ThrowIfCAAudioUnitError(result, "AudioUnitGetProperty");
+
+	// A channel subset is recorded as non-interleaved audio in the bus's sample format
+	auto clientFormat = busFormat;
+	if(!output.mChannels.empty()) {
+		if(!busFormat.IsPCM())
+			throw std::invalid_argument("Channel subsets require linear PCM");
+		for(auto channel : output.mChannels) {
+			if(channel >= busFormat.mChannelsPerFrame)
+				throw std::invalid_argument("Channel not present in bus");
+		}
+
+		clientFormat.mChannelsPerFrame = static_cast<UInt32>(output.mChannels.size());
+		clientFormat.mFormatFlags |= kAudioFormatFlagIsNonInterleaved;
+		clientFormat.mBytesPerFrame = busFormat.SampleWordSize();
+		clientFormat.mBytesPerPacket = clientFormat.mBytesPerFrame * clientFormat.mFramesPerPacket;
+	}
+
+	output.mRecorderOutput.Prepare(clientFormat, mRingBufferFrameCapacity, mWriteBatchFrameCount);
+	output.mBusFormat = busFormat;
+}
+
+void SFB::MultiBusAudioUnitRecorder::WriterThreadEntry() noexcept
+{
+	pthread_setname_np("org.sbooth.MultiBusAudioUnitRecorder");
+
+	while(mKeepWriting.load(std::memory_order_acquire)) {
+		mSemaphore.Wait(dispatch_time(DISPATCH_TIME_NOW, detail::RecorderOutput::sWriterTimeout));
+		DrainRingBuffers();
+	}
+
+	// Write any audio rendered before the render callback was removed
+	DrainRingBuffers();
+}
+
+void SFB::MultiBusAudioUnitRecorder::DrainRingBuffers() noexcept
+{
+	for(auto& output : mOutputs)
+		output->mRecorderOutput.Drain();
+}
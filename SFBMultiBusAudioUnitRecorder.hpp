@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <cstddef>
+#import <memory>
+#import <thread>
+#import <vector>
+
+#import <AudioToolbox/AudioUnit.h>
+
+#import "SFBAudioUnitRecorder.hpp"
+#import "SFBDispatchSemaphore.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A class that writes the output from several buses or channel subsets of an @c AudioUnit to separate files
+///
+/// A single render notify is installed on the @c AudioUnit. On the render thread the audio from each bus is routed
+/// to the outputs recording that bus using a table indexed by bus number. Each output copies its channels to its own
+/// preallocated @c AudioRingBuffer. One shared writer thread drains all the ring buffers and writes to the files in
+/// large batches.
+///
+/// @code
+/// SFB::MultiBusAudioUnitRecorder recorder(mixer);
+/// recorder.AddOutput(0, leftURL, kAudioFileCAFType, fileFormat, {0});
+/// recorder.AddOutput(0, rightURL, kAudioFileCAFType, fileFormat, {1});
+/// recorder.Start();
+/// @endcode
+class MultiBusAudioUnitRecorder
+{
+
+public:
+
+	/// Recording statistics for an output
+	using Statistics = AudioUnitRecorder::Statistics;
+
+	/// Default constructor
+	MultiBusAudioUnitRecorder() noexcept = delete;
+
+	// This class is non-copyable
+	MultiBusAudioUnitRecorder(const MultiBusAudioUnitRecorder& rhs) = delete;
+
+	// This class is non-assignable
+	MultiBusAudioUnitRecorder& operator=(const MultiBusAudioUnitRecorder& rhs) = delete;
+
+	/// Stops recording and destroys the @c MultiBusAudioUnitRecorder
+	~MultiBusAudioUnitRecorder();
+
+	// This class is non-movable
+	MultiBusAudioUnitRecorder(MultiBusAudioUnitRecorder&& rhs) = delete;
+
+	// This class is non-move assignable
+	MultiBusAudioUnitRecorder& operator=(MultiBusAudioUnitRecorder&& rhs) = delete;
+
+	/// Creates a new @c MultiBusAudioUnitRecorder for an @c AudioUnit
+	/// @param au The @c AudioUnit to record
+	/// @param ringBufferFrameCapacity The minimum capacity of each output's ring buffer in frames
+	/// @param writeBatchFrameCount The maximum number of frames written to a file at once
+	/// @throws @c std::invalid_argument
+	/// @throws @c std::runtime_error
+	MultiBusAudioUnitRecorder(AudioUnit au, UInt32 ringBufferFrameCapacity = AudioUnitRecorder::sDefaultRingBufferFrameCapacity, UInt32 writeBatchFrameCount = AudioUnitRecorder::sDefaultWriteBatchFrameCount);
+
+	/// Adds an output recording a bus of the @c AudioUnit to a file
+	/// @note Outputs may only be added when not recording
+	/// @param busNumber The bus number to record
+	/// @param outputFileURL The URL of the output audio file
+	/// @param fileType The type of the file to create
+	/// @param format The format of the audio data to be written to the file
+	/// @param channels The channels of the bus to record, or an empty vector to record all channels
+	/// @return The index of the output
+	/// @throws @c std::logic_error if recording
+	/// @throws @c std::system_error
+	std::size_t AddOutput(UInt32 busNumber, CFURLRef outputFileURL, AudioFileTypeID fileType, const AudioStreamBasicDescription& format, std::vector<UInt32> channels = {});
+
+	/// Returns the number of outputs
+	inline std::size_t OutputCount() const noexcept
+	{
+		return mOutputs.size();
+	}
+
+	/// Starts recording
+	///
+	/// Each output's ring buffer and write buffer are allocated the first time recording starts.
+	/// @throws @c std::bad_alloc
+	/// @throws @c std::invalid_argument if a channel is not present in its bus
+	/// @throws @c std::system_error
+	void Start();
+
+	/// Stops recording
+	///
+	/// Audio remaining in the ring buffers is written to the files before this method returns.
+	/// @throws @c std::system_error
+	void Stop();
+
+	/// Returns @c true if recording
+	inline bool IsRecording() const noexcept
+	{
+		return mWriterThread.joinable();
+	}
+
+	/// Returns the recording statistics for the output at @c index
+	/// @note Each value is read atomically but the values are not read as a group
+	Statistics GetStatistics(std::size_t index) const noexcept;
+
+	/// Resets the recording statistics for all outputs
+	void ResetStatistics() noexcept;
+
+private:
+
+	struct Output;
+
+	/// Routes rendered audio to the outputs recording its bus
+	static OSStatus RenderCallback(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp, UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData);
+
+	/// Allocates the buffers for @c output
+	void Prepare(Output& output);
+
+	/// The writer thread entry point
+	void WriterThreadEntry() noexcept;
+
+	/// Writes all audio in the ring buffers to the files
+	void DrainRingBuffers() noexcept;
+
+	/// The @c AudioUnit to record
+	AudioUnit mAudioUnit;
+	/// The minimum capacity of each ring buffer in frames
+	UInt32 mRingBufferFrameCapacity;
+	/// The maximum number of frames written to a file at once
+	UInt32 mWriteBatchFrameCount;
+
+	/// The outputs
+	std::vector<std::unique_ptr<Output>> mOutputs;
+	/// The outputs recording each bus, indexed by bus number
+	std::vector<std::vector<Output *>> mOutputsByBus;
+
+	/// Signaled when there is audio to write or the writer thread should exit
+	DispatchSemaphore mSemaphore;
+	/// The writer thread
+	std::thread mWriterThread;
+	/// @c false if the writer thread should exit
+	std::atomic_bool mKeepWriting;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
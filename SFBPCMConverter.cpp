@@ -0,0 +1,464 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstring>
+#import <stdexcept>
+
+#import "SFBPCMConverter.hpp"
+
+namespace {
+
+/// The number of samples converted per block
+constexpr std::size_t kBlockSize = 256;
+
+/// The initial state of the dither generator
+constexpr uint32_t kDitherSeed = 0x9E3779B9;
+
+/// Native byte order
+constexpr bool kNativeIsBigEndian = kAudioFormatFlagsNativeEndian == kAudioFormatFlagIsBigEndian;
+
+/// Supported sample types
+enum class SampleType {
+	int16,
+	int24,
+	int32,
+	float32,
+	float64,
+};
+
+/// Returns the number of significant bits in a sample of type @c type
+constexpr int SampleBits(SampleType type) noexcept
+{
+	switch(type) {
+		case SampleType::int16:		return 16;
+		case SampleType::int24:		return 24;
+		case SampleType::int32:		return 32;
+		case SampleType::float32:	return 24;
+		case SampleType::float64:	return 53;
+	}
+	return 0;
+}
+
+/// Returns @c true if @c type is a floating point sample type
+constexpr bool IsFloat(SampleType type) noexcept
+{
+	return type == SampleType::float32 || type == SampleType::float64;
+}
+
+/// Determines the sample type of @c format
+/// @return @c true on success, @c false if @c format is not a supported sample format
+bool GetSampleType(const SFB::CAStreamBasicDescription& format, SampleType& type) noexcept
+{
+	if(!format.IsPCM() || !format.IsPacked() || format.mChannelsPerFrame == 0)
+		return false;
+
+	auto wordSize = format.SampleWordSize();
+	if(wordSize * 8 != format.mBitsPerChannel)
+		return false;
+
+	if(format.IsFloat()) {
+		if(wordSize == 4)
+			type = SampleType::float32;
+		else if(wordSize == 8)
+			type = SampleType::float64;
+		else
+			return false;
+	}
+	else if(format.IsSignedInteger()) {
+		if(wordSize == 2)
+			type = SampleType::int16;
+		else if(wordSize == 3)
+			type = SampleType::int24;
+		else if(wordSize == 4)
+			type = SampleType::int32;
+		else
+			return false;
+	}
+	else
+		return false;
+
+	return true;
+}
+
+/// Reads a sample of type @c T from @c p and returns it normalized as @c I
+template <SampleType T, bool BigEndian, typename I>
+inline I LoadSample(const uint8_t * const p) noexcept
+{
+	constexpr bool swap = BigEndian != kNativeIsBigEndian;
+
+	if constexpr(T == SampleType::int16) {
+		uint16_t u;
+		std::memcpy(&u, p, sizeof u);
+		if constexpr(swap)
+			u = __builtin_bswap16(u);
+		return static_cast<I>(static_cast<int16_t>(u)) * (I(1) / I(1u << 15));
+	}
+	else if constexpr(T == SampleType::int24) {
+		// Place the sample in the high bits of a 32-bit word to preserve the sign
+		uint32_t u;
+		if constexpr(BigEndian)
+			u = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8);
+		else
+			u = (uint32_t(p[2]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[0]) << 8);
+		return static_cast<I>(static_cast<int32_t>(u)) * (I(1) / I(1u << 31));
+	}
+	else if constexpr(T == SampleType::int32) {
+		uint32_t u;
+		std::memcpy(&u, p, sizeof u);
+		if constexpr(swap)
+			u = __builtin_bswap32(u);
+		return static_cast<I>(static_cast<int32_t>(u)) * (I(1) / I(1u << 31));
+	}
+	else if constexpr(T == SampleType::float32) {
+		uint32_t u;
+		std::memcpy(&u, p, sizeof u);
+		if constexpr(swap)
+			u = __builtin_bswap32(u);
+		float f;
+		std::memcpy(&f, &u, sizeof f);
+		return static_cast<I>(f);
+	}
+	else {
+		uint64_t u;
+		std::memcpy(&u, p, sizeof u);
+		if constexpr(swap)
+			u = __builtin_bswap64(u);
+		double d;
+		std::memcpy(&d, &u, sizeof d);
+		return static_cast<I>(d);
+	}
+}
+
+/// Returns a triangular random value in the open interval (-1, 1)
+template <typename I>
+inline I TriangularDither(uint32_t& state) noexcept
+{
+	// xorshift32
+	auto next = [&state]() noexcept {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	};
+
+	constexpr I scale = I(1) / I(4294967296.0);
+	auto a = static_cast<I>(next()) * scale;
+	auto b = static_cast<I>(next()) * scale;
+	return a - b;
+}
+
+/// Writes the normalized value @c value to @c p as a sample of type @c T
+template <SampleType T, bool BigEndian, bool Dither, typename I>
+inline void StoreSample(uint8_t * const p, I value, uint32_t& ditherState) noexcept
+{
+	constexpr bool swap = BigEndian != kNativeIsBigEndian;
+
+	if constexpr(T == SampleType::float32) {
+		auto f = static_cast<float>(value);
+		uint32_t u;
+		std::memcpy(&u, &f, sizeof u);
+		if constexpr(swap)
+			u = __builtin_bswap32(u);
+		std::memcpy(p, &u, sizeof u);
+	}
+	else if constexpr(T == SampleType::float64) {
+		auto d = static_cast<double>(value);
+		uint64_t u;
+		std::memcpy(&u, &d, sizeof u);
+		if constexpr(swap)
+			u = __builtin_bswap64(u);
+		std::memcpy(p, &u, sizeof u);
+	}
+	else {
+		constexpr I scale = static_cast<I>(1ull << (SampleBits(T) - 1));
+		constexpr I minimum = -scale;
+		constexpr I maximum = scale - I(1);
+
+		auto x = value * scale;
+		if constexpr(Dither)
+			x += TriangularDither<I>(ditherState);
+
+		// Clip, mapping NaN to the minimum, and round half away from zero
+		x = x > minimum ? x : minimum;
+		x = x < maximum ? x : maximum;
+		auto i = static_cast<int32_t>(x + (x < I(0) ? I(-0.5) : I(0.5)));
+
+		if constexpr(T == SampleType::int16) {
+			auto u = static_cast<uint16_t>(i);
+			if constexpr(swap)
+				u = __builtin_bswap16(u);
+			std::memcpy(p, &u, sizeof u);
+		}
+		else if constexpr(T == SampleType::int24) {
+			auto u = static_cast<uint32_t>(i);
+			if constexpr(BigEndian) {
+				p[0] = static_cast<uint8_t>(u >> 16);
+				p[1] = static_cast<uint8_t>(u >> 8);
+				p[2] = static_cast<uint8_t>(u);
+			}
+			else {
+				p[0] = static_cast<uint8_t>(u);
+				p[1] = static_cast<uint8_t>(u >> 8);
+				p[2] = static_cast<uint8_t>(u >> 16);
+			}
+		}
+		else {
+			auto u = static_cast<uint32_t>(i);
+			if constexpr(swap)
+				u = __builtin_bswap32(u);
+			std::memcpy(p, &u, sizeof u);
+		}
+	}
+}
+
+/// The size in bytes of a sample of type @c T
+template <SampleType T>
+constexpr std::ptrdiff_t kSampleSize = T == SampleType::int16 ? 2 : T == SampleType::int24 ? 3 : T == SampleType::float64 ? 8 : 4;
+
+/// Converts @c count samples of type @c T spaced @c stride bytes apart to @c I
+template <SampleType T, bool BigEndian, typename I>
+void Decode(const uint8_t * const src, std::ptrdiff_t stride, void * const block, std::size_t count) noexcept
+{
+	auto dst = static_cast<I *>(block);
+	// The constant stride in the contiguous case allows the loop to be vectorized
+	if(stride == kSampleSize<T>) {
+		for(std::size_t i = 0; i < count; ++i)
+			dst[i] = LoadSample<T, BigEndian, I>(src + i * kSampleSize<T>);
+	}
+	else {
+		for(std::size_t i = 0; i < count; ++i)
+			dst[i] = LoadSample<T, BigEndian, I>(src + i * stride);
+	}
+}
+
+/// Converts @c count samples of @c I to type @c T spaced @c stride bytes apart
+template <SampleType T, bool BigEndian, bool Dither, typename I>
+void Encode(const void * const block, uint8_t * const dst, std::ptrdiff_t stride, std::size_t count, uint32_t& ditherState) noexcept
+{
+	auto src = static_cast<const I *>(block);
+	if(stride == kSampleSize<T>) {
+		for(std::size_t i = 0; i < count; ++i)
+			StoreSample<T, BigEndian, Dither, I>(dst + i * kSampleSize<T>, src[i], ditherState);
+	}
+	else {
+		for(std::size_t i = 0; i < count; ++i)
+			StoreSample<T, BigEndian, Dither, I>(dst + i * stride, src[i], ditherState);
+	}
+}
+
+/// Returns the decoder for samples of type @c type
+template <typename I, typename F>
+F DecoderFor(SampleType type, bool bigEndian) noexcept
+{
+	switch(type) {
+		case SampleType::int16:		return bigEndian ? Decode<SampleType::int16, true, I> : Decode<SampleType::int16, false, I>;
+		case SampleType::int24:		return bigEndian ? Decode<SampleType::int24, true, I> : Decode<SampleType::int24, false, I>;
+		case SampleType::int32:		return bigEndian ? Decode<SampleType::int32, true, I> : Decode<SampleType::int32, false, I>;
+		case SampleType::float32:	return bigEndian ? Decode<SampleType::float32, true, I> : Decode<SampleType::float32, false, I>;
+		case SampleType::float64:	return bigEndian ? Decode<SampleType::float64, true, I> : Decode<SampleType::float64, false, I>;
+	}
+	return nullptr;
+}
+
+/// Returns the encoder for samples of type @c type
+template <typename I, typename F>
+F EncoderFor(SampleType type, bool bigEndian, bool dither) noexcept
+{
+	switch(type) {
+		case SampleType::int16:
+			if(dither)
+				return bigEndian ? Encode<SampleType::int16, true, true, I> : Encode<SampleType::int16, false, true, I>;
+			return bigEndian ? Encode<SampleType::int16, true, false, I> : Encode<SampleType::int16, false, false, I>;
+		case SampleType::int24:
+			if(dither)
+				return bigEndian ? Encode<SampleType::int24, true, true, I> : Encode<SampleType::int24, false, true, I>;
+			return bigEndian ? Encode<SampleType::int24, true, false, I> : Encode<SampleType::int24, false, false, I>;
+		case SampleType::int32:
+			if(dither)
+				return bigEndian ? Encode<SampleType::int32, true, true, I> : Encode<SampleType::int32, false, true, I>;
+			return bigEndian ? Encode<SampleType::int32, true, false, I> : Encode<SampleType::int32, false, false, I>;
+		case SampleType::float32:	return bigEndian ? Encode<SampleType::float32, true, false, I> : Encode<SampleType::float32, false, false, I>;
+		case SampleType::float64:	return bigEndian ? Encode<SampleType::float64, true, false, I> : Encode<SampleType::float64, false, false, I>;
+	}
+	return nullptr;
+}
+
+}
+
+bool SFB::PCMConverter::IsSupported(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat) noexcept
+{
+	SampleType sourceType, destinationType;
+	return GetSampleType(sourceFormat, sourceType) && GetSampleType(destinationFormat, destinationType) && sourceFormat.mChannelsPerFrame == destinationFormat.mChannelsPerFrame && sourceFormat.mSampleRate == destinationFormat.mSampleRate;
+}
+
+#pragma mark Creation and Destruction
+
+SFB::PCMConverter::PCMConverter() noexcept
+: mSourceSampleSize(0), mDestinationSampleSize(0), mDecode(nullptr), mEncode(nullptr), mIsCopy(false), mDithers(false), mDitherState(kDitherSeed)
+{}
+
+SFB::PCMConverter::PCMConverter(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat, Dither dither)
+: PCMConverter()
+{
+	if(!Configure(sourceFormat, destinationFormat, dither))
+		throw std::invalid_argument("Unsupported PCM conversion");
+}
+
+#pragma mark Configuration
+
+bool SFB::PCMConverter::Configure(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat, Dither dither) noexcept
+{
+	SampleType sourceType, destinationType;
+	if(!GetSampleType(sourceFormat, sourceType) || !GetSampleType(destinationFormat, destinationType) || sourceFormat.mChannelsPerFrame != destinationFormat.mChannelsPerFrame || sourceFormat.mSampleRate != destinationFormat.mSampleRate)
+		return false;
+
+	mSourceFormat = sourceFormat;
+	mDestinationFormat = destinationFormat;
+	mSourceSampleSize = sourceFormat.SampleWordSize();
+	mDestinationSampleSize = destinationFormat.SampleWordSize();
+
+	mIsCopy = sourceType == destinationType && sourceFormat.IsBigEndian() == destinationFormat.IsBigEndian();
+
+	// Dither only when an integer destination discards precision
+	mDithers = dither == Dither::triangular && !mIsCopy && !IsFloat(destinationType) && (IsFloat(sourceType) || SampleBits(sourceType) > SampleBits(destinationType));
+	mDitherState = kDitherSeed;
+
+	// Single precision is exact for 16- and 24-bit integers and 32-bit floats
+	auto needsDouble = [](SampleType type) noexcept {
+		return type == SampleType::int32 || type == SampleType::float64;
+	};
+
+	if(needsDouble(sourceType) || needsDouble(destinationType)) {
+		mDecode = DecoderFor<double, DecodeFunction>(sourceType, sourceFormat.IsBigEndian());
+		mEncode = EncoderFor<double, EncodeFunction>(destinationType, destinationFormat.IsBigEndian(), mDithers);
+	}
+	else {
+		mDecode = DecoderFor<float, DecodeFunction>(sourceType, sourceFormat.IsBigEndian());
+		mEncode = EncoderFor<float, EncodeFunction>(destinationType, destinationFormat.IsBigEndian(), mDithers);
+	}
+
+	return true;
+}
+
+#pragma mark Conversion
+
+UInt32 SFB::PCMConverter::Convert(const CABufferList& source, CABufferList& destination) noexcept
+{
+	if(!mDecode || !source || !destination || source.Format() != mSourceFormat || destination.Format() != mDestinationFormat)
+		return 0;
+
+	auto frameCount = std::min(source.FrameLength(), destination.FrameCapacity());
+
+	// Discard the existing contents so no frames are moved
+	destination.SetFrameLength(0);
+	destination.SetFrameLength(frameCount);
+
+	return Convert(source.ABL(), destination.ABL(), frameCount);
+}
+
+UInt32 SFB::PCMConverter::Convert(const AudioBufferList * const source, AudioBufferList * const destination, UInt32 frameCount) noexcept
+{
+	if(!mDecode || !source || !destination || source->mNumberBuffers != mSourceFormat.ChannelStreamCount() || destination->mNumberBuffers != mDestinationFormat.ChannelStreamCount())
+		return 0;
+
+	for(UInt32 i = 0; i < source->mNumberBuffers; ++i)
+		frameCount = std::min(frameCount, source->mBuffers[i].mDataByteSize / mSourceFormat.mBytesPerFrame);
+
+	ConvertChannels([&](UInt32 stream) noexcept {
+		return static_cast<const uint8_t *>(source->mBuffers[stream].mData);
+	}, [&](UInt32 stream) noexcept {
+		return static_cast<uint8_t *>(destination->mBuffers[stream].mData);
+	}, frameCount);
+
+	for(UInt32 i = 0; i < destination->mNumberBuffers; ++i)
+		destination->mBuffers[i].mDataByteSize = frameCount * mDestinationFormat.mBytesPerFrame;
+
+	return frameCount;
+}
+
+UInt32 SFB::PCMConverter::Convert(const AudioBufferList * const source, UInt32 sourceFrameOffset, uint8_t * const * const destination, UInt32 destinationFrameOffset, UInt32 frameCount) noexcept
+{
+	if(!mDecode || !source || !destination || source->mNumberBuffers != mSourceFormat.ChannelStreamCount())
+		return 0;
+
+	auto sourceByteOffset = sourceFrameOffset * mSourceFormat.mBytesPerFrame;
+	auto destinationByteOffset = destinationFrameOffset * mDestinationFormat.mBytesPerFrame;
+
+	for(UInt32 i = 0; i < source->mNumberBuffers; ++i) {
+		if(sourceByteOffset >= source->mBuffers[i].mDataByteSize)
+			return 0;
+		frameCount = std::min(frameCount, (source->mBuffers[i].mDataByteSize - sourceByteOffset) / mSourceFormat.mBytesPerFrame);
+	}
+
+	ConvertChannels([&](UInt32 stream) noexcept {
+		return static_cast<const uint8_t *>(source->mBuffers[stream].mData) + sourceByteOffset;
+	}, [&](UInt32 stream) noexcept {
+		return destination[stream] + destinationByteOffset;
+	}, frameCount);
+
+	return frameCount;
+}
+
+#pragma mark Internals
+
+template <typename S, typename D>
+void SFB::PCMConverter::ConvertChannels(S&& source, D&& destination, UInt32 frameCount) noexcept
+{
+	if(frameCount == 0)
+		return;
+
+	auto channelCount = mSourceFormat.mChannelsPerFrame;
+
+	// Matching layouts are converted as contiguous runs
+	if(mSourceFormat.IsInterleaved() == mDestinationFormat.IsInterleaved()) {
+		auto streamCount = mSourceFormat.ChannelStreamCount();
+		auto samplesPerStream = static_cast<std::size_t>(frameCount) * mSourceFormat.InterleavedChannelCount();
+		for(UInt32 stream = 0; stream < streamCount; ++stream) {
+			if(mIsCopy)
+				std::memcpy(destination(stream), source(stream), samplesPerStream * mSourceSampleSize);
+			else
+				ConvertSamples(source(stream), mSourceSampleSize, destination(stream), mDestinationSampleSize, samplesPerStream);
+		}
+	}
+	// Otherwise each channel is interleaved or deinterleaved during conversion
+	else {
+		for(UInt32 channel = 0; channel < channelCount; ++channel) {
+			const uint8_t *src;
+			uint8_t *dst;
+			std::ptrdiff_t srcStride, dstStride;
+
+			if(mSourceFormat.IsInterleaved()) {
+				src = source(0) + channel * mSourceSampleSize;
+				srcStride = mSourceFormat.mBytesPerFrame;
+				dst = destination(channel);
+				dstStride = mDestinationSampleSize;
+			}
+			else {
+				src = source(channel);
+				srcStride = mSourceSampleSize;
+				dst = destination(0) + channel * mDestinationSampleSize;
+				dstStride = mDestinationFormat.mBytesPerFrame;
+			}
+
+			ConvertSamples(src, srcStride, dst, dstStride, frameCount);
+		}
+	}
+}
+
+void SFB::PCMConverter::ConvertSamples(const uint8_t *src, std::ptrdiff_t srcStride, uint8_t *dst, std::ptrdiff_t dstStride, std::size_t count) noexcept
+{
+	alignas(64) double block [kBlockSize];
+
+	while(count > 0) {
+		auto n = std::min(count, kBlockSize);
+		mDecode(src, srcStride, block, n);
+		mEncode(block, dst, dstStride, n, mDitherState);
+		src += n * srcStride;
+		dst += n * dstStride;
+		count -= n;
+	}
+}
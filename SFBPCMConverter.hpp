@@ -0,0 +1,175 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <cstddef>
+
+#import <CoreAudioTypes/CoreAudioTypes.h>
+
+#import "SFBCABufferList.hpp"
+#import "SFBCAStreamBasicDescription.hpp"
+
+namespace SFB {
+
+/// A converter between linear PCM sample formats
+///
+/// Conversions between signed 16-, 24-, and 32-bit integer and 32- and 64-bit floating point samples of either
+/// endianness and interleaving are supported. The channel count and sample rate of the formats must match.
+///
+/// The conversion kernels are selected once when the converter is configured. Samples are converted in small blocks
+/// through a @c float or @c double intermediate so each kernel is a simple loop that compilers can vectorize.
+/// Conversions between identical formats are copies.
+///
+/// Integer samples are normalized so full scale is [-1, 1). Conversions to integer samples round to the nearest value
+/// and clip. Triangular dither may be added when reducing bit depth.
+/// @note This class is not thread safe because the dither generator has state
+class PCMConverter
+{
+
+public:
+
+	/// Dither applied when converting to an integer format with fewer bits of precision
+	enum class Dither {
+		/// No dither
+		none,
+		/// Triangular probability density function dither with an amplitude of ±1 LSB
+		triangular,
+	};
+
+	/// Returns @c true if conversion from @c sourceFormat to @c destinationFormat is supported
+	static bool IsSupported(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat) noexcept;
+
+#pragma mark Creation and Destruction
+
+	/// Creates an empty @c PCMConverter
+	/// @note @c Configure() must be called before the object may be used.
+	PCMConverter() noexcept;
+
+	/// Creates a new @c PCMConverter
+	/// @param sourceFormat The format of the audio to convert
+	/// @param destinationFormat The format of the converted audio
+	/// @param dither The dither to apply when reducing bit depth
+	/// @throws @c std::invalid_argument if the conversion is not supported
+	PCMConverter(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat, Dither dither = Dither::none);
+
+	// This class is non-copyable
+	PCMConverter(const PCMConverter& rhs) = delete;
+
+	// This class is non-assignable
+	PCMConverter& operator=(const PCMConverter& rhs) = delete;
+
+	/// Destructor
+	~PCMConverter() = default;
+
+	// This class is non-movable
+	PCMConverter(PCMConverter&& rhs) = delete;
+
+	// This class is non-move assignable
+	PCMConverter& operator=(PCMConverter&& rhs) = delete;
+
+#pragma mark Configuration
+
+	/// Selects the conversion kernels for @c sourceFormat and @c destinationFormat
+	/// @param sourceFormat The format of the audio to convert
+	/// @param destinationFormat The format of the converted audio
+	/// @param dither The dither to apply when reducing bit depth
+	/// @return @c true on success, @c false if the conversion is not supported
+	bool Configure(const CAStreamBasicDescription& sourceFormat, const CAStreamBasicDescription& destinationFormat, Dither dither = Dither::none) noexcept;
+
+	/// Returns the format of the audio to convert
+	inline const CAStreamBasicDescription& SourceFormat() const noexcept
+	{
+		return mSourceFormat;
+	}
+
+	/// Returns the format of the converted audio
+	inline const CAStreamBasicDescription& DestinationFormat() const noexcept
+	{
+		return mDestinationFormat;
+	}
+
+	/// Returns @c true if dither is applied by this converter
+	inline bool Dithers() const noexcept
+	{
+		return mDithers;
+	}
+
+	/// Returns @c true if this @c PCMConverter has been configured
+	inline explicit operator bool() const noexcept
+	{
+		return mDecode != nullptr;
+	}
+
+	/// Returns @c true if this @c PCMConverter has not been configured
+	inline bool operator!() const noexcept
+	{
+		return !operator bool();
+	}
+
+#pragma mark Conversion
+
+	/// Converts the contents of @c source to @c destination
+	/// @note The formats of @c source and @c destination must match @c SourceFormat() and @c DestinationFormat()
+	/// @param source The audio to convert
+	/// @param destination A buffer to receive the converted audio
+	/// @return The number of frames converted, which is limited by the capacity of @c destination
+	UInt32 Convert(const CABufferList& source, CABufferList& destination) noexcept;
+
+	/// Converts @c frameCount frames from @c source to @c destination
+	/// @note The layouts of @c source and @c destination must match @c SourceFormat() and @c DestinationFormat()
+	/// @param source The audio to convert
+	/// @param destination An @c AudioBufferList to receive the converted audio
+	/// @param frameCount The number of frames to convert
+	/// @return The number of frames converted
+	UInt32 Convert(const AudioBufferList * const _Nonnull source, AudioBufferList * const _Nonnull destination, UInt32 frameCount) noexcept;
+
+	/// Converts @c frameCount frames from @c source to channel buffers
+	/// @note The layout of @c source must match @c SourceFormat()
+	/// @param source The audio to convert
+	/// @param sourceFrameOffset The frame offset in @c source to begin reading
+	/// @param destination An array of @c DestinationFormat().ChannelStreamCount() buffers to receive the converted audio
+	/// @param destinationFrameOffset The frame offset in @c destination to begin writing
+	/// @param frameCount The number of frames to convert
+	/// @return The number of frames converted, which is limited by the byte sizes of the buffers in @c source
+	UInt32 Convert(const AudioBufferList * const _Nonnull source, UInt32 sourceFrameOffset, uint8_t * const _Nonnull * const _Nonnull destination, UInt32 destinationFrameOffset, UInt32 frameCount) noexcept;
+
+private:
+
+	/// Converts @c count samples spaced @c stride bytes apart to the intermediate format
+	using DecodeFunction = void (*)(const uint8_t * _Nonnull src, std::ptrdiff_t stride, void * _Nonnull block, std::size_t count);
+	/// Converts @c count samples from the intermediate format to samples spaced @c stride bytes apart
+	using EncodeFunction = void (*)(const void * _Nonnull block, uint8_t * _Nonnull dst, std::ptrdiff_t stride, std::size_t count, uint32_t& ditherState);
+
+	/// Converts the channels located by @c source and @c destination
+	template <typename S, typename D>
+	void ConvertChannels(S&& source, D&& destination, UInt32 frameCount) noexcept;
+
+	/// Converts @c count samples
+	void ConvertSamples(const uint8_t * _Nonnull src, std::ptrdiff_t srcStride, uint8_t * _Nonnull dst, std::ptrdiff_t dstStride, std::size_t count) noexcept;
+
+	/// The format of the audio to convert
+	CAStreamBasicDescription mSourceFormat;
+	/// The format of the converted audio
+	CAStreamBasicDescription mDestinationFormat;
+	/// The size of a source sample in bytes
+	UInt32 mSourceSampleSize;
+	/// The size of a destination sample in bytes
+	UInt32 mDestinationSampleSize;
+	/// The source sample decoder
+	DecodeFunction _Nullable mDecode;
+	/// The destination sample encoder
+	EncodeFunction _Nullable mEncode;
+	/// Whether the sample formats are identical
+	bool mIsCopy;
+	/// Whether dither is applied
+	bool mDithers;
+	/// The state of the dither generator
+	uint32_t mDitherState;
+
+};
+
+} // namespace SFB
@@ -0,0 +1,352 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cstdlib>
+#import <cstring>
+#import <limits>
+#import <assert.h>
+
+#import "SFBPacketRingBuffer.hpp"
+#import "SFBMirroredMemory.hpp"
+
+namespace {
+
+/// The header preceding each packet in the buffer
+struct RecordHeader {
+	/// The size of the record in bytes, including the header
+	uint32_t mRecordSize;
+	/// Record flags
+	uint32_t mFlags;
+	/// The size of the packet in bytes
+	uint32_t mDataByteSize;
+	/// The number of frames in the packet
+	uint32_t mVariableFramesInPacket;
+	/// The packet timestamp
+	AudioTimeStamp mTimeStamp;
+};
+
+/// Record flag indicating the space to the end of the buffer is unused
+constexpr uint32_t kRecordFlagSkip = 1u << 0;
+
+/// The alignment of records in the buffer
+constexpr uint32_t kRecordAlignment = 16;
+/// The size of a record header
+constexpr uint32_t kRecordHeaderSize = (sizeof(RecordHeader) + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+/// The minimum buffer capacity
+constexpr uint32_t kMinimumCapacityBytes = 256;
+
+static_assert(alignof(RecordHeader) <= kRecordAlignment, "Record headers must be aligned");
+
+/// Returns the smallest power of two value greater than @c x
+/// @param x A value in the range [2..2147483648]
+/// @return The smallest power of two greater than @c x
+inline constexpr uint32_t NextPowerOfTwo(uint32_t x) noexcept
+{
+	assert(x > 1);
+	assert(x <= ((std::numeric_limits<uint32_t>::max() / 2) + 1));
+	return static_cast<uint32_t>(1 << (32 - __builtin_clz(x - 1)));
+}
+
+/// Returns the size of the record for a packet of @c byteSize bytes
+inline constexpr uint32_t RecordSize(uint32_t byteSize) noexcept
+{
+	return (kRecordHeaderSize + byteSize + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+/// Returns the number of bytes available for reading
+/// @param writePosition The write position
+/// @param readPosition The read position
+/// @param capacityBytes The buffer capacity in bytes
+/// @param capacityBytesMask The buffer capacity in bytes minus one
+inline constexpr uint32_t ReadableBytes(uint32_t writePosition, uint32_t readPosition, uint32_t capacityBytes, uint32_t capacityBytesMask) noexcept
+{
+	if(writePosition > readPosition)
+		return writePosition - readPosition;
+	else
+		return (writePosition - readPosition + capacityBytes) & capacityBytesMask;
+}
+
+/// Returns the number of bytes available for writing
+/// @param writePosition The write position
+/// @param readPosition The read position
+/// @param capacityBytes The buffer capacity in bytes
+/// @param capacityBytesMask The buffer capacity in bytes minus one
+inline constexpr uint32_t WritableBytes(uint32_t writePosition, uint32_t readPosition, uint32_t capacityBytes, uint32_t capacityBytesMask) noexcept
+{
+	if(writePosition > readPosition)
+		return ((readPosition - writePosition + capacityBytes) & capacityBytesMask) - 1;
+	else if(writePosition < readPosition)
+		return (readPosition - writePosition) - 1;
+	else
+		return capacityBytes - 1;
+}
+
+}
+
+#pragma mark Creation and Destruction
+
+SFB::PacketRingBuffer::PacketRingBuffer() noexcept
+: mBuffer(nullptr), mCapacityBytes(0), mCapacityBytesMask(0), mIsMirrored(false), mWritePosition(0), mCachedReadPosition(0), mReservedPosition(0), mReservedByteSize(0), mIsReserved(false), mReadPosition(0), mCachedWritePosition(0)
+{
+	assert(mWritePosition.is_lock_free());
+}
+
+SFB::PacketRingBuffer::~PacketRingBuffer()
+{
+	Deallocate();
+}
+
+#pragma mark Buffer Management
+
+bool SFB::PacketRingBuffer::Allocate(uint32_t capacityBytes, bool mirrored) noexcept
+{
+	if(capacityBytes < 2 || capacityBytes > 0x80000000)
+		return false;
+
+	Deallocate();
+
+	// Round up to the next power of two
+	capacityBytes = std::max(NextPowerOfTwo(static_cast<uint32_t>(capacityBytes)), kMinimumCapacityBytes);
+
+	if(mirrored) {
+		// The granularity is a power of two so the capacity remains a power of two
+		auto granularity = MirroredRegionGranularity();
+		if(granularity > 0x80000000)
+			return false;
+		capacityBytes = std::max(capacityBytes, static_cast<uint32_t>(granularity));
+		mBuffer = static_cast<uint8_t *>(AllocateMirroredRegions(capacityBytes, 1));
+	}
+	else
+		mBuffer = static_cast<uint8_t *>(std::malloc(capacityBytes));
+
+	if(!mBuffer)
+		return false;
+
+	mIsMirrored = mirrored;
+
+	mCapacityBytes = capacityBytes;
+	mCapacityBytesMask = capacityBytes - 1;
+
+	Reset();
+
+	return true;
+}
+
+void SFB::PacketRingBuffer::Deallocate() noexcept
+{
+	if(mBuffer) {
+		if(mIsMirrored)
+			DeallocateMirroredRegions(mBuffer, mCapacityBytes, 1);
+		else
+			std::free(mBuffer);
+		mBuffer = nullptr;
+
+		mCapacityBytes = 0;
+		mCapacityBytesMask = 0;
+		mIsMirrored = false;
+
+		Reset();
+	}
+}
+
+void SFB::PacketRingBuffer::Reset() noexcept
+{
+	mReadPosition = 0;
+	mWritePosition = 0;
+	mCachedReadPosition = 0;
+	mCachedWritePosition = 0;
+	mReservedPosition = 0;
+	mReservedByteSize = 0;
+	mIsReserved = false;
+}
+
+uint32_t SFB::PacketRingBuffer::MaximumPacketSize() const noexcept
+{
+	if(!mBuffer)
+		return 0;
+
+	// One record's worth of alignment is always left free to distinguish a full buffer from an empty one.
+	// Without mirroring a packet must also fit before the end of the buffer or after the space skipped to reach the
+	// beginning, which is guaranteed only for records no larger than half the buffer.
+	auto maximumRecordSize = mIsMirrored ? mCapacityBytes - kRecordAlignment : mCapacityBytes / 2;
+	return maximumRecordSize - kRecordHeaderSize;
+}
+
+bool SFB::PacketRingBuffer::IsEmpty() const noexcept
+{
+	return mWritePosition.load(std::memory_order_acquire) == mReadPosition.load(std::memory_order_acquire);
+}
+
+uint32_t SFB::PacketRingBuffer::BytesAvailableToRead() const noexcept
+{
+	auto writePosition = mWritePosition.load(std::memory_order_acquire);
+	auto readPosition = mReadPosition.load(std::memory_order_acquire);
+	return ReadableBytes(writePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
+}
+
+uint32_t SFB::PacketRingBuffer::BytesAvailableToWrite() const noexcept
+{
+	auto writePosition = mWritePosition.load(std::memory_order_acquire);
+	auto readPosition = mReadPosition.load(std::memory_order_acquire);
+	return WritableBytes(writePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
+}
+
+#pragma mark Writing Packets
+
+void * SFB::PacketRingBuffer::ReservePacket(uint32_t byteSize) noexcept
+{
+	mIsReserved = false;
+
+	if(!mBuffer || byteSize > MaximumPacketSize())
+		return nullptr;
+
+	auto recordSize = RecordSize(byteSize);
+	auto writePosition = mWritePosition.load(std::memory_order_relaxed);
+
+	// A record that doesn't fit before the end of a non-mirrored buffer is placed at the beginning
+	uint32_t skipBytes = 0;
+	if(!mIsMirrored && writePosition + recordSize > mCapacityBytes)
+		skipBytes = mCapacityBytes - writePosition;
+
+	// Only reload the read position if the cached value doesn't satisfy the request
+	auto bytesRequired = skipBytes + recordSize;
+	auto bytesAvailable = WritableBytes(writePosition, mCachedReadPosition, mCapacityBytes, mCapacityBytesMask);
+	if(bytesAvailable < bytesRequired) {
+		mCachedReadPosition = mReadPosition.load(std::memory_order_acquire);
+		bytesAvailable = WritableBytes(writePosition, mCachedReadPosition, mCapacityBytes, mCapacityBytesMask);
+		if(bytesAvailable < bytesRequired)
+			return nullptr;
+	}
+
+	// The skip record becomes visible to the reader when the packet is committed
+	if(skipBytes) {
+		auto header = reinterpret_cast<RecordHeader *>(mBuffer + writePosition);
+		header->mRecordSize = skipBytes;
+		header->mFlags = kRecordFlagSkip;
+	}
+
+	mReservedPosition = (writePosition + skipBytes) & mCapacityBytesMask;
+	mReservedByteSize = byteSize;
+	mIsReserved = true;
+
+	return mBuffer + mReservedPosition + kRecordHeaderSize;
+}
+
+bool SFB::PacketRingBuffer::CommitPacket(uint32_t byteSize, uint32_t variableFramesInPacket, const AudioTimeStamp& timeStamp) noexcept
+{
+	if(!mIsReserved || byteSize > mReservedByteSize)
+		return false;
+
+	auto recordSize = RecordSize(byteSize);
+
+	auto header = reinterpret_cast<RecordHeader *>(mBuffer + mReservedPosition);
+	header->mRecordSize = recordSize;
+	header->mFlags = 0;
+	header->mDataByteSize = byteSize;
+	header->mVariableFramesInPacket = variableFramesInPacket;
+	header->mTimeStamp = timeStamp;
+
+	mIsReserved = false;
+	mWritePosition.store((mReservedPosition + recordSize) & mCapacityBytesMask, std::memory_order_release);
+
+	return true;
+}
+
+bool SFB::PacketRingBuffer::WritePacket(const void * const data, const AudioStreamPacketDescription& packetDescription, const AudioTimeStamp& timeStamp) noexcept
+{
+	if(!data)
+		return false;
+
+	auto packet = ReservePacket(packetDescription.mDataByteSize);
+	if(!packet)
+		return false;
+
+	std::memcpy(packet, static_cast<const uint8_t *>(data) + packetDescription.mStartOffset, packetDescription.mDataByteSize);
+	return CommitPacket(packetDescription.mDataByteSize, packetDescription.mVariableFramesInPacket, timeStamp);
+}
+
+uint32_t SFB::PacketRingBuffer::WritePackets(const void * const data, const AudioStreamPacketDescription * const packetDescriptions, uint32_t packetCount, const AudioTimeStamp& timeStamp, uint32_t framesPerPacket) noexcept
+{
+	if(!data || !packetDescriptions)
+		return 0;
+
+	auto packetTimeStamp = timeStamp;
+	for(uint32_t i = 0; i < packetCount; ++i) {
+		if(!WritePacket(data, packetDescriptions[i], packetTimeStamp))
+			return i;
+
+		if(i == 0) {
+			auto flags = timeStamp.mFlags & kAudioTimeStampSampleTimeValid;
+			packetTimeStamp = {};
+			packetTimeStamp.mSampleTime = timeStamp.mSampleTime;
+			packetTimeStamp.mFlags = flags;
+		}
+		packetTimeStamp.mSampleTime += framesPerPacket ? framesPerPacket : packetDescriptions[i].mVariableFramesInPacket;
+	}
+
+	return packetCount;
+}
+
+#pragma mark Reading Packets
+
+bool SFB::PacketRingBuffer::PeekPacket(Packet& packet) const noexcept
+{
+	auto position = NextPacketPosition();
+	if(position == std::numeric_limits<uint32_t>::max())
+		return false;
+
+	auto header = reinterpret_cast<const RecordHeader *>(mBuffer + position);
+	packet.mData = mBuffer + position + kRecordHeaderSize;
+	packet.mPacketDescription = { 0, header->mVariableFramesInPacket, header->mDataByteSize };
+	packet.mTimeStamp = header->mTimeStamp;
+
+	return true;
+}
+
+bool SFB::PacketRingBuffer::ConsumePacket() noexcept
+{
+	auto position = NextPacketPosition();
+	if(position == std::numeric_limits<uint32_t>::max())
+		return false;
+
+	auto header = reinterpret_cast<const RecordHeader *>(mBuffer + position);
+	mReadPosition.store((position + header->mRecordSize) & mCapacityBytesMask, std::memory_order_release);
+
+	return true;
+}
+
+bool SFB::PacketRingBuffer::ReadPacket(void * const buffer, uint32_t bufferSize, AudioStreamPacketDescription& packetDescription, AudioTimeStamp& timeStamp) noexcept
+{
+	Packet packet;
+	if(!buffer || !PeekPacket(packet) || packet.mPacketDescription.mDataByteSize > bufferSize)
+		return false;
+
+	std::memcpy(buffer, packet.mData, packet.mPacketDescription.mDataByteSize);
+	packetDescription = packet.mPacketDescription;
+	timeStamp = packet.mTimeStamp;
+
+	return ConsumePacket();
+}
+
+uint32_t SFB::PacketRingBuffer::NextPacketPosition() const noexcept
+{
+	auto readPosition = mReadPosition.load(std::memory_order_relaxed);
+
+	// Only reload the write position if the cached value indicates the buffer is empty
+	if(readPosition == mCachedWritePosition) {
+		mCachedWritePosition = mWritePosition.load(std::memory_order_acquire);
+		if(readPosition == mCachedWritePosition)
+			return std::numeric_limits<uint32_t>::max();
+	}
+
+	// A skip record is committed together with the packet following it
+	auto header = reinterpret_cast<const RecordHeader *>(mBuffer + readPosition);
+	if(header->mFlags & kRecordFlagSkip)
+		readPosition = (readPosition + header->mRecordSize) & mCapacityBytesMask;
+
+	return readPosition;
+}
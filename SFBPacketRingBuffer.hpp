@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+
+#import <CoreAudioTypes/CoreAudioTypes.h>
+
+#import "SFBHardwareInterferenceSize.hpp"
+
+namespace SFB {
+
+/// A ring buffer of variable-size packets of audio with packet descriptions and timestamps
+///
+/// This class is thread safe when used from one reader thread and one writer thread (single producer, single consumer model).
+///
+/// Each packet is stored contiguously in a single arena together with its packet description and timestamp, so
+/// packets may be written in place using @c ReservePacket() and @c CommitPacket() and read in place using
+/// @c PeekPacket() and @c ConsumePacket(). The read and write positions are managed in the same way as
+/// @c RingBuffer. When a packet doesn't fit before the end of a non-mirrored buffer the remaining space is skipped.
+///
+/// @code
+/// // Writer
+/// if(auto data = ring.ReservePacket(maximumPacketSize)) {
+///     auto byteSize = Encode(data, maximumPacketSize);
+///     ring.CommitPacket(byteSize, 0, timeStamp);
+/// }
+/// // Reader
+/// SFB::PacketRingBuffer::Packet packet;
+/// while(ring.PeekPacket(packet)) {
+///     Send(packet.mData, packet.mPacketDescription.mDataByteSize);
+///     ring.ConsumePacket();
+/// }
+/// @endcode
+class PacketRingBuffer
+{
+
+public:
+
+	/// A packet in the ring buffer
+	struct Packet {
+		/// The packet data
+		const void * _Nullable mData;
+		/// The packet description
+		/// @note @c mStartOffset is always @c 0
+		AudioStreamPacketDescription mPacketDescription;
+		/// The packet timestamp
+		AudioTimeStamp mTimeStamp;
+	};
+
+#pragma mark Creation and Destruction
+
+	/// Creates a new @c PacketRingBuffer
+	/// @note @c Allocate() must be called before the object may be used.
+	PacketRingBuffer() noexcept;
+
+	// This class is non-copyable
+	PacketRingBuffer(const PacketRingBuffer& rhs) = delete;
+
+	// This class is non-assignable
+	PacketRingBuffer& operator=(const PacketRingBuffer& rhs) = delete;
+
+	/// Destroys the @c PacketRingBuffer and release all associated resources.
+	~PacketRingBuffer();
+
+	// This class is non-movable
+	PacketRingBuffer(PacketRingBuffer&& rhs) = delete;
+
+	// This class is non-move assignable
+	PacketRingBuffer& operator=(PacketRingBuffer&& rhs) = delete;
+
+#pragma mark Buffer management
+
+	/// Allocates space for packets.
+	///
+	/// A mirrored buffer maps its memory twice in consecutive virtual memory so no space is skipped at the end of the
+	/// buffer. The capacity of a mirrored buffer is rounded up to a multiple of @c MirroredRegionGranularity().
+	/// @note This method is not thread safe.
+	/// @note Capacities from 2 to 2,147,483,648 (0x80000000) bytes are supported and capacities less than 256 bytes
+	/// are rounded up to 256 bytes
+	/// @param byteCount The desired capacity, in bytes, including packet descriptions and timestamps
+	/// @param mirrored Whether to allocate mirrored memory
+	/// @return @c true on success, @c false on error
+	bool Allocate(uint32_t byteCount, bool mirrored = false) noexcept;
+
+	/// Frees the resources used by this @c PacketRingBuffer
+	/// @note This method is not thread safe.
+	void Deallocate() noexcept;
+
+
+	/// Resets this @c PacketRingBuffer to its default state.
+	/// @note This method is not thread safe.
+	void Reset() noexcept;
+
+
+	/// Returns the capacity of this @c PacketRingBuffer in bytes
+	inline uint32_t CapacityBytes() const noexcept
+	{
+		return mCapacityBytes;
+	}
+
+	/// Returns @c true if this @c PacketRingBuffer uses mirrored memory
+	inline bool IsMirrored() const noexcept
+	{
+		return mIsMirrored;
+	}
+
+	/// Returns the largest packet size in bytes that can be written to an empty @c PacketRingBuffer
+	uint32_t MaximumPacketSize() const noexcept;
+
+	/// Returns @c true if no packets are available for reading
+	bool IsEmpty() const noexcept;
+
+	/// Returns the number of bytes of packets, descriptions, and timestamps available for reading
+	uint32_t BytesAvailableToRead() const noexcept;
+
+	/// Returns the free space available for writing packets, descriptions, and timestamps in bytes
+	uint32_t BytesAvailableToWrite() const noexcept;
+
+#pragma mark Writing packets
+
+	/// Reserves contiguous space for a packet of up to @c byteSize bytes
+	///
+	/// The packet isn't visible to the reader until it is committed using @c CommitPacket().
+	/// @note A reservation that isn't committed is abandoned by the next call to @c ReservePacket()
+	/// @param byteSize The maximum size of the packet in bytes
+	/// @return A pointer to @c byteSize bytes of space for the packet data or @c nullptr if insufficient space is available
+	void * _Nullable ReservePacket(uint32_t byteSize) noexcept;
+
+	/// Commits the packet in the space returned by the last call to @c ReservePacket()
+	/// @param byteSize The size of the packet in bytes, which must not exceed the reserved size
+	/// @param variableFramesInPacket The number of frames in the packet for formats with a variable number of frames per packet, or @c 0
+	/// @param timeStamp The packet timestamp
+	/// @return @c true on success, @c false if no space is reserved or @c byteSize exceeds the reserved size
+	bool CommitPacket(uint32_t byteSize, uint32_t variableFramesInPacket, const AudioTimeStamp& timeStamp) noexcept;
+
+	/// Copies a packet to the @c PacketRingBuffer
+	/// @param data The packet data
+	/// @param packetDescription The packet description, with @c mStartOffset the offset of the packet in @c data
+	/// @param timeStamp The packet timestamp
+	/// @return @c true on success, @c false if insufficient space is available
+	bool WritePacket(const void * const _Nonnull data, const AudioStreamPacketDescription& packetDescription, const AudioTimeStamp& timeStamp) noexcept;
+
+	/// Copies packets to the @c PacketRingBuffer
+	/// @param data The packet data
+	/// @param packetDescriptions The packet descriptions, with @c mStartOffset the offset of each packet in @c data
+	/// @param packetCount The number of packets in @c data
+	/// @param timeStamp The timestamp of the first packet. Subsequent packets receive only a sample time, advanced by
+	/// @c framesPerPacket or the preceding packet's @c mVariableFramesInPacket, if @c timeStamp contains a valid sample time.
+	/// @param framesPerPacket The number of frames per packet for formats with a constant number of frames per packet, or @c 0
+	/// @return The number of packets actually written
+	uint32_t WritePackets(const void * const _Nonnull data, const AudioStreamPacketDescription * const _Nonnull packetDescriptions, uint32_t packetCount, const AudioTimeStamp& timeStamp, uint32_t framesPerPacket = 0) noexcept;
+
+#pragma mark Reading packets
+
+	/// Retrieves the next packet without removing it from the @c PacketRingBuffer
+	/// @note The packet data remains valid until @c ConsumePacket() is called
+	/// @param packet A @c Packet to receive the next packet
+	/// @return @c true on success, @c false if no packets are available
+	bool PeekPacket(Packet& packet) const noexcept;
+
+	/// Removes the next packet from the @c PacketRingBuffer
+	/// @return @c true on success, @c false if no packets are available
+	bool ConsumePacket() noexcept;
+
+	/// Copies the next packet from the @c PacketRingBuffer and removes it
+	/// @param buffer A buffer to receive the packet data
+	/// @param bufferSize The size of @c buffer in bytes
+	/// @param packetDescription An @c AudioStreamPacketDescription to receive the packet description
+	/// @param timeStamp An @c AudioTimeStamp to receive the packet timestamp
+	/// @return @c true on success, @c false if no packets are available or the next packet is larger than @c bufferSize
+	bool ReadPacket(void * const _Nonnull buffer, uint32_t bufferSize, AudioStreamPacketDescription& packetDescription, AudioTimeStamp& timeStamp) noexcept;
+
+private:
+
+	/// Returns the position of the record for the next packet or @c UINT32_MAX if no packets are available
+	uint32_t NextPacketPosition() const noexcept;
+
+	/// The memory buffer holding the packet records
+	uint8_t * _Nullable mBuffer;
+
+	/// The capacity of @c mBuffer in bytes
+	uint32_t mCapacityBytes;
+	/// The capacity of @c mBuffer in bytes minus one
+	uint32_t mCapacityBytesMask;
+	/// Whether @c mBuffer uses mirrored memory
+	bool mIsMirrored;
+
+	/// The offset into @c mBuffer of the write location
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mWritePosition;
+	/// The writer's copy of @c mReadPosition
+	uint32_t mCachedReadPosition;
+	/// The position of the reserved record
+	uint32_t mReservedPosition;
+	/// The size of the reserved packet in bytes
+	uint32_t mReservedByteSize;
+	/// Whether space is reserved for a packet
+	bool mIsReserved;
+
+	/// The offset into @c mBuffer of the read location
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mReadPosition;
+	/// The reader's copy of @c mWritePosition
+	mutable uint32_t mCachedWritePosition;
+
+};
+
+} // namespace SFB
@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <condition_variable>
+#import <exception>
+#import <mutex>
+#import <new>
+#import <stdexcept>
+#import <thread>
+#import <vector>
+
+#import "SFBParallelTranscoder.hpp"
+#import "SFBCABufferList.hpp"
+#import "SFBCAExtAudioFile.hpp"
+
+namespace {
+
+/// The maximum number of frames decoded by a single read
+constexpr UInt32 kReadFrameCount = 4096;
+
+/// Opens @c url for decoding to @c format
+SFB::CAExtAudioFile OpenSource(CFURLRef url, const SFB::CAStreamBasicDescription& format)
+{
+	SFB::CAExtAudioFile file;
+	file.OpenURL(url);
+	file.SetClientDataFormat(format);
+	return file;
+}
+
+/// Creates the file at @c url accepting audio in @c clientFormat
+SFB::CAExtAudioFile CreateDestination(CFURLRef url, AudioFileTypeID fileType, const SFB::CAStreamBasicDescription& format, const SFB::CAStreamBasicDescription& clientFormat)
+{
+	SFB::CAExtAudioFile file;
+	file.CreateWithURL(url, fileType, format, nullptr, kAudioFileFlags_EraseFile);
+	file.SetClientDataFormat(clientFormat);
+	return file;
+}
+
+/// Decodes audio from @c file and appends it to @c buffer until @c buffer contains @c frameLength frames or the end of
+/// file is reached
+/// @return @c true if @c buffer contains @c frameLength frames, @c false if the end of file was reached
+bool AppendAudio(SFB::CAExtAudioFile& file, SFB::CABufferList& readBuffer, SFB::CABufferList& buffer, UInt32 frameLength)
+{
+	frameLength = std::min(frameLength, buffer.FrameCapacity());
+	while(buffer.FrameLength() < frameLength) {
+		auto frameCount = std::min(readBuffer.FrameCapacity(), frameLength - buffer.FrameLength());
+		readBuffer.SetFrameLength(frameCount);
+		file.Read(frameCount, readBuffer);
+		if(frameCount == 0)
+			return false;
+		readBuffer.SetFrameLength(frameCount);
+		buffer.AppendContentsOfBuffer(readBuffer);
+	}
+	return true;
+}
+
+/// Decodes audio from @c source and writes it to @c destination until the end of file is reached
+/// @return The number of frames written
+SInt64 CopyRemainingAudio(SFB::CAExtAudioFile& source, SFB::CAExtAudioFile& destination, SFB::CABufferList& buffer)
+{
+	SInt64 framesWritten = 0;
+	for(;;) {
+		source.Read(buffer);
+		if(buffer.IsEmpty())
+			break;
+		destination.Write(buffer.FrameLength(), buffer);
+		framesWritten += buffer.FrameLength();
+	}
+	return framesWritten;
+}
+
+}
+
+bool SFB::ParallelTranscoder::IsFrameSeekable(const CAStreamBasicDescription& format) noexcept
+{
+	// With a constant number of frames per packet a frame position maps to a packet and an offset
+	return format.IsPCM() || format.mFramesPerPacket > 0;
+}
+
+#pragma mark Creation and Destruction
+
+SFB::ParallelTranscoder::ParallelTranscoder(CFURLRef sourceURL, CFURLRef destinationURL, AudioFileTypeID fileType, const AudioStreamBasicDescription& format, unsigned int threadCount, UInt32 chunkFrameCount)
+: mSourceURL(static_cast<CFURLRef>(CFRetain(sourceURL))), mDestinationURL(static_cast<CFURLRef>(CFRetain(destinationURL))), mFileType(fileType), mFormat(format), mThreadCount(threadCount), mChunkFrameCount(chunkFrameCount)
+{
+	if(chunkFrameCount == 0)
+		throw std::invalid_argument("chunkFrameCount == 0");
+	if(mThreadCount == 0)
+		mThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+#pragma mark Transcoding
+
+SInt64 SFB::ParallelTranscoder::Transcode()
+{
+	SInt64 frameLength;
+	CAStreamBasicDescription sourceFormat;
+	{
+		CAExtAudioFile source;
+		source.OpenURL(mSourceURL);
+		sourceFormat = source.FileDataFormat();
+		frameLength = source.FrameLength();
+	}
+
+	// Chunks are decoded and converted to the destination's channel count at the source's sample rate; sample rate
+	// conversion is stateful and is performed sequentially when writing
+	CAStreamBasicDescription intermediateFormat{CommonPCMFormat::float32, sourceFormat.mSampleRate, mFormat.mChannelsPerFrame, false};
+
+	if(!IsFrameSeekable(sourceFormat) || mThreadCount == 1 || frameLength <= mChunkFrameCount)
+		return TranscodeSequentially(intermediateFormat);
+	return TranscodeConcurrently(intermediateFormat, frameLength);
+}
+
+SInt64 SFB::ParallelTranscoder::TranscodeSequentially(const CAStreamBasicDescription& intermediateFormat)
+{
+	auto source = OpenSource(mSourceURL, intermediateFormat);
+	auto destination = CreateDestination(mDestinationURL, mFileType, mFormat, intermediateFormat);
+
+	CABufferList buffer(intermediateFormat, kReadFrameCount);
+	return CopyRemainingAudio(source, destination, buffer);
+}
+
+SInt64 SFB::ParallelTranscoder::TranscodeConcurrently(const CAStreamBasicDescription& intermediateFormat, SInt64 frameLength)
+{
+	const auto chunkCount = static_cast<std::size_t>((frameLength + mChunkFrameCount - 1) / mChunkFrameCount);
+	const auto threadCount = std::min(static_cast<std::size_t>(mThreadCount), chunkCount);
+
+	// Chunk k is decoded into slot k % slotCount once chunk k - slotCount has been written
+	struct Slot {
+		CABufferList mBuffer;
+		std::size_t mChunk;
+		bool mIsReady;
+	};
+
+	const auto slotCount = 2 * threadCount;
+	std::vector<Slot> slots(slotCount);
+	for(std::size_t i = 0; i < slotCount; ++i) {
+		if(!slots[i].mBuffer.Allocate(intermediateFormat, mChunkFrameCount))
+			throw std::bad_alloc();
+		slots[i].mChunk = i;
+		slots[i].mIsReady = false;
+	}
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::size_t nextChunk = 0;
+	bool cancel = false;
+	std::exception_ptr error;
+
+	// Stops all threads after an error
+	auto fail = [&](std::exception_ptr e) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if(!error)
+			error = e;
+		cancel = true;
+		condition.notify_all();
+	};
+
+	auto decode = [&]() {
+		try {
+			auto source = OpenSource(mSourceURL, intermediateFormat);
+			CABufferList readBuffer(intermediateFormat, kReadFrameCount);
+
+			for(;;) {
+				std::size_t chunk;
+				Slot *slot;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					if(cancel || nextChunk == chunkCount)
+						return;
+					chunk = nextChunk++;
+					slot = &slots[chunk % slotCount];
+					condition.wait(lock, [&] { return cancel || slot->mChunk == chunk; });
+					if(cancel)
+						return;
+				}
+
+				const auto startingFrame = static_cast<SInt64>(chunk) * mChunkFrameCount;
+				const auto expectedFrameCount = static_cast<UInt32>(std::min(static_cast<SInt64>(mChunkFrameCount), frameLength - startingFrame));
+
+				// ExtAudioFileSeek discards the decoder's priming frames so the chunk begins exactly at startingFrame
+				source.Seek(startingFrame);
+				auto& buffer = slot->mBuffer;
+				buffer.Clear();
+				// Only the final chunk may end early
+				if(!AppendAudio(source, readBuffer, buffer, expectedFrameCount) && chunk != chunkCount - 1)
+					throw std::runtime_error("Unexpected end of audio");
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					slot->mIsReady = true;
+				}
+				condition.notify_all();
+			}
+		}
+		catch(...) {
+			fail(std::current_exception());
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+
+	SInt64 framesWritten = 0;
+	try {
+		auto destination = CreateDestination(mDestinationURL, mFileType, mFormat, intermediateFormat);
+
+		for(std::size_t i = 0; i < threadCount; ++i)
+			threads.emplace_back(decode);
+
+		std::size_t chunk = 0;
+		for(; chunk < chunkCount; ++chunk) {
+			auto& slot = slots[chunk % slotCount];
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [&] { return cancel || slot.mIsReady; });
+				if(cancel)
+					break;
+			}
+
+			destination.Write(slot.mBuffer.FrameLength(), slot.mBuffer);
+			framesWritten += slot.mBuffer.FrameLength();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slot.mIsReady = false;
+				slot.mChunk = chunk + slotCount;
+			}
+			condition.notify_all();
+		}
+
+		// The frame length of some files is an estimate so audio may follow the final chunk
+		if(chunk == chunkCount && framesWritten == frameLength) {
+			auto source = OpenSource(mSourceURL, intermediateFormat);
+			source.Seek(frameLength);
+			CABufferList buffer(intermediateFormat, kReadFrameCount);
+			framesWritten += CopyRemainingAudio(source, destination, buffer);
+		}
+	}
+	catch(...) {
+		fail(std::current_exception());
+	}
+
+	for(auto& thread : threads)
+		thread.join();
+
+	if(error)
+		std::rethrow_exception(error);
+
+	return framesWritten;
+}
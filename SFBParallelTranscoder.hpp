@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "SFBCAStreamBasicDescription.hpp"
+#import "SFBCFWrapper.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A class that transcodes an audio file by decoding frame ranges of the source concurrently
+///
+/// The source is divided into chunks using its frame length. Each worker thread opens its own @c ExtAudioFile, seeks to
+/// the start of a chunk, and decodes and converts the chunk to an intermediate linear PCM format. The chunks are
+/// written to the destination in order on the calling thread, so encoding, sample rate conversion, and the
+/// destination's priming and remainder frames are handled exactly as for a sequential transcode.
+///
+/// @c ExtAudioFileSeek decodes the frames preceding the seek position and discards them, so each chunk of a
+/// compressed source begins on the requested frame without priming artifacts. Sources whose data format isn't
+/// frame-seekable are transcoded sequentially.
+///
+/// @note Only decoding is performed concurrently. Sample rate conversion and encoding are stateful across the whole
+/// stream and run on the calling thread, overlapped with decoding, so the speedup is limited by the time spent
+/// encoding. Transcodes to linear PCM or from expensive decoders benefit the most; transcodes whose cost is dominated
+/// by a compressed encoder such as AAC run at close to the speed of a single encoder.
+///
+/// @code
+/// SFB::ParallelTranscoder transcoder(sourceURL, destinationURL, kAudioFileM4AType, format);
+/// auto framesWritten = transcoder.Transcode();
+/// @endcode
+class ParallelTranscoder
+{
+
+public:
+
+	/// The default number of frames in each chunk
+	static constexpr UInt32 sDefaultChunkFrameCount = 262144;
+
+	/// Returns @c true if audio in @c format can be decoded starting at an arbitrary frame
+	static bool IsFrameSeekable(const CAStreamBasicDescription& format) noexcept;
+
+#pragma mark Creation and Destruction
+
+	/// Default constructor
+	ParallelTranscoder() noexcept = delete;
+
+	// This class is non-copyable
+	ParallelTranscoder(const ParallelTranscoder& rhs) = delete;
+
+	// This class is non-assignable
+	ParallelTranscoder& operator=(const ParallelTranscoder& rhs) = delete;
+
+	/// Destructor
+	~ParallelTranscoder() = default;
+
+	// This class is non-movable
+	ParallelTranscoder(ParallelTranscoder&& rhs) = delete;
+
+	// This class is non-move assignable
+	ParallelTranscoder& operator=(ParallelTranscoder&& rhs) = delete;
+
+	/// Creates a @c ParallelTranscoder
+	/// @param sourceURL The URL of the audio file to transcode
+	/// @param destinationURL The URL of the file to create, which is overwritten if it exists
+	/// @param fileType The type of the file to create
+	/// @param format The data format of the file to create
+	/// @param threadCount The number of decoding threads, in addition to the calling thread which encodes, or @c 0 to use one per processor
+	/// @param chunkFrameCount The number of source frames decoded by a thread at once
+	/// @throws @c std::invalid_argument if @c chunkFrameCount is @c 0
+	ParallelTranscoder(CFURLRef sourceURL, CFURLRef destinationURL, AudioFileTypeID fileType, const AudioStreamBasicDescription& format, unsigned int threadCount = 0, UInt32 chunkFrameCount = sDefaultChunkFrameCount);
+
+#pragma mark Transcoding
+
+	/// Transcodes the source to the destination
+	///
+	/// This method blocks until the transcode is complete.
+	/// @return The number of source frames transcoded
+	/// @throws @c std::bad_alloc
+	/// @throws @c std::runtime_error if a chunk ends before its expected length
+	/// @throws @c std::system_error
+	SInt64 Transcode();
+
+private:
+
+	/// Transcodes the source sequentially
+	SInt64 TranscodeSequentially(const CAStreamBasicDescription& intermediateFormat);
+
+	/// Transcodes the source using multiple decoding threads
+	SInt64 TranscodeConcurrently(const CAStreamBasicDescription& intermediateFormat, SInt64 frameLength);
+
+	/// The URL of the audio file to transcode
+	CFURL mSourceURL;
+	/// The URL of the file to create
+	CFURL mDestinationURL;
+	/// The type of the file to create
+	AudioFileTypeID mFileType;
+	/// The data format of the file to create
+	CAStreamBasicDescription mFormat;
+	/// The number of decoding threads
+	unsigned int mThreadCount;
+	/// The number of frames in each chunk
+	UInt32 mChunkFrameCount;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
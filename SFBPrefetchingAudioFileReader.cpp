@@ -0,0 +1,233 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <cmath>
+#import <cstring>
+#import <exception>
+#import <new>
+#import <stdexcept>
+
+#import <os/log.h>
+
+#import "SFBPrefetchingAudioFileReader.hpp"
+
+namespace {
+
+/// The maximum number of frames decoded at once
+constexpr UInt32 kDecodeChunkFrameCount = 4096;
+
+/// The interval between decoding passes
+constexpr int64_t kDecodeInterval = 10 * NSEC_PER_MSEC;
+
+}
+
+#pragma mark Creation and Destruction
+
+SFB::PrefetchingAudioFileReader::PrefetchingAudioFileReader(CFURLRef url, const CAStreamBasicDescription& clientFormat, double prefetchSeconds)
+: mFrameLength(0), mQueue(nullptr), mTimer(nullptr), mDecoderAtEnd(false), mReadPosition(0), mRequestedSeekPosition(0), mSeekRequestCount(0), mSeekRequestsProcessed(0), mFileSeekPosition(0), mSeekState(SeekState::idle), mUnderruns(0), mFramesMissed(0), mBufferedSeeks(0), mFileSeeks(0), mDecodeErrors(0)
+{
+	mExtAudioFile.OpenURL(url);
+
+	// Frame positions are only unambiguous without sample rate conversion
+	if(clientFormat.mSampleRate != mExtAudioFile.FileDataFormat().mSampleRate)
+		throw std::invalid_argument("Sample rate conversion is not supported");
+
+	mExtAudioFile.SetClientDataFormat(clientFormat);
+	mFormat = clientFormat;
+	mFrameLength = mExtAudioFile.FrameLength();
+
+	auto capacity = std::max(static_cast<UInt32>(std::ceil(std::max(prefetchSeconds, 0.0) * mFormat.mSampleRate)), kDecodeChunkFrameCount);
+	if(!mRingBuffer.Allocate(mFormat, capacity))
+		throw std::bad_alloc();
+	if(!mDecodeBuffer.Allocate(mFormat, kDecodeChunkFrameCount))
+		throw std::bad_alloc();
+
+	mQueue = dispatch_queue_create("org.sbooth.PrefetchingAudioFileReader", DISPATCH_QUEUE_SERIAL);
+	if(!mQueue)
+		throw std::runtime_error("Unable to create the dispatch queue");
+
+	mTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, mQueue);
+	if(!mTimer) {
+#if !__has_feature(objc_arc)
+		dispatch_release(mQueue);
+#endif
+		throw std::runtime_error("Unable to create the dispatch timer");
+	}
+
+	dispatch_set_context(mTimer, this);
+	dispatch_source_set_event_handler_f(mTimer, Decode);
+	dispatch_source_set_timer(mTimer, DISPATCH_TIME_NOW, kDecodeInterval, kDecodeInterval / 2);
+	dispatch_resume(mTimer);
+}
+
+SFB::PrefetchingAudioFileReader::~PrefetchingAudioFileReader()
+{
+	dispatch_source_cancel(mTimer);
+	// Wait for any decoding pass in progress or already submitted to complete
+	dispatch_sync_f(mQueue, nullptr, [](void *) {});
+
+#if !__has_feature(objc_arc)
+	dispatch_release(mTimer);
+	dispatch_release(mQueue);
+#endif
+}
+
+#pragma mark Information
+
+bool SFB::PrefetchingAudioFileReader::IsAtEnd() const noexcept
+{
+	return mDecoderAtEnd.load(std::memory_order_acquire) && mSeekState.load(std::memory_order_acquire) == SeekState::idle && mSeekRequestCount.load(std::memory_order_acquire) == mSeekRequestsProcessed.load(std::memory_order_relaxed) && mRingBuffer.FramesAvailableToRead() == 0;
+}
+
+SFB::PrefetchingAudioFileReader::Statistics SFB::PrefetchingAudioFileReader::GetStatistics() const noexcept
+{
+	return {
+		mUnderruns.load(std::memory_order_relaxed),
+		mFramesMissed.load(std::memory_order_relaxed),
+		mBufferedSeeks.load(std::memory_order_relaxed),
+		mFileSeeks.load(std::memory_order_relaxed),
+		mDecodeErrors.load(std::memory_order_relaxed),
+	};
+}
+
+#pragma mark Reading and Seeking
+
+UInt32 SFB::PrefetchingAudioFileReader::Read(AudioBufferList * const bufferList, UInt32 frameCount) noexcept
+{
+	if(!bufferList || frameCount == 0)
+		return 0;
+
+	uint32_t framesRead = 0;
+	if(ProcessSeeks()) {
+		// If the decoder has finished all remaining audio is already in the ring buffer
+		auto decoderAtEnd = mDecoderAtEnd.load(std::memory_order_acquire);
+
+		framesRead = mRingBuffer.Read(bufferList, frameCount);
+		mReadPosition.store(mReadPosition.load(std::memory_order_relaxed) + framesRead, std::memory_order_relaxed);
+
+		if(framesRead < frameCount && !decoderAtEnd) {
+			mUnderruns.fetch_add(1, std::memory_order_relaxed);
+			mFramesMissed.fetch_add(frameCount - framesRead, std::memory_order_relaxed);
+		}
+	}
+
+	// Fill the remainder with silence
+	auto byteOffset = framesRead * mFormat.mBytesPerFrame;
+	auto byteSize = frameCount * mFormat.mBytesPerFrame;
+	for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i) {
+		std::memset(static_cast<uint8_t *>(bufferList->mBuffers[i].mData) + byteOffset, 0, byteSize - byteOffset);
+		bufferList->mBuffers[i].mDataByteSize = byteSize;
+	}
+
+	return framesRead;
+}
+
+void SFB::PrefetchingAudioFileReader::Seek(SInt64 frame) noexcept
+{
+	mRequestedSeekPosition.store(std::clamp(frame, SInt64(0), mFrameLength), std::memory_order_relaxed);
+	mSeekRequestCount.fetch_add(1, std::memory_order_release);
+}
+
+#pragma mark Internals
+
+void SFB::PrefetchingAudioFileReader::Decode(void *context) noexcept
+{
+	static_cast<PrefetchingAudioFileReader *>(context)->FillRingBuffer();
+}
+
+void SFB::PrefetchingAudioFileReader::FillRingBuffer() noexcept
+{
+	auto state = mSeekState.load(std::memory_order_acquire);
+
+	// Reposition the file and let the reader discard the stale audio
+	if(state == SeekState::fileSeekPending) {
+		auto position = mFileSeekPosition.load(std::memory_order_relaxed);
+		try {
+			mExtAudioFile.Seek(position);
+			mDecoderAtEnd.store(false, std::memory_order_release);
+		}
+		catch(const std::exception& e) {
+			mDecodeErrors.fetch_add(1, std::memory_order_relaxed);
+			mDecoderAtEnd.store(true, std::memory_order_release);
+			os_log_error(OS_LOG_DEFAULT, "Error seeking to frame %lld: %{public}s", position, e.what());
+		}
+
+		mSeekState.store(SeekState::discardPending, std::memory_order_release);
+		return;
+	}
+
+	// Nothing written now would be read
+	if(state == SeekState::discardPending)
+		return;
+
+	while(!mDecoderAtEnd.load(std::memory_order_relaxed)) {
+		auto framesToDecode = std::min(mRingBuffer.FramesAvailableToWrite(), mDecodeBuffer.FrameCapacity());
+		if(framesToDecode == 0)
+			break;
+
+		mDecodeBuffer.SetFrameLength(framesToDecode);
+		try {
+			mExtAudioFile.Read(framesToDecode, mDecodeBuffer);
+		}
+		catch(const std::exception& e) {
+			mDecodeErrors.fetch_add(1, std::memory_order_relaxed);
+			os_log_error(OS_LOG_DEFAULT, "Error decoding audio: %{public}s", e.what());
+			break;
+		}
+
+		if(framesToDecode == 0) {
+			mDecoderAtEnd.store(true, std::memory_order_release);
+			break;
+		}
+
+		mDecodeBuffer.SetFrameLength(framesToDecode);
+		mRingBuffer.Write(mDecodeBuffer, framesToDecode);
+
+		// Stop decoding audio that a seek will discard
+		if(mSeekState.load(std::memory_order_acquire) != SeekState::idle)
+			break;
+	}
+}
+
+bool SFB::PrefetchingAudioFileReader::ProcessSeeks() noexcept
+{
+	auto state = mSeekState.load(std::memory_order_acquire);
+
+	// The decoder has repositioned the file and stopped writing so everything in the ring buffer is stale
+	if(state == SeekState::discardPending) {
+		mRingBuffer.AdvanceReadPosition(mRingBuffer.FramesAvailableToRead());
+		mReadPosition.store(mFileSeekPosition.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		mSeekState.store(SeekState::idle, std::memory_order_release);
+		state = SeekState::idle;
+	}
+
+	if(state == SeekState::fileSeekPending)
+		return false;
+
+	auto seekRequestCount = mSeekRequestCount.load(std::memory_order_acquire);
+	if(seekRequestCount == mSeekRequestsProcessed.load(std::memory_order_relaxed))
+		return true;
+	mSeekRequestsProcessed.store(seekRequestCount, std::memory_order_relaxed);
+
+	auto target = mRequestedSeekPosition.load(std::memory_order_relaxed);
+	auto position = mReadPosition.load(std::memory_order_relaxed);
+	auto framesBuffered = mRingBuffer.FramesAvailableToRead();
+
+	// Seek within the decoded audio by discarding the frames preceding the target
+	if(target >= position && target - position <= framesBuffered) {
+		mRingBuffer.AdvanceReadPosition(static_cast<uint32_t>(target - position));
+		mReadPosition.store(target, std::memory_order_relaxed);
+		mBufferedSeeks.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	mFileSeekPosition.store(target, std::memory_order_relaxed);
+	mSeekState.store(SeekState::fileSeekPending, std::memory_order_release);
+	mFileSeeks.fetch_add(1, std::memory_order_relaxed);
+
+	return false;
+}
@@ -0,0 +1,201 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <cstdint>
+
+#import <dispatch/dispatch.h>
+
+#import "SFBAudioRingBuffer.hpp"
+#import "SFBCABufferList.hpp"
+#import "SFBCAExtAudioFile.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+/// A reader that decodes an audio file ahead of playback on a background queue
+///
+/// Audio is decoded on a serial dispatch queue into an @c AudioRingBuffer holding a configurable number of seconds of
+/// audio. The render thread pulls audio using the real-time safe @c Read() method, which never blocks, allocates, or
+/// throws.
+///
+/// Seeks to a frame already in the ring buffer are satisfied by discarding the frames preceding it. Other seeks
+/// reposition the file on the decoding queue; until the new audio is available @c Read() returns silence.
+/// @note Seeks are completed by @c Read() so a seek requested while audio isn't being pulled takes effect on the next
+/// call to @c Read()
+class PrefetchingAudioFileReader
+{
+
+public:
+
+	/// Reader statistics
+	struct Statistics {
+		/// The number of calls to @c Read() that could not be completely satisfied before the end of the file
+		uint64_t mUnderruns;
+		/// The number of frames of silence returned because of underruns
+		uint64_t mFramesMissed;
+		/// The number of seeks satisfied from the ring buffer
+		uint64_t mBufferedSeeks;
+		/// The number of seeks requiring the file to be repositioned
+		uint64_t mFileSeeks;
+		/// The number of failed reads
+		uint64_t mDecodeErrors;
+	};
+
+#pragma mark Creation and Destruction
+
+	/// Default constructor
+	PrefetchingAudioFileReader() noexcept = delete;
+
+	// This class is non-copyable
+	PrefetchingAudioFileReader(const PrefetchingAudioFileReader& rhs) = delete;
+
+	// This class is non-assignable
+	PrefetchingAudioFileReader& operator=(const PrefetchingAudioFileReader& rhs) = delete;
+
+	/// Stops decoding and destroys the @c PrefetchingAudioFileReader
+	~PrefetchingAudioFileReader();
+
+	// This class is non-movable
+	PrefetchingAudioFileReader(PrefetchingAudioFileReader&& rhs) = delete;
+
+	// This class is non-move assignable
+	PrefetchingAudioFileReader& operator=(PrefetchingAudioFileReader&& rhs) = delete;
+
+	/// Opens the audio file at @c url and begins decoding
+	/// @param url The URL of the audio file
+	/// @param clientFormat The format of the audio returned by @c Read()
+	/// @param prefetchSeconds The amount of audio to decode ahead
+	/// @throws @c std::invalid_argument if @c clientFormat's sample rate differs from the file's sample rate
+	/// @throws @c std::bad_alloc
+	/// @throws @c std::system_error
+	PrefetchingAudioFileReader(CFURLRef url, const CAStreamBasicDescription& clientFormat, double prefetchSeconds = 2);
+
+#pragma mark Information
+
+	/// Returns the format of the audio returned by @c Read()
+	inline const CAStreamBasicDescription& Format() const noexcept
+	{
+		return mFormat;
+	}
+
+	/// Returns the number of audio frames in the file
+	inline SInt64 FrameLength() const noexcept
+	{
+		return mFrameLength;
+	}
+
+	/// Returns the frame position of the next frame returned by @c Read()
+	inline SInt64 FramePosition() const noexcept
+	{
+		return mReadPosition.load(std::memory_order_relaxed);
+	}
+
+	/// Returns the number of decoded frames available to @c Read()
+	inline uint32_t FramesBuffered() const noexcept
+	{
+		return mRingBuffer.FramesAvailableToRead();
+	}
+
+	/// Returns @c true if all audio has been decoded and read
+	bool IsAtEnd() const noexcept;
+
+	/// Returns the reader statistics
+	/// @note Each value is read atomically but the values are not read as a group
+	Statistics GetStatistics() const noexcept;
+
+#pragma mark Reading and Seeking
+
+	/// Reads audio
+	///
+	/// Frames not yet decoded are filled with silence.
+	/// @note This method is real-time safe and may only be called from a single thread
+	/// @param bufferList An @c AudioBufferList in @c Format() with the capacity for @c frameCount frames
+	/// @param frameCount The number of frames to read
+	/// @return The number of frames of audio read, excluding silence
+	UInt32 Read(AudioBufferList * const _Nonnull bufferList, UInt32 frameCount) noexcept;
+
+	/// Requests a seek to @c frame
+	///
+	/// The seek is completed asynchronously.
+	/// @param frame The desired frame position
+	void Seek(SInt64 frame) noexcept;
+
+private:
+
+	/// Seek states
+	enum class SeekState {
+		/// No seek is in progress
+		idle,
+		/// The file must be repositioned by the decoder
+		fileSeekPending,
+		/// The stale audio in the ring buffer must be discarded by the reader
+		discardPending,
+	};
+
+	/// Decodes audio on @c mQueue
+	static void Decode(void * _Nullable context) noexcept;
+
+	/// Fills the ring buffer
+	void FillRingBuffer() noexcept;
+
+	/// Completes a pending seek if possible
+	/// @return @c true if @c Read() may return audio
+	bool ProcessSeeks() noexcept;
+
+	/// The underlying @c ExtAudioFile
+	CAExtAudioFile mExtAudioFile;
+	/// The format of the audio returned by @c Read()
+	CAStreamBasicDescription mFormat;
+	/// The number of audio frames in the file
+	SInt64 mFrameLength;
+
+	/// Decoded audio
+	AudioRingBuffer mRingBuffer;
+	/// The buffer decoded audio is read into
+	CABufferList mDecodeBuffer;
+
+	/// The queue decoding audio
+	dispatch_queue_t mQueue;
+	/// The timer periodically decoding audio
+	dispatch_source_t mTimer;
+
+	/// @c true if the decoder reached the end of the file
+	std::atomic_bool mDecoderAtEnd;
+
+	/// The frame position of the next frame returned by @c Read()
+	std::atomic<SInt64> mReadPosition;
+
+	/// The most recently requested seek position
+	std::atomic<SInt64> mRequestedSeekPosition;
+	/// The number of seeks requested
+	std::atomic_uint64_t mSeekRequestCount;
+	/// The number of seek requests processed by @c Read()
+	std::atomic_uint64_t mSeekRequestsProcessed;
+	/// The position the file is being repositioned to
+	std::atomic<SInt64> mFileSeekPosition;
+	/// The current seek state
+	std::atomic<SeekState> mSeekState;
+
+	/// The number of underruns
+	std::atomic_uint64_t mUnderruns;
+	/// The number of frames of silence returned because of underruns
+	std::atomic_uint64_t mFramesMissed;
+	/// The number of seeks satisfied from the ring buffer
+	std::atomic_uint64_t mBufferedSeeks;
+	/// The number of seeks requiring the file to be repositioned
+	std::atomic_uint64_t mFileSeeks;
+	/// The number of failed reads
+	std::atomic_uint64_t mDecodeErrors;
+
+};
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
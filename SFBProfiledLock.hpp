@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <cstdint>
+#import <utility>
+
+#import <time.h>
+
+#import "SFBUnfairLock.hpp"
+
+namespace SFB {
+
+/// Contention statistics collected by @c ProfiledLock
+struct LockContentionStatistics {
+	/// The number of times the lock was acquired
+	uint64_t mAcquisitions;
+	/// The number of acquisitions by @c lock() that found the lock held
+	uint64_t mContendedAcquisitions;
+	/// The number of failed calls to @c try_lock()
+	uint64_t mFailedTryLocks;
+	/// The total time spent waiting for contended acquisitions in nanoseconds
+	uint64_t mTotalWaitTime;
+	/// The longest time spent waiting for a contended acquisition in nanoseconds
+	uint64_t mMaximumWaitTime;
+};
+
+/// A wrapper around a @c Lockable type that collects contention statistics
+///
+/// An uncontended @c lock() costs one additional @c try_lock() and an atomic increment. A contended @c lock()
+/// additionally reads the clock twice. The statistics may be read from any thread while the lock is in use.
+///
+/// @code
+/// SFB::ProfiledLock<SFB::AdaptiveUnfairLock> _lock;
+/// // Later
+/// std::lock_guard<SFB::ProfiledLock<SFB::AdaptiveUnfairLock>> lock(_lock);
+/// // Elsewhere
+/// auto statistics = _lock.Statistics();
+/// @endcode
+/// @tparam Lock A type implementing @c Lockable
+template <typename Lock = UnfairLock>
+class ProfiledLock
+{
+
+public:
+
+#pragma mark Creation and Destruction
+
+	/// Creates a new @c ProfiledLock
+	/// @param args Arguments forwarded to the constructor of @c Lock
+	template <typename... Args>
+	explicit ProfiledLock(Args&&... args) noexcept
+	: mLock(std::forward<Args>(args)...)
+	{
+		ResetStatistics();
+	}
+
+	// This class is non-copyable
+	ProfiledLock(const ProfiledLock& rhs) = delete;
+
+	// This class is non-assignable
+	ProfiledLock& operator=(const ProfiledLock& rhs) = delete;
+
+	// Destructor
+	~ProfiledLock() = default;
+
+	// This class is non-movable
+	ProfiledLock(ProfiledLock&& rhs) = delete;
+
+	// This class is non-move assignable
+	ProfiledLock& operator=(ProfiledLock&& rhs) = delete;
+
+#pragma mark Lockable
+
+	/// Locks the lock
+	void lock() noexcept
+	{
+		if(!mLock.try_lock()) {
+			auto start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+			mLock.lock();
+			auto waitTime = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+
+			mContendedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+			mTotalWaitTime.fetch_add(waitTime, std::memory_order_relaxed);
+			auto maximum = mMaximumWaitTime.load(std::memory_order_relaxed);
+			while(waitTime > maximum && !mMaximumWaitTime.compare_exchange_weak(maximum, waitTime, std::memory_order_relaxed))
+				;
+		}
+		mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// Unlocks the lock
+	void unlock() noexcept
+	{
+		mLock.unlock();
+	}
+
+	/// Attempts to lock the lock
+	/// @return @c true if the lock was successfully locked, @c false on error
+	bool try_lock() noexcept
+	{
+		if(!mLock.try_lock()) {
+			mFailedTryLocks.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+#pragma mark Ownership
+
+	/// Asserts that the calling thread is the current owner of the lock.
+	void assert_owner() noexcept
+	{
+		mLock.assert_owner();
+	}
+
+	///	Asserts that the calling thread is not the current owner of the lock.
+	void assert_not_owner() noexcept
+	{
+		mLock.assert_not_owner();
+	}
+
+#pragma mark Statistics
+
+	/// Returns the collected statistics
+	/// @note Each value is read atomically but the values are not read as a group
+	LockContentionStatistics Statistics() const noexcept
+	{
+		return {
+			mAcquisitions.load(std::memory_order_relaxed),
+			mContendedAcquisitions.load(std::memory_order_relaxed),
+			mFailedTryLocks.load(std::memory_order_relaxed),
+			mTotalWaitTime.load(std::memory_order_relaxed),
+			mMaximumWaitTime.load(std::memory_order_relaxed),
+		};
+	}
+
+	/// Discards the collected statistics
+	void ResetStatistics() noexcept
+	{
+		mAcquisitions.store(0, std::memory_order_relaxed);
+		mContendedAcquisitions.store(0, std::memory_order_relaxed);
+		mFailedTryLocks.store(0, std::memory_order_relaxed);
+		mTotalWaitTime.store(0, std::memory_order_relaxed);
+		mMaximumWaitTime.store(0, std::memory_order_relaxed);
+	}
+
+private:
+
+	/// The underlying lock
+	Lock mLock;
+
+	/// The number of acquisitions
+	std::atomic_uint64_t mAcquisitions;
+	/// The number of contended acquisitions
+	std::atomic_uint64_t mContendedAcquisitions;
+	/// The number of failed calls to @c try_lock()
+	std::atomic_uint64_t mFailedTryLocks;
+	/// The total wait time in nanoseconds
+	std::atomic_uint64_t mTotalWaitTime;
+	/// The longest wait time in nanoseconds
+	std::atomic_uint64_t mMaximumWaitTime;
+
+};
+
+} // namespace SFB
@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2021 - 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#import <algorithm>
+#import <chrono>
+#import <exception>
+#import <new>
+
+#import <os/log.h>
+
+#import "SFBRecorderOutput.hpp"
+
+namespace {
+
+/// Sets @c value to the larger of @c value and @c candidate
+template <typename T>
+inline void StoreMaximum(std::atomic<T>& value, T candidate) noexcept
+{
+	auto current = value.load(std::memory_order_relaxed);
+	while(candidate > current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed))
+		;
+}
+
+}
+
+SFB::detail::RecorderOutput::RecorderOutput() noexcept
+{
+	ResetStatistics();
+}
+
+void SFB::detail::RecorderOutput::Prepare(const CAStreamBasicDescription& clientFormat, UInt32 ringBufferFrameCapacity, UInt32 writeBatchFrameCount)
+{
+	mExtAudioFile.SetClientDataFormat(clientFormat);
+
+	if(!mRingBuffer.Allocate(clientFormat, std::max(ringBufferFrameCapacity, writeBatchFrameCount)))
+		throw std::bad_alloc();
+	if(!mWriteBuffer.Allocate(clientFormat, writeBatchFrameCount))
+		throw std::bad_alloc();
+}
+
+void SFB::detail::RecorderOutput::Drain() noexcept
+{
+	auto framesAvailable = mRingBuffer.FramesAvailableToRead();
+	StoreMaximum(mMaximumBacklogFrames, framesAvailable);
+
+	while(framesAvailable > 0) {
+		mWriteBuffer.SetFrameLength(mWriteBuffer.FrameCapacity());
+		auto framesRead = mRingBuffer.Read(mWriteBuffer, std::min(framesAvailable, mWriteBuffer.FrameCapacity()));
+		if(framesRead == 0)
+			break;
+		mWriteBuffer.SetFrameLength(framesRead);
+		framesAvailable -= framesRead;
+
+		auto start = std::chrono::steady_clock::now();
+		try {
+			mExtAudioFile.Write(framesRead, mWriteBuffer);
+			mFramesWritten.fetch_add(framesRead, std::memory_order_relaxed);
+		}
+		catch(const std::exception& e) {
+			mWriteErrors.fetch_add(1, std::memory_order_relaxed);
+			os_log_error(OS_LOG_DEFAULT, "Error writing frames: %{public}s", e.what());
+		}
+		auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+		mWriteCount.fetch_add(1, std::memory_order_relaxed);
+		mTotalWriteNanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+		StoreMaximum(mMaximumWriteNanoseconds, elapsed);
+	}
+}
+
+SFB::detail::RecorderOutput::Statistics SFB::detail::RecorderOutput::GetStatistics() const noexcept
+{
+	return {
+		mFramesRendered.load(std::memory_order_relaxed),
+		mFramesWritten.load(std::memory_order_relaxed),
+		mFramesDropped.load(std::memory_order_relaxed),
+		mOverruns.load(std::memory_order_relaxed),
+		mWriteErrors.load(std::memory_order_relaxed),
+		mWriteCount.load(std::memory_order_relaxed),
+		mTotalWriteNanoseconds.load(std::memory_order_relaxed),
+		mMaximumWriteNanoseconds.load(std::memory_order_relaxed),
+		mMaximumBacklogFrames.load(std::memory_order_relaxed),
+	};
+}
+
+void SFB::detail::RecorderOutput::ResetStatistics() noexcept
+{
+	mFramesRendered.store(0, std::memory_order_relaxed);
+	mFramesWritten.store(0, std::memory_order_relaxed);
+	mFramesDropped.store(0, std::memory_order_relaxed);
+	mOverruns.store(0, std::memory_order_relaxed);
+	mWriteErrors.store(0, std::memory_order_relaxed);
+	mWriteCount.store(0, std::memory_order_relaxed);
+	mTotalWriteNanoseconds.store(0, std::memory_order_relaxed);
+	mMaximumWriteNanoseconds.store(0, std::memory_order_relaxed);
+	mMaximumBacklogFrames.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2021 - 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <cstdint>
+
+#import <dispatch/dispatch.h>
+
+#import "SFBAudioRingBuffer.hpp"
+#import "SFBCABufferList.hpp"
+#import "SFBCAExtAudioFile.hpp"
+
+CF_ASSUME_NONNULL_BEGIN
+
+namespace SFB {
+
+namespace detail {
+
+/// A file recording rendered audio through a ring buffer drained by a writer thread
+///
+/// This is the shared implementation of @c AudioUnitRecorder and @c MultiBusAudioUnitRecorder.
+/// Audio is stored on the render thread and written to the file in batches of up to @c WriteBatchFrameCount() frames
+/// by @c Drain() on the writer thread.
+class RecorderOutput
+{
+
+public:
+
+	/// Recording statistics
+	struct Statistics {
+		/// The number of frames rendered by the audio unit while recording
+		uint64_t mFramesRendered;
+		/// The number of frames written to the file
+		uint64_t mFramesWritten;
+		/// The number of frames discarded because the ring buffer was full
+		uint64_t mFramesDropped;
+		/// The number of render cycles whose audio was discarded
+		uint64_t mOverruns;
+		/// The number of writes that failed
+		uint64_t mWriteErrors;
+		/// The number of writes to the file
+		uint64_t mWriteCount;
+		/// The total time spent writing to the file in nanoseconds
+		uint64_t mTotalWriteNanoseconds;
+		/// The longest write to the file in nanoseconds
+		uint64_t mMaximumWriteNanoseconds;
+		/// The largest number of frames waiting to be written
+		uint32_t mMaximumBacklogFrames;
+	};
+
+	/// The maximum time a writer thread waits before writing partial batches
+	static constexpr int64_t sWriterTimeout = 100 * NSEC_PER_MSEC;
+
+	/// Creates a new @c RecorderOutput
+	RecorderOutput() noexcept;
+
+	// This class is non-copyable
+	RecorderOutput(const RecorderOutput& rhs) = delete;
+
+	// This class is non-assignable
+	RecorderOutput& operator=(const RecorderOutput& rhs) = delete;
+
+	/// Destructor
+	~RecorderOutput() = default;
+
+	// This class is non-movable
+	RecorderOutput(RecorderOutput&& rhs) = delete;
+
+	// This class is non-move assignable
+	RecorderOutput& operator=(RecorderOutput&& rhs) = delete;
+
+	/// Returns the underlying @c ExtAudioFile
+	inline CAExtAudioFile& ExtAudioFile() noexcept
+	{
+		return mExtAudioFile;
+	}
+
+	/// Sets the client data format of the file and allocates the ring buffer and write buffer
+	/// @param clientFormat The format of the audio to be stored
+	/// @param ringBufferFrameCapacity The minimum capacity of the ring buffer in frames
+	/// @param writeBatchFrameCount The maximum number of frames written to the file at once
+	/// @throws @c std::bad_alloc
+	/// @throws @c std::system_error
+	void Prepare(const CAStreamBasicDescription& clientFormat, UInt32 ringBufferFrameCapacity, UInt32 writeBatchFrameCount);
+
+	/// Returns @c true if the buffers are allocated
+	inline bool IsPrepared() const noexcept
+	{
+		return static_cast<bool>(mWriteBuffer);
+	}
+
+	/// Returns the maximum number of frames written to the file at once
+	inline UInt32 WriteBatchFrameCount() const noexcept
+	{
+		return mWriteBuffer.FrameCapacity();
+	}
+
+	/// Stores @c frameCount frames of rendered audio using @c write
+	///
+	/// The entire render cycle is discarded if the ring buffer can't hold @c frameCount frames.
+	/// @note This method is real-time safe if @c write is
+	/// @param frameCount The number of frames rendered
+	/// @param write A callable taking an @c AudioRingBuffer& that writes exactly @c frameCount frames to it
+	template <typename F>
+	void Store(UInt32 frameCount, F&& write) noexcept
+	{
+		mFramesRendered.fetch_add(frameCount, std::memory_order_relaxed);
+
+		// Discard the entire render cycle rather than write a partial buffer
+		if(mRingBuffer.FramesAvailableToWrite() < frameCount) {
+			mFramesDropped.fetch_add(frameCount, std::memory_order_relaxed);
+			mOverruns.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		write(mRingBuffer);
+	}
+
+	/// Stores @c frameCount frames of rendered audio from @c bufferList
+	/// @note This method is real-time safe
+	inline void Store(const AudioBufferList * const _Nonnull bufferList, UInt32 frameCount) noexcept
+	{
+		Store(frameCount, [&](AudioRingBuffer& ringBuffer) noexcept {
+			ringBuffer.Write(bufferList, frameCount);
+		});
+	}
+
+	/// Returns @c true if a full batch of audio is waiting to be written
+	inline bool HasFullBatch() const noexcept
+	{
+		return mRingBuffer.FramesAvailableToRead() >= WriteBatchFrameCount();
+	}
+
+	/// Writes all audio in the ring buffer to the file
+	/// @note This method must only be called from the writer thread
+	void Drain() noexcept;
+
+	/// Returns the recording statistics
+	/// @note Each value is read atomically but the values are not read as a group
+	Statistics GetStatistics() const noexcept;
+
+	/// Resets the recording statistics
+	void ResetStatistics() noexcept;
+
+private:
+
+	/// The underlying @c ExtAudioFile
+	CAExtAudioFile mExtAudioFile;
+	/// Rendered audio waiting to be written
+	AudioRingBuffer mRingBuffer;
+	/// The buffer used by the writer thread to write to the file
+	CABufferList mWriteBuffer;
+
+	/// The number of frames rendered
+	std::atomic_uint64_t mFramesRendered;
+	/// The number of frames written
+	std::atomic_uint64_t mFramesWritten;
+	/// The number of frames discarded
+	std::atomic_uint64_t mFramesDropped;
+	/// The number of render cycles whose audio was discarded
+	std::atomic_uint64_t mOverruns;
+	/// The number of failed writes
+	std::atomic_uint64_t mWriteErrors;
+	/// The number of writes
+	std::atomic_uint64_t mWriteCount;
+	/// The total write duration in nanoseconds
+	std::atomic_uint64_t mTotalWriteNanoseconds;
+	/// The longest write duration in nanoseconds
+	std::atomic_uint64_t mMaximumWriteNanoseconds;
+	/// The largest backlog in frames
+	std::atomic_uint32_t mMaximumBacklogFrames;
+
+};
+
+} // namespace detail
+
+} // namespace SFB
+
+CF_ASSUME_NONNULL_END
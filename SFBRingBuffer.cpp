@@ -11,6 +11,7 @@
 #import <assert.h>
 
 #import "SFBRingBuffer.hpp"
+#import "SFBMirroredMemory.hpp"
 
 namespace {
 
@@ -24,24 +25,52 @@ inline constexpr uint32_t NextPowerOfTwo(uint32_t x) noexcept
 	return static_cast<uint32_t>(1 << (32 - __builtin_clz(x - 1)));
 }
 
+/// Returns the number of bytes available for reading
+/// @param writePosition The write position
+/// @param readPosition The read position
+/// @param capacityBytes The buffer capacity in bytes
+/// @param capacityBytesMask The buffer capacity in bytes minus one
+inline constexpr uint32_t ReadableBytes(uint32_t writePosition, uint32_t readPosition, uint32_t capacityBytes, uint32_t capacityBytesMask) noexcept
+{
+	if(writePosition > readPosition)
+		return writePosition - readPosition;
+	else
+		return (writePosition - readPosition + capacityBytes) & capacityBytesMask;
+}
+
+/// Returns the number of bytes available for writing
+/// @param writePosition The write position
+/// @param readPosition The read position
+/// @param capacityBytes The buffer capacity in bytes
+/// @param capacityBytesMask The buffer capacity in bytes minus one
+inline constexpr uint32_t WritableBytes(uint32_t writePosition, uint32_t readPosition, uint32_t capacityBytes, uint32_t capacityBytesMask) noexcept
+{
+	if(writePosition > readPosition)
+		return ((readPosition - writePosition + capacityBytes) & capacityBytesMask) - 1;
+	else if(writePosition < readPosition)
+		return (readPosition - writePosition) - 1;
+	else
+		return capacityBytes - 1;
+}
+
 }
 
 #pragma mark Creation and Destruction
 
 SFB::RingBuffer::RingBuffer() noexcept
-: mBuffer(nullptr), mCapacityBytes(0), mCapacityBytesMask(0), mWritePosition(0), mReadPosition(0)
+: mBuffer(nullptr), mCapacityBytes(0), mCapacityBytesMask(0), mIsMirrored(false), mWritePosition(0), mCachedReadPosition(0), mReadPosition(0), mCachedWritePosition(0)
 {
 	assert(mWritePosition.is_lock_free());
 }
 
 SFB::RingBuffer::~RingBuffer()
 {
-	std::free(mBuffer);
+	Deallocate();
 }
 
 #pragma mark Buffer Management
 
-bool SFB::RingBuffer::Allocate(uint32_t capacityBytes) noexcept
+bool SFB::RingBuffer::Allocate(uint32_t capacityBytes, bool mirrored) noexcept
 {
 	if(capacityBytes < 2 || capacityBytes > 0x80000000)
 		return false;
@@ -51,27 +80,44 @@ bool SFB::RingBuffer::Allocate(uint32_t capacityBytes) noexcept
 	// Round up to the next power of two
 	capacityBytes = NextPowerOfTwo(static_cast<uint32_t>(capacityBytes));
 
-	mBuffer = static_cast<uint8_t *>(std::malloc(capacityBytes));
+	if(mirrored) {
+		// The granularity is a power of two so the capacity remains a power of two
+		auto granularity = MirroredRegionGranularity();
+		if(granularity > 0x80000000)
+			return false;
+		capacityBytes = std::max(capacityBytes, static_cast<uint32_t>(granularity));
+		mBuffer = static_cast<uint8_t *>(AllocateMirroredRegions(capacityBytes, 1));
+	}
+	else
+		mBuffer = static_cast<uint8_t *>(std::malloc(capacityBytes));
+
 	if(!mBuffer)
 		return false;
 
+	mIsMirrored = mirrored;
+
 	mCapacityBytes = capacityBytes;
 	mCapacityBytesMask = capacityBytes - 1;
 
+	Reset();
+
 	return true;
 }
 
 void SFB::RingBuffer::Deallocate() noexcept
 {
 	if(mBuffer) {
-		std::free(mBuffer);
+		if(mIsMirrored)
+			DeallocateMirroredRegions(mBuffer, mCapacityBytes, 1);
+		else
+			std::free(mBuffer);
 		mBuffer = nullptr;
 
 		mCapacityBytes = 0;
 		mCapacityBytesMask = 0;
+		mIsMirrored = false;
 
-		mReadPosition = 0;
-		mWritePosition = 0;
+		Reset();
 	}
 }
 
@@ -79,30 +125,22 @@ void SFB::RingBuffer::Reset() noexcept
 {
 	mReadPosition = 0;
 	mWritePosition = 0;
+	mCachedReadPosition = 0;
+	mCachedWritePosition = 0;
 }
 
 uint32_t SFB::RingBuffer::BytesAvailableToRead() const noexcept
 {
 	auto writePosition = mWritePosition.load(std::memory_order_acquire);
 	auto readPosition = mReadPosition.load(std::memory_order_acquire);
-
-	if(writePosition > readPosition)
-		return writePosition - readPosition;
-	else
-		return (writePosition - readPosition + mCapacityBytes) & mCapacityBytesMask;
+	return ReadableBytes(writePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
 }
 
 uint32_t SFB::RingBuffer::BytesAvailableToWrite() const noexcept
 {
 	auto writePosition = mWritePosition.load(std::memory_order_acquire);
 	auto readPosition = mReadPosition.load(std::memory_order_acquire);
-
-	if(writePosition > readPosition)
-		return ((readPosition - writePosition + mCapacityBytes) & mCapacityBytesMask) - 1;
-	else if(writePosition < readPosition)
-		return (readPosition - writePosition) - 1;
-	else
-		return mCapacityBytes - 1;
+	return WritableBytes(writePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
 }
 
 #pragma mark Reading and Writing Data
@@ -112,20 +150,24 @@ uint32_t SFB::RingBuffer::Read(void * const destinationBuffer, uint32_t byteCoun
 	if(!destinationBuffer || byteCount == 0)
 		return 0;
 
-	auto writePosition = mWritePosition.load(std::memory_order_acquire);
-	auto readPosition = mReadPosition.load(std::memory_order_acquire);
+	auto readPosition = mReadPosition.load(std::memory_order_relaxed);
 
-	uint32_t bytesAvailable;
-	if(writePosition > readPosition)
-		bytesAvailable = writePosition - readPosition;
-	else
-		bytesAvailable = (writePosition - readPosition + mCapacityBytes) & mCapacityBytesMask;
+	// Only reload the write position if the cached value doesn't satisfy the request
+	auto bytesAvailable = ReadableBytes(mCachedWritePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
+	if(bytesAvailable < byteCount) {
+		mCachedWritePosition = mWritePosition.load(std::memory_order_acquire);
+		bytesAvailable = ReadableBytes(mCachedWritePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordRead(byteCount, bytesAvailable);
+#endif
 
 	if(bytesAvailable == 0)
 		return 0;
 
 	auto bytesToRead = std::min(bytesAvailable, byteCount);
-	if(readPosition + bytesToRead > mCapacityBytes) {
+	if(!mIsMirrored && readPosition + bytesToRead > mCapacityBytes) {
 		auto bytesAfterReadPointer = mCapacityBytes - readPosition;
 		std::memcpy(destinationBuffer, mBuffer + readPosition, bytesAfterReadPointer);
 		std::memcpy(static_cast<uint8_t *>(destinationBuffer) + bytesAfterReadPointer, mBuffer, bytesToRead - bytesAfterReadPointer);
@@ -143,20 +185,20 @@ uint32_t SFB::RingBuffer::Peek(void * const destinationBuffer, uint32_t byteCoun
 	if(!destinationBuffer || byteCount == 0)
 		return 0;
 
-	auto writePosition = mWritePosition.load(std::memory_order_acquire);
-	auto readPosition = mReadPosition.load(std::memory_order_acquire);
+	auto readPosition = mReadPosition.load(std::memory_order_relaxed);
 
-	uint32_t bytesAvailable;
-	if(writePosition > readPosition)
-		bytesAvailable = writePosition - readPosition;
-	else
-		bytesAvailable = (writePosition - readPosition + mCapacityBytes) & mCapacityBytesMask;
+	// Only reload the write position if the cached value doesn't satisfy the request
+	auto bytesAvailable = ReadableBytes(mCachedWritePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
+	if(bytesAvailable < byteCount) {
+		mCachedWritePosition = mWritePosition.load(std::memory_order_acquire);
+		bytesAvailable = ReadableBytes(mCachedWritePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
+	}
 
 	if(bytesAvailable == 0)
 		return 0;
 
 	auto bytesToRead = std::min(bytesAvailable, byteCount);
-	if(readPosition + bytesToRead > mCapacityBytes) {
+	if(!mIsMirrored && readPosition + bytesToRead > mCapacityBytes) {
 		auto bytesAfterReadPointer = mCapacityBytes - readPosition;
 		std::memcpy(destinationBuffer, mBuffer + readPosition, bytesAfterReadPointer);
 		std::memcpy(static_cast<uint8_t *>(destinationBuffer) + bytesAfterReadPointer, mBuffer, bytesToRead - bytesAfterReadPointer);
@@ -172,22 +214,24 @@ uint32_t SFB::RingBuffer::Write(const void * const sourceBuffer, uint32_t byteCo
 	if(!sourceBuffer || byteCount == 0)
 		return 0;
 
-	auto writePosition = mWritePosition.load(std::memory_order_acquire);
-	auto readPosition = mReadPosition.load(std::memory_order_acquire);
+	auto writePosition = mWritePosition.load(std::memory_order_relaxed);
 
-	uint32_t bytesAvailable;
-	if(writePosition > readPosition)
-		bytesAvailable = ((readPosition - writePosition + mCapacityBytes) & mCapacityBytesMask) - 1;
-	else if(writePosition < readPosition)
-		bytesAvailable = (readPosition - writePosition) - 1;
-	else
-		bytesAvailable = mCapacityBytes - 1;
+	// Only reload the read position if the cached value doesn't satisfy the request
+	auto bytesAvailable = WritableBytes(writePosition, mCachedReadPosition, mCapacityBytes, mCapacityBytesMask);
+	if(bytesAvailable < byteCount) {
+		mCachedReadPosition = mReadPosition.load(std::memory_order_acquire);
+		bytesAvailable = WritableBytes(writePosition, mCachedReadPosition, mCapacityBytes, mCapacityBytesMask);
+	}
+
+#if SFB_RING_BUFFER_STATISTICS
+	mStatistics.RecordWrite(byteCount, bytesAvailable, mCapacityBytes - 1);
+#endif
 
 	if(bytesAvailable == 0)
 		return 0;
 
 	auto bytesToWrite = std::min(bytesAvailable, byteCount);
-	if(writePosition + bytesToWrite > mCapacityBytes) {
+	if(!mIsMirrored && writePosition + bytesToWrite > mCapacityBytes) {
 		auto bytesAfterWritePointer = mCapacityBytes - writePosition;
 		std::memcpy(mBuffer + writePosition, sourceBuffer, bytesAfterWritePointer);
 		std::memcpy(mBuffer, static_cast<const uint8_t *>(sourceBuffer) + bytesAfterWritePointer, bytesToWrite - bytesAfterWritePointer);
@@ -197,55 +241,75 @@ uint32_t SFB::RingBuffer::Write(const void * const sourceBuffer, uint32_t byteCo
 
 	mWritePosition.store((writePosition + bytesToWrite) & mCapacityBytesMask, std::memory_order_release);
 
+	NotifyWaiter();
+
 	return bytesToWrite;
 }
 
 void SFB::RingBuffer::AdvanceReadPosition(uint32_t byteCount) noexcept
 {
-	mReadPosition.store((mReadPosition.load(std::memory_order_acquire) + byteCount) & mCapacityBytesMask, std::memory_order_release);
+	mReadPosition.store((mReadPosition.load(std::memory_order_relaxed) + byteCount) & mCapacityBytesMask, std::memory_order_release);
 }
 
 void SFB::RingBuffer::AdvanceWritePosition(uint32_t byteCount) noexcept
 {
-	mWritePosition.store((mWritePosition.load(std::memory_order_acquire) + byteCount) & mCapacityBytesMask, std::memory_order_release);
+	mWritePosition.store((mWritePosition.load(std::memory_order_relaxed) + byteCount) & mCapacityBytesMask, std::memory_order_release);
+	NotifyWaiter();
 }
 
 const SFB::RingBuffer::ReadBufferPair SFB::RingBuffer::ReadVector() const noexcept
 {
 	auto writePosition = mWritePosition.load(std::memory_order_acquire);
-	auto readPosition = mReadPosition.load(std::memory_order_acquire);
-
-	uint32_t bytesAvailable;
-	if(writePosition > readPosition)
-		bytesAvailable = writePosition - readPosition;
-	else
-		bytesAvailable = (writePosition - readPosition + mCapacityBytes) & mCapacityBytesMask;
+	auto readPosition = mReadPosition.load(std::memory_order_relaxed);
 
+	auto bytesAvailable = ReadableBytes(writePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
 	auto endOfRead = readPosition + bytesAvailable;
 
-	if(endOfRead > mCapacityBytes)
-		return { { mBuffer + readPosition, mCapacityBytes - readPosition }, { mBuffer, endOfRead & mCapacityBytes } };
+	if(!mIsMirrored && endOfRead > mCapacityBytes)
+		return { { mBuffer + readPosition, mCapacityBytes - readPosition }, { mBuffer, endOfRead & mCapacityBytesMask } };
 	else
 		return { { mBuffer + readPosition, bytesAvailable }, {} };
 }
 
 const SFB::RingBuffer::WriteBufferPair SFB::RingBuffer::WriteVector() const noexcept
 {
-	auto writePosition = mWritePosition.load(std::memory_order_acquire);
+	auto writePosition = mWritePosition.load(std::memory_order_relaxed);
 	auto readPosition = mReadPosition.load(std::memory_order_acquire);
 
-	uint32_t bytesAvailable;
-	if(writePosition > readPosition)
-		bytesAvailable = ((readPosition - writePosition + mCapacityBytes) & mCapacityBytesMask) - 1;
-	else if(writePosition < readPosition)
-		bytesAvailable = (readPosition - writePosition) - 1;
-	else
-		bytesAvailable = mCapacityBytes - 1;
-
+	auto bytesAvailable = WritableBytes(writePosition, readPosition, mCapacityBytes, mCapacityBytesMask);
 	auto endOfWrite = writePosition + bytesAvailable;
 
-	if(endOfWrite > mCapacityBytes)
-		return { { mBuffer + writePosition, mCapacityBytes - writePosition }, { mBuffer, endOfWrite & mCapacityBytes } };
+	if(!mIsMirrored && endOfWrite > mCapacityBytes)
+		return { { mBuffer + writePosition, mCapacityBytes - writePosition }, { mBuffer, endOfWrite & mCapacityBytesMask } };
 	else
 		return { { mBuffer + writePosition, bytesAvailable }, {} };
 }
+
+#pragma mark Waiting
+
+bool SFB::RingBuffer::WaitForBytes(uint32_t byteCount, dispatch_time_t timeout) noexcept
+{
+	if(byteCount == 0 || byteCount >= mCapacityBytes)
+		return false;
+
+	auto readPosition = mReadPosition.load(std::memory_order_relaxed);
+	return mWaiter.Wait(byteCount, timeout, [&] {
+		return ReadableBytes(mWritePosition.load(std::memory_order_acquire), readPosition, mCapacityBytes, mCapacityBytesMask);
+	});
+}
+
+uint32_t SFB::RingBuffer::ReadBlocking(void * const destinationBuffer, uint32_t byteCount, dispatch_time_t timeout) noexcept
+{
+	if(!destinationBuffer || byteCount == 0)
+		return 0;
+
+	WaitForBytes(byteCount, timeout);
+	return Read(destinationBuffer, byteCount);
+}
+
+void SFB::RingBuffer::NotifyWaiter() noexcept
+{
+	mWaiter.Notify([&] {
+		return ReadableBytes(mWritePosition.load(std::memory_order_relaxed), mReadPosition.load(std::memory_order_acquire), mCapacityBytes, mCapacityBytesMask);
+	});
+}
@@ -8,11 +8,21 @@
 
 #import <atomic>
 
+#import <dispatch/dispatch.h>
+
+#import "SFBHardwareInterferenceSize.hpp"
+#import "SFBMirroredMemory.hpp"
+#import "SFBRingBufferStatistics.hpp"
+#import "SFBRingBufferWaiter.hpp"
+
 namespace SFB {
 
 /// A generic ring buffer.
 ///
 /// This class is thread safe when used from one reader thread and one writer thread (single producer, single consumer model).
+///
+/// The read and write positions are stored on separate cache lines and each side keeps a private copy of the other
+/// side's position, which is reloaded only when the copy indicates the buffer is too empty or too full.
 class RingBuffer
 {
 
@@ -42,11 +52,16 @@ public:
 #pragma mark Buffer management
 
 	/// Allocates space for data.
+	///
+	/// A mirrored buffer maps its memory twice in consecutive virtual memory so any read or write of up to the buffer's
+	/// capacity is a single contiguous span. The capacity of a mirrored buffer is rounded up to a multiple of
+	/// @c MirroredRegionGranularity().
 	/// @note This method is not thread safe.
 	/// @note Capacities from 2 to 2,147,483,648 (0x80000000) bytes are supported
 	/// @param byteCount The desired capacity, in bytes
+	/// @param mirrored Whether to allocate mirrored memory
 	/// @return @c true on success, @c false on error
-	bool Allocate(uint32_t byteCount) noexcept;
+	bool Allocate(uint32_t byteCount, bool mirrored = false) noexcept;
 
 	/// Frees the resources used by this @c RingBuffer
 	/// @note This method is not thread safe.
@@ -64,6 +79,12 @@ public:
 		return mCapacityBytes;
 	}
 
+	/// Returns @c true if this @c RingBuffer uses mirrored memory
+	inline bool IsMirrored() const noexcept
+	{
+		return mIsMirrored;
+	}
+
 	/// Returns the number of bytes available for reading
 	uint32_t BytesAvailableToRead() const noexcept;
 
@@ -122,6 +143,7 @@ public:
 	using ReadBufferPair = std::pair<const ReadBuffer, const ReadBuffer>;
 
 	/// Returns the read vector containing the current readable data
+	/// @note If the buffer is mirrored the second @c ReadBuffer is always empty
 	const ReadBufferPair ReadVector() const noexcept;
 
 
@@ -149,10 +171,65 @@ public:
 	using WriteBufferPair = std::pair<const WriteBuffer, const WriteBuffer>;
 
 	/// Returns the write vector containing the current writable space
+	/// @note If the buffer is mirrored the second @c WriteBuffer is always empty
 	const WriteBufferPair WriteVector() const noexcept;
 
+#pragma mark Waiting
+
+	/// Enables @c WaitForBytes() and @c ReadBlocking()
+	///
+	/// When waiting is enabled the writer checks for a waiting reader after each write and signals a semaphore only if
+	/// the reader's threshold was reached. The writer never blocks.
+	/// @note This method is not thread safe.
+	/// @return @c true on success, @c false on error
+	inline bool EnableWaiting() noexcept
+	{
+		return mWaiter.Enable();
+	}
+
+	/// Waits for at least @c byteCount bytes to become available for reading
+	/// @note Only the reader may call this method
+	/// @param byteCount The desired number of bytes, from 1 to @c CapacityBytes()-1
+	/// @param timeout The time after which to stop waiting
+	/// @return @c true if at least @c byteCount bytes are available, @c false on timeout, if @c byteCount is out of range, or if waiting isn't enabled
+	bool WaitForBytes(uint32_t byteCount, dispatch_time_t timeout = DISPATCH_TIME_FOREVER) noexcept;
+
+	/// Waits for at least @c byteCount bytes to become available and reads them, advancing the read pointer.
+	///
+	/// If @c byteCount bytes aren't available before @c timeout the available bytes are read.
+	/// @note Only the reader may call this method
+	/// @param destinationBuffer An address to receive the data
+	/// @param byteCount The desired number of bytes to read, from 1 to @c CapacityBytes()-1
+	/// @param timeout The time after which to stop waiting
+	/// @return The number of bytes actually read
+	uint32_t ReadBlocking(void * const _Nonnull destinationBuffer, uint32_t byteCount, dispatch_time_t timeout = DISPATCH_TIME_FOREVER) noexcept;
+
+#pragma mark Statistics
+
+	/// Returns the statistics for this @c RingBuffer in bytes
+	/// @note Statistics are collected only when @c SFB_RING_BUFFER_STATISTICS is nonzero; otherwise all values are zero
+	inline RingBufferStatistics GetStatistics() const noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		return mStatistics.Snapshot();
+#else
+		return {};
+#endif
+	}
+
+	/// Discards the statistics for this @c RingBuffer
+	inline void ResetStatistics() noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		mStatistics.Reset();
+#endif
+	}
+
 private:
 
+	/// Wakes the reader if it is waiting for the bytes now available
+	void NotifyWaiter() noexcept;
+
 	/// The memory buffer holding the data
 	uint8_t * _Nullable mBuffer;
 
@@ -160,11 +237,26 @@ private:
 	uint32_t mCapacityBytes;
 	/// The capacity of @c mBuffer in bytes minus one
 	uint32_t mCapacityBytesMask;
+	/// Whether @c mBuffer is mirrored
+	bool mIsMirrored;
 
-	/// The offset into @c mBuffer of the read location
-	std::atomic_uint32_t mWritePosition;
 	/// The offset into @c mBuffer of the write location
-	std::atomic_uint32_t mReadPosition;
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mWritePosition;
+	/// The writer's copy of @c mReadPosition
+	uint32_t mCachedReadPosition;
+
+	/// The offset into @c mBuffer of the read location
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mReadPosition;
+	/// The reader's copy of @c mWritePosition
+	mutable uint32_t mCachedWritePosition;
+
+	/// Wakes a reader waiting for data
+	alignas(DestructiveInterferenceSize) RingBufferWaiter mWaiter;
+
+#if SFB_RING_BUFFER_STATISTICS
+	/// The buffer's statistics
+	alignas(DestructiveInterferenceSize) RingBufferStatisticsCollector mStatistics;
+#endif
 
 };
 
@@ -0,0 +1,203 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <algorithm>
+#import <atomic>
+#import <cstdint>
+#import <limits>
+
+#import "SFBHardwareInterferenceSize.hpp"
+
+/// Set to a nonzero value to collect ring buffer statistics
+///
+/// When zero, the default, no statistics are collected and ring buffers contain no additional state.
+/// @note This must have the same value in every translation unit using a ring buffer
+#ifndef SFB_RING_BUFFER_STATISTICS
+#define SFB_RING_BUFFER_STATISTICS 0
+#endif
+
+namespace SFB {
+
+/// Statistics collected by @c RingBuffer, @c AudioRingBuffer, and @c CARingBuffer
+///
+/// Units are bytes for @c RingBuffer and frames for @c AudioRingBuffer and @c CARingBuffer.
+struct RingBufferStatistics {
+	/// The number of reads for which less data was available than requested
+	uint64_t mUnderruns;
+	/// For @c RingBuffer and @c AudioRingBuffer the number of writes for which less space was available than requested;
+	/// for @c CARingBuffer the number of reads of audio that was overwritten before or during the read
+	uint64_t mOverruns;
+	/// The number of units requested by reads that weren't available
+	uint64_t mUnitsNotRead;
+	/// The number of units passed to writes that couldn't be stored
+	uint64_t mUnitsNotWritten;
+	/// The number of frames zero-filled by @c CARingBuffer reads because they were outside the buffer's time bounds
+	uint64_t mZeroFilledFrames;
+	/// The smallest occupancy observed by a read or write
+	uint64_t mMinimumOccupancy;
+	/// The largest occupancy observed by a read or write, the buffer's high-water mark
+	uint64_t mMaximumOccupancy;
+};
+
+/// Lock-free collection of @c RingBufferStatistics
+///
+/// Statistics recorded by the reader and the writer are stored in separate cache lines so collecting them doesn't
+/// introduce false sharing between the two threads. @c RecordWrite() and @c RecordWriteOccupancy() should only be
+/// called by the writer and the remaining @c Record methods only by the reader.
+/// @note This class is thread safe
+class RingBufferStatisticsCollector
+{
+
+public:
+
+	/// Creates an empty @c RingBufferStatisticsCollector
+	RingBufferStatisticsCollector() noexcept
+	{
+		Reset();
+	}
+
+	// This class is non-copyable
+	RingBufferStatisticsCollector(const RingBufferStatisticsCollector& rhs) = delete;
+
+	// This class is non-assignable
+	RingBufferStatisticsCollector& operator=(const RingBufferStatisticsCollector& rhs) = delete;
+
+	/// Records a read of @c requested units when @c available units were available
+	inline void RecordRead(uint64_t requested, uint64_t available) noexcept
+	{
+		mReader.RecordOccupancy(available);
+		if(available < requested) {
+			mReader.mUnderruns.fetch_add(1, std::memory_order_relaxed);
+			mReader.mUnitsNotRead.fetch_add(requested - available, std::memory_order_relaxed);
+		}
+	}
+
+	/// Records a write of @c requested units when @c available of @c capacity units were available
+	inline void RecordWrite(uint64_t requested, uint64_t available, uint64_t capacity) noexcept
+	{
+		mWriter.RecordOccupancy(capacity - available + std::min(requested, available));
+		if(available < requested) {
+			mWriter.mOverruns.fetch_add(1, std::memory_order_relaxed);
+			mWriter.mUnitsNotWritten.fetch_add(requested - available, std::memory_order_relaxed);
+		}
+	}
+
+	/// Records a read of @c underrunFrames frames not yet written and @c overrunFrames frames already overwritten
+	inline void RecordTimestampedRead(uint64_t underrunFrames, uint64_t overrunFrames) noexcept
+	{
+		if(underrunFrames > 0) {
+			mReader.mUnderruns.fetch_add(1, std::memory_order_relaxed);
+			mReader.mUnitsNotRead.fetch_add(underrunFrames, std::memory_order_relaxed);
+		}
+		if(overrunFrames > 0) {
+			mReader.mOverruns.fetch_add(1, std::memory_order_relaxed);
+			mReader.mUnitsNotRead.fetch_add(overrunFrames, std::memory_order_relaxed);
+		}
+		if(underrunFrames + overrunFrames > 0)
+			mReader.mZeroFilledFrames.fetch_add(underrunFrames + overrunFrames, std::memory_order_relaxed);
+	}
+
+	/// Records a read of audio that was overwritten before or during the read
+	inline void RecordReadOverrun() noexcept
+	{
+		mReader.mOverruns.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// Records an underrun of @c units units
+	inline void RecordUnderrun(uint64_t units) noexcept
+	{
+		mReader.mUnderruns.fetch_add(1, std::memory_order_relaxed);
+		mReader.mUnitsNotRead.fetch_add(units, std::memory_order_relaxed);
+	}
+
+	/// Records an occupancy of @c occupancy units observed by the reader
+	inline void RecordReadOccupancy(uint64_t occupancy) noexcept
+	{
+		mReader.RecordOccupancy(occupancy);
+	}
+
+	/// Records an occupancy of @c occupancy units observed by the writer
+	inline void RecordWriteOccupancy(uint64_t occupancy) noexcept
+	{
+		mWriter.RecordOccupancy(occupancy);
+	}
+
+	/// Returns the collected statistics
+	/// @note Each value is read atomically but the values are not read as a group
+	RingBufferStatistics Snapshot() const noexcept
+	{
+		auto minimum = std::min(mReader.mMinimumOccupancy.load(std::memory_order_relaxed), mWriter.mMinimumOccupancy.load(std::memory_order_relaxed));
+		return {
+			mReader.mUnderruns.load(std::memory_order_relaxed) + mWriter.mUnderruns.load(std::memory_order_relaxed),
+			mReader.mOverruns.load(std::memory_order_relaxed) + mWriter.mOverruns.load(std::memory_order_relaxed),
+			mReader.mUnitsNotRead.load(std::memory_order_relaxed) + mWriter.mUnitsNotRead.load(std::memory_order_relaxed),
+			mReader.mUnitsNotWritten.load(std::memory_order_relaxed) + mWriter.mUnitsNotWritten.load(std::memory_order_relaxed),
+			mReader.mZeroFilledFrames.load(std::memory_order_relaxed) + mWriter.mZeroFilledFrames.load(std::memory_order_relaxed),
+			minimum == std::numeric_limits<uint64_t>::max() ? 0 : minimum,
+			std::max(mReader.mMaximumOccupancy.load(std::memory_order_relaxed), mWriter.mMaximumOccupancy.load(std::memory_order_relaxed)),
+		};
+	}
+
+	/// Discards the collected statistics
+	void Reset() noexcept
+	{
+		mReader.Reset();
+		mWriter.Reset();
+	}
+
+private:
+
+	/// Statistics recorded by one thread
+	struct Counters {
+		/// The number of underruns
+		std::atomic_uint64_t mUnderruns;
+		/// The number of overruns
+		std::atomic_uint64_t mOverruns;
+		/// The number of units not read
+		std::atomic_uint64_t mUnitsNotRead;
+		/// The number of units not written
+		std::atomic_uint64_t mUnitsNotWritten;
+		/// The number of zero-filled frames
+		std::atomic_uint64_t mZeroFilledFrames;
+		/// The smallest observed occupancy
+		std::atomic_uint64_t mMinimumOccupancy;
+		/// The largest observed occupancy
+		std::atomic_uint64_t mMaximumOccupancy;
+
+		/// Records an observed occupancy of @c occupancy units
+		inline void RecordOccupancy(uint64_t occupancy) noexcept
+		{
+			auto minimum = mMinimumOccupancy.load(std::memory_order_relaxed);
+			while(occupancy < minimum && !mMinimumOccupancy.compare_exchange_weak(minimum, occupancy, std::memory_order_relaxed))
+				;
+			auto maximum = mMaximumOccupancy.load(std::memory_order_relaxed);
+			while(occupancy > maximum && !mMaximumOccupancy.compare_exchange_weak(maximum, occupancy, std::memory_order_relaxed))
+				;
+		}
+
+		/// Discards the statistics
+		void Reset() noexcept
+		{
+			mUnderruns.store(0, std::memory_order_relaxed);
+			mOverruns.store(0, std::memory_order_relaxed);
+			mUnitsNotRead.store(0, std::memory_order_relaxed);
+			mUnitsNotWritten.store(0, std::memory_order_relaxed);
+			mZeroFilledFrames.store(0, std::memory_order_relaxed);
+			mMinimumOccupancy.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+			mMaximumOccupancy.store(0, std::memory_order_relaxed);
+		}
+	};
+
+	/// Statistics recorded by the reader
+	alignas(DestructiveInterferenceSize) Counters mReader;
+	/// Statistics recorded by the writer
+	alignas(DestructiveInterferenceSize) Counters mWriter;
+
+};
+
+} // namespace SFB
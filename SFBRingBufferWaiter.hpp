@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <atomic>
+#import <cstdint>
+#import <memory>
+#import <new>
+#import <stdexcept>
+
+#import <os/log.h>
+
+#import "SFBDispatchSemaphore.hpp"
+
+namespace SFB {
+
+/// Wait and notify support allowing a ring buffer's reader to block until enough data is available
+///
+/// The reader publishes the amount of data it is waiting for and sleeps on a @c DispatchSemaphore. After publishing
+/// data the writer checks whether a threshold is published and signals the semaphore only when the threshold is
+/// reached, so the writer never blocks and performs no system calls unless a reader is waiting.
+/// @note Only one thread may wait at a time
+class RingBufferWaiter
+{
+
+public:
+
+	/// Creates a @c RingBufferWaiter with waiting disabled
+	RingBufferWaiter() noexcept
+	: mThreshold(0)
+	{}
+
+	// This class is non-copyable
+	RingBufferWaiter(const RingBufferWaiter& rhs) = delete;
+
+	// This class is non-assignable
+	RingBufferWaiter& operator=(const RingBufferWaiter& rhs) = delete;
+
+	/// Enables waiting
+	/// @note This method is not thread safe and must not be called while the ring buffer is in use
+	/// @return @c true on success, @c false if the semaphore could not be created
+	bool Enable() noexcept
+	{
+		if(mSemaphore)
+			return true;
+		try {
+			mSemaphore = std::make_unique<DispatchSemaphore>(0);
+		}
+		catch(const std::exception& e) {
+			os_log_error(OS_LOG_DEFAULT, "Unable to create ring buffer semaphore: %{public}s", e.what());
+			return false;
+		}
+		return true;
+	}
+
+	/// Returns @c true if waiting is enabled
+	inline bool IsEnabled() const noexcept
+	{
+		return mSemaphore != nullptr;
+	}
+
+	/// Wakes the waiting reader if the amount of readable data reached its threshold
+	/// @note Only the writer may call this method, after publishing data
+	/// @param readable A function returning the amount of data available for reading
+	template <typename F>
+	inline void Notify(F&& readable) noexcept
+	{
+		if(!mSemaphore)
+			return;
+
+		// Order the writer's publication before the threshold check, pairing with the reader's publication of the threshold
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto threshold = mThreshold.load(std::memory_order_relaxed);
+		if(threshold != 0 && readable() >= threshold && mThreshold.compare_exchange_strong(threshold, 0, std::memory_order_relaxed))
+			mSemaphore->Signal();
+	}
+
+	/// Waits for at least @c count units to become available for reading
+	/// @note Only the reader may call this method
+	/// @param count The desired number of units, which must be nonzero
+	/// @param timeout The time after which to stop waiting
+	/// @param readable A function returning the amount of data available for reading
+	/// @return @c true if at least @c count units are available, @c false on timeout or if waiting isn't enabled
+	template <typename F>
+	bool Wait(uint32_t count, dispatch_time_t timeout, F&& readable) noexcept
+	{
+		if(readable() >= count)
+			return true;
+		if(!mSemaphore)
+			return false;
+
+		for(;;) {
+			mThreshold.store(count, std::memory_order_seq_cst);
+
+			// Data published before the threshold was visible to the writer would not be signaled
+			if(readable() >= count) {
+				CancelWait();
+				return true;
+			}
+
+			if(!mSemaphore->Wait(timeout)) {
+				CancelWait();
+				return readable() >= count;
+			}
+
+			if(readable() >= count)
+				return true;
+		}
+	}
+
+private:
+
+	/// Withdraws the threshold and consumes the writer's signal if it was already sent
+	inline void CancelWait() noexcept
+	{
+		// A zero threshold means the writer claimed it and its signal is imminent
+		if(mThreshold.exchange(0, std::memory_order_relaxed) == 0)
+			mSemaphore->Wait(DISPATCH_TIME_FOREVER);
+	}
+
+	/// The semaphore used to wake the reader or @c nullptr if waiting is disabled
+	std::unique_ptr<DispatchSemaphore> mSemaphore;
+	/// The amount of data the reader is waiting for or @c 0 if no reader is waiting
+	std::atomic_uint32_t mThreshold;
+
+};
+
+} // namespace SFB
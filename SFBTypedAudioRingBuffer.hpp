@@ -0,0 +1,523 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <algorithm>
+#import <atomic>
+#import <cassert>
+#import <cstdlib>
+#import <cstring>
+#import <limits>
+#import <type_traits>
+
+#import <CoreAudioTypes/CoreAudioTypes.h>
+
+#import "SFBAudioInterleaving.hpp"
+#import "SFBCAStreamBasicDescription.hpp"
+#import "SFBHardwareInterferenceSize.hpp"
+#import "SFBRingBufferStatistics.hpp"
+
+namespace SFB {
+
+/// A ring buffer of interleaved audio with a sample type and channel count fixed at compile time.
+///
+/// Because the frame size is a compile-time constant, byte offsets fold to shifts and the copy loops are specialized for
+/// the channel count: stereo conversions between interleaved and non-interleaved audio use 128-bit vector shuffles and
+/// other channel counts use loops the compiler can fully unroll. Use @c AudioRingBuffer when the format is known only
+/// at runtime.
+///
+/// This class is thread safe when used from one reader thread and one writer thread (single producer, single consumer model).
+///
+/// @code
+/// SFB::TypedAudioRingBuffer<float, 2> ringBuffer;
+/// if(!ringBuffer.Allocate(format, 4096))
+///     // The format isn't native-endian packed stereo float32 or allocation failed
+/// @endcode
+/// @tparam T The sample type, an arithmetic type of 1, 2, 4, or 8 bytes
+/// @tparam Channels The number of channels
+template <typename T, uint32_t Channels>
+class TypedAudioRingBuffer
+{
+
+	static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "T must be an arithmetic sample type");
+	static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "Unsupported sample size");
+	static_assert(Channels > 0, "Channels must be nonzero");
+
+public:
+
+	/// The sample type
+	using SampleType = T;
+	/// The number of channels
+	static constexpr uint32_t sChannelCount = Channels;
+	/// The size of a single interleaved frame in bytes
+	static constexpr uint32_t sBytesPerFrame = sizeof(T) * Channels;
+
+#pragma mark Format Compatibility
+
+	/// Returns @c true if @c format describes native-endian packed linear PCM audio of @c T with @c Channels channels
+	/// @note Both interleaved and non-interleaved formats are compatible
+	static bool FormatIsCompatible(const CAStreamBasicDescription& format) noexcept
+	{
+		if(!format.IsPCM() || !format.IsNativeEndian() || format.mChannelsPerFrame != Channels || format.mBitsPerChannel != 8 * sizeof(T))
+			return false;
+		if(format.IsFloat() != std::is_floating_point_v<T>)
+			return false;
+		if(std::is_integral_v<T> && format.IsSignedInteger() != std::is_signed_v<T>)
+			return false;
+		return format.mBytesPerFrame == (format.IsInterleaved() ? sBytesPerFrame : sizeof(T)) && format.mFramesPerPacket == 1;
+	}
+
+	/// Returns the format of the audio stored in a @c TypedAudioRingBuffer
+	/// @param sampleRate The sample rate
+	/// @param isInterleaved Whether the format should be interleaved
+	static CAStreamBasicDescription Format(Float64 sampleRate, bool isInterleaved = true) noexcept
+	{
+		CAStreamBasicDescription format;
+		FillOutASBDForLPCM(format, sampleRate, Channels, 8 * sizeof(T), 8 * sizeof(T), std::is_floating_point_v<T>, false, !isInterleaved);
+		if(std::is_integral_v<T> && !std::is_signed_v<T>)
+			format.mFormatFlags &= ~kAudioFormatFlagIsSignedInteger;
+		return format;
+	}
+
+#pragma mark Creation and Destruction
+
+	/// Creates a new @c TypedAudioRingBuffer
+	/// @note @c Allocate() must be called before the object may be used.
+	TypedAudioRingBuffer() noexcept
+	: mBuffer(nullptr), mCapacityFrames(0), mCapacityFramesMask(0), mWritePointer(0), mCachedReadPointer(0), mReadPointer(0), mCachedWritePointer(0)
+	{
+		assert(mWritePointer.is_lock_free());
+	}
+
+	// This class is non-copyable
+	TypedAudioRingBuffer(const TypedAudioRingBuffer& rhs) = delete;
+
+	// This class is non-assignable
+	TypedAudioRingBuffer& operator=(const TypedAudioRingBuffer& rhs) = delete;
+
+	/// Destroys the @c TypedAudioRingBuffer and release all associated resources.
+	~TypedAudioRingBuffer()
+	{
+		Deallocate();
+	}
+
+	// This class is non-movable
+	TypedAudioRingBuffer(TypedAudioRingBuffer&& rhs) = delete;
+
+	// This class is non-move assignable
+	TypedAudioRingBuffer& operator=(TypedAudioRingBuffer&& rhs) = delete;
+
+#pragma mark Buffer management
+
+	/// Allocates space for audio data.
+	/// @note This method is not thread safe.
+	/// @note Capacities from 2 to 2,147,483,648 (0x80000000) frames are supported
+	/// @note The total capacity in bytes may not exceed 4,294,967,295 (0xFFFFFFFF)
+	/// @param capacityFrames The desired capacity, in frames
+	/// @return @c true on success, @c false on error
+	bool Allocate(uint32_t capacityFrames) noexcept
+	{
+		if(capacityFrames < 2 || capacityFrames > 0x80000000)
+			return false;
+
+		Deallocate();
+
+		// Round up to the next power of two
+		capacityFrames = static_cast<uint32_t>(1 << (32 - __builtin_clz(capacityFrames - 1)));
+
+		auto capacityBytes = static_cast<uint64_t>(capacityFrames) * sBytesPerFrame;
+		if(capacityBytes > std::numeric_limits<uint32_t>::max())
+			return false;
+
+		mBuffer = static_cast<T *>(std::calloc(capacityFrames, sBytesPerFrame));
+		if(!mBuffer)
+			return false;
+
+		mCapacityFrames = capacityFrames;
+		mCapacityFramesMask = capacityFrames - 1;
+
+		Reset();
+
+		return true;
+	}
+
+	/// Allocates space for audio data after verifying @c format is compatible
+	/// @note This method is not thread safe.
+	/// @param format The format of the audio that will be written to and read from this buffer
+	/// @param capacityFrames The desired capacity, in frames
+	/// @return @c true on success, @c false if @c format isn't compatible or on error
+	bool Allocate(const CAStreamBasicDescription& format, uint32_t capacityFrames) noexcept
+	{
+		if(!FormatIsCompatible(format))
+			return false;
+		return Allocate(capacityFrames);
+	}
+
+	/// Frees the resources used by this @c TypedAudioRingBuffer
+	/// @note This method is not thread safe.
+	void Deallocate() noexcept
+	{
+		if(mBuffer) {
+			std::free(mBuffer);
+			mBuffer = nullptr;
+
+			mCapacityFrames = 0;
+			mCapacityFramesMask = 0;
+
+			Reset();
+		}
+	}
+
+
+	/// Resets this @c TypedAudioRingBuffer to its default state.
+	/// @note This method is not thread safe.
+	void Reset() noexcept
+	{
+		mReadPointer = 0;
+		mWritePointer = 0;
+		mCachedReadPointer = 0;
+		mCachedWritePointer = 0;
+	}
+
+
+	/// Returns the capacity in frames of this @c TypedAudioRingBuffer
+	inline uint32_t CapacityFrames() const noexcept
+	{
+		return mCapacityFrames;
+	}
+
+	/// Returns the number of frames available for reading
+	inline uint32_t FramesAvailableToRead() const noexcept
+	{
+		auto writePointer = mWritePointer.load(std::memory_order_acquire);
+		auto readPointer = mReadPointer.load(std::memory_order_acquire);
+		return ReadableFrames(writePointer, readPointer);
+	}
+
+	/// Returns the free space available for writing in frames
+	inline uint32_t FramesAvailableToWrite() const noexcept
+	{
+		auto writePointer = mWritePointer.load(std::memory_order_acquire);
+		auto readPointer = mReadPointer.load(std::memory_order_acquire);
+		return WritableFrames(writePointer, readPointer);
+	}
+
+#pragma mark Reading and writing audio
+
+	/// Reads interleaved audio from the @c TypedAudioRingBuffer and advances the read pointer.
+	/// @param buffer A buffer to receive @c frameCount frames of interleaved audio
+	/// @param frameCount The desired number of frames to read
+	/// @return The number of frames actually read
+	uint32_t ReadInterleaved(T * const _Nonnull buffer, uint32_t frameCount) noexcept
+	{
+		if(!buffer)
+			return 0;
+		return ReadFrames(frameCount, [&](uint32_t srcFrame, uint32_t dstFrame, uint32_t count) noexcept {
+			std::memcpy(buffer + dstFrame * Channels, mBuffer + srcFrame * Channels, count * sBytesPerFrame);
+		});
+	}
+
+	/// Reads non-interleaved audio from the @c TypedAudioRingBuffer and advances the read pointer.
+	///
+	/// The audio is deinterleaved during the copy.
+	/// @param buffers An array of @c Channels buffers each receiving @c frameCount frames of audio
+	/// @param frameCount The desired number of frames to read
+	/// @return The number of frames actually read
+	uint32_t ReadNonInterleaved(T * const _Nonnull * const _Nonnull buffers, uint32_t frameCount) noexcept
+	{
+		if(!buffers)
+			return 0;
+		return ReadFrames(frameCount, [&](uint32_t srcFrame, uint32_t dstFrame, uint32_t count) noexcept {
+			DeinterleaveFrames(mBuffer + srcFrame * Channels, buffers, dstFrame, count);
+		});
+	}
+
+	/// Writes interleaved audio to the @c TypedAudioRingBuffer and advances the write pointer.
+	/// @param buffer A buffer containing @c frameCount frames of interleaved audio
+	/// @param frameCount The desired number of frames to write
+	/// @return The number of frames actually written
+	uint32_t WriteInterleaved(const T * const _Nonnull buffer, uint32_t frameCount) noexcept
+	{
+		if(!buffer)
+			return 0;
+		return WriteFrames(frameCount, [&](uint32_t dstFrame, uint32_t srcFrame, uint32_t count) noexcept {
+			std::memcpy(mBuffer + dstFrame * Channels, buffer + srcFrame * Channels, count * sBytesPerFrame);
+		});
+	}
+
+	/// Writes non-interleaved audio to the @c TypedAudioRingBuffer and advances the write pointer.
+	///
+	/// The audio is interleaved during the copy.
+	/// @param buffers An array of @c Channels buffers each containing @c frameCount frames of audio
+	/// @param frameCount The desired number of frames to write
+	/// @return The number of frames actually written
+	uint32_t WriteNonInterleaved(const T * const _Nonnull * const _Nonnull buffers, uint32_t frameCount) noexcept
+	{
+		if(!buffers)
+			return 0;
+		return WriteFrames(frameCount, [&](uint32_t dstFrame, uint32_t srcFrame, uint32_t count) noexcept {
+			InterleaveFrames(buffers, srcFrame, mBuffer + dstFrame * Channels, count);
+		});
+	}
+
+
+	/// Reads audio from the @c TypedAudioRingBuffer and advances the read pointer.
+	///
+	/// @c bufferList may contain either one buffer of @c Channels interleaved channels or @c Channels buffers of one
+	/// channel. At most as many frames as fit in the smallest buffer are read, and the buffer sizes are set to the
+	/// number of frames read.
+	/// @param bufferList An @c AudioBufferList to receive the audio
+	/// @param frameCount The desired number of frames to read
+	/// @return The number of frames actually read or @c 0 if the layout of @c bufferList is incompatible
+	uint32_t Read(AudioBufferList * const _Nonnull bufferList, uint32_t frameCount) noexcept
+	{
+		uint32_t framesRead = 0;
+		if(IsInterleavedBufferList(bufferList))
+			framesRead = ReadInterleaved(static_cast<T *>(bufferList->mBuffers[0].mData), std::min(frameCount, BufferListFrameCapacity(bufferList)));
+		else if(IsNonInterleavedBufferList(bufferList)) {
+			T *buffers [Channels];
+			for(uint32_t i = 0; i < Channels; ++i)
+				buffers[i] = static_cast<T *>(bufferList->mBuffers[i].mData);
+			framesRead = ReadNonInterleaved(buffers, std::min(frameCount, BufferListFrameCapacity(bufferList)));
+		}
+		else
+			return 0;
+
+		auto bytesPerBufferFrame = bufferList->mNumberBuffers == 1 ? sBytesPerFrame : sizeof(T);
+		for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+			bufferList->mBuffers[i].mDataByteSize = framesRead * bytesPerBufferFrame;
+
+		return framesRead;
+	}
+
+	/// Writes audio to the @c TypedAudioRingBuffer and advances the write pointer.
+	///
+	/// @c bufferList may contain either one buffer of @c Channels interleaved channels or @c Channels buffers of one
+	/// channel. At most as many frames as are contained in the smallest buffer are written.
+	/// @param bufferList An @c AudioBufferList containing the audio to copy
+	/// @param frameCount The desired number of frames to write
+	/// @return The number of frames actually written or @c 0 if the layout of @c bufferList is incompatible
+	uint32_t Write(const AudioBufferList * const _Nonnull bufferList, uint32_t frameCount) noexcept
+	{
+		if(IsInterleavedBufferList(bufferList))
+			return WriteInterleaved(static_cast<const T *>(bufferList->mBuffers[0].mData), std::min(frameCount, BufferListFrameCapacity(bufferList)));
+		else if(IsNonInterleavedBufferList(bufferList)) {
+			const T *buffers [Channels];
+			for(uint32_t i = 0; i < Channels; ++i)
+				buffers[i] = static_cast<const T *>(bufferList->mBuffers[i].mData);
+			return WriteNonInterleaved(buffers, std::min(frameCount, BufferListFrameCapacity(bufferList)));
+		}
+		return 0;
+	}
+
+
+	/// Advance the read position by the specified number of frames
+	inline void AdvanceReadPosition(uint32_t frameCount) noexcept
+	{
+		mReadPointer.store((mReadPointer.load(std::memory_order_acquire) + frameCount) & mCapacityFramesMask, std::memory_order_release);
+	}
+
+	/// Advance the write position by the specified number of frames
+	inline void AdvanceWritePosition(uint32_t frameCount) noexcept
+	{
+		mWritePointer.store((mWritePointer.load(std::memory_order_acquire) + frameCount) & mCapacityFramesMask, std::memory_order_release);
+	}
+
+#pragma mark Statistics
+
+	/// Returns the statistics for this @c TypedAudioRingBuffer in frames
+	/// @note Statistics are collected only when @c SFB_RING_BUFFER_STATISTICS is nonzero; otherwise all values are zero
+	inline RingBufferStatistics GetStatistics() const noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		return mStatistics.Snapshot();
+#else
+		return {};
+#endif
+	}
+
+	/// Discards the statistics for this @c TypedAudioRingBuffer
+	inline void ResetStatistics() noexcept
+	{
+#if SFB_RING_BUFFER_STATISTICS
+		mStatistics.Reset();
+#endif
+	}
+
+private:
+
+	/// Returns the number of frames available for reading
+	inline uint32_t ReadableFrames(uint32_t writePointer, uint32_t readPointer) const noexcept
+	{
+		return (writePointer - readPointer) & mCapacityFramesMask;
+	}
+
+	/// Returns the number of frames available for writing
+	inline uint32_t WritableFrames(uint32_t writePointer, uint32_t readPointer) const noexcept
+	{
+		return (readPointer - writePointer - 1) & mCapacityFramesMask;
+	}
+
+	/// Reads up to @c frameCount frames by calling @c copy(srcFrame, dstFrame, count) once or twice
+	template <typename F>
+	inline uint32_t ReadFrames(uint32_t frameCount, F&& copy) noexcept
+	{
+		if(frameCount == 0)
+			return 0;
+
+		auto readPointer = mReadPointer.load(std::memory_order_relaxed);
+
+		// Only reload the write location if the cached value doesn't satisfy the request
+		auto framesAvailable = ReadableFrames(mCachedWritePointer, readPointer);
+		if(framesAvailable < frameCount) {
+			mCachedWritePointer = mWritePointer.load(std::memory_order_acquire);
+			framesAvailable = ReadableFrames(mCachedWritePointer, readPointer);
+		}
+
+#if SFB_RING_BUFFER_STATISTICS
+		mStatistics.RecordRead(frameCount, framesAvailable);
+#endif
+
+		if(framesAvailable == 0)
+			return 0;
+
+		auto framesToRead = std::min(framesAvailable, frameCount);
+		if(readPointer + framesToRead > mCapacityFrames) {
+			auto framesAfterReadPointer = mCapacityFrames - readPointer;
+			copy(readPointer, 0, framesAfterReadPointer);
+			copy(0, framesAfterReadPointer, framesToRead - framesAfterReadPointer);
+		}
+		else
+			copy(readPointer, 0, framesToRead);
+
+		mReadPointer.store((readPointer + framesToRead) & mCapacityFramesMask, std::memory_order_release);
+
+		return framesToRead;
+	}
+
+	/// Writes up to @c frameCount frames by calling @c copy(dstFrame, srcFrame, count) once or twice
+	template <typename F>
+	inline uint32_t WriteFrames(uint32_t frameCount, F&& copy) noexcept
+	{
+		if(frameCount == 0)
+			return 0;
+
+		auto writePointer = mWritePointer.load(std::memory_order_relaxed);
+
+		// Only reload the read location if the cached value doesn't satisfy the request
+		auto framesAvailable = WritableFrames(writePointer, mCachedReadPointer);
+		if(framesAvailable < frameCount) {
+			mCachedReadPointer = mReadPointer.load(std::memory_order_acquire);
+			framesAvailable = WritableFrames(writePointer, mCachedReadPointer);
+		}
+
+#if SFB_RING_BUFFER_STATISTICS
+		mStatistics.RecordWrite(frameCount, framesAvailable, mCapacityFrames - 1);
+#endif
+
+		if(framesAvailable == 0)
+			return 0;
+
+		auto framesToWrite = std::min(framesAvailable, frameCount);
+		if(writePointer + framesToWrite > mCapacityFrames) {
+			auto framesAfterWritePointer = mCapacityFrames - writePointer;
+			copy(writePointer, 0, framesAfterWritePointer);
+			copy(0, framesAfterWritePointer, framesToWrite - framesAfterWritePointer);
+		}
+		else
+			copy(writePointer, 0, framesToWrite);
+
+		mWritePointer.store((writePointer + framesToWrite) & mCapacityFramesMask, std::memory_order_release);
+
+		return framesToWrite;
+	}
+
+	/// Interleaves @c frameCount frames from @c src starting at frame @c srcFrame to @c dst
+	static inline void InterleaveFrames(const T * const _Nonnull * const _Nonnull src, uint32_t srcFrame, T * const _Nonnull dst, uint32_t frameCount) noexcept
+	{
+		if constexpr(Channels == 1)
+			std::memcpy(dst, src[0] + srcFrame, frameCount * sizeof(T));
+		else if constexpr(Channels == 2)
+			detail::InterleaveStereo(src[0] + srcFrame, src[1] + srcFrame, dst, frameCount);
+		else {
+			for(uint32_t i = 0; i < frameCount; ++i) {
+				for(uint32_t channel = 0; channel < Channels; ++channel)
+					dst[i * Channels + channel] = src[channel][srcFrame + i];
+			}
+		}
+	}
+
+	/// Deinterleaves @c frameCount frames from @c src to @c dst starting at frame @c dstFrame
+	static inline void DeinterleaveFrames(const T * const _Nonnull src, T * const _Nonnull * const _Nonnull dst, uint32_t dstFrame, uint32_t frameCount) noexcept
+	{
+		if constexpr(Channels == 1)
+			std::memcpy(dst[0] + dstFrame, src, frameCount * sizeof(T));
+		else if constexpr(Channels == 2)
+			detail::DeinterleaveStereo(src, dst[0] + dstFrame, dst[1] + dstFrame, frameCount);
+		else {
+			for(uint32_t i = 0; i < frameCount; ++i) {
+				for(uint32_t channel = 0; channel < Channels; ++channel)
+					dst[channel][dstFrame + i] = src[i * Channels + channel];
+			}
+		}
+	}
+
+	/// Returns @c true if @c bufferList contains one buffer of @c Channels interleaved channels
+	static inline bool IsInterleavedBufferList(const AudioBufferList * const _Nullable bufferList) noexcept
+	{
+		return bufferList && bufferList->mNumberBuffers == 1 && bufferList->mBuffers[0].mNumberChannels == Channels && bufferList->mBuffers[0].mData;
+	}
+
+	/// Returns @c true if @c bufferList contains @c Channels buffers of one channel
+	static inline bool IsNonInterleavedBufferList(const AudioBufferList * const _Nullable bufferList) noexcept
+	{
+		if(!bufferList || bufferList->mNumberBuffers != Channels || Channels == 1)
+			return false;
+		for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i) {
+			if(bufferList->mBuffers[i].mNumberChannels != 1 || !bufferList->mBuffers[i].mData)
+				return false;
+		}
+		return true;
+	}
+
+	/// Returns the number of frames contained in the smallest buffer in @c bufferList
+	static inline uint32_t BufferListFrameCapacity(const AudioBufferList * const _Nonnull bufferList) noexcept
+	{
+		auto bytesPerBufferFrame = bufferList->mNumberBuffers == 1 ? sBytesPerFrame : sizeof(T);
+		auto frameCapacity = std::numeric_limits<uint32_t>::max();
+		for(UInt32 i = 0; i < bufferList->mNumberBuffers; ++i)
+			frameCapacity = std::min(frameCapacity, static_cast<uint32_t>(bufferList->mBuffers[i].mDataByteSize / bytesPerBufferFrame));
+		return frameCapacity;
+	}
+
+	/// The interleaved frames
+	T * _Nullable mBuffer;
+
+	/// The frame capacity
+	uint32_t mCapacityFrames;
+	/// Mask used to wrap read and write locations
+	/// @note Equal to @c mCapacityFrames-1
+	uint32_t mCapacityFramesMask;
+
+	/// The offset in frames of the write location
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mWritePointer;
+	/// The writer's copy of @c mReadPointer
+	uint32_t mCachedReadPointer;
+
+	/// The offset in frames of the read location
+	alignas(DestructiveInterferenceSize) std::atomic_uint32_t mReadPointer;
+	/// The reader's copy of @c mWritePointer
+	uint32_t mCachedWritePointer;
+
+#if SFB_RING_BUFFER_STATISTICS
+	/// The buffer's statistics
+	alignas(DestructiveInterferenceSize) RingBufferStatisticsCollector mStatistics;
+#endif
+
+};
+
+} // namespace SFB
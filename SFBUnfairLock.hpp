@@ -6,6 +6,9 @@
 
 #pragma once
 
+#import <algorithm>
+#import <cstdint>
+
 #import <os/lock.h>
 
 namespace SFB {
@@ -98,4 +101,122 @@ private:
 
 };
 
+/// A wrapper around @c os_unfair_lock implementing C++ @c Lockable that spins briefly before blocking
+///
+/// When the lock is contended @c lock() retries @c os_unfair_lock_trylock() up to @c SpinCount() times with an
+/// increasing number of processor pause hints between attempts before blocking in @c os_unfair_lock_lock().
+/// For very short critical sections this avoids the cost of parking and waking the thread in the kernel.
+///
+/// With the default spin count a contended @c lock() issues at most 111 pause hints before blocking. That is
+/// roughly 5 µs on x86 processors where a pause takes about 140 cycles, and less than 1 µs on Apple silicon.
+/// @note Spinning wastes processor time when the lock is held for long periods or the owner isn't running,
+/// so this lock should only protect critical sections of a few instructions.
+///
+/// @code
+/// SFB::AdaptiveUnfairLock _lock;
+/// // Later
+/// std::lock_guard<SFB::AdaptiveUnfairLock> lock(_lock);
+/// @endcode
+class AdaptiveUnfairLock
+{
+
+public:
+
+	/// The default number of attempts to acquire the lock before blocking
+	static constexpr uint32_t sDefaultSpinCount = 16;
+
+#pragma mark Creation and Destruction
+
+	/// Creates a new @c AdaptiveUnfairLock
+	/// @param spinCount The number of attempts to acquire the lock before blocking
+	inline explicit AdaptiveUnfairLock(uint32_t spinCount = sDefaultSpinCount) noexcept
+	: mLock(OS_UNFAIR_LOCK_INIT), mSpinCount(spinCount)
+	{}
+
+	// This class is non-copyable
+	AdaptiveUnfairLock(const AdaptiveUnfairLock& rhs) = delete;
+
+	// This class is non-assignable
+	AdaptiveUnfairLock& operator=(const AdaptiveUnfairLock& rhs) = delete;
+
+	// Destructor
+	~AdaptiveUnfairLock() = default;
+
+	// This class is non-movable
+	AdaptiveUnfairLock(AdaptiveUnfairLock&& rhs) = delete;
+
+	// This class is non-move assignable
+	AdaptiveUnfairLock& operator=(AdaptiveUnfairLock&& rhs) = delete;
+
+	/// Returns the number of attempts to acquire the lock before blocking
+	inline uint32_t SpinCount() const noexcept
+	{
+		return mSpinCount;
+	}
+
+#pragma mark Lockable
+
+	/// Locks the lock
+	inline void lock() noexcept
+	{
+		uint32_t pauseCount = 1;
+		for(uint32_t i = 0; i < mSpinCount; ++i) {
+			if(os_unfair_lock_trylock(&mLock))
+				return;
+			for(uint32_t j = 0; j < pauseCount; ++j)
+				Pause();
+			pauseCount = std::min(pauseCount * 2, sMaximumPauseCount);
+		}
+		os_unfair_lock_lock(&mLock);
+	}
+
+	/// Unlocks the lock
+	inline void unlock() noexcept
+	{
+		os_unfair_lock_unlock(&mLock);
+	}
+
+	/// Attempts to lock the lock
+	/// @return @c true if the lock was successfully locked, @c false on error
+	inline bool try_lock() noexcept
+	{
+		return os_unfair_lock_trylock(&mLock);
+	}
+
+#pragma mark Ownership
+
+	/// Asserts that the calling thread is the current owner of the lock.
+	inline void assert_owner() noexcept
+	{
+		os_unfair_lock_assert_owner(&mLock);
+	}
+
+	///	Asserts that the calling thread is not the current owner of the lock.
+	inline void assert_not_owner() noexcept
+	{
+		os_unfair_lock_assert_not_owner(&mLock);
+	}
+
+private:
+
+	/// The maximum number of pause hints between attempts to acquire the lock
+	static constexpr uint32_t sMaximumPauseCount = 8;
+
+	/// Hints to the processor that the calling thread is spinning
+	static inline void Pause() noexcept
+	{
+#if defined(__arm64__) || defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	/// The primitive lock
+	os_unfair_lock mLock;
+	/// The number of attempts to acquire the lock before blocking
+	const uint32_t mSpinCount;
+
+};
+
 } // namespace SFB
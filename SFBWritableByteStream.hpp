@@ -0,0 +1,284 @@
+//
+// Copyright (c) 2023 Stephen F. Booth <me@sbooth.org>
+// Part of https://github.com/sbooth/SFBAudioUtilities
+// MIT license
+//
+
+#pragma once
+
+#import <algorithm>
+#import <cstring>
+#import <stdexcept>
+#import <type_traits>
+
+#import <libkern/OSByteOrder.h>
+
+namespace SFB {
+
+/// A @c WritableByteStream provides heterogeneous typed writes to an untyped buffer.
+///
+/// This is the counterpart to @c ByteStream for serialization. The buffer is not resized; writes that don't fit fail
+/// without modifying the buffer or the write position.
+class WritableByteStream
+{
+
+public:
+
+	/// Creates an empty @c WritableByteStream
+	WritableByteStream() noexcept
+	: mBuffer(nullptr), mBufferLength(0), mWritePosition(0)
+	{}
+
+	/// Initializes a @c WritableByteStream object with the same buffer, length, and write position as @c rhs
+	/// @param rhs The object to copy
+	WritableByteStream(const WritableByteStream& rhs) noexcept
+	: mBuffer(rhs.mBuffer), mBufferLength(rhs.mBufferLength), mWritePosition(rhs.mWritePosition)
+	{}
+
+	/// Sets the buffer, length, and write position to those of @c rhs
+	/// @param rhs The object to copy
+	/// @return A reference to @c this
+	WritableByteStream& operator=(const WritableByteStream& rhs) noexcept
+	{
+		if(this != &rhs) {
+			mBuffer = rhs.mBuffer;
+			mBufferLength = rhs.mBufferLength;
+			mWritePosition = rhs.mWritePosition;
+		}
+		return *this;
+	}
+
+	/// Destructor
+	~WritableByteStream() = default;
+
+	/// Move constructor
+	WritableByteStream(WritableByteStream&& rhs) noexcept
+	: mBuffer(rhs.mBuffer), mBufferLength(rhs.mBufferLength), mWritePosition(rhs.mWritePosition)
+	{
+		rhs.mBuffer = nullptr;
+		rhs.mBufferLength = 0;
+		rhs.mWritePosition = 0;
+	}
+
+	/// Move assignment operator
+	WritableByteStream& operator=(WritableByteStream&& rhs) noexcept
+	{
+		if(this != &rhs) {
+			mBuffer = rhs.mBuffer;
+			mBufferLength = rhs.mBufferLength;
+			mWritePosition = rhs.mWritePosition;
+
+			rhs.mBuffer = nullptr;
+			rhs.mBufferLength = 0;
+			rhs.mWritePosition = 0;
+		}
+		return *this;
+	}
+
+
+	/// Initializes a @c WritableByteStream object with the specified buffer and length and sets the write position to @c 0
+	/// @param buf The buffer receiving the data
+	/// @param len The length of @c buf in bytes
+	/// @throw @c std::invalid_argument if @c buf==nullptr and @c len>0
+	WritableByteStream(void * const _Nullable buf, size_t len)
+	: mBuffer(buf), mBufferLength(len), mWritePosition(0)
+	{
+		if(!mBuffer && len > 0)
+			throw std::invalid_argument("!mBuffer && len > 0");
+	}
+
+
+	/// Writes an integral type and advances the write position
+	/// @tparam T The integral type to write
+	/// @param value The value to write
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value, bool>::type Write(T value) noexcept
+	{
+		return Write(&value, sizeof(value)) == sizeof(value);
+	}
+
+	/// Writes an unsigned integral type converted from host to little endian byte ordering and advances the write position
+	/// @tparam T The unsigned integral type to write
+	/// @param value The value to write
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type WriteLE(T value) noexcept
+	{
+		return Write(OSHostByteOrder() == OSLittleEndian ? value : Swapped(value));
+	}
+
+	/// Writes an unsigned integral type converted from host to big endian byte ordering and advances the write position
+	/// @tparam T The unsigned integral type to write
+	/// @param value The value to write
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type WriteBE(T value) noexcept
+	{
+		return Write(OSHostByteOrder() == OSBigEndian ? value : Swapped(value));
+	}
+
+	/// Swaps the byte ordering of an unsigned integral type, writes it, and advances the write position
+	/// @tparam T The unsigned integral type to write
+	/// @param value The value to write
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type WriteSwapped(T value) noexcept
+	{
+		return Write(Swapped(value));
+	}
+
+	/// Writes an array of unsigned integral types converted from host to little endian byte ordering and advances the write position
+	///
+	/// The bounds are checked once and no values are written unless all fit.
+	/// @tparam T The unsigned integral type to write
+	/// @param values The values to write
+	/// @param count The number of values to write
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type WriteLE(const T * const _Nonnull values, size_t count) noexcept
+	{
+		return WriteValues(values, count, OSHostByteOrder() != OSLittleEndian);
+	}
+
+	/// Writes an array of unsigned integral types converted from host to big endian byte ordering and advances the write position
+	///
+	/// The bounds are checked once and no values are written unless all fit.
+	/// @tparam T The unsigned integral type to write
+	/// @param values The values to write
+	/// @param count The number of values to write
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type WriteBE(const T * const _Nonnull values, size_t count) noexcept
+	{
+		return WriteValues(values, count, OSHostByteOrder() != OSBigEndian);
+	}
+
+	/// Swaps the byte ordering of an array of unsigned integral types, writes them, and advances the write position
+	///
+	/// The bounds are checked once and no values are written unless all fit.
+	/// @tparam T The unsigned integral type to write
+	/// @param values The values to write
+	/// @param count The number of values to write
+	/// @return @c true on success, @c false otherwise
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, bool>::type WriteSwapped(const T * const _Nonnull values, size_t count) noexcept
+	{
+		return WriteValues(values, count, true);
+	}
+
+	/// Writes bytes and advances the write position
+	///
+	/// No bytes are written unless all fit.
+	/// @param buf The source buffer
+	/// @param count The number of bytes to write
+	/// @return The number of bytes actually written, either @c count or @c 0
+	size_t Write(const void * const _Nonnull buf, size_t count) noexcept
+	{
+		if(count > Remaining())
+			return 0;
+		std::memcpy(static_cast<uint8_t *>(mBuffer) + mWritePosition, buf, count);
+		mWritePosition += count;
+		return count;
+	}
+
+	/// Advances the write position
+	///
+	/// Skipped bytes are not modified.
+	/// @param count The number of bytes to skip
+	/// @return The number of bytes actually skipped
+	size_t Skip(size_t count) noexcept
+	{
+		auto bytesToSkip = std::min(count, mBufferLength - mWritePosition);
+		mWritePosition += bytesToSkip;
+		return bytesToSkip;
+	}
+
+	/// Rewinds the write position
+	/// @param count The number of bytes to rewind
+	/// @return The number of bytes actually skipped
+	size_t Rewind(size_t count) noexcept
+	{
+		auto bytesToSkip = std::min(count, mWritePosition);
+		mWritePosition -= bytesToSkip;
+		return bytesToSkip;
+	}
+
+	/// Returns the number of bytes in the buffer
+	/// @return The number of bytes in the buffer
+	inline size_t Length() const noexcept
+	{
+		return mBufferLength;
+	}
+
+	/// Returns the number of bytes remaining
+	inline size_t Remaining() const noexcept
+	{
+		return mBufferLength - mWritePosition;
+	}
+
+	/// Returns the write position
+	/// @return The write posiiton
+	inline size_t Position() const noexcept
+	{
+		return mWritePosition;
+	}
+
+	/// Sets the write position
+	/// @param pos The desired write position
+	/// @return The new write posiiton
+	inline size_t SetPosition(size_t pos) noexcept
+	{
+		mWritePosition = std::min(pos, mBufferLength);
+		return mWritePosition;
+	}
+
+private:
+
+	/// Returns @c value with its byte ordering swapped
+	template <typename T>
+	static T Swapped(T value) noexcept
+	{
+		if constexpr(sizeof(T) == 2)
+			return static_cast<T>(OSSwapInt16(value));
+		else if constexpr(sizeof(T) == 4)
+			return static_cast<T>(OSSwapInt32(value));
+		else if constexpr(sizeof(T) == 8)
+			return static_cast<T>(OSSwapInt64(value));
+		else
+			return value;
+	}
+
+	/// Writes an array of integral types, optionally swapping their byte ordering, and advances the write position
+	template <typename T>
+	bool WriteValues(const T * const _Nonnull values, size_t count, bool swap) noexcept
+	{
+		// Dividing avoids overflow in count * sizeof(T)
+		if(count > Remaining() / sizeof(T))
+			return false;
+
+		auto dst = static_cast<uint8_t *>(mBuffer) + mWritePosition;
+		if(swap) {
+			// The buffer may not be aligned for T; the compiler vectorizes the swap and the fixed-size copy
+			for(size_t i = 0; i < count; ++i) {
+				auto value = Swapped(values[i]);
+				std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+			}
+		}
+		else
+			std::memcpy(dst, values, count * sizeof(T));
+
+		mWritePosition += count * sizeof(T);
+		return true;
+	}
+
+	/// The wrapped buffer
+	void * _Nullable mBuffer;
+	/// The number of bytes in @c mBuffer
+	size_t mBufferLength;
+	/// The current write position
+	size_t mWritePosition;
+
+};
+
+} // namespace SFB